@@ -6,7 +6,19 @@
 #include "DarknetUtil.h"
 #include "Util.h"
 
+#include "data/PrefetchingImageLoader.h"
+
+#include <algorithm>
 #include <cstring>
+#include <iostream>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#include <darknet/cuda.h>
+#include <darknet/parallel.h>
+#include <darknet/quantize.h>
+#include <darknet/resolution_plan.h>
 
 //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
 
@@ -23,28 +35,112 @@ char ** DarknetUtil::convert_vector_string_to_char_array(const std::vector<std::
   return array;
 }
 
+size_t DarknetUtil::default_loader_worker_count()
+{
+  const size_t hardwareThreads = std::max(1u, boost::thread::hardware_concurrency());
+
+#ifdef WITH_CUDA
+  if(gpu_index >= 0) return hardwareThreads;
+#endif
+
+  const size_t networkThreads = static_cast<size_t>(get_cpu_threads());
+  return std::max<size_t>(2, hardwareThreads > networkThreads ? hardwareThreads - networkThreads : 0);
+}
+
 std::vector<float> DarknetUtil::predict(network& net, const cv::Mat3b& im)
 {
-  if(net.w != im.cols || net.h != im.rows)
-    throw std::runtime_error("The network is expecting an image of size: " + net.w + 'x' + net.h);
+  return predict_batch(net, std::vector<cv::Mat3b>(1, im))[0];
+}
 
-  int netBatch = net.batch;
-  if(netBatch > 1) set_batch_network(&net, 1);
+std::vector<std::vector<float> > DarknetUtil::predict_batch(network& net, const std::vector<cv::Mat3b>& images)
+{
+  const int imageCount = static_cast<int>(images.size());
+  if(imageCount == 0) return std::vector<std::vector<float> >();
 
-  // TODO: this should go in DarknetUtil.
-  float *imData = Util::make_rgb_image(im, 1/255.0f);
+  if(net.allocated_batch && imageCount > net.allocated_batch)
+  {
+    throw std::runtime_error("The network can process at most " + boost::lexical_cast<std::string>(net.allocated_batch) + " images per batch");
+  }
 
-  float *cpredictions = network_predict(net, imData);
+  // Pack the images into a single planar RGB input tensor.
+  const int width = images[0].cols, height = images[0].rows;
+  const int imageSize = width * height * net.c;
+  std::vector<float> input(static_cast<size_t>(imageCount) * imageSize);
+  for(int i = 0; i < imageCount; ++i)
+  {
+    const cv::Mat3b& im = images[i];
+    if(im.cols != width || im.rows != height)
+    {
+      throw std::runtime_error("The images in a batch should all be the same size: " + boost::lexical_cast<std::string>(width) + 'x' + boost::lexical_cast<std::string>(height));
+    }
 
-  // size of output should be: gridSideLength * gridSideLength * (boxesPerGridcell * 5 + categoryCount).
-  // 5 = |boxParameters| + |confidenceScore|; 4 + 1.
-  int predictionSize = get_network_output_size(net);
-  // This does a copy;
-  std::vector<float> predictions {cpredictions, cpredictions + predictionSize};
+    Util::make_rgb_image(im, 1/255.0f, &input[static_cast<size_t>(i) * imageSize]);
+  }
 
-  set_batch_network(&net, netBatch);
+  return predict_tensor(net, &input[0], imageCount, width, height);
+}
+
+std::vector<std::vector<float> > DarknetUtil::predict_tensor(network& net, float *input, int imageCount, int width, int height)
+{
+  if(imageCount == 0) return std::vector<std::vector<float> >();
+
+  if(net.allocated_batch && imageCount > net.allocated_batch)
+  {
+    throw std::runtime_error("The network can process at most " + boost::lexical_cast<std::string>(net.allocated_batch) + " images per batch");
+  }
+
+  if(width == 0) width = net.w;
+  if(height == 0) height = net.h;
 
-  delete [] imData;
+  float *cpredictions;
+  int predictionSize;
+  if(width != net.w || height != net.h)
+  {
+    resolution_plan *plan = get_resolution_plan(&net, width, height);
+    cpredictions = predict_resolution_plan(plan, input, imageCount);
+    predictionSize = get_network_output_size(plan->net);
+  }
+  else
+  {
+    int netBatch = net.batch;
+    if(netBatch != imageCount) set_batch_network(&net, imageCount);
+    cpredictions = network_predict(net, input);
+    predictionSize = get_network_output_size(net);
+    if(netBatch != imageCount) set_batch_network(&net, netBatch);
+  }
+
+  // size of output per image should be: gridSideLength * gridSideLength * (boxesPerGridcell * 5 + categoryCount).
+  // 5 = |boxParameters| + |confidenceScore|; 4 + 1.
+  std::vector<std::vector<float> > predictions(imageCount);
+  for(int i = 0; i < imageCount; ++i)
+  {
+    const float *begin = cpredictions + static_cast<size_t>(i) * predictionSize;
+    predictions[i].assign(begin, begin + predictionSize);
+  }
 
   return predictions;
 }
+
+void DarknetUtil::quantize(network& net, const std::vector<std::string>& calibrationImagePaths, size_t loaderWorkerCount)
+{
+  if(calibrationImagePaths.empty()) throw std::runtime_error("Cannot quantize the network without any calibration images");
+
+  int netBatch = net.batch;
+  set_batch_network(&net, 1);
+
+  std::cout << "Calibrating the int8 quantization on " << calibrationImagePaths.size() << " images.." << std::endl;
+  PrefetchingImageLoader loader(calibrationImagePaths, net.w, net.h, loaderWorkerCount);
+  PrefetchingImageLoader::Item item;
+  while(loader.pop(item))
+  {
+    if(!item.error.empty())
+    {
+      std::cerr << "Skipping calibration image " << calibrationImagePaths[item.index] << ": " << item.error << '\n';
+      continue;
+    }
+    calibrate_quantization(net, &item.tensor[0]);
+  }
+
+  quantize_network(&net);
+  set_batch_network(&net, netBatch);
+}
@@ -21,8 +21,58 @@ struct DarknetUtil
 //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
 static char ** convert_vector_string_to_char_array(const std::vector<std::string>& v);
 
+/**
+ * \brief Chooses how many threads should load images for the network.
+ *
+ * When the network runs on the GPU, its CPU thread pool sits idle and every hardware thread can decode images.
+ * Otherwise the loader gets the hardware threads that the network layers leave free (see get_cpu_threads),
+ * but at least two.
+ */
+static size_t default_loader_worker_count();
+
 static std::vector<float> predict(network& net, const cv::Mat3b& im);
 
+/**
+ * \brief Runs a single forward pass over a batch of images.
+ *
+ * The images are packed into one contiguous input tensor, so the work in each layer is shared across the batch.
+ * The images must all be the same size, and the batch may be no larger than the batch the network was built with.
+ * Images that are not net.w x net.h are run through a resolution plan for their size (see predict_tensor).
+ *
+ * \param net     The network.
+ * \param images  The images.
+ * \return        The raw network output for each image.
+ */
+static std::vector<std::vector<float> > predict_batch(network& net, const std::vector<cv::Mat3b>& images);
+
+/**
+ * \brief Runs a single forward pass over a batch of images that have already been packed into an input tensor.
+ *
+ * An input size other than net.w x net.h is served by a resolution plan that shares the weights of the network,
+ * made the first time the size is used and kept with the network for later batches.
+ *
+ * \param net         The network.
+ * \param input       The input tensor: imageCount consecutive planar RGB images of size width x height, scaled to [0,1].
+ * \param imageCount  The number of images in the tensor.
+ * \param width       The width of the images (0 for net.w).
+ * \param height      The height of the images (0 for net.h).
+ * \return            The raw network output for each image.
+ */
+static std::vector<std::vector<float> > predict_tensor(network& net, float *input, int imageCount, int width = 0, int height = 0);
+
+/**
+ * \brief Quantises the convolutional and connected layers of a network to int8 for inference on the CPU.
+ *
+ * The range of the input of each layer is first calibrated by running the fp32 network on the calibration images.
+ * Once quantised, the network can no longer be trained or saved.
+ *
+ * \param net                     The network.
+ * \param calibrationImagePaths   The paths to the calibration images, which should be representative of the data the network will see.
+ * \param loaderWorkerCount       The number of threads that load the calibration images (0 for the loader's default).
+ * \throws std::runtime_error     If there are no calibration images.
+ */
+static void quantize(network& net, const std::vector<std::string>& calibrationImagePaths, size_t loaderWorkerCount = 0);
+
 //static float train(network& net, const Datum& datum, 
 };
 
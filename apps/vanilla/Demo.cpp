@@ -61,6 +61,8 @@ TIME( // Capture a video frame.
     {
       const cv::Mat3b& im = m_capture.frame;
 
+    const LazyMask::Statistics initialMaskStatistics = LazyMask::get_statistics();
+
 TIME( // Run the detection.
     std::vector<float> predictions = m_movingPredictionAverage.push(DetectionUtil::get_raw_predictions(net, im, im.cols, im.rows));
 
@@ -68,11 +70,15 @@ TIME( // Run the detection.
 
     if(m_detectionSettings.nms)
     {
-      detections = DetectionUtil::non_maximal_suppression(detections, m_detectionSettings.overlapThreshold);
+      detections = DetectionUtil::non_maximal_suppression(detections, m_detectionSettings.overlapThreshold, m_detectionSettings.maskNMS);
     }
 
+    // Only the masks of the detections that will be displayed are decoded.
+    DetectionUtil::decode_masks(detections, m_detectionSettings.detectionThreshold);
+
 , microseconds, detectionStep);
     std::cout << "detectionStep:" << detectionStep.duration().count()/1000.0 << '\n';
+    std::cout << "shapeMasks: " << (LazyMask::get_statistics() - initialMaskStatistics) << '\n';
     static MovingAverage<double> processingTimeAverage(50, 0.0);
     m_processingTime = processingTimeAverage.push(double(detectionStep.duration().count()/1000.0));
 
@@ -4,7 +4,7 @@
  */
 
 #include "core/DetectionComparator.h"
-#include "data/InputDataAssembler.h"
+#include "data/PrefetchingImageLoader.h"
 #include "DetectionUtil.h"
 #include "Util.h"
 
@@ -12,7 +12,9 @@
 
 #include "core/Box.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -24,7 +26,16 @@ using namespace tvgshape;
 
 #include <tvgplot/PaletteGenerator.h>
 
-typedef boost::shared_ptr<CircularQueue<std::pair<cv::Mat3b,cv::Size> > > CQ_Ptr;
+namespace {
+
+/** Returns whether or not a detection has a non-zero score for some category (and so can suppress others). */
+bool is_candidate(const Detection& detection)
+{
+  const std::vector<float>& scores = detection.second;
+  return !scores.empty() && *std::max_element(scores.begin(), scores.end()) >= std::numeric_limits<float>::min();
+}
+
+}
 
 std::vector<Detections> DetectionUtil::detect(network& net, const std::vector<std::string>& paths, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
 {
@@ -41,35 +52,102 @@ std::vector<Detections> DetectionUtil::detect(network& net, const std::vector<st
   return detections;
 }
 
-std::vector<Detections> DetectionUtil::detect_fast(network& net, const std::vector<std::string>& paths, const DetectionSettings& ds, const boost::optional<ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
+std::vector<Detections> DetectionUtil::detect_fast(network& net, const std::vector<std::string>& paths, const DetectionSettings& ds, const boost::optional<ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator, size_t batchSize, size_t loaderWorkerCount)
 {
   size_t pathCount = paths.size();
   std::vector<Detections> detections(pathCount);
+  if(pathCount == 0) return detections;
 
-  //TODO: only store shared pointers to types in the circular queue.
-  CQ_Ptr dataBuffer(new CircularQueue<std::pair<cv::Mat3b,cv::Size> >(10));
-  InputDataAssembler dataLoader(paths, dataBuffer, net.w, net.h);
-  boost::thread dataLoadingThread(&InputDataAssembler::run_load_loop, boost::ref(dataLoader));
+  if(batchSize == 0) batchSize = 1;
+  if(net.allocated_batch > 0 && batchSize > static_cast<size_t>(net.allocated_batch)) batchSize = net.allocated_batch;
 
-  for(size_t i = 0; i < pathCount; ++i)
+  // The loader decodes, resizes and converts the images on its own worker threads, so each batch only needs to be copied into the input tensor.
+  const cv::Size inputSize = network_input_size(net, ds);
+  PrefetchingImageLoader loader(paths, inputSize.width, inputSize.height, loaderWorkerCount);
+  const LazyMask::Statistics initialMaskStatistics = LazyMask::get_statistics();
+
+  const size_t imageSize = static_cast<size_t>(inputSize.width) * inputSize.height * 3;
+  std::vector<float> input(batchSize * imageSize);
+  std::vector<cv::Size> originalSizes;
+  PrefetchingImageLoader::Item item;
+  for(size_t i = 0; i < pathCount; i += batchSize)
   {
-    if(i > 0)
+    const size_t currentBatchSize = std::min(batchSize, pathCount - i);
+
+    // Gather the next batch of images from the loader.
+    originalSizes.resize(currentBatchSize);
+    for(size_t j = 0; j < currentBatchSize; ++j)
     {
-      if(i % 50 == 0) std::cout << i << ' ' << std::flush;
-      if(i % 500 == 0) std::cout << std::endl;
+      if(!loader.pop(item)) throw std::runtime_error("The image loader ran out of images");
+      std::copy(item.tensor.begin(), item.tensor.end(), input.begin() + j * imageSize);
+      originalSizes[j] = item.originalSize;
     }
 
-    while(true)
+    std::vector<Detections> batchDetections = detect_batch(net, &input[0], originalSizes, ds, shapeDescriptorCalculator);
+    for(size_t j = 0; j < currentBatchSize; ++j)
     {
-      boost::optional<const std::pair<cv::Mat3b,cv::Size>& > data = dataBuffer->pop();
-      if(data)
+      detections[i + j] = batchDetections[j];
+
+      const size_t k = i + j;
+      if(k > 0)
       {
-        detections[i] = detect(net, (*data).first, (*data).second.width, (*data).second.height, ds, shapeDescriptorCalculator);
-        break;
+        if(k % 50 == 0) std::cout << k << ' ' << std::flush;
+        if(k % 500 == 0) std::cout << std::endl;
       }
     }
   }
-  std::cout << '\n' << std::endl;
+  std::cout << '\n' << loader.get_counters() << '\n';
+  std::cout << "Shape masks: " << (LazyMask::get_statistics() - initialMaskStatistics) << '\n' << std::endl;
+
+  return detections;
+}
+
+std::vector<Detections> DetectionUtil::detect_batch(network& net, const std::vector<cv::Mat3b>& images, const std::vector<cv::Size>& originalSizes, const DetectionSettings& ds, const boost::optional<ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
+{
+  const size_t imageCount = images.size();
+  if(originalSizes.size() != imageCount) throw std::runtime_error("Expected one original size per image");
+  if(imageCount == 0) return std::vector<Detections>();
+
+  // Bring every image to the network input size and pack them into a single input tensor.
+  const cv::Size inputSize = network_input_size(net, ds);
+  const size_t imageSize = static_cast<size_t>(inputSize.width) * inputSize.height * 3;
+  std::vector<float> input(imageCount * imageSize);
+  cv::Mat3b resizedImage;
+  for(size_t i = 0; i < imageCount; ++i)
+  {
+    const cv::Mat3b& image = images[i];
+    if(image.size() != inputSize)
+    {
+      if(image.cols != originalSizes[i].width || image.rows != originalSizes[i].height)
+      {
+        throw std::runtime_error("The original image width and the input image width should be the same");
+      }
+      cv::resize(image, resizedImage, inputSize);
+      Util::make_rgb_image(resizedImage, 1/255.0f, &input[i * imageSize]);
+    }
+    else
+    {
+      // Assume that the image has been resized externally.
+      Util::make_rgb_image(image, 1/255.0f, &input[i * imageSize]);
+    }
+  }
+
+  return detect_batch(net, &input[0], originalSizes, ds, shapeDescriptorCalculator);
+}
+
+std::vector<Detections> DetectionUtil::detect_batch(network& net, float *input, const std::vector<cv::Size>& originalSizes, const DetectionSettings& ds, const boost::optional<ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
+{
+  const size_t imageCount = originalSizes.size();
+  if(imageCount == 0) return std::vector<Detections>();
+
+  const cv::Size inputSize = network_input_size(net, ds);
+  std::vector<std::vector<float> > predictions = DarknetUtil::predict_tensor(net, input, static_cast<int>(imageCount), inputSize.width, inputSize.height);
+
+  std::vector<Detections> detections(imageCount);
+  for(size_t i = 0; i < imageCount; ++i)
+  {
+    detections[i] = process_predictions(predictions[i], originalSizes[i].width, originalSizes[i].height, ds, shapeDescriptorCalculator);
+  }
 
   return detections;
 }
@@ -84,17 +162,24 @@ Detections DetectionUtil::detect(network& net, const std::string& path, const De
 
 Detections DetectionUtil::detect(network& net, const cv::Mat3b& image, int originalImageWidth, int originalImageHeight, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
 {
-  std::vector<float> predictions = get_raw_predictions(net, image, originalImageWidth, originalImageHeight);
+  std::vector<float> predictions = get_raw_predictions(net, image, originalImageWidth, originalImageHeight, network_input_size(net, ds));
+  return process_predictions(predictions, originalImageWidth, originalImageHeight, ds, shapeDescriptorCalculator);
+}
 
+Detections DetectionUtil::process_predictions(const std::vector<float>& predictions, int originalImageWidth, int originalImageHeight, const DetectionSettings& ds, const boost::optional<ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
+{
   Detections d = DetectionUtil::extract_detections(predictions, ds, originalImageWidth, originalImageHeight, shapeDescriptorCalculator);
 
   if(ds.nms)
   {
-    d = DetectionUtil::non_maximal_suppression(d, ds.overlapThreshold);
+    d = DetectionUtil::non_maximal_suppression(d, ds.overlapThreshold, ds.maskNMS);
   }
 
   d = DetectionUtil::prune_detections(d, ds.detectionThreshold);
 
+  // Decode the masks of the surviving detections together.
+  DetectionUtil::decode_masks(d, ds.detectionThreshold);
+
   return d;
   /*
   if(ds.nms) return DetectionUtil::non_maximal_suppression(d, ds.overlapThreshold);
@@ -119,10 +204,25 @@ Detections DetectionUtil::prune_detections(const Detections& detections, float d
   return pruned;
 }
 
-std::vector<float> DetectionUtil::get_raw_predictions(network& net, const cv::Mat3b& image, int originalImageWidth, int originalImageHeight)
+void DetectionUtil::decode_masks(const Detections& detections, float detectionThreshold)
 {
-  const int imageWidthNetwork = net.w;
-  const int imageHeightNetwork = net.h;
+  std::vector<LazyMask_CPtr> masks;
+  for(size_t i = 0, detectionCount = detections.size(); i < detectionCount; ++i)
+  {
+    const LazyMask_CPtr& mask = detections[i].first.get_lazy_mask();
+    if(!mask || mask->is_decoded()) continue;
+
+    const std::vector<float>& scores = detections[i].second;
+    if(scores[ArgUtil::argmax(scores)] >= detectionThreshold) masks.push_back(mask);
+  }
+
+  LazyMask::decode(masks);
+}
+
+std::vector<float> DetectionUtil::get_raw_predictions(network& net, const cv::Mat3b& image, int originalImageWidth, int originalImageHeight, const cv::Size& inputSize)
+{
+  const int imageWidthNetwork = inputSize.width > 0 ? inputSize.width : net.w;
+  const int imageHeightNetwork = inputSize.height > 0 ? inputSize.height : net.h;
 
   std::vector<float> predictions;
   if(image.cols != imageWidthNetwork || image.rows != imageHeightNetwork)
@@ -131,7 +231,7 @@ std::vector<float> DetectionUtil::get_raw_predictions(network& net, const cv::Ma
     {
       throw std::runtime_error("The original image width and the input image width should be the same");
     }
-    cv::Mat3b resizedImage(net.w, net.h);
+    cv::Mat3b resizedImage(imageHeightNetwork, imageWidthNetwork);
     cv::resize(image, resizedImage, cv::Size(imageWidthNetwork, imageHeightNetwork));
     predictions = DarknetUtil::predict(net, resizedImage);
   }
@@ -144,6 +244,12 @@ std::vector<float> DetectionUtil::get_raw_predictions(network& net, const cv::Ma
   return predictions;
 }
 
+cv::Size DetectionUtil::network_input_size(const network& net, const DetectionSettings& ds)
+{
+  if(ds.inputSize == 0) return cv::Size(net.w, net.h);
+  return cv::Size(static_cast<int>(ds.inputSize), static_cast<int>(ds.inputSize));
+}
+
 Detections DetectionUtil::extract_detections(const std::vector<float>& predictions, const DetectionSettings& ds, size_t inputImageWidth, size_t inputImageHeight, const boost::optional<ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
 {
   const size_t categoryCount = ds.categoryCount;
@@ -152,6 +258,9 @@ Detections DetectionUtil::extract_detections(const std::vector<float>& predictio
 
   size_t cellCount = gridSide * gridSide;
   Detections detections(boxesPerCell * cellCount);
+
+  // The shape descriptors are not decoded here, since most of the boxes will be discarded by non-maximal suppression
+  // and thresholding: each mask is decoded when it is first needed, or together with the others by decode_masks.
   for(size_t i = 0; i < cellCount; ++i)
   {
     // Get the row and column index, cells are in row major format.
@@ -218,7 +327,7 @@ Detections DetectionUtil::extract_detections(const std::vector<float>& predictio
         }
       }
 
-      cv::Mat1b mask;
+      Shape shape(vbox);
       if((ds.paramsPerShapeEncoding > 0) && (maxConfidence >= ds.detectionThreshold)) // If shape is activated.
       {
         const float *shapeData = &predictions[boxIndex + ds.paramsPerBox];
@@ -226,7 +335,7 @@ Detections DetectionUtil::extract_detections(const std::vector<float>& predictio
         if(shapeDescriptorCalculator)
         {
           std::vector<float> encoding(shapeData, shapeData + ds.paramsPerShapeEncoding);
-          mask = (*shapeDescriptorCalculator)->to_mask(encoding, cv::Size(vbox.w(), vbox.h()));
+          shape = Shape(vbox, LazyMask_CPtr(new LazyMask(encoding, cv::Size(vbox.w(), vbox.h()), *shapeDescriptorCalculator)));
         }
         else throw std::runtime_error("Expecting a shape descriptor calculator!");
       }
@@ -237,7 +346,6 @@ Detections DetectionUtil::extract_detections(const std::vector<float>& predictio
         classConfidenceScores[0] = boxConfidence;
       }
 
-      Shape shape(vbox, mask);
       detections[arrayIndex] = std::make_pair(shape, classConfidenceScores);
     }
   }
@@ -245,7 +353,7 @@ Detections DetectionUtil::extract_detections(const std::vector<float>& predictio
   return detections;
 }
 
-Detections DetectionUtil::non_maximal_suppression(const Detections& d, float overlapThreshold)
+Detections DetectionUtil::non_maximal_suppression(const Detections& d, float overlapThreshold, bool maskRefinement)
 {
   if(d.empty()) return d;
 
@@ -253,28 +361,73 @@ Detections DetectionUtil::non_maximal_suppression(const Detections& d, float ove
 
   size_t detectionCount = nmsd.size();
   size_t categoryCount = nmsd[0].second.size();
+
+  // The detections are sorted by index rather than moved, so that the packed masks can be cached by index.
+  std::vector<size_t> order(detectionCount);
+  for(size_t i = 0; i < detectionCount; ++i) order[i] = i;
+
+  std::vector<boost::optional<BitMask> > bitMasks;
+  if(maskRefinement)
+  {
+    // Only the masks of the candidates whose boxes overlap those of other candidates can be compared, so decode those together.
+    std::vector<LazyMask_CPtr> masks;
+    for(size_t i = 0; i < detectionCount; ++i)
+    {
+      if(!nmsd[i].first.get_lazy_mask() || !is_candidate(nmsd[i])) continue;
+
+      VOCBox b1 = nmsd[i].first.get_voc_box();
+      for(size_t j = 0; j < detectionCount; ++j)
+      {
+        if(j != i && is_candidate(nmsd[j]) && b1.overlap(nmsd[j].first.get_voc_box()) > 0.0f)
+        {
+          masks.push_back(nmsd[i].first.get_lazy_mask());
+          break;
+        }
+      }
+    }
+    LazyMask::decode(masks);
+
+    bitMasks.resize(detectionCount);
+  }
+
   for(size_t c = 0; c < categoryCount; ++c)
   {
     DetectionComparator<Detection> comp(c, std::greater<float>());
-    std::sort(nmsd.begin(), nmsd.end(), comp);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return comp(nmsd[a], nmsd[b]); });
 
     for(size_t i = 0; i < detectionCount; ++i)
     {
-      if(nmsd[i].second[c] < std::numeric_limits<float>::min()) continue;
+      const size_t k1 = order[i];
+      if(nmsd[k1].second[c] < std::numeric_limits<float>::min()) continue;
 
-      VOCBox b1 = nmsd[i].first.get_voc_box();
+      VOCBox b1 = nmsd[k1].first.get_voc_box();
       for(size_t j = i + 1; j < detectionCount; ++j)
       {
-        VOCBox b2 = nmsd[j].first.get_voc_box();
-        if(b1.overlap(b2) > overlapThreshold)
+        const size_t k2 = order[j];
+        VOCBox b2 = nmsd[k2].first.get_voc_box();
+        float overlap = b1.overlap(b2);
+
+        // When refining, the masks of overlapping candidates replace their boxes (masks can only overlap if their boxes do).
+        if(maskRefinement && overlap > 0.0f && nmsd[k2].second[c] >= std::numeric_limits<float>::min() && nmsd[k1].first.has_mask() && nmsd[k2].first.has_mask())
         {
-          nmsd[j].second[c] = -1.0f;
+          if(!bitMasks[k1]) bitMasks[k1] = nmsd[k1].first.get_bit_mask();
+          if(!bitMasks[k2]) bitMasks[k2] = nmsd[k2].first.get_bit_mask();
+          overlap = static_cast<float>(bitMasks[k1]->calculate_IoU(*bitMasks[k2]));
+        }
+
+        if(overlap > overlapThreshold)
+        {
+          nmsd[k2].second[c] = -1.0f;
         }
       }
     }
   }
 
-  return nmsd;
+  // Return the detections in the order in which they were sorted for the last category.
+  Detections sorted(detectionCount);
+  for(size_t i = 0; i < detectionCount; ++i) sorted[i] = nmsd[order[i]];
+
+  return sorted;
 }
 
 cv::Mat3b DetectionUtil::overlay_detections(const cv::Mat3b& im, const Detections& detections, float displayDetectionThreshold, const std::vector<std::string>& categoryNames, const std::map<size_t,cv::Scalar>& palette)
@@ -28,20 +28,56 @@ struct DetectionUtil
 
 static std::vector<Detections> detect(network& net, const std::vector<std::string>& paths, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
 
-static std::vector<Detections> detect_fast(network& net, const std::vector<std::string>& paths, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
+static std::vector<Detections> detect_fast(network& net, const std::vector<std::string>& paths, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none, size_t batchSize = 1, size_t loaderWorkerCount = 0);
+
+/**
+ * \brief Detects objects in a batch of images using a single forward pass of the network.
+ *
+ * \param images         The images, either already resized to the network input size or at their original sizes.
+ * \param originalSizes  The original size of each image, which the detections are expressed in.
+ */
+static std::vector<Detections> detect_batch(network& net, const std::vector<cv::Mat3b>& images, const std::vector<cv::Size>& originalSizes, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
+
+/**
+ * \brief Detects objects in a batch of images that have already been packed into an input tensor, using a single forward pass of the network.
+ *
+ * \param input          The input tensor: one planar RGB image of the network input size (see network_input_size) per original size, scaled to [0,1].
+ * \param originalSizes  The original size of each image, which the detections are expressed in.
+ */
+static std::vector<Detections> detect_batch(network& net, float *input, const std::vector<cv::Size>& originalSizes, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
 
 static Detections detect(network& net, const std::string& path, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
 
 static Detections detect(network& net, const cv::Mat3b& image, int originalImageWidth, int originalImageHeight, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
 
-static std::vector<float> get_raw_predictions(network& net, const cv::Mat3b& image, int originalImageWidth, int originalImageHeight);
+/**
+ * \brief Runs the network on one image, resizing it to the network input size first if need be.
+ *
+ * \param inputSize  The size to run the network at (empty for net.w x net.h).
+ */
+static std::vector<float> get_raw_predictions(network& net, const cv::Mat3b& image, int originalImageWidth, int originalImageHeight, const cv::Size& inputSize = cv::Size());
+
+/** Returns the size the images are run through the network at: ds.inputSize x ds.inputSize, or net.w x net.h if ds.inputSize is 0. */
+static cv::Size network_input_size(const network& net, const DetectionSettings& ds);
+
+/** Turns the raw network output for one image into its final detections (extraction, non-maximal suppression, pruning and the decoding of the surviving masks). */
+static Detections process_predictions(const std::vector<float>& predictions, int originalImageWidth, int originalImageHeight, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
 
 static Detections extract_detections(const std::vector<float>& predictions, const DetectionSettings& ds, size_t inputImageWidth, size_t inputImageHeight, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
 
-static Detections non_maximal_suppression(const Detections& d, float overlapThreshold);
+/**
+ * \brief Suppresses the detections of each category that overlap a higher-scoring detection of that category by more than a threshold.
+ *
+ * \param maskRefinement  Whether to measure the overlap of detections whose boxes overlap by the IoU of their masks
+ *                        rather than of their boxes (only the masks of such detections are decoded).
+ */
+static Detections non_maximal_suppression(const Detections& d, float overlapThreshold, bool maskRefinement = false);
 
 static Detections prune_detections(const Detections& d, float detectionThreshold);
 
+/** Decodes together the lazy masks of the detections whose best score reaches the threshold (and that have yet to be decoded). */
+static void decode_masks(const Detections& detections, float detectionThreshold);
+
 static cv::Mat3b overlay_detections(const cv::Mat3b& im, const Detections& detections, float displayDetectionThreshold, const std::vector<std::string>& categoryNames, const std::map<size_t,cv::Scalar>& palette);
 
 static Detections voc_objects_to_detections(const std::vector<VOCObject>& objects, size_t categoryCount);
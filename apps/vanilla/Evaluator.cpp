@@ -4,13 +4,16 @@
  */
 
 #include "Evaluator.h"
+#include "DarknetUtil.h"
 #include "DetectionUtil.h"
 #include "Util.h"
 
 #include "core/Detection.h"
-#include "core/TupleComparator.h"
 
+#include <algorithm>
+#include <fstream>
 #include <numeric>
+#include <sstream>
 
 #include <boost/assign/list_of.hpp>
 #include <boost/bind/bind.hpp>
@@ -19,6 +22,9 @@
 #include <boost/format.hpp>
 using namespace boost::assign;
 
+#include <darknet/low_rank.h>
+#include <darknet/resolution_plan.h>
+
 #include <evaluation/core/PerformanceMeasure.h>
 #include <evaluation/core/PerformanceTable.h>
 using namespace evaluation;
@@ -32,9 +38,11 @@ using namespace tvgshape;
 
 //#################### CONSTRUCTORS ####################
 
-Evaluator::Evaluator(const Dataset_CPtr& dataset, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
-: m_dataset(dataset),
+Evaluator::Evaluator(const Dataset_CPtr& dataset, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator, size_t batchSize, size_t loaderWorkerCount)
+: m_batchSize(batchSize),
+  m_dataset(dataset),
   m_ds(ds),
+  m_loaderWorkerCount(loaderWorkerCount),
   m_shapeDescriptorCalculator(shapeDescriptorCalculator)
 {}
 
@@ -47,12 +55,18 @@ double Evaluator::calculate_map(network& net, const std::string& saveResultsPath
   std::vector<std::string> imagePaths= m_dataset->get_image_paths(vocYear, vocSplit, VOC_JPEG, maxImages);
 
   std::cout << "\nCalculating detections..\n" << std::endl;
-  std::vector<NamedCategoryDetections> perClassNamedCategoryDetections = calculate_detections_per_category(net, imagePaths);
+  TIME(std::vector<NamedCategoryDetections> perClassNamedCategoryDetections = calculate_detections_per_category(net, imagePaths), milliseconds, detectionPhase);
 
   std::cout << "\nPreparing the ground truth..\n" << std::endl;
-  NameToVOCObjectsHash nameToVOCObjectsHash = create_name_to_objects_hash(imagePaths);
+  TIME(NameToVOCObjectsHash nameToVOCObjectsHash = create_name_to_objects_hash(imagePaths), milliseconds, groundTruthPhase);
+
+  std::cout << "\nMatching the detections to the ground truth..\n" << std::endl;
+  TIME(std::vector<CategoryMatches> categoryMatches = match_detections(nameToVOCObjectsHash, perClassNamedCategoryDetections), milliseconds, matchingPhase);
 
-  return calculate_map(perClassNamedCategoryDetections, nameToVOCObjectsHash, saveResultsPath, uniqueStamp, overlapThreshold);
+  TIME(double meanAveragePrecision = calculate_map(categoryMatches, saveResultsPath, uniqueStamp, overlapThreshold), milliseconds, precisionRecallPhase);
+
+  print_phase_timings(detectionPhase, groundTruthPhase, matchingPhase, precisionRecallPhase);
+  return meanAveragePrecision;
 }
 
 double Evaluator::calculate_map_vol(network& net, const std::string& saveResultsPath, VOCYear vocYear, VOCSplit vocSplit, const std::string& uniqueStamp, const std::vector<double>& overlapThresholds, const boost::optional<size_t>& maxImages) const
@@ -62,17 +76,25 @@ double Evaluator::calculate_map_vol(network& net, const std::string& saveResults
   std::vector<std::string> imagePaths= m_dataset->get_image_paths(vocYear, vocSplit, VOC_JPEG, maxImages);
 
   std::cout << "\nCalculating detections..\n" << std::endl;
-  std::vector<NamedCategoryDetections> perClassNamedCategoryDetections = calculate_detections_per_category(net, imagePaths);
+  TIME(std::vector<NamedCategoryDetections> perClassNamedCategoryDetections = calculate_detections_per_category(net, imagePaths), milliseconds, detectionPhase);
 
   std::cout << "\nPreparing the ground truth..\n" << std::endl;
-  NameToVOCObjectsHash nameToVOCObjectsHash = create_name_to_objects_hash(imagePaths);
+  TIME(NameToVOCObjectsHash nameToVOCObjectsHash = create_name_to_objects_hash(imagePaths), milliseconds, groundTruthPhase);
+
+  // The matches do not depend on the overlap threshold, so they only need to be found once.
+  std::cout << "\nMatching the detections to the ground truth..\n" << std::endl;
+  TIME(std::vector<CategoryMatches> categoryMatches = match_detections(nameToVOCObjectsHash, perClassNamedCategoryDetections), milliseconds, matchingPhase);
 
   std::vector<double> mapPerThreshold(overlapThresholds.size());
+  TIME(
   for(size_t i = 0; i < overlapThresholds.size(); ++i)
   {
     std::cout << "\nCalculating map with overlap threshold: " << overlapThresholds[i] << std::endl;
-    mapPerThreshold[i] = calculate_map(perClassNamedCategoryDetections, nameToVOCObjectsHash, saveResultsPath, uniqueStamp, overlapThresholds[i]);
+    mapPerThreshold[i] = calculate_map(categoryMatches, saveResultsPath, uniqueStamp, overlapThresholds[i]);
   }
+  , milliseconds, precisionRecallPhase);
+
+  print_phase_timings(detectionPhase, groundTruthPhase, matchingPhase, precisionRecallPhase);
 
   boost::format tenDecimalPlaces("%0.10f");
   double mapVol = Util::average_vector(mapPerThreshold);
@@ -83,13 +105,137 @@ double Evaluator::calculate_map_vol(network& net, const std::string& saveResults
   return mapVol;
 }
 
+double Evaluator::calculate_map_vol_int8(network& net, const std::vector<std::string>& calibrationImagePaths, const std::string& saveResultsPath, VOCYear vocYear, VOCSplit vocSplit, const std::string& uniqueStamp, const std::vector<double>& overlapThresholds, const boost::optional<size_t>& maxImages) const
+{
+  // The fp32 results go in a subdirectory, so that the int8 ones take the usual place.
+  const std::string fp32ResultsPath = saveResultsPath + "/fp32";
+  boost::filesystem::create_directories(fp32ResultsPath);
+
+  std::cout << "\nEvaluating the fp32 network..\n" << std::endl;
+  double fp32MapVol = calculate_map_vol(net, fp32ResultsPath, vocYear, vocSplit, uniqueStamp, overlapThresholds, maxImages);
+
+  DarknetUtil::quantize(net, calibrationImagePaths, m_loaderWorkerCount);
+
+  std::cout << "\nEvaluating the int8 network..\n" << std::endl;
+  double int8MapVol = calculate_map_vol(net, saveResultsPath, vocYear, vocSplit, uniqueStamp, overlapThresholds, maxImages);
+
+  boost::format fourDecimalPlaces("%0.4f");
+  std::ostringstream report;
+  report << "mAPVol fp32: " << (fourDecimalPlaces % fp32MapVol).str() << '\n'
+         << "mAPVol int8: " << (fourDecimalPlaces % int8MapVol).str() << '\n'
+         << "delta: " << (fourDecimalPlaces % (int8MapVol - fp32MapVol)).str() << '\n';
+  std::cout << '\n' << report.str();
+
+  std::ofstream reportFile(saveResultsPath + "/quantization.txt");
+  reportFile << report.str();
+
+  return int8MapVol;
+}
+
+double Evaluator::calculate_map_vol_low_rank(network& net, const std::vector<size_t>& ranks, const std::string& saveResultsPath, VOCYear vocYear, VOCSplit vocSplit, const std::string& uniqueStamp, const std::vector<double>& overlapThresholds, const boost::optional<size_t>& maxImages) const
+{
+  int layerIndex = find_factorizable_layer(net);
+  if(layerIndex < 0) throw std::runtime_error("The network has no connected layer to factorise");
+  if(ranks.empty()) throw std::runtime_error("No ranks to evaluate the network at");
+  const layer& original = net.layers[layerIndex];
+
+  // The results for each rank go in a subdirectory, and those for the network as it is take the usual place.
+  std::cout << "\nEvaluating the full-rank network..\n" << std::endl;
+  double fullMapVol = calculate_map_vol(net, saveResultsPath, vocYear, vocSplit, uniqueStamp, overlapThresholds, maxImages);
+  double fullLatency = measure_latency(net);
+
+  const size_t maxRank = *std::max_element(ranks.begin(), ranks.end());
+  std::cout << "\nFactorising layer " << layerIndex << " (" << original.inputs << " x " << original.outputs << ") to rank " << maxRank << "..\n" << std::endl;
+  TIME(low_rank_factors factors = factorize_connected_layer(original, static_cast<int>(maxRank)), seconds, factorisationTime);
+  std::cout << factorisationTime << '\n';
+
+  boost::format rankRow("%8s %12d %8.4f %10.3f\n");
+  std::ostringstream report;
+  report << boost::format("%8s %12s %8s %10s\n") % "rank" % "weights" % "mAPVol" % "ms/image";
+  report << rankRow % "full" % (static_cast<size_t>(original.inputs) * original.outputs) % fullMapVol % fullLatency;
+
+  for(size_t i = 0; i < ranks.size(); ++i)
+  {
+    const size_t rank = ranks[i];
+    const std::string rankResultsPath = saveResultsPath + "/rank" + boost::lexical_cast<std::string>(rank);
+    boost::filesystem::create_directories(rankResultsPath);
+
+    network factorized = make_factorized_network(net, layerIndex, factors, static_cast<int>(rank));
+    std::cout << "\nEvaluating the network at rank " << rank << "..\n" << std::endl;
+    double mapVol = calculate_map_vol(factorized, rankResultsPath, vocYear, vocSplit, uniqueStamp, overlapThresholds, maxImages);
+    double latency = measure_latency(factorized);
+    free_factorized_network(&factorized, layerIndex);
+
+    report << rankRow % rank % (rank * (original.inputs + original.outputs)) % mapVol % latency;
+  }
+  free_low_rank_factors(factors);
+
+  std::cout << '\n' << report.str();
+  std::ofstream reportFile(saveResultsPath + "/lowrank.txt");
+  reportFile << report.str();
+
+  return fullMapVol;
+}
+
+double Evaluator::calculate_map_vol_input_sizes(network& net, const std::vector<size_t>& inputSizes, const std::string& saveResultsPath, VOCYear vocYear, VOCSplit vocSplit, const std::string& uniqueStamp, const std::vector<double>& overlapThresholds, const boost::optional<size_t>& maxImages) const
+{
+  if(inputSizes.empty()) throw std::runtime_error("No input sizes to evaluate the network at");
+
+  // The configured size comes first, and its results take the usual place; those for the other sizes go in subdirectories.
+  std::vector<size_t> sizes(1, m_ds.inputSize);
+  sizes.insert(sizes.end(), inputSizes.begin(), inputSizes.end());
+
+  boost::format sizeRow("%10s %12s %10s %8.4f %10.3f\n");
+  std::ostringstream report;
+  report << boost::format("%10s %12s %10s %8s %10s\n") % "input" % "trunk grid" % "head grid" % "mAPVol" % "ms/image";
+
+  double configuredMapVol = 0.0;
+  for(size_t i = 0; i < sizes.size(); ++i)
+  {
+    Evaluator sizeEvaluator(*this);
+    sizeEvaluator.m_ds.inputSize = sizes[i];
+    const cv::Size inputSize = DetectionUtil::network_input_size(net, sizeEvaluator.m_ds);
+    const std::string sizeName = boost::lexical_cast<std::string>(inputSize.width) + 'x' + boost::lexical_cast<std::string>(inputSize.height);
+
+    std::string sizeResultsPath = saveResultsPath;
+    if(i > 0)
+    {
+      sizeResultsPath += "/size" + boost::lexical_cast<std::string>(inputSize.width);
+      boost::filesystem::create_directories(sizeResultsPath);
+    }
+
+    std::cout << "\nEvaluating the network at " << sizeName << "..\n" << std::endl;
+    double mapVol = sizeEvaluator.calculate_map_vol(net, sizeResultsPath, vocYear, vocSplit, uniqueStamp, overlapThresholds, maxImages);
+    double latency = sizeEvaluator.measure_latency(net);
+    if(i == 0) configuredMapVol = mapVol;
+
+    // At the network's own size the trunk produces the grid the head was trained on; at any other, the plan says what it produces.
+    std::string trunkGrid = "trained", headGrid = "trained";
+    if(inputSize.width != net.w || inputSize.height != net.h)
+    {
+      const resolution_plan *plan = get_resolution_plan(&net, inputSize.width, inputSize.height);
+      const layer& last = plan->net.layers[plan->head - 1];
+      trunkGrid = boost::lexical_cast<std::string>(last.out_w) + 'x' + boost::lexical_cast<std::string>(last.out_h);
+      headGrid = plan->head_input ? boost::lexical_cast<std::string>(plan->head_w) + 'x' + boost::lexical_cast<std::string>(plan->head_h) : trunkGrid;
+    }
+
+    report << sizeRow % sizeName % trunkGrid % headGrid % mapVol % latency;
+  }
+
+  std::cout << '\n' << report.str();
+  std::ofstream reportFile(saveResultsPath + "/inputsizes.txt");
+  reportFile << report.str();
+
+  return configuredMapVol;
+}
+
 void Evaluator::find_save_best_worst(network& net, const std::string& saveResultsPath, VOCYear year, VOCSplit split) const
 {
   std::vector<std::string> imagePaths= m_dataset->get_image_paths(year, split, VOC_JPEG);
 
   std::cout << "\nCalculating detections..\n" << std::endl;
   TIME(
-  std::vector<Detections> detections = DetectionUtil::detect_fast(net, imagePaths, m_ds, m_shapeDescriptorCalculator);
+  std::vector<Detections> detections = DetectionUtil::detect_fast(net, imagePaths, m_ds, m_shapeDescriptorCalculator, m_batchSize, m_loaderWorkerCount);
   , seconds, detectionCalculationTime); std::cout << detectionCalculationTime;
 
   if(detections.size() != imagePaths.size()) throw std::runtime_error("sizes must be equal");
@@ -190,7 +336,7 @@ double Evaluator::calculate_map_matlab(network& net, const std::string& saveResu
   if(!boost::filesystem::exists(saveResultsPerCategoryFiles[0]))
   {
     TIME(
-    std::vector<Detections> detections = DetectionUtil::detect_fast(net, imagePaths, m_ds);
+    std::vector<Detections> detections = DetectionUtil::detect_fast(net, imagePaths, m_ds, boost::none, 1, m_loaderWorkerCount);
     , seconds, fastDetection); std::cout << fastDetection << std::endl;
 
     if(detections.size() != imagePaths.size()) throw std::runtime_error("The number of detections and image paths shold be equal");
@@ -208,83 +354,42 @@ double Evaluator::calculate_map_matlab(network& net, const std::string& saveResu
 
 //#################### PRIVATE MEMBER FUNCTIONS ####################
 
-std::vector<double> Evaluator::calculate_ap_for_categories(const NameToVOCObjectsHash& nameToVOCObjectsHash, const std::vector<NamedCategoryDetections>& namedCategoryDetections, double overlapThreshold) const
+std::vector<double> Evaluator::calculate_ap_for_categories(const std::vector<CategoryMatches>& categoryMatches, double overlapThreshold) const
 {
-  int categoryCount = static_cast<int>(namedCategoryDetections.size());
+  int categoryCount = static_cast<int>(categoryMatches.size());
   std::vector<double> ap(categoryCount);
-#pragma omp parallel for
+
+  // The categories are independent, and each AP is calculated serially by one thread, so the results are the same as
+  // those of a serial loop. The categories can have very different numbers of detections, hence the dynamic schedule.
+#pragma omp parallel for schedule(dynamic)
   for(int c = 0; c < categoryCount; ++c)
   {
-    ap[c] = calculate_ap_for_category(nameToVOCObjectsHash, namedCategoryDetections[c], c, overlapThreshold);
+    ap[c] = calculate_ap_for_category(categoryMatches[c], overlapThreshold);
   }
 
   return ap;
 }
 
-double Evaluator::calculate_ap_for_category(const NameToVOCObjectsHash& nameToVOCObjectsHash, const NamedCategoryDetections& namedCategoryDetections, size_t categoryId, double overlapThreshold) const
+double Evaluator::calculate_ap_for_category(const CategoryMatches& categoryMatches, double overlapThreshold) const
 {
-  // Sort detections by decreasing confidence.
-  std::vector<NamedCategoryDetection> dets = namedCategoryDetections;
-  TupleComparator<2, NamedCategoryDetection> comp((std::greater<float>()));
-  std::sort(dets.begin(), dets.end(), comp);
-
-  std::set<std::string> alreadyDetected;
-  size_t detCount(namedCategoryDetections.size());
-  std::set<std::string> uniqueImageNames;
+  const std::vector<DetectionMatch>& matches = categoryMatches.detectionMatches;
+  size_t detCount(matches.size());
+  std::vector<char> alreadyDetected(categoryMatches.objectDifficult.size(), 0);
   std::vector<int> tp(detCount,0);
   std::vector<int> fp(detCount,0);
   for(size_t i = 0; i < detCount; ++i)
   {
-    const NamedCategoryDetection& det = dets[i];
-    const std::string& imageName = det.get<0>();
-    const Shape& predShape = det.get<1>();
-    //float score = det.get<2>();
-
-    // Get the ground truth annotation for the image in which the detection was found.
-    uniqueImageNames.insert(imageName);
-
-    NameToVOCObjectsHash::const_iterator it = nameToVOCObjectsHash.find(imageName);
-    if(it == nameToVOCObjectsHash.end()) throw std::runtime_error("Cound not find the objects for the specified image name");
-    const std::vector<VOCObject>& objects = it->second;
-
-    float maxOverlap(-std::numeric_limits<float>::max());
-    size_t maxIndex(0);
-
-    // Assign detection to ground truth object if any.
-    for(size_t o = 0, gtObjectCount = objects.size(); o < gtObjectCount; ++o)
-    {
-      if(objects[o].categoryId != static_cast<int>(categoryId)) continue;
-
-      const Shape& gtShape = objects[o].rep;
-
-      float intersectionArea = predShape.calculate_intersection_area(gtShape);
-
-      if(intersectionArea > 0)
-      {
-        float unionArea = predShape.area()
-                          + gtShape.area()
-                          - intersectionArea;
-
-        float overlap = intersectionArea / unionArea;
-        if(overlap > maxOverlap)
-        {
-          maxOverlap = overlap;
-          maxIndex = o;
-        }
-      }
-    }
+    const DetectionMatch& match = matches[i];
 
     // Assign detection as true positive/don't care/false positive
-    if(maxOverlap >= overlapThreshold)
+    if(match.maxOverlap >= overlapThreshold)
     {
-      const std::string key = imageName + boost::lexical_cast<std::string>(maxIndex);
-      const VOCObject& gtObject = objects[maxIndex];
-      if(!gtObject.difficult)
+      if(!categoryMatches.objectDifficult[match.objectId])
       {
-        if(alreadyDetected.find(key) == alreadyDetected.end())
+        if(!alreadyDetected[match.objectId])
         {
           tp[i] = 1; // true positive
-          alreadyDetected.insert(key);
+          alreadyDetected[match.objectId] = 1;
         }
         else
         {
@@ -300,13 +405,7 @@ double Evaluator::calculate_ap_for_category(const NameToVOCObjectsHash& nameToVO
     }
   }
 
-  size_t positiveCount(0);
-  for(std::set<std::string>::iterator it = uniqueImageNames.begin(), iend = uniqueImageNames.end(); it != iend; ++it)
-  {
-    NameToVOCObjectsHash::const_iterator oit = nameToVOCObjectsHash.find(*it);
-    if(oit == nameToVOCObjectsHash.end()) throw std::runtime_error("Cound not find the objects for the specified image name");
-    positiveCount += VOCAnnotation::calculate_object_count(oit->second, categoryId);
-  }
+  size_t positiveCount(categoryMatches.positiveCount);
 
   // Compute the precision / recall
   std::vector<int> cumsumtp(tp.size(), 0);
@@ -335,10 +434,10 @@ double Evaluator::calculate_ap_for_category(const NameToVOCObjectsHash& nameToVO
   return ap;
 }
 
-double Evaluator::calculate_map(const std::vector<NamedCategoryDetections>& perClassNamedCategoryDetections, const NameToVOCObjectsHash& nameToVOCObjectsHash, const std::string& saveResultsPath, const std::string uniqueStamp, double overlapThreshold) const
+double Evaluator::calculate_map(const std::vector<CategoryMatches>& categoryMatches, const std::string& saveResultsPath, const std::string uniqueStamp, double overlapThreshold) const
 {
   std::cout << "\nPerforming the evaluation..\n" << std::endl;
-  std::vector<double> ap = calculate_ap_for_categories(nameToVOCObjectsHash, perClassNamedCategoryDetections, overlapThreshold);
+  std::vector<double> ap = calculate_ap_for_categories(categoryMatches, overlapThreshold);
 
   // Save the results to a file.
   save_results_to_file(saveResultsPath, uniqueStamp, m_dataset->get_category_names(), ap, overlapThreshold);
@@ -357,6 +456,12 @@ Evaluator::NameToVOCObjectsHash Evaluator::create_name_to_objects_hash(const std
     boost::filesystem::path bpath(imagePaths[i]);
     std::string imageName = bpath.stem().string();
     objectsPerImage[i] = m_dataset->get_annotation_from_image_name(imageName)->get_objects();
+
+    // Run-length encode the masks, since each ground truth shape is compared with many detections.
+    for(size_t j = 0, objectCount = objectsPerImage[i].size(); j < objectCount; ++j)
+    {
+      objectsPerImage[i][j].rep = objectsPerImage[i][j].rep.to_rle();
+    }
   }
   std::cout << '\n';
 
@@ -372,16 +477,175 @@ Evaluator::NameToVOCObjectsHash Evaluator::create_name_to_objects_hash(const std
   return nameToVOCObjectsHash;
 }
 
+std::vector<Evaluator::CategoryMatches> Evaluator::match_detections(const NameToVOCObjectsHash& nameToVOCObjectsHash, const std::vector<NamedCategoryDetections>& perClassNamedCategoryDetections) const
+{
+  const size_t categoryCount = perClassNamedCategoryDetections.size();
+
+  // Give each image with detections an integer id, and group its detections by category.
+  boost::unordered_map<std::string,size_t> imageNameToId;
+  std::vector<const std::vector<VOCObject>*> imageObjects;
+  std::vector<std::vector<std::vector<size_t> > > imageDetections;
+  for(size_t c = 0; c < categoryCount; ++c)
+  {
+    const NamedCategoryDetections& dets = perClassNamedCategoryDetections[c];
+    for(size_t k = 0, detCount = dets.size(); k < detCount; ++k)
+    {
+      const std::string& imageName = dets[k].get<0>();
+      boost::unordered_map<std::string,size_t>::const_iterator it = imageNameToId.find(imageName);
+      size_t imageId;
+      if(it != imageNameToId.end()) imageId = it->second;
+      else
+      {
+        NameToVOCObjectsHash::const_iterator oit = nameToVOCObjectsHash.find(imageName);
+        if(oit == nameToVOCObjectsHash.end()) throw std::runtime_error("Cound not find the objects for the specified image name");
+        imageId = imageObjects.size();
+        imageNameToId.insert(std::make_pair(imageName, imageId));
+        imageObjects.push_back(&oit->second);
+        imageDetections.push_back(std::vector<std::vector<size_t> >(categoryCount));
+      }
+      imageDetections[imageId][c].push_back(k);
+    }
+  }
+
+  // Give each ground truth object of those images an integer id within its category, and count the positives
+  // of each category (the non-difficult objects in the images in which the category was detected).
+  const int imageCount = static_cast<int>(imageObjects.size());
+  std::vector<CategoryMatches> categoryMatches(categoryCount);
+  std::vector<std::vector<int> > objectIds(imageCount);
+  for(int i = 0; i < imageCount; ++i)
+  {
+    const std::vector<VOCObject>& objects = *imageObjects[i];
+    objectIds[i].resize(objects.size(), -1);
+    for(size_t o = 0, objectCount = objects.size(); o < objectCount; ++o)
+    {
+      const size_t c = static_cast<size_t>(objects[o].categoryId);
+      if(c >= categoryCount) continue;
+
+      CategoryMatches& cm = categoryMatches[c];
+      objectIds[i][o] = static_cast<int>(cm.objectDifficult.size());
+      cm.objectDifficult.push_back(objects[o].difficult);
+      if(!objects[o].difficult && !imageDetections[i][c].empty()) ++cm.positiveCount;
+    }
+  }
+
+  for(size_t c = 0; c < categoryCount; ++c)
+  {
+    const NamedCategoryDetections& dets = perClassNamedCategoryDetections[c];
+    categoryMatches[c].detectionMatches.resize(dets.size());
+    for(size_t k = 0, detCount = dets.size(); k < detCount; ++k)
+    {
+      categoryMatches[c].detectionMatches[k].score = dets[k].get<2>();
+    }
+  }
+
+  // Split the matching into work items, each covering a chunk of the detections of one category in one image, so that
+  // the work can be spread evenly across the threads even when a few images or categories have most of the detections.
+  const size_t detectionsPerWorkItem = 32;
+  std::vector<boost::tuple<size_t,size_t,size_t> > workItems; // (image id, category id, first detection of the chunk)
+  for(int i = 0; i < imageCount; ++i)
+  {
+    for(size_t c = 0; c < categoryCount; ++c)
+    {
+      for(size_t begin = 0, detCount = imageDetections[i][c].size(); begin < detCount; begin += detectionsPerWorkItem)
+      {
+        workItems.push_back(boost::make_tuple(i, c, begin));
+      }
+    }
+  }
+
+  // Match each detection to the ground truth object of its category that it overlaps most, in parallel. The overlap of
+  // each detection/object pair is computed exactly once, and the best match does not depend on the overlap threshold,
+  // so the matches can be reused to calculate the AP at any threshold. Each match is computed by a single thread in a
+  // fixed order, so the results do not depend on the number of threads or on how the work is scheduled.
+  const int workItemCount = static_cast<int>(workItems.size());
+#pragma omp parallel for schedule(dynamic)
+  for(int w = 0; w < workItemCount; ++w)
+  {
+    const size_t i = workItems[w].get<0>();
+    const size_t c = workItems[w].get<1>();
+    const std::vector<size_t>& detIndices = imageDetections[i][c];
+    const size_t begin = workItems[w].get<2>();
+    const size_t end = std::min(begin + detectionsPerWorkItem, detIndices.size());
+
+    const std::vector<VOCObject>& objects = *imageObjects[i];
+    std::vector<size_t> objectIndices;
+    std::vector<float> objectAreas;
+    for(size_t o = 0, objectCount = objects.size(); o < objectCount; ++o)
+    {
+      if(objects[o].categoryId != static_cast<int>(c)) continue;
+      objectIndices.push_back(o);
+      objectAreas.push_back(objects[o].rep.area());
+    }
+
+    for(size_t d = begin; d < end; ++d)
+    {
+      const Shape& predShape = perClassNamedCategoryDetections[c][detIndices[d]].get<1>();
+      const float predArea = predShape.area();
+
+      DetectionMatch& match = categoryMatches[c].detectionMatches[detIndices[d]];
+      match.maxOverlap = -std::numeric_limits<float>::max();
+      match.objectId = -1;
+
+      for(size_t g = 0, gtCount = objectIndices.size(); g < gtCount; ++g)
+      {
+        const size_t o = objectIndices[g];
+        float intersectionArea = predShape.calculate_intersection_area(objects[o].rep);
+        if(intersectionArea > 0)
+        {
+          float overlap = intersectionArea / (predArea + objectAreas[g] - intersectionArea);
+          if(overlap > match.maxOverlap)
+          {
+            match.maxOverlap = overlap;
+            match.objectId = objectIds[i][o];
+          }
+        }
+      }
+    }
+  }
+
+  // Sort the detections of each category by decreasing confidence.
+  for(size_t c = 0; c < categoryCount; ++c)
+  {
+    std::vector<DetectionMatch>& matches = categoryMatches[c].detectionMatches;
+    std::stable_sort(matches.begin(), matches.end(), boost::bind(&DetectionMatch::score, _1) > boost::bind(&DetectionMatch::score, _2));
+  }
+
+  return categoryMatches;
+}
+
 std::vector<NamedCategoryDetections> Evaluator::calculate_detections_per_category(network& net, const std::vector<std::string>& imagePaths) const
 {
   // Calculate the detections and convert them to an appropriate format for evaluation.
   TIME(
-  std::vector<Detections> detections = DetectionUtil::detect_fast(net, imagePaths, m_ds, m_shapeDescriptorCalculator);
+  std::vector<Detections> detections = DetectionUtil::detect_fast(net, imagePaths, m_ds, m_shapeDescriptorCalculator, m_batchSize, m_loaderWorkerCount);
   , seconds, detectionCalculationTime); std::cout << detectionCalculationTime;
 
   return convert_to_named_category_detections(imagePaths, detections);
 }
 
+double Evaluator::measure_latency(network& net, size_t runs) const
+{
+  const cv::Size inputSize = DetectionUtil::network_input_size(net, m_ds);
+  std::vector<float> input(static_cast<size_t>(net.batch) * inputSize.width * inputSize.height * net.c);
+
+  // The first pass is not timed, since it may make a resolution plan for the input size.
+  DarknetUtil::predict_tensor(net, &input[0], net.batch, inputSize.width, inputSize.height);
+  TIME(
+  for(size_t i = 0; i < runs; ++i) DarknetUtil::predict_tensor(net, &input[0], net.batch, inputSize.width, inputSize.height);
+  , microseconds, latencyTimer);
+
+  return latencyTimer.duration().count() / (1000.0 * runs * net.batch);
+}
+
+void Evaluator::print_phase_timings(const Milliseconds_Timer& detectionPhase, const Milliseconds_Timer& groundTruthPhase, const Milliseconds_Timer& matchingPhase, const Milliseconds_Timer& precisionRecallPhase) const
+{
+  std::cout << "\nEvaluation time per phase (wall-clock):\n"
+            << "  detection:        " << detectionPhase.duration() << '\n'
+            << "  ground truth:     " << groundTruthPhase.duration() << '\n'
+            << "  matching:         " << matchingPhase.duration() << '\n'
+            << "  precision/recall: " << precisionRecallPhase.duration() << '\n';
+}
+
 void Evaluator::save_results_to_file(const std::string& saveResultsPath, const std::string& uniqueStamp, const std::vector<std::string>& categoryNames, const std::vector<double>& ap, double overlapThreshold) const
 {
   boost::format oneDecimalPlace("%0.1f");
@@ -463,7 +727,7 @@ std::vector<std::vector<NamedCategoryDetection> > Evaluator::convert_to_named_ca
 
     for(size_t i = 0, detectionCount = detections[imageId].size(); i < detectionCount; ++i)
     {
-      Shape shape = detections[imageId][i].first;
+      Shape shape = detections[imageId][i].first.to_rle();
       std::vector<float> scores = detections[imageId][i].second;
 
       for(size_t c = 0; c < categoryCount; ++c)
@@ -13,6 +13,7 @@
 #include <darknet/network.h>
 
 #include <tvgshape/ShapeDescriptorCalculator.h>
+#include <tvgutil/timing/Timer.h>
 
 /**
  * \brief TODO.
@@ -23,16 +24,61 @@ class Evaluator
 private:
   typedef boost::unordered_map<std::string,std::vector<VOCObject> > NameToVOCObjectsHash;
   typedef std::vector<NamedCategoryDetection> NamedCategoryDetections;
+  typedef tvgutil::Timer<boost::chrono::milliseconds> Milliseconds_Timer;
+
+  //#################### NESTED TYPES ####################
+private:
+  /**
+   * \brief An instance of this struct records the ground truth object that a detection overlaps most.
+   */
+  struct DetectionMatch
+  {
+    /** The overlap between the detection and the object (or -FLT_MAX if it does not overlap any object of its category). */
+    float maxOverlap;
+
+    /** The id of the object within its category (or -1 if there is no such object). */
+    int objectId;
+
+    /** The confidence of the detection. */
+    float score;
+  };
+
+  /**
+   * \brief An instance of this struct holds the matches between the detections and the ground truth of a category,
+   *        which are all that is needed to calculate the AP of the category at any overlap threshold.
+   */
+  struct CategoryMatches
+  {
+    /** The matches of the detections of the category, in decreasing order of confidence. */
+    std::vector<DetectionMatch> detectionMatches;
+
+    /** Whether or not each object of the category (indexed by its id) is marked as difficult. */
+    std::vector<char> objectDifficult;
+
+    /** The number of non-difficult objects of the category in the images in which it was detected. */
+    size_t positiveCount;
+
+    CategoryMatches()
+    : positiveCount(0)
+    {}
+  };
 
   //#################### PRIVATE MEMBER VARIABLES ####################
 private:
+  /** The number of images to push through the network in each forward pass. */
+  size_t m_batchSize;
+
   Dataset_CPtr m_dataset;
   DetectionSettings m_ds;
+
+  /** The number of threads that load the images (0 for the loader's default). */
+  size_t m_loaderWorkerCount;
+
   boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr> m_shapeDescriptorCalculator;
   
   //#################### CONSTRUCTORS ####################
 public:
-  Evaluator(const Dataset_CPtr& dataset, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none);
+  Evaluator(const Dataset_CPtr& dataset, const DetectionSettings& ds, const boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator = boost::none, size_t batchSize = 1, size_t loaderWorkerCount = 0);
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
@@ -42,6 +88,30 @@ public:
   /** Calculate the mean average precision over a set of overlap thresholds. */
   double calculate_map_vol(network& net, const std::string& saveResultsPath, VOCYear vocYear, VOCSplit vocSplit, const std::string& uniqueStamp, const std::vector<double>& overlapThresholds, const boost::optional<size_t>& maxImages = boost::none) const;
 
+  /** Calculate the mean average precision over a set of overlap thresholds in fp32, then quantise the network to int8 and report the change. */
+  double calculate_map_vol_int8(network& net, const std::vector<std::string>& calibrationImagePaths, const std::string& saveResultsPath, VOCYear vocYear, VOCSplit vocSplit, const std::string& uniqueStamp, const std::vector<double>& overlapThresholds, const boost::optional<size_t>& maxImages = boost::none) const;
+
+  /**
+   * \brief Calculate the mean average precision over a set of overlap thresholds, and again with the first connected layer of the network
+   *        factorised to each of a set of ranks, and report the mAPVol, the number of weights in the layer and the latency at each rank.
+   *
+   * The factorisation is found once, at the largest rank, and truncated for the smaller ones. The network itself is left unchanged.
+   *
+   * \return The mAPVol of the network as it is.
+   */
+  double calculate_map_vol_low_rank(network& net, const std::vector<size_t>& ranks, const std::string& saveResultsPath, VOCYear vocYear, VOCSplit vocSplit, const std::string& uniqueStamp, const std::vector<double>& overlapThresholds, const boost::optional<size_t>& maxImages = boost::none) const;
+
+  /**
+   * \brief Calculate the mean average precision over a set of overlap thresholds at the configured input size, and again at each of a set
+   *        of other input sizes, and report the mAPVol and the latency at each size.
+   *
+   * The sizes other than net.w x net.h are run through resolution plans, whose heads still see the output of the trunk averaged
+   * to the grid they were trained on; the report shows the grid the trunk produces at each size alongside that of the head.
+   *
+   * \return The mAPVol at the configured input size.
+   */
+  double calculate_map_vol_input_sizes(network& net, const std::vector<size_t>& inputSizes, const std::string& saveResultsPath, VOCYear vocYear, VOCSplit vocSplit, const std::string& uniqueStamp, const std::vector<double>& overlapThresholds, const boost::optional<size_t>& maxImages = boost::none) const;
+
   /** Find the best and worst detections and save them to file. */
   void find_save_best_worst(network& net, const std::string& saveResultsPath, VOCYear year, VOCSplit split) const;
 
@@ -52,13 +122,13 @@ public:
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
   /** Calculate the average precisions for a set of categories. */
-  std::vector<double> calculate_ap_for_categories(const NameToVOCObjectsHash& nameToVOCObjectsHash, const std::vector<NamedCategoryDetections>& namedCategoryDetections, double overlapThreshold) const;
+  std::vector<double> calculate_ap_for_categories(const std::vector<CategoryMatches>& categoryMatches, double overlapThreshold) const;
 
   /** Calculate the average precision for a particular category. */
-  double calculate_ap_for_category(const NameToVOCObjectsHash& nameToVOCObjectsHash, const NamedCategoryDetections& namedCategoryDetections, size_t categoryId, double overlapThreshold) const;
+  double calculate_ap_for_category(const CategoryMatches& categoryMatches, double overlapThreshold) const;
 
-  /** Calculate the mean average precision from formatted detections and ground truth (for a particular overlap threshold.) */
-  double calculate_map(const std::vector<NamedCategoryDetections>& perClassNamedCategoryDetections, const NameToVOCObjectsHash& nameToVOCObjectsHash, const std::string& saveResultsPath, const std::string uniqueStamp, double overlapThreshold = 0.5) const;
+  /** Calculate the mean average precision from the matches between the detections and ground truth (for a particular overlap threshold.) */
+  double calculate_map(const std::vector<CategoryMatches>& categoryMatches, const std::string& saveResultsPath, const std::string uniqueStamp, double overlapThreshold = 0.5) const;
 
 #if 0
   double calculate_map_matlab(const std::string& resultsPath, const std::string& competitionCode, const std::string& splitName) const;
@@ -68,14 +138,23 @@ private:
 
   NameToVOCObjectsHash create_name_to_objects_hash(const std::vector<std::string>& imagePaths) const;
 
+  /** Match each detection to the ground truth object of its category that it overlaps most. */
+  std::vector<CategoryMatches> match_detections(const NameToVOCObjectsHash& nameToVOCObjectsHash, const std::vector<NamedCategoryDetections>& perClassNamedCategoryDetections) const;
+
   std::vector<std::string> get_save_results_per_category_files(const std::string& saveResultsPath, const std::string& competitionCode) const;
 
   double get_score_per_image(const NameToVOCObjectsHash& nameToVOCObjectsHash, const std::string& imagePath, const Detections& detections) const;
 
+  /** Print the wall-clock time taken by each phase of an evaluation. */
+  void print_phase_timings(const Milliseconds_Timer& detectionPhase, const Milliseconds_Timer& groundTruthPhase, const Milliseconds_Timer& matchingPhase, const Milliseconds_Timer& precisionRecallPhase) const;
+
   void print_detections(const std::vector<std::vector<NamedCategoryDetection> >& namedCategoryDetections, const std::vector<std::string>& saveResultsPerCategoryFiles, size_t categoryCount) const;
 
   std::vector<NamedCategoryDetections> calculate_detections_per_category(network& net, const std::vector<std::string>& imagePaths) const;
 
+  /** Measure the average time (in milliseconds) the network takes to run a forward pass on one image, excluding any pre- or post-processing. */
+  double measure_latency(network& net, size_t runs = 20) const;
+
   void save_images(const std::string& saveResultsPath, const std::string& imagePath, const Detections& detections, const std::string& tag) const;
 
   void save_results_to_file(const std::string& saveResultsPath, const std::string& uniqueStamp, const std::vector<std::string>& categoryNames, const std::vector<double>& ap, double overlapThreshold) const;
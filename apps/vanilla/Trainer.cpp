@@ -109,7 +109,7 @@ void Trainer::train(network& net, size_t epochCount) const
   TrainingDataGenerator dataGenerator(trainPaths, m_dataset, net.w, net.h, DataTransformationFactory::Settings(), m_seed, m_shapeDescriptorCalculator);
 #endif
 
-  CQ_Ptr dataBuffer(new CircularQueue<std::vector<Datum> >(35));
+  Queue_Ptr dataBuffer(new SPSCQueue<std::vector<Datum> >(35));
   boost::thread dataLoadingThread(&TrainingDataGenerator::run_load_loop, boost::ref(dataGenerator), dataBuffer, batchNumber, maxBatchNumber, numDatum, imagesPerDatum, detectionLayer.jitter, m_ds);
 
   // Before starting to train, write a report with the settings used to train.
@@ -132,26 +132,22 @@ void Trainer::train(network& net, size_t epochCount) const
     float epoch = (batchNumber * imagesPerBatch) / static_cast<float>(imagesPerEpoch);
 
     float loss;
-    while(true)
+    std::vector<Datum> data;
+    if(!dataBuffer->pop(data))
     {
-      boost::optional<const std::vector<Datum>& > data = dataBuffer->pop();
-      //boost::optional<std::vector<Datum> > data = dataGenerator.generate_training_data(numDatum, imagesPerDatum, detectionLayer.jitter, m_ds);
+      dataLoadingThread.join();
+      throw std::runtime_error("The training data generator stopped before generating all of the batches");
+    }
 
-      if(data)
-      {
 #ifdef DEBUG_DATA
-        for(size_t i = 0; i < numDatum; ++i)
-        {
-          dataGenerator.debug_training_datum(data[i], imagesPerDatum, m_ds);
-          cv::waitKey(100);
-        }
-#endif
-        std::vector<Datum>& data2 = const_cast<std::vector<Datum>& >(*data);
-        TIME(loss = lossMovingAverage.push(train_network(net, data2));, milliseconds, trainTimeA);
-        if(m_debugFlag) std::cout << trainTimeA << '\n';
-        break;
-      }
+    for(size_t i = 0; i < numDatum; ++i)
+    {
+      dataGenerator.debug_training_datum(data[i], imagesPerDatum, m_ds);
+      cv::waitKey(100);
     }
+#endif
+    TIME(loss = lossMovingAverage.push(train_network(net, data));, milliseconds, trainTimeA);
+    if(m_debugFlag) std::cout << trainTimeA << '\n';
 
     // Reporting
     std::string info("BatchNo: " + (sixDigits % batchNumber).str() + '/' + (sixDigits % maxBatchNumber).str()
@@ -188,6 +184,9 @@ void Trainer::train(network& net, size_t epochCount) const
     std::cout << "###" << batchProcessTime << '\n' << std::endl;
   }
 
+  dataBuffer->close();
+  dataLoadingThread.join();
+
   // Create a table for plotting.
   std::string tableFile = saveResultsDir + "/table.txt";
   std::ofstream ofs(tableFile);
@@ -205,7 +204,8 @@ float Trainer::get_and_save_performance(network& net, VOCYear vocYear, VOCSplit
 {
   std::string stamp = m_dataset->get_split_name(vocSplit) + TimeUtil::get_iso_timestamp();
   std::string saveResultsPathTrain = m_dataset->get_dir_in_results(m_experimentUniqueStamp + '/' + "intermediate-results" + '/' + stamp);
-  Evaluator evaluator(m_dataset, m_ds, m_shapeDescriptorCalculator);
+  // The training network already has buffers for net.batch images, so evaluate in batches of that size.
+  Evaluator evaluator(m_dataset, m_ds, m_shapeDescriptorCalculator, net.batch);
   double overlapThreshold(0.5);
   return evaluator.calculate_map(net, saveResultsPathTrain, vocYear, vocSplit, "batchNumber-" + boost::lexical_cast<std::string>(batchNumber), overlapThreshold, m_maxImagesToEvaluateOn);
 }
@@ -16,7 +16,7 @@
 
 #include <evaluation/core/PerformanceTable.h>
 
-#include <tvgutil/containers/CircularQueue.h>
+#include <tvgutil/containers/SPSCQueue.h>
 
 #include <tvgshape/ShapeDescriptorCalculator.h>
 
@@ -27,7 +27,7 @@ class Trainer
 {
   //#################### PRIVATE TYPEDEFS ####################
 private:
-  typedef boost::shared_ptr<tvgutil::CircularQueue<std::vector<Datum> > > CQ_Ptr;
+  typedef boost::shared_ptr<tvgutil::SPSCQueue<std::vector<Datum> > > Queue_Ptr;
 
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
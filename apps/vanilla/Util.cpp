@@ -48,11 +48,17 @@ cv::Mat1b Util::make_gray_image(const float *grayData, int width, int height, fl
 }
 
 float* Util::make_rgb_image(const cv::Mat3b& im, float scaleFactor)
+{
+  float *rgbData = new float[im.cols * im.rows * im.channels()];
+  make_rgb_image(im, scaleFactor, rgbData);
+  return rgbData;
+}
+
+void Util::make_rgb_image(const cv::Mat3b& im, float scaleFactor, float *rgbData)
 {
   int width = im.cols;
   int height = im.rows;
   int pixelCount = width*height;
-  float *rgbData = new float[pixelCount * im.channels()];
 
   int counter(0);
   for(int y = 0; y < height; ++y)
@@ -66,8 +72,6 @@ float* Util::make_rgb_image(const cv::Mat3b& im, float scaleFactor)
       counter++;
     }
   }
-
-  return rgbData;
 }
 
 float* Util::make_gray_image(const cv::Mat1b& im, float scaleFactor)
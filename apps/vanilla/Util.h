@@ -109,6 +109,15 @@ static void decimate_vector(std::vector<T>& v, size_t level)
 static cv::Mat3b make_rgb_image(const float *rgbData, int width, int height, float scaleFactor);
 static cv::Mat1b make_gray_image(const float *grayData, int width, int height, float scaleFactor);
 static float *make_rgb_image(const cv::Mat3b& im, float scaleFactor);
+
+/**
+ * \brief Writes an image into a caller-provided planar buffer in the format [R1,R2,R3, ... , G1,G2,G3, ... , B1,B2,B3, ...].
+ *
+ * \param im           The image.
+ * \param scaleFactor  The factor by which to scale the image pixels.
+ * \param rgbData      A buffer of at least im.cols * im.rows * 3 floats.
+ */
+static void make_rgb_image(const cv::Mat3b& im, float scaleFactor, float *rgbData);
 static float *make_gray_image(const cv::Mat1b& im, float scaleFactor);
 
 
@@ -20,7 +20,9 @@ DetectionSettings::DetectionSettings(
   bool onlyObjectness_,
   float overlapThreshold_,
   float shapeScale_,
-  bool useSquare_
+  bool useSquare_,
+  size_t inputSize_,
+  bool maskNMS_
   )
 : categoryCount(categoryCount_),
   boxesPerCell(boxesPerCell_),
@@ -34,7 +36,9 @@ DetectionSettings::DetectionSettings(
   onlyObjectness(onlyObjectness_),
   overlapThreshold(overlapThreshold_),
   shapeScale(shapeScale_),
-  useSquare(useSquare_)
+  useSquare(useSquare_),
+  inputSize(inputSize_),
+  maskNMS(maskNMS_)
 {}
 
 //#################### OUTPUT ####################
@@ -55,6 +59,8 @@ std::ostream& operator<<(std::ostream& os, const DetectionSettings& ds)
   PRT(ds.overlapThreshold);
   PRT(ds.shapeScale);
   PRT(ds.useSquare);
+  PRT(ds.inputSize);
+  PRT(ds.maskNMS);
   return os;
 }
 #undef PRT
@@ -25,6 +25,8 @@ struct DetectionSettings
   float overlapThreshold;
   float shapeScale;
   bool useSquare;
+  size_t inputSize;
+  bool maskNMS;
 
   //#################### CONSTRUCTORS ####################
   DetectionSettings(
@@ -40,7 +42,9 @@ struct DetectionSettings
     bool onlyObjectness_ = false,
     float overlapThreshold_ = 0.5f,
     float shapeScale = 0.1f,
-    bool useSquare_ = true
+    bool useSquare_ = true,
+    size_t inputSize_ = 0,
+    bool maskNMS_ = false
     );
 };
 
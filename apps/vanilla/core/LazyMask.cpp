@@ -0,0 +1,145 @@
+/**
+ * vanilla: LazyMask.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#include "LazyMask.h"
+
+#include <map>
+
+#include <boost/chrono.hpp>
+
+namespace {
+
+typedef boost::chrono::steady_clock Clock;
+
+unsigned long long nanoseconds_since(const Clock::time_point& t0)
+{
+  return static_cast<unsigned long long>(boost::chrono::duration_cast<boost::chrono::nanoseconds>(Clock::now() - t0).count());
+}
+
+}
+
+//#################### PRIVATE STATIC VARIABLES ####################
+
+std::atomic<size_t> LazyMask::s_createdCount(0);
+std::atomic<unsigned long long> LazyMask::s_decodeNanoseconds(0);
+std::atomic<size_t> LazyMask::s_decodedCount(0);
+
+//#################### CONSTRUCTORS ####################
+
+LazyMask::LazyMask(const std::vector<float>& descriptor, const cv::Size& maskSize, const tvgshape::ShapeDescriptorCalculator_CPtr& calculator)
+: m_calculator(calculator), m_decoded(false), m_descriptor(descriptor), m_maskSize(maskSize)
+{
+  ++s_createdCount;
+}
+
+//#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+void LazyMask::decode(const std::vector<LazyMask_CPtr>& masks)
+{
+  // Group the masks that have yet to be decoded by their calculator, so that each calculator can decode its masks together.
+  std::map<const tvgshape::ShapeDescriptorCalculator*,std::vector<LazyMask_CPtr> > pendingMasks;
+  for(size_t i = 0, size = masks.size(); i < size; ++i)
+  {
+    if(masks[i] && !masks[i]->is_decoded()) pendingMasks[masks[i]->m_calculator.get()].push_back(masks[i]);
+  }
+
+  for(std::map<const tvgshape::ShapeDescriptorCalculator*,std::vector<LazyMask_CPtr> >::const_iterator it = pendingMasks.begin(), iend = pendingMasks.end(); it != iend; ++it)
+  {
+    const std::vector<LazyMask_CPtr>& group = it->second;
+    std::vector<std::vector<float> > descriptors(group.size());
+    std::vector<cv::Size> maskSizes(group.size());
+    for(size_t i = 0, size = group.size(); i < size; ++i)
+    {
+      descriptors[i] = group[i]->m_descriptor;
+      maskSizes[i] = group[i]->m_maskSize;
+    }
+
+    Clock::time_point t0 = Clock::now();
+    std::vector<cv::Mat1b> decodedMasks = it->first->to_masks(descriptors, maskSizes);
+    const unsigned long long nanoseconds = nanoseconds_since(t0);
+
+    // Another thread may have decoded some of the masks in the meantime, in which case its masks are kept.
+    size_t decodedCount = 0;
+    for(size_t i = 0, size = group.size(); i < size; ++i)
+    {
+      const LazyMask& mask = *group[i];
+      boost::lock_guard<boost::mutex> lock(mask.m_decodeMutex);
+      if(mask.m_decoded.load(std::memory_order_relaxed)) continue;
+
+      mask.m_mask = decodedMasks[i];
+      mask.m_decoded.store(true, std::memory_order_release);
+      ++decodedCount;
+    }
+
+    record_decoding(decodedCount, nanoseconds);
+  }
+}
+
+LazyMask::Statistics LazyMask::get_statistics()
+{
+  Statistics s;
+  s.createdCount = s_createdCount.load();
+  s.decodeMilliseconds = s_decodeNanoseconds.load() / 1e6;
+  s.decodedCount = s_decodedCount.load();
+  return s;
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+const cv::Mat1b& LazyMask::get_mask() const
+{
+  if(m_decoded.load(std::memory_order_acquire)) return m_mask;
+
+  boost::lock_guard<boost::mutex> lock(m_decodeMutex);
+  if(!m_decoded.load(std::memory_order_relaxed))
+  {
+    Clock::time_point t0 = Clock::now();
+    m_mask = m_calculator->to_mask(m_descriptor, m_maskSize);
+    record_decoding(1, nanoseconds_since(t0));
+    m_decoded.store(true, std::memory_order_release);
+  }
+
+  return m_mask;
+}
+
+bool LazyMask::is_decoded() const
+{
+  return m_decoded.load(std::memory_order_acquire);
+}
+
+//#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+
+void LazyMask::record_decoding(size_t count, unsigned long long nanoseconds)
+{
+  s_decodedCount += count;
+  s_decodeNanoseconds += nanoseconds;
+}
+
+//#################### PUBLIC NESTED TYPE MEMBER FUNCTIONS ####################
+
+double LazyMask::Statistics::estimate_saved_milliseconds() const
+{
+  // Assume that each of the masks that were never decoded would have taken as long as the average mask that was.
+  if(decodedCount == 0 || createdCount <= decodedCount) return 0.0;
+  return (createdCount - decodedCount) * decodeMilliseconds / decodedCount;
+}
+
+LazyMask::Statistics LazyMask::Statistics::operator-(const Statistics& rhs) const
+{
+  Statistics s;
+  s.createdCount = createdCount - rhs.createdCount;
+  s.decodeMilliseconds = decodeMilliseconds - rhs.decodeMilliseconds;
+  s.decodedCount = decodedCount - rhs.decodedCount;
+  return s;
+}
+
+//#################### OUTPUT ####################
+
+std::ostream& operator<<(std::ostream& os, const LazyMask::Statistics& s)
+{
+  os << "decoded " << s.decodedCount << " of " << s.createdCount << " shape masks in " << s.decodeMilliseconds << " ms"
+     << " (about " << s.estimate_saved_milliseconds() << " ms saved)";
+  return os;
+}
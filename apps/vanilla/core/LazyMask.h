@@ -0,0 +1,150 @@
+/**
+ * vanilla: LazyMask.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#ifndef H_VANILLA_LAZYMASK
+#define H_VANILLA_LAZYMASK
+
+#include <atomic>
+#include <ostream>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <tvgshape/ShapeDescriptorCalculator.h>
+
+/**
+ * \brief An instance of this class represents the mask of a detected shape, which is only decoded from its shape
+ *        descriptor when it is first needed.
+ *
+ * Decoding a descriptor (e.g. running the autoencoder, or filling a radial polygon) is the expensive part of turning
+ * the network output into detections, yet most of the candidate boxes are discarded by thresholding and non-maximal
+ * suppression. Deferring the decoding means that only the masks of the detections that are actually used are paid
+ * for. The masks that are needed together can be decoded in a single batch with decode(). A lazy mask is shared
+ * between the copies of the shape that owns it, so each mask is decoded at most once, and it may be decoded from
+ * several threads at once.
+ */
+class LazyMask
+{
+  //#################### NESTED TYPES ####################
+public:
+  /**
+   * \brief An instance of this struct holds the numbers of masks that have been created and decoded so far.
+   */
+  struct Statistics
+  {
+    /** The number of lazy masks that have been created. */
+    size_t createdCount;
+
+    /** The total time spent decoding masks, in milliseconds. */
+    double decodeMilliseconds;
+
+    /** The number of lazy masks that have been decoded. */
+    size_t decodedCount;
+
+    /**
+     * \brief Estimates the time saved by not decoding the masks that were never needed, in milliseconds.
+     */
+    double estimate_saved_milliseconds() const;
+
+    /**
+     * \brief Gets the statistics of the masks created and decoded since an earlier snapshot.
+     */
+    Statistics operator-(const Statistics& rhs) const;
+  };
+
+  //#################### PRIVATE STATIC VARIABLES ####################
+private:
+  /** The number of lazy masks that have been created. */
+  static std::atomic<size_t> s_createdCount;
+
+  /** The total time spent decoding masks, in nanoseconds. */
+  static std::atomic<unsigned long long> s_decodeNanoseconds;
+
+  /** The number of lazy masks that have been decoded. */
+  static std::atomic<size_t> s_decodedCount;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The calculator used to decode the descriptor. */
+  tvgshape::ShapeDescriptorCalculator_CPtr m_calculator;
+
+  /** Whether or not the mask has been decoded. */
+  mutable std::atomic<bool> m_decoded;
+
+  /** The mutex used to make sure the mask is only decoded once. */
+  mutable boost::mutex m_decodeMutex;
+
+  /** The shape descriptor. */
+  std::vector<float> m_descriptor;
+
+  /** The decoded mask (only valid once m_decoded is set). */
+  mutable cv::Mat1b m_mask;
+
+  /** The size of the mask to decode. */
+  cv::Size m_maskSize;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a mask that will be decoded from the specified shape descriptor on demand.
+   *
+   * \param descriptor  The shape descriptor.
+   * \param maskSize    The size of the mask to decode.
+   * \param calculator  The calculator used to decode the descriptor.
+   */
+  LazyMask(const std::vector<float>& descriptor, const cv::Size& maskSize, const tvgshape::ShapeDescriptorCalculator_CPtr& calculator);
+
+  //#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+  // Deliberately private and unimplemented (lazy masks are shared rather than copied).
+  LazyMask(const LazyMask&);
+  LazyMask& operator=(const LazyMask&);
+
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Decodes the masks that have not yet been decoded, batching together the masks that share a calculator.
+   *
+   * \param masks The masks.
+   */
+  static void decode(const std::vector<boost::shared_ptr<const LazyMask> >& masks);
+
+  /**
+   * \brief Gets the numbers of masks that have been created and decoded since the program started.
+   */
+  static Statistics get_statistics();
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the mask, decoding it first if need be.
+   */
+  const cv::Mat1b& get_mask() const;
+
+  /**
+   * \brief Gets whether or not the mask has been decoded.
+   */
+  bool is_decoded() const;
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Records that a number of masks have been decoded in the specified time.
+   */
+  static void record_decoding(size_t count, unsigned long long nanoseconds);
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<const LazyMask> LazyMask_CPtr;
+
+//#################### OUTPUT ####################
+
+std::ostream& operator<<(std::ostream& os, const LazyMask::Statistics& s);
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * vanilla: RLEMask.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#include "RLEMask.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+//#################### LOCAL TYPES ####################
+
+/**
+ * \brief An instance of this class walks over the foreground of a mask as a sequence of vertical segments,
+ *        in column-major order. A run that wraps from one column to the next yields one segment per column.
+ */
+class ForegroundSegmentIterator
+{
+  //#################### PUBLIC VARIABLES ####################
+public:
+  /** The image x coordinate of the current segment. */
+  int x;
+
+  /** The image y coordinates of the current segment, which covers [yBegin, yEnd). */
+  int yBegin, yEnd;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  const std::vector<boost::uint32_t>& m_counts;
+  bool m_done;
+  int m_height;
+  cv::Point m_offset;
+  size_t m_pos;
+  size_t m_runEnd;
+  size_t m_runIndex;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  explicit ForegroundSegmentIterator(const RLEMask& mask)
+  : m_counts(mask.get_counts()), m_done(false), m_height(mask.get_size().height), m_offset(mask.get_offset()), m_pos(0), m_runEnd(0), m_runIndex(0)
+  {
+    next_run();
+  }
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  bool done() const
+  {
+    return m_done;
+  }
+
+  void next()
+  {
+    m_pos += yEnd - yBegin;
+    if(m_pos < m_runEnd) load_segment();
+    else next_run();
+  }
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  void load_segment()
+  {
+    const int column = static_cast<int>(m_pos / m_height);
+    const int row = static_cast<int>(m_pos % m_height);
+    x = m_offset.x + column;
+    yBegin = m_offset.y + row;
+    yEnd = m_offset.y + static_cast<int>(std::min<size_t>(m_height, row + (m_runEnd - m_pos)));
+  }
+
+  void next_run()
+  {
+    // Skip the background run at m_runIndex, and stop at the first non-empty foreground run after it.
+    while(m_runIndex + 1 < m_counts.size())
+    {
+      m_pos += m_counts[m_runIndex];
+      const size_t length = m_counts[m_runIndex + 1];
+      m_runIndex += 2;
+      if(length > 0)
+      {
+        m_runEnd = m_pos + length;
+        load_segment();
+        return;
+      }
+    }
+    m_done = true;
+  }
+};
+
+//#################### CONSTRUCTORS ####################
+
+RLEMask::RLEMask()
+: m_area(0), m_counts(new std::vector<boost::uint32_t>), m_offset(0, 0), m_size(0, 0)
+{}
+
+RLEMask::RLEMask(const cv::Point& offset, const cv::Size& size, const std::vector<boost::uint32_t>& counts)
+: m_area(0), m_counts(new std::vector<boost::uint32_t>(counts)), m_offset(offset), m_size(size)
+{
+  size_t total = 0;
+  for(size_t i = 0, runCount = counts.size(); i < runCount; ++i)
+  {
+    total += counts[i];
+    if(i % 2 == 1) m_area += counts[i];
+  }
+
+  if(total != static_cast<size_t>(size.area())) throw std::runtime_error("The run lengths do not sum to the number of pixels in the mask");
+}
+
+//#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+RLEMask RLEMask::encode(const cv::Mat1b& mask, const cv::Point& offset)
+{
+  std::vector<boost::uint32_t> counts;
+  bool current = false;
+  boost::uint32_t length = 0;
+  for(int x = 0; x < mask.cols; ++x)
+  {
+    for(int y = 0; y < mask.rows; ++y)
+    {
+      const bool value = mask(y, x) != 0;
+      if(value != current)
+      {
+        counts.push_back(length);
+        current = value;
+        length = 0;
+      }
+      ++length;
+    }
+  }
+  counts.push_back(length);
+
+  return RLEMask(offset, mask.size(), counts);
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+size_t RLEMask::area() const
+{
+  return m_area;
+}
+
+size_t RLEMask::calculate_intersection_area(const RLEMask& rhs) const
+{
+  // Early out if the rectangles covered by the masks do not overlap.
+  const cv::Rect overlap = cv::Rect(m_offset, m_size) & cv::Rect(rhs.m_offset, rhs.m_size);
+  if(overlap.area() <= 0 || m_area == 0 || rhs.m_area == 0) return 0;
+
+  // Merge the two sorted sequences of segments, accumulating the overlap of segments in the same column.
+  size_t result = 0;
+  ForegroundSegmentIterator a(*this), b(rhs);
+  while(!a.done() && !b.done())
+  {
+    if(a.x < b.x) a.next();
+    else if(b.x < a.x) b.next();
+    else
+    {
+      const int overlapLength = std::min(a.yEnd, b.yEnd) - std::max(a.yBegin, b.yBegin);
+      if(overlapLength > 0) result += overlapLength;
+      if(a.yEnd < b.yEnd) a.next();
+      else b.next();
+    }
+  }
+
+  return result;
+}
+
+size_t RLEMask::calculate_union_area(const RLEMask& rhs) const
+{
+  return m_area + rhs.m_area - calculate_intersection_area(rhs);
+}
+
+cv::Mat1b RLEMask::decode() const
+{
+  cv::Mat1b mask = cv::Mat1b::zeros(m_size);
+  for(ForegroundSegmentIterator it(*this); !it.done(); it.next())
+  {
+    for(int y = it.yBegin; y < it.yEnd; ++y)
+    {
+      mask(y - m_offset.y, it.x - m_offset.x) = 255;
+    }
+  }
+  return mask;
+}
+
+bool RLEMask::empty() const
+{
+  return m_size.area() == 0;
+}
+
+const std::vector<boost::uint32_t>& RLEMask::get_counts() const
+{
+  return *m_counts;
+}
+
+const cv::Point& RLEMask::get_offset() const
+{
+  return m_offset;
+}
+
+const cv::Size& RLEMask::get_size() const
+{
+  return m_size;
+}
+
+//#################### OUTPUT ####################
+
+std::ostream& operator<<(std::ostream& os, const RLEMask& m)
+{
+  os << "RLEMask(" << m.get_offset().x << ',' << m.get_offset().y << ' ' << m.get_size().width << 'x' << m.get_size().height
+     << ", " << m.get_counts().size() << " runs, area " << m.area() << ')';
+  return os;
+}
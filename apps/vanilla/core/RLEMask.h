@@ -0,0 +1,126 @@
+/**
+ * vanilla: RLEMask.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#ifndef H_VANILLA_RLEMASK
+#define H_VANILLA_RLEMASK
+
+#include <ostream>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * \brief An instance of this class represents a run-length-encoded binary mask placed in an image.
+ *
+ * As in the COCO API, the mask is stored as the lengths of alternating runs of background and foreground pixels
+ * in column-major order, starting with a (possibly empty) background run. The mask covers a rectangle of the
+ * image whose top-left corner is at the specified offset, so masks with different rectangles can be compared.
+ *
+ * Areas, intersections and unions are computed directly on the runs, in time proportional to the number of
+ * runs rather than the number of pixels. The runs are immutable and shared between copies.
+ */
+class RLEMask
+{
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The number of foreground pixels in the mask. */
+  size_t m_area;
+
+  /** The run lengths, alternating between background and foreground and starting with background. */
+  boost::shared_ptr<const std::vector<boost::uint32_t> > m_counts;
+
+  /** The position of the top-left corner of the mask in the image. */
+  cv::Point m_offset;
+
+  /** The size of the mask. */
+  cv::Size m_size;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs an empty mask.
+   */
+  RLEMask();
+
+  /**
+   * \brief Constructs a mask from its run lengths.
+   *
+   * \param offset              The position of the top-left corner of the mask in the image.
+   * \param size                The size of the mask.
+   * \param counts              The run lengths, in column-major order, alternating between background and foreground.
+   * \throws std::runtime_error If the run lengths do not sum to the number of pixels in the mask.
+   */
+  RLEMask(const cv::Point& offset, const cv::Size& size, const std::vector<boost::uint32_t>& counts);
+
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Run-length encodes a mask, treating every non-zero pixel as foreground.
+   *
+   * \param mask    The mask.
+   * \param offset  The position of the top-left corner of the mask in the image.
+   * \return        The encoded mask.
+   */
+  static RLEMask encode(const cv::Mat1b& mask, const cv::Point& offset = cv::Point(0, 0));
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the number of foreground pixels in the mask.
+   */
+  size_t area() const;
+
+  /**
+   * \brief Calculates the number of pixels that are foreground in both this mask and another one.
+   *
+   * \param rhs The other mask.
+   * \return    The area of the intersection of the two masks.
+   */
+  size_t calculate_intersection_area(const RLEMask& rhs) const;
+
+  /**
+   * \brief Calculates the number of pixels that are foreground in either this mask or another one.
+   *
+   * \param rhs The other mask.
+   * \return    The area of the union of the two masks.
+   */
+  size_t calculate_union_area(const RLEMask& rhs) const;
+
+  /**
+   * \brief Decodes the mask.
+   *
+   * \return  The mask, with foreground pixels set to 255 and background pixels set to 0.
+   */
+  cv::Mat1b decode() const;
+
+  /**
+   * \brief Gets whether or not the mask covers no pixels at all.
+   */
+  bool empty() const;
+
+  /**
+   * \brief Gets the run lengths of the mask.
+   */
+  const std::vector<boost::uint32_t>& get_counts() const;
+
+  /**
+   * \brief Gets the position of the top-left corner of the mask in the image.
+   */
+  const cv::Point& get_offset() const;
+
+  /**
+   * \brief Gets the size of the mask.
+   */
+  const cv::Size& get_size() const;
+};
+
+//#################### OUTPUT ####################
+
+std::ostream& operator<<(std::ostream& os, const RLEMask& m);
+
+#endif
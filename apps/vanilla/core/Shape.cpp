@@ -6,11 +6,12 @@
 #include "Shape.h"
 
 #include <opencv2/core/core.hpp>
-#include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "../Util.h"
 
+#include <stdexcept>
+
 //#################### CONSTRUCTORS ####################
 
 Shape::Shape()
@@ -25,6 +26,16 @@ Shape::Shape(const VOCBox& box, const cv::Mat1b& mask)
   m_mask(mask)
 {}
 
+Shape::Shape(const VOCBox& box, const RLEMask& rleMask)
+: m_box(box),
+  m_rleMask(rleMask)
+{}
+
+Shape::Shape(const VOCBox& box, const LazyMask_CPtr& lazyMask)
+: m_box(box),
+  m_lazyMask(lazyMask)
+{}
+
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
 VOCBox Shape::get_voc_box() const
@@ -32,77 +43,98 @@ VOCBox Shape::get_voc_box() const
   return m_box;
 }
 
+tvgshape::BitMask Shape::get_bit_mask() const
+{
+  if(!has_image_mask()) return tvgshape::BitMask(get_mask(), m_rleMask.get_offset());
+
+  cv::Rect rect;
+  cv::Mat1b boxMask = make_box_mask(rect);
+  return tvgshape::BitMask(boxMask, rect.tl());
+}
+
+const LazyMask_CPtr& Shape::get_lazy_mask() const
+{
+  return m_lazyMask;
+}
+
 cv::Mat1b Shape::get_mask() const
 {
+  if(m_lazyMask) return m_lazyMask->get_mask();
+  if(!m_mask.data && !m_rleMask.empty()) return m_rleMask.decode();
   return m_mask;
 }
 
-float Shape::calculate_intersection_area(const Shape& shape, uint8_t binaryMaskThreshold) const
+RLEMask Shape::get_rle_mask() const
 {
-  float boxIntersectionArea = m_box.calculate_intersection_area(shape.get_voc_box());
-  if(boxIntersectionArea <= 0.0f || (!m_mask.data)) return boxIntersectionArea;
-
-  // Only calculate the shape intersection area if the box intersection area is greater than zero, and a shape mask exists.
+  if(!has_image_mask()) return m_rleMask;
 
-  // Calculate the maximum width or height the canvas needs to be.
-  int xmax = std::max(m_box.xmax, shape.get_voc_box().xmax);
-  int ymax = std::max(m_box.ymax, shape.get_voc_box().ymax);
+  cv::Rect rect;
+  cv::Mat1b boxMask = make_box_mask(rect);
+  if(!boxMask.data) return RLEMask(rect.tl(), cv::Size(0, 0), std::vector<boost::uint32_t>(1, 0));
 
-  cv::Mat1b canvasA = draw_binary_mask_on_canvas(m_box, m_mask, xmax, ymax, binaryMaskThreshold);
-  cv::Mat1b canvasB = draw_binary_mask_on_canvas(shape.get_voc_box(), shape.get_mask(), xmax, ymax, binaryMaskThreshold);
+  return RLEMask::encode(boxMask, rect.tl());
+}
 
-  cv::Mat1b intersectionMask = cv::Mat::zeros(ymax, xmax, CV_8UC1);
-  cv::bitwise_and(canvasA, canvasB, intersectionMask);
+bool Shape::has_mask() const
+{
+  return has_image_mask() || !m_rleMask.empty();
+}
 
-//#define SHAPE_DRAW_MASK_DEBUG
-#ifdef SHAPE_DRAW_MASK_DEBUG
-  cv::imshow("mask", m_mask);
+float Shape::calculate_intersection_area(const Shape& shape, uint8_t binaryMaskThreshold) const
+{
+  float boxIntersectionArea = m_box.calculate_intersection_area(shape.get_voc_box());
 
-  cv::imshow("canvasA", canvasA);
-  cv::imshow("canvasB", canvasB);
+  // Only calculate the shape intersection area if the box intersection area is greater than zero, and both shapes have masks.
+  if(boxIntersectionArea <= 0.0f || !has_mask() || !shape.has_mask()) return boxIntersectionArea;
 
-  cv::imshow("intersection", intersectionMask);
-  cv::waitKey();
-#endif
+  // If both masks are images, packing them into bits is cheaper than run-length encoding them.
+  if(has_image_mask() && shape.has_image_mask())
+  {
+    return static_cast<float>(get_bit_mask().calculate_intersection_area(shape.get_bit_mask()));
+  }
 
-  return static_cast<float>(cv::countNonZero(intersectionMask));
+  return static_cast<float>(get_rle_mask().calculate_intersection_area(shape.get_rle_mask()));
 }
 
 float Shape::area(uint8_t binaryMaskThreshold) const
 {
   float boxArea = m_box.area();
   if(boxArea <= 0.0f) throw std::runtime_error("The box area should not be less than or equal to zero");
-  if(!m_mask.data) return boxArea;
+  if(!has_mask()) return boxArea;
+
+  return static_cast<float>(has_image_mask() ? get_bit_mask().area() : get_rle_mask().area());
+}
 
-  // Only calculate the shape intersection area if the box intersection area is greater than zero, and a shape mask exists.
-  cv::Mat1b canvas = draw_binary_mask_on_canvas(m_box, m_mask, m_box.xmax, m_box.ymax, binaryMaskThreshold);
-  return static_cast<float>(cv::countNonZero(canvas));
+Shape Shape::to_rle() const
+{
+  return has_image_mask() ? Shape(m_box, get_rle_mask()) : *this;
 }
 
 //#################### PRIVATE MEMBER FUNCTIONS ####################
 
-cv::Mat1b Shape::draw_binary_mask_on_canvas(const VOCBox& vbox, const cv::Mat1b& mask, size_t canvasWidth, size_t canvasHeight, uint8_t binaryMaskThreshold) const
+bool Shape::has_image_mask() const
+{
+  return m_lazyMask || m_mask.data;
+}
+
+cv::Mat1b Shape::make_box_mask(cv::Rect& rect) const
 {
-    // FIXME duplicate code in DetecitonUtil
-    cv::Rect rect = Util::to_rect(vbox);
-    cv::Mat1b resizedMask(rect.height, rect.width);
-    if(mask.cols != rect.width || mask.rows != rect.height)
-    {
-      cv::resize(mask, resizedMask, resizedMask.size(), 0.0, 0.0, cv::INTER_CUBIC);
-    }
-    else
-    {
-      resizedMask = mask;
-    }
-
-    //cv::threshold(resizedMask, resizedMask, binaryMaskThreshold, 255, cv::THRESH_BINARY);
-
-    // Create a canvas on which to draw the shapes.
-    cv::Mat1b canvas = cv::Mat::zeros(canvasHeight, canvasWidth, CV_8UC1);
-    cv::Mat1b roiCanvas = canvas(rect);
-    cv::add(roiCanvas, resizedMask, roiCanvas, resizedMask);
-
-    return canvas;
+  // Stretch the mask to fit the box, counting every non-zero pixel of the result as part of the shape.
+  rect = Util::to_rect(m_box);
+  if(rect.width <= 0 || rect.height <= 0) return cv::Mat1b();
+
+  const cv::Mat1b mask = get_mask();
+  cv::Mat1b resizedMask;
+  if(mask.cols != rect.width || mask.rows != rect.height)
+  {
+    cv::resize(mask, resizedMask, rect.size(), 0.0, 0.0, cv::INTER_CUBIC);
+  }
+  else
+  {
+    resizedMask = mask;
+  }
+
+  return resizedMask;
 }
 
 //#################### OUTPUT ####################
@@ -6,38 +6,67 @@
 #ifndef H_VANILLA_SHAPE
 #define H_VANILLA_SHAPE
 
+#include "LazyMask.h"
+#include "RLEMask.h"
 #include "VOCBox.h"
 
 #include <ostream>
 #include <opencv2/core/core.hpp>
 
+#include <tvgshape/BitMask.h>
+
 /*
  * brief Represents a shape.
+ *
+ * The mask of a shape (if any) is stored either as an image, which is stretched to fit the box when it is compared
+ * with other shapes, or as a run-length-encoded mask that already fits the box. The latter is much more compact,
+ * and much faster to compare, so shapes that are compared many times (e.g. during evaluation) should use to_rle().
+ * Shapes whose masks are both images (e.g. fresh detections) are compared by packing the stretched masks into bits.
+ * The image mask of a detection can also be left as a shape descriptor that is only decoded when the mask is first
+ * needed (see LazyMask), so that the masks of the detections that are later discarded are never decoded.
  */
 class Shape
 {
   //#################### PRIVATE MEMBER VARIABLES ####################
 private:
   VOCBox m_box;
+  LazyMask_CPtr m_lazyMask;
   cv::Mat1b m_mask;
+  RLEMask m_rleMask;
 
   //#################### CONSTRUCTORS ####################
 public:
   Shape();
   explicit Shape(const VOCBox& box);
   Shape(const VOCBox& box, const cv::Mat1b& mask);
+  Shape(const VOCBox& box, const RLEMask& rleMask);
+  Shape(const VOCBox& box, const LazyMask_CPtr& lazyMask);
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
   VOCBox get_voc_box() const;
+  tvgshape::BitMask get_bit_mask() const;
+
+  /* Return the lazy mask of the shape (if any), so that the masks of several shapes can be decoded together. */
+  const LazyMask_CPtr& get_lazy_mask() const;
+
   cv::Mat1b get_mask() const;
+  RLEMask get_rle_mask() const;
+  bool has_mask() const;
 
   float calculate_intersection_area(const Shape& shape, uint8_t binaryMaskThreshold = 100) const;
   float area(uint8_t binaryMaskThreshold = 100) const;
 
+  /* Return a copy of the shape whose mask (if any) is run-length encoded. */
+  Shape to_rle() const;
+
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
-  cv::Mat1b draw_binary_mask_on_canvas(const VOCBox& vbox, const cv::Mat1b& mask, size_t canvasWidth, size_t canvasHeight, uint8_t binaryMaskThreshold) const;
+  /* Return whether the mask of the shape is (or will be decoded to) an image. */
+  bool has_image_mask() const;
+
+  /* Stretch the image mask to fit the box, returning an empty mask if the box is empty. */
+  cv::Mat1b make_box_mask(cv::Rect& rect) const;
 };
 
 //#################### OUTPUT ####################
@@ -19,52 +19,53 @@ DataTransformationFactory::Settings::Settings()
 
 //#################### CONSTRUCTORS ####################
 
-DataTransformationFactory::DataTransformationFactory(unsigned int seed, const DataTransformationFactory::Settings& settings)
-: m_rng(seed),
-  m_settings(settings)
+DataTransformationFactory::DataTransformationFactory(const DataTransformationFactory::Settings& settings)
+: m_settings(settings)
 {}
 
-DataTransformation DataTransformationFactory::generate_transformation() const
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+DataTransformation DataTransformationFactory::generate_transformation(tvgutil::CounterBasedRandomNumberGenerator& rng) const
 {
   const float smallValue(1e-3);
 
   float rotationAngle(0.0f);
   if(m_settings.maxRotation > smallValue)
-    rotationAngle = m_rng.generate_real_from_uniform(-m_settings.maxRotation, m_settings.maxRotation);
+    rotationAngle = rng.generate_real_from_uniform(-m_settings.maxRotation, m_settings.maxRotation);
 
   float xTranslation(0.0f);
   float yTranslation(0.0f);
   if(m_settings.maxTranslation > smallValue)
   {
-    xTranslation = m_rng.generate_real_from_uniform(-m_settings.maxTranslation, m_settings.maxTranslation);
-    yTranslation = m_rng.generate_real_from_uniform(-m_settings.maxTranslation, m_settings.maxTranslation);
+    xTranslation = rng.generate_real_from_uniform(-m_settings.maxTranslation, m_settings.maxTranslation);
+    yTranslation = rng.generate_real_from_uniform(-m_settings.maxTranslation, m_settings.maxTranslation);
   }
 
   float spatialScaleFactor(1.0f);
   if(m_settings.maxSpatialScalePercentage > smallValue)
-    spatialScaleFactor = 1.0f + (m_rng.generate_real_from_uniform(0.0f, m_settings.maxSpatialScalePercentage * 0.01f)) * (m_rng.generate_int_from_uniform(0, 1)*2-1);
+    spatialScaleFactor = 1.0f + (rng.generate_real_from_uniform(0.0f, m_settings.maxSpatialScalePercentage * 0.01f)) * (rng.generate_int_from_uniform(0, 1)*2-1);
 
   float scaleIntensityFactor(1.0f);
   if(m_settings.maxScaleIntensityPercentage > smallValue)
-    scaleIntensityFactor = 1.0f + (m_rng.generate_real_from_uniform(0.0f, m_settings.maxScaleIntensityPercentage * 0.01f)) * (m_rng.generate_int_from_uniform(0, 1)*2-1);
+    scaleIntensityFactor = 1.0f + (rng.generate_real_from_uniform(0.0f, m_settings.maxScaleIntensityPercentage * 0.01f)) * (rng.generate_int_from_uniform(0, 1)*2-1);
 
   float addToIntensityValue(0.0f);
   if(m_settings.maxAddToIntensityValue > smallValue)
-    addToIntensityValue = m_rng.generate_real_from_uniform(-m_settings.maxAddToIntensityValue, m_settings.maxAddToIntensityValue);
+    addToIntensityValue = rng.generate_real_from_uniform(-m_settings.maxAddToIntensityValue, m_settings.maxAddToIntensityValue);
 
   bool yflip = false;
-  if(m_settings.useRandomFlipping) yflip = static_cast<bool>(m_rng.generate_int_from_uniform(0, 1));
+  if(m_settings.useRandomFlipping) yflip = static_cast<bool>(rng.generate_int_from_uniform(0, 1));
 
   return DataTransformation(rotationAngle, xTranslation, yTranslation, spatialScaleFactor,
                             scaleIntensityFactor, addToIntensityValue, yflip, m_settings.networkImageWidth, m_settings.networkImageHeight);
 }
 
-std::vector<DataTransformation> DataTransformationFactory::generate_transformations(size_t transformationCount) const
+std::vector<DataTransformation> DataTransformationFactory::generate_transformations(size_t transformationCount, tvgutil::CounterBasedRandomNumberGenerator& rng) const
 {
   std::vector<DataTransformation> result;
   for(size_t i = 0; i < transformationCount; ++i)
   {
-    result.push_back(generate_transformation());
+    result.push_back(generate_transformation(rng));
   }
 
   return result;
@@ -8,7 +8,7 @@
 
 #include "DataTransformation.h"
 
-#include <tvgutil/numbers/RandomNumberGenerator.h>
+#include <tvgutil/numbers/CounterBasedRandomNumberGenerator.h>
 
 class DataTransformationFactory
 {
@@ -34,16 +34,21 @@ public:
 
   //#################### PRIVATE VARIABLES ####################
 private:
-  mutable tvgutil::RandomNumberGenerator m_rng;
-
   Settings m_settings;
 
   //#################### CONSTRUCTORS ####################
 public:
-  DataTransformationFactory(unsigned int seed, const DataTransformationFactory::Settings& settings); 
+  explicit DataTransformationFactory(const DataTransformationFactory::Settings& settings);
 
-  DataTransformation generate_transformation() const;
-  std::vector<DataTransformation> generate_transformations(size_t transformationCount) const;
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Generates a random transformation, drawing from the specified random number generator.
+   *
+   * The factory itself holds no random state, so it can be shared by several threads as long as each one passes in its own generator.
+   */
+  DataTransformation generate_transformation(tvgutil::CounterBasedRandomNumberGenerator& rng) const;
+  std::vector<DataTransformation> generate_transformations(size_t transformationCount, tvgutil::CounterBasedRandomNumberGenerator& rng) const;
 
   friend std::ostream& operator<<(std::ostream& os, const DataTransformationFactory& d);
 };
@@ -0,0 +1,209 @@
+/**
+ * vanilla: PrefetchingImageLoader.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#include "PrefetchingImageLoader.h"
+
+#include "../Util.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+typedef boost::chrono::steady_clock Clock;
+
+//#################### LOCAL CONSTANTS ####################
+
+// The number of workers used when the caller does not say. Callers that know where the network runs should ask for more
+// when there are threads to spare (see DarknetUtil::default_loader_worker_count).
+static const size_t defaultWorkerCount(2);
+
+//#################### LOCAL FUNCTIONS ####################
+
+static double seconds_since(const Clock::time_point& t0)
+{
+  return boost::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+//#################### CONSTRUCTORS ####################
+
+PrefetchingImageLoader::PrefetchingImageLoader(const std::vector<std::string>& imagePaths, size_t imageWidthNetwork, size_t imageHeightNetwork, size_t workerCount, size_t memoryBudget)
+: m_imageHeightNetwork(imageHeightNetwork),
+  m_imagePaths(imagePaths),
+  m_imageWidthNetwork(imageWidthNetwork),
+  m_nextImageToLoad(0),
+  m_nextImageToPop(0),
+  m_startTime(Clock::now()),
+  m_stopping(false)
+{
+  if(workerCount == 0) workerCount = std::min<size_t>(defaultWorkerCount, std::max(1u, boost::thread::hardware_concurrency()));
+  workerCount = std::max<size_t>(1, std::min(workerCount, imagePaths.size()));
+
+  const size_t bytesPerImage = imageWidthNetwork * imageHeightNetwork * 3 * sizeof(float);
+  m_maxImagesInFlight = std::max<size_t>(1, memoryBudget / std::max<size_t>(1, bytesPerImage));
+
+  m_counters.convertSeconds = 0.0;
+  m_counters.consumerWaitSeconds = 0.0;
+  m_counters.decodeSeconds = 0.0;
+  m_counters.elapsedSeconds = 0.0;
+  m_counters.imagesConsumed = 0;
+  m_counters.imagesLoaded = 0;
+  m_counters.resizeSeconds = 0.0;
+  m_counters.workerCount = workerCount;
+
+  for(size_t i = 0; i < workerCount; ++i)
+  {
+    m_workers.create_thread(boost::bind(&PrefetchingImageLoader::run_worker, this));
+  }
+}
+
+//#################### DESTRUCTOR ####################
+
+PrefetchingImageLoader::~PrefetchingImageLoader()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_itemTaken.notify_all();
+  m_workers.join_all();
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+PrefetchingImageLoader::Counters PrefetchingImageLoader::get_counters() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  Counters counters = m_counters;
+  counters.elapsedSeconds = seconds_since(m_startTime);
+  return counters;
+}
+
+bool PrefetchingImageLoader::pop(Item& item)
+{
+  Clock::time_point t0 = Clock::now();
+
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if(m_nextImageToPop >= m_imagePaths.size()) return false;
+
+    std::map<size_t,Item>::iterator it;
+    while((it = m_reorderBuffer.find(m_nextImageToPop)) == m_reorderBuffer.end())
+    {
+      m_itemLoaded.wait(lock);
+    }
+
+    std::swap(item, it->second);
+    m_reorderBuffer.erase(it);
+
+    ++m_nextImageToPop;
+    ++m_counters.imagesConsumed;
+    m_counters.consumerWaitSeconds += seconds_since(t0);
+  }
+
+  m_itemTaken.notify_all();
+
+  if(!item.error.empty()) throw std::runtime_error(item.error);
+  return true;
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+PrefetchingImageLoader::Item PrefetchingImageLoader::load_image(size_t index, Counters& counters) const
+{
+  Item item;
+  item.index = index;
+
+  const std::string& path = m_imagePaths[index];
+
+  Clock::time_point t0 = Clock::now();
+  cv::Mat3b im = cv::imread(path, CV_LOAD_IMAGE_COLOR);
+  counters.decodeSeconds += seconds_since(t0);
+
+  if(!im.data)
+  {
+    item.error = "Could not read the image " + path;
+    return item;
+  }
+
+  item.originalSize = cv::Size(im.cols, im.rows);
+
+  const cv::Size networkSize(static_cast<int>(m_imageWidthNetwork), static_cast<int>(m_imageHeightNetwork));
+  cv::Mat3b resized;
+  t0 = Clock::now();
+  if(item.originalSize != networkSize) cv::resize(im, resized, networkSize);
+  else resized = im;
+  counters.resizeSeconds += seconds_since(t0);
+
+  t0 = Clock::now();
+  item.tensor.resize(m_imageWidthNetwork * m_imageHeightNetwork * 3);
+  Util::make_rgb_image(resized, 1/255.0f, &item.tensor[0]);
+  counters.convertSeconds += seconds_since(t0);
+
+  return item;
+}
+
+void PrefetchingImageLoader::run_worker()
+{
+  for(;;)
+  {
+    size_t index;
+
+    // Claim the next image, waiting if the maximum number of images are already in flight.
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while(!m_stopping && m_nextImageToLoad < m_imagePaths.size() && m_nextImageToLoad >= m_nextImageToPop + m_maxImagesInFlight)
+      {
+        m_itemTaken.wait(lock);
+      }
+
+      if(m_stopping || m_nextImageToLoad >= m_imagePaths.size()) return;
+      index = m_nextImageToLoad++;
+    }
+
+    Counters counters;
+    counters.convertSeconds = counters.decodeSeconds = counters.resizeSeconds = 0.0;
+
+    Item item;
+    try
+    {
+      item = load_image(index, counters);
+    }
+    catch(std::exception& e)
+    {
+      item.error = "Could not load the image " + m_imagePaths[index] + ": " + e.what();
+      item.index = index;
+    }
+
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      std::swap(m_reorderBuffer[index], item);
+
+      ++m_counters.imagesLoaded;
+      m_counters.convertSeconds += counters.convertSeconds;
+      m_counters.decodeSeconds += counters.decodeSeconds;
+      m_counters.resizeSeconds += counters.resizeSeconds;
+    }
+
+    m_itemLoaded.notify_one();
+  }
+}
+
+//#################### STREAM OPERATORS ####################
+
+std::ostream& operator<<(std::ostream& os, const PrefetchingImageLoader::Counters& counters)
+{
+  // Reports the rate of each stage as images per second of (summed) worker time, and the overall rate as images per second of wall-clock time.
+  const double n = static_cast<double>(counters.imagesLoaded);
+  os << "PrefetchingImageLoader: " << counters.imagesConsumed << " images in " << counters.elapsedSeconds << "s ("
+     << (counters.elapsedSeconds > 0.0 ? counters.imagesConsumed / counters.elapsedSeconds : 0.0) << " images/s, "
+     << counters.workerCount << " workers)\n";
+  os << "  decode:  " << counters.decodeSeconds << "s (" << (counters.decodeSeconds > 0.0 ? n / counters.decodeSeconds : 0.0) << " images/s per worker)\n";
+  os << "  resize:  " << counters.resizeSeconds << "s (" << (counters.resizeSeconds > 0.0 ? n / counters.resizeSeconds : 0.0) << " images/s per worker)\n";
+  os << "  convert: " << counters.convertSeconds << "s (" << (counters.convertSeconds > 0.0 ? n / counters.convertSeconds : 0.0) << " images/s per worker)\n";
+  os << "  consumer waiting: " << counters.consumerWaitSeconds << "s";
+  return os;
+}
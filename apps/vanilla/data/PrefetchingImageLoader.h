@@ -0,0 +1,188 @@
+/**
+ * vanilla: PrefetchingImageLoader.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#ifndef H_VANILLA_PREFETCHINGIMAGELOADER
+#define H_VANILLA_PREFETCHINGIMAGELOADER
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * \brief An instance of this class loads a sequence of images on a pool of worker threads and hands them out,
+ *        in their original order, as network-ready input tensors.
+ *
+ * Each worker claims the next unloaded image, decodes it, resizes it to the network input size and converts it
+ * to a planar RGB float tensor scaled to [0,1]. Finished images wait in a reorder buffer until the consumer
+ * reaches them. At most a fixed number of images (derived from the memory budget) are in flight at any one
+ * time, so a slow consumer cannot cause the loader to run ahead and fill memory.
+ */
+class PrefetchingImageLoader
+{
+  //#################### NESTED TYPES ####################
+public:
+  /**
+   * \brief An instance of this struct represents a loaded image.
+   */
+  struct Item
+  {
+    /** The error that occurred while loading the image (empty if it loaded successfully). */
+    std::string error;
+
+    /** The position of the image in the sequence. */
+    size_t index;
+
+    /** The size of the image before it was resized. */
+    cv::Size originalSize;
+
+    /** The image, as a planar RGB tensor of size imageWidthNetwork x imageHeightNetwork x 3. */
+    std::vector<float> tensor;
+  };
+
+  /**
+   * \brief An instance of this struct holds the throughput counters of the loader.
+   */
+  struct Counters
+  {
+    /** The total time spent by the workers converting images to tensors, in seconds. */
+    double convertSeconds;
+
+    /** The total time spent waiting by the consumer for the next image, in seconds. */
+    double consumerWaitSeconds;
+
+    /** The total time spent by the workers decoding images, in seconds. */
+    double decodeSeconds;
+
+    /** The wall-clock time since the loader was started, in seconds. */
+    double elapsedSeconds;
+
+    /** The number of images handed out to the consumer. */
+    size_t imagesConsumed;
+
+    /** The number of images loaded by the workers. */
+    size_t imagesLoaded;
+
+    /** The total time spent by the workers resizing images, in seconds. */
+    double resizeSeconds;
+
+    /** The number of worker threads. */
+    size_t workerCount;
+  };
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The throughput counters (guarded by m_mutex). */
+  Counters m_counters;
+
+  /** The height of the network input. */
+  size_t m_imageHeightNetwork;
+
+  /** The paths to the images to load. */
+  std::vector<std::string> m_imagePaths;
+
+  /** The width of the network input. */
+  size_t m_imageWidthNetwork;
+
+  /** Signalled when an image is added to the reorder buffer. */
+  boost::condition_variable m_itemLoaded;
+
+  /** Signalled when the consumer takes an image, freeing up space for another one to be loaded. */
+  boost::condition_variable m_itemTaken;
+
+  /** The maximum number of images that may be loading or waiting in the reorder buffer at any one time. */
+  size_t m_maxImagesInFlight;
+
+  /** The mutex that guards the shared state of the loader. */
+  mutable boost::mutex m_mutex;
+
+  /** The index of the next image to be claimed by a worker. */
+  size_t m_nextImageToLoad;
+
+  /** The index of the next image to be handed out to the consumer. */
+  size_t m_nextImageToPop;
+
+  /** The loaded images that are waiting to be handed out, keyed by their indices. */
+  std::map<size_t,Item> m_reorderBuffer;
+
+  /** The time at which the loader was started. */
+  boost::chrono::steady_clock::time_point m_startTime;
+
+  /** Whether or not the workers have been asked to stop. */
+  bool m_stopping;
+
+  /** The worker threads. */
+  boost::thread_group m_workers;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a loader for the specified images, and starts its worker threads.
+   *
+   * \param imagePaths          The paths to the images to load, in the order in which they should be handed out.
+   * \param imageWidthNetwork   The width of the network input.
+   * \param imageHeightNetwork  The height of the network input.
+   * \param workerCount         The number of worker threads (0 means a small default, leaving the cores to the network).
+   * \param memoryBudget        The maximum number of bytes of tensors to hold at any one time (at least one image is always allowed).
+   */
+  PrefetchingImageLoader(const std::vector<std::string>& imagePaths, size_t imageWidthNetwork, size_t imageHeightNetwork, size_t workerCount = 0, size_t memoryBudget = 256 * 1024 * 1024);
+
+  //#################### DESTRUCTOR ####################
+public:
+  /**
+   * \brief Stops the worker threads and waits for them to finish.
+   */
+  ~PrefetchingImageLoader();
+
+  //#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+  // Deliberately private and unimplemented.
+  PrefetchingImageLoader(const PrefetchingImageLoader&);
+  PrefetchingImageLoader& operator=(const PrefetchingImageLoader&);
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets a snapshot of the throughput counters of the loader.
+   *
+   * \return  The throughput counters.
+   */
+  Counters get_counters() const;
+
+  /**
+   * \brief Waits for the next image in the sequence and moves it out of the loader.
+   *
+   * \param item                The variable into which to move the image.
+   * \return                    true, if an image was popped, or false if every image has already been popped.
+   * \throws std::runtime_error If the image could not be loaded.
+   */
+  bool pop(Item& item);
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Loads the image with the specified index.
+   *
+   * \param index     The index of the image to load.
+   * \param counters  The counters to which to add the time spent in each stage.
+   * \return          The loaded image.
+   */
+  Item load_image(size_t index, Counters& counters) const;
+
+  /**
+   * \brief Repeatedly claims and loads the next image in the sequence, until there are none left or the loader is stopped.
+   */
+  void run_worker();
+};
+
+//#################### STREAM OPERATORS ####################
+
+std::ostream& operator<<(std::ostream& os, const PrefetchingImageLoader::Counters& counters);
+
+#endif
@@ -42,61 +42,65 @@ std::vector<float> generate_random_vector(tvgutil::RandomNumberGenerator& rng, s
 
 TrainingDataGenerator::TrainingDataGenerator(const std::vector<std::string>& imagePaths, const Dataset_CPtr& dataset, size_t imageWidthNetwork, size_t imageHeightNetwork, const DataTransformationFactory::Settings& dataTransformationSettings, unsigned int seed, const boost::optional<ShapeDescriptorCalculator_CPtr>& shapeDescriptorCalculator)
 : m_dataset(dataset),
-  m_dataTransformationFactory(seed, dataTransformationSettings),
+  m_dataTransformationFactory(dataTransformationSettings),
   m_imageHeightNetwork(imageHeightNetwork),
   m_imagePaths(imagePaths),
   m_imageWidthNetwork(imageWidthNetwork),
-  m_rng(seed),
+  m_seed(seed),
   m_shapeDescriptorCalculator(shapeDescriptorCalculator)
 {}
 
-void TrainingDataGenerator::run_load_loop(CQ_Ptr& cq, size_t startBatchNumber, size_t maxBatchNumber, size_t numDatum, size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const
+void TrainingDataGenerator::run_load_loop(const Queue_Ptr& queue, size_t startBatchNumber, size_t maxBatchNumber, size_t numDatum, size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const
 {
   for(size_t i = startBatchNumber; i < maxBatchNumber; ++i)
   {
     //TIME(
-    std::vector<Datum> data = generate_training_data(numDatum, imagesPerDatum, jitter, ds);
+    std::vector<Datum> data = generate_training_data(i, numDatum, imagesPerDatum, jitter, ds);
     //, milliseconds, dataLoadTime); std::cout << dataLoadTime << '\n';
 
-    bool loaded = false;
-    while(!loaded)
-    {
-      loaded = cq->push(data);
-    }
+    // Stop early if the trainer has closed the queue.
+    if(!queue->push(std::move(data))) break;
   }
+
+  queue->close();
 }
 
-std::vector<Datum> TrainingDataGenerator::generate_training_data(size_t numDatum, size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const
+std::vector<Datum> TrainingDataGenerator::generate_training_data(size_t batchNumber, size_t numDatum, size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const
 {
   std::vector<Datum> data(numDatum);
+  std::vector<Histogram<std::string> > datumHists(numDatum);
 #ifdef WITH_OPENMP
   #pragma omp parallel for
 #endif
   for(int i = 0; i < static_cast<int>(numDatum); ++i)
   {
-    data[i] = generate_training_datum(imagesPerDatum, jitter, ds);
+    CounterBasedRandomNumberGenerator rng(m_seed, batchNumber, i);
+    data[i] = generate_training_datum(imagesPerDatum, jitter, ds, rng, datumHists[i]);
+  }
+
+  // Merge the categories picked by each datum into the balancing histogram, ready for the next batch.
+  for(size_t i = 0; i < numDatum; ++i)
+  {
+    m_hist = histogram_add(m_hist, datumHists[i]);
   }
 
   return data;
 }
 
-Datum TrainingDataGenerator::generate_training_datum(size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const
+Datum TrainingDataGenerator::generate_training_datum(size_t imagesPerDatum, float jitter, const DetectionSettings& ds, CounterBasedRandomNumberGenerator& rng, Histogram<std::string>& datumHist) const
 {
   // Get random paths.
-  std::vector<std::string> randomPaths = generate_random_image_paths(imagesPerDatum);
-  std::vector<DataTransformation> dataTransformations = m_dataTransformationFactory.generate_transformations(randomPaths.size());
+  std::vector<std::string> randomPaths = generate_random_image_paths(imagesPerDatum, rng, datumHist);
+  std::vector<DataTransformation> dataTransformations = m_dataTransformationFactory.generate_transformations(randomPaths.size(), rng);
   std::vector<float> input = prepare_input(randomPaths, dataTransformations);
   //TIME(
   std::vector<float> target = prepare_target(randomPaths, ds, dataTransformations);
   //, milliseconds, prepareTarget); std::cout << prepareTarget << '\n';
 
-  // TODO
-  std::cout << m_hist << std::endl;
-
   return std::make_pair(input, target);
 }
 
-std::vector<std::string> TrainingDataGenerator::generate_random_image_paths(size_t imagesPerDatum) const
+std::vector<std::string> TrainingDataGenerator::generate_random_image_paths(size_t imagesPerDatum, CounterBasedRandomNumberGenerator& rng, Histogram<std::string>& datumHist) const
 {
 
   size_t multiplier(1);
@@ -108,7 +112,7 @@ std::vector<std::string> TrainingDataGenerator::generate_random_image_paths(size
   std::vector<std::string> randomPaths;
   for(size_t i = 0; i < imagesPerDatum*multiplier; ++i)
   {
-    randomPaths.push_back(m_imagePaths[m_rng.generate_int_from_uniform(0,pathCount - 1)]);
+    randomPaths.push_back(m_imagePaths[rng.generate_int_from_uniform(0,pathCount - 1)]);
   }
 
   std::vector<std::string> bestPaths;
@@ -123,7 +127,7 @@ std::vector<std::string> TrainingDataGenerator::generate_random_image_paths(size
     const std::vector<VOCObject>& objects = m_dataset->get_annotation_from_image_path(bestPaths[i])->get_objects();
     for(size_t i = 0; i < objects.size(); ++i)
     {
-      m_hist.add(objects[i].categoryName);
+      datumHist.add(objects[i].categoryName);
     }
   }
 
@@ -13,8 +13,8 @@
 #include "../core/DetectionSettings.h"
 #include "../dataset/Dataset.h"
 
-#include <tvgutil/containers/CircularQueue.h>
-#include <tvgutil/numbers/RandomNumberGenerator.h>
+#include <tvgutil/containers/SPSCQueue.h>
+#include <tvgutil/numbers/CounterBasedRandomNumberGenerator.h>
 #include <tvgutil/statistics/Histogram.h>
 
 #include <tvgshape/ShapeDescriptorCalculator.h>
@@ -26,7 +26,7 @@ class TrainingDataGenerator
 {
   //#################### PRIVATE TYPEDEFS ####################
 private:
-  typedef boost::shared_ptr<tvgutil::CircularQueue<std::vector<Datum> > > CQ_Ptr;
+  typedef boost::shared_ptr<tvgutil::SPSCQueue<std::vector<Datum> > > Queue_Ptr;
 
   //#################### PRIVATE VARIABLES ####################
 private:
@@ -40,10 +40,12 @@ private:
 
   size_t m_imageWidthNetwork;
 
-  mutable tvgutil::RandomNumberGenerator m_rng;
-
+  /** The categories of the objects picked so far, used to balance the categories (only updated between batches). */
   mutable tvgutil::Histogram<std::string> m_hist;
 
+  /** The seed from which the random stream of each datum is derived. */
+  unsigned int m_seed;
+
   boost::optional<tvgshape::ShapeDescriptorCalculator_CPtr> m_shapeDescriptorCalculator;
 
   //#################### CONSTRUCTORS ####################
@@ -54,17 +56,24 @@ public:
 public:
   void debug_training_datum(const Datum& datum, size_t imagesPerDatum, const DetectionSettings& ds) const;
 
-  std::vector<Datum> generate_training_data(size_t numDatum, size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const;
+  /**
+   * \brief Generates the data for the specified batch.
+   *
+   * Datum i of batch b draws from the random stream (seed, b, i), and the categories it picks are only added to the
+   * balancing histogram once the whole batch is done, so the output for a given seed does not depend on the number
+   * of threads used to generate it.
+   */
+  std::vector<Datum> generate_training_data(size_t batchNumber, size_t numDatum, size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const;
 
-  Datum generate_training_datum(size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const;
+  Datum generate_training_datum(size_t imagesPerDatum, float jitter, const DetectionSettings& ds, tvgutil::CounterBasedRandomNumberGenerator& rng, tvgutil::Histogram<std::string>& datumHist) const;
 
-  void run_load_loop(CQ_Ptr& cq, size_t startBatchNumber, size_t maxBatchNumber, size_t numDatum, size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const;
+  void run_load_loop(const Queue_Ptr& queue, size_t startBatchNumber, size_t maxBatchNumber, size_t numDatum, size_t imagesPerDatum, float jitter, const DetectionSettings& ds) const;
 
   friend std::ostream& operator<<(std::ostream& os, const TrainingDataGenerator& d);
 
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
-  std::vector<std::string> generate_random_image_paths(size_t imagesPerDatum) const;
+  std::vector<std::string> generate_random_image_paths(size_t imagesPerDatum, tvgutil::CounterBasedRandomNumberGenerator& rng, tvgutil::Histogram<std::string>& datumHist) const;
 
   std::vector<float> prepare_input(const std::vector<std::string>& imagePaths, const std::vector<DataTransformation>& dataTransformations) const;
 
@@ -62,6 +62,11 @@ Dataset::~Dataset(){}
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
+void Dataset::build_annotation_cache() const
+{
+  throw std::runtime_error("This dataset does not support an annotation cache");
+}
+
 Detections Dataset::get_detections_from_image_path(const std::string& imagePath, const boost::optional<DataTransformation>& dataTransformation) const
 {
   boost::filesystem::path bpath(imagePath);
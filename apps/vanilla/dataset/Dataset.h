@@ -100,6 +100,13 @@ public:
 
   virtual std::string get_competition_code(VOCSplit vocSplit, bool seenNonVOCData) const = 0;
 
+  /**
+   * \brief Preprocesses the annotations of the dataset into a binary cache that will be used in place of the originals in future runs.
+   *
+   * \throws std::runtime_error If the dataset does not support an annotation cache.
+   */
+  virtual void build_annotation_cache() const;
+
   VOCAnnotation_CPtr get_annotation_from_image_path(const std::string& path) const;
   VOCAnnotation_CPtr get_annotation_from_image_name(const std::string& imageName) const;
   boost::optional<VOCAnnotation_CPtr> optionally_get_annotation_from_name(const std::string& name) const;
@@ -0,0 +1,213 @@
+/**
+ * vanilla: SegmentationAnnotationCache.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#include "SegmentationAnnotationCache.h"
+
+#include "VOCSegmentationAnnotation.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+
+//#################### LOCAL CONSTANTS ####################
+
+static const char MAGIC[] = "VANSEGC2";
+static const size_t MAGIC_SIZE = 8;
+static const size_t HEADER_SIZE = MAGIC_SIZE + sizeof(boost::uint32_t) + sizeof(boost::uint64_t);
+
+//#################### LOCAL FUNCTIONS ####################
+
+template <typename T>
+static void write_value(std::ostream& os, T value)
+{
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * \brief Reads a value from a memory-mapped buffer and advances the read position past it.
+ *
+ * The value is copied out rather than dereferenced in place, since the fields in the file are not aligned.
+ */
+template <typename T>
+static T read_value(const char *& p, const char *end)
+{
+  if(p + sizeof(T) > end) throw std::runtime_error("The annotation cache is truncated");
+  T value;
+  memcpy(&value, p, sizeof(T));
+  p += sizeof(T);
+  return value;
+}
+
+//#################### CONSTRUCTORS ####################
+
+SegmentationAnnotationCache::SegmentationAnnotationCache(const std::string& path)
+: m_loaded(false), m_path(path)
+{}
+
+//#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+void SegmentationAnnotationCache::build(const std::string& path, const std::map<std::string,VOCAnnotation_CPtr>& imageNameToAnnotation)
+{
+  // Write to a temporary file first, so that an interrupted build never leaves a partial cache behind.
+  const std::string tempPath = path + ".tmp";
+  std::ofstream fs(tempPath.c_str(), std::ios::binary);
+  if(!fs) throw std::runtime_error("Could not open " + tempPath + " for writing");
+
+  fs.write(MAGIC, MAGIC_SIZE);
+  write_value<boost::uint32_t>(fs, static_cast<boost::uint32_t>(imageNameToAnnotation.size()));
+  write_value<boost::uint64_t>(fs, 0);
+
+  std::vector<std::pair<std::string,IndexEntry> > index;
+  index.reserve(imageNameToAnnotation.size());
+
+  size_t objectCount = 0;
+  for(std::map<std::string,VOCAnnotation_CPtr>::const_iterator it = imageNameToAnnotation.begin(), iend = imageNameToAnnotation.end(); it != iend; ++it)
+  {
+    VOCSegmentationAnnotation_CPtr annotation = boost::dynamic_pointer_cast<const VOCSegmentationAnnotation>(it->second);
+    if(!annotation) throw std::runtime_error("Cannot cache the annotation of " + it->first + ": it is not a segmentation annotation");
+
+    cv::Size imageSize;
+    std::vector<VOCObject> objects = annotation->get_objects_from_label_images(boost::none, &imageSize);
+
+    IndexEntry entry;
+    entry.imageHeight = imageSize.height;
+    entry.imageWidth = imageSize.width;
+    entry.objectCount = objects.size();
+    entry.objectsOffset = static_cast<size_t>(fs.tellp());
+    index.push_back(std::make_pair(it->first, entry));
+
+    for(size_t i = 0, size = objects.size(); i < size; ++i)
+    {
+      const VOCBox box = objects[i].rep.get_voc_box();
+      const RLEMask mask = objects[i].rep.get_rle_mask();
+      const std::vector<boost::uint32_t>& runs = mask.get_counts();
+
+      write_value<boost::int32_t>(fs, objects[i].categoryId);
+      write_value<boost::int32_t>(fs, box.xmin);
+      write_value<boost::int32_t>(fs, box.ymin);
+      write_value<boost::int32_t>(fs, box.xmax);
+      write_value<boost::int32_t>(fs, box.ymax);
+      write_value<boost::uint32_t>(fs, mask.get_size().width);
+      write_value<boost::uint32_t>(fs, mask.get_size().height);
+      write_value<boost::uint32_t>(fs, static_cast<boost::uint32_t>(runs.size()));
+      fs.write(reinterpret_cast<const char*>(&runs[0]), runs.size() * sizeof(boost::uint32_t));
+    }
+
+    objectCount += objects.size();
+    if(index.size() % 1000 == 0) std::cout << "Cached the annotations of " << index.size() << '/' << imageNameToAnnotation.size() << " images\n";
+  }
+
+  const boost::uint64_t indexOffset = static_cast<boost::uint64_t>(fs.tellp());
+  for(size_t i = 0, size = index.size(); i < size; ++i)
+  {
+    const std::string& imageName = index[i].first;
+    const IndexEntry& entry = index[i].second;
+    write_value<boost::uint32_t>(fs, static_cast<boost::uint32_t>(imageName.size()));
+    fs.write(imageName.data(), imageName.size());
+    write_value<boost::uint32_t>(fs, static_cast<boost::uint32_t>(entry.imageWidth));
+    write_value<boost::uint32_t>(fs, static_cast<boost::uint32_t>(entry.imageHeight));
+    write_value<boost::uint32_t>(fs, static_cast<boost::uint32_t>(entry.objectCount));
+    write_value<boost::uint64_t>(fs, entry.objectsOffset);
+  }
+
+  fs.seekp(MAGIC_SIZE + sizeof(boost::uint32_t));
+  write_value<boost::uint64_t>(fs, indexOffset);
+  fs.close();
+  if(!fs) throw std::runtime_error("Could not write " + tempPath);
+
+  boost::filesystem::rename(tempPath, path);
+  std::cout << "Wrote the annotation cache " << path << " (" << index.size() << " images, " << objectCount << " objects)\n";
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+bool SegmentationAnnotationCache::lookup(const std::string& imageName, std::vector<CachedObject>& objects, cv::Size& imageSize) const
+{
+  ensure_loaded();
+
+  std::map<std::string,IndexEntry>::const_iterator it = m_index.find(imageName);
+  if(it == m_index.end()) return false;
+
+  const IndexEntry& entry = it->second;
+  imageSize = cv::Size(static_cast<int>(entry.imageWidth), static_cast<int>(entry.imageHeight));
+
+  const char *begin = static_cast<const char*>(m_region.get_address());
+  const char *end = begin + m_region.get_size();
+  const char *p = begin + entry.objectsOffset;
+
+  objects.resize(entry.objectCount);
+  for(size_t i = 0; i < entry.objectCount; ++i)
+  {
+    CachedObject& object = objects[i];
+    object.categoryId = read_value<boost::int32_t>(p, end);
+    object.box.xmin = read_value<boost::int32_t>(p, end);
+    object.box.ymin = read_value<boost::int32_t>(p, end);
+    object.box.xmax = read_value<boost::int32_t>(p, end);
+    object.box.ymax = read_value<boost::int32_t>(p, end);
+
+    const int maskWidth = static_cast<int>(read_value<boost::uint32_t>(p, end));
+    const int maskHeight = static_cast<int>(read_value<boost::uint32_t>(p, end));
+    const size_t runCount = read_value<boost::uint32_t>(p, end);
+
+    std::vector<boost::uint32_t> runs(runCount);
+    for(size_t j = 0; j < runCount; ++j)
+    {
+      runs[j] = read_value<boost::uint32_t>(p, end);
+    }
+    object.mask = RLEMask(cv::Point(object.box.xmin, object.box.ymin), cv::Size(maskWidth, maskHeight), runs);
+  }
+
+  return true;
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+void SegmentationAnnotationCache::ensure_loaded() const
+{
+  if(m_loaded.load(std::memory_order_acquire)) return;
+
+  boost::lock_guard<boost::mutex> lock(m_loadMutex);
+  if(m_loaded.load(std::memory_order_relaxed)) return;
+
+  boost::interprocess::file_mapping file(m_path.c_str(), boost::interprocess::read_only);
+  boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+
+  const char *begin = static_cast<const char*>(region.get_address());
+  const char *end = begin + region.get_size();
+  if(region.get_size() < HEADER_SIZE || memcmp(begin, MAGIC, MAGIC_SIZE) != 0)
+  {
+    throw std::runtime_error(m_path + " is not an annotation cache in the current format: rebuild it with --buildAnnotationCache");
+  }
+
+  const char *p = begin + MAGIC_SIZE;
+  const size_t imageCount = read_value<boost::uint32_t>(p, end);
+  const boost::uint64_t indexOffset = read_value<boost::uint64_t>(p, end);
+  if(indexOffset > region.get_size()) throw std::runtime_error("The annotation cache " + m_path + " is truncated");
+
+  std::map<std::string,IndexEntry> index;
+  p = begin + indexOffset;
+  for(size_t i = 0; i < imageCount; ++i)
+  {
+    const size_t nameLength = read_value<boost::uint32_t>(p, end);
+    if(p + nameLength > end) throw std::runtime_error("The annotation cache " + m_path + " is truncated");
+    std::string imageName(p, nameLength);
+    p += nameLength;
+
+    IndexEntry entry;
+    entry.imageWidth = read_value<boost::uint32_t>(p, end);
+    entry.imageHeight = read_value<boost::uint32_t>(p, end);
+    entry.objectCount = read_value<boost::uint32_t>(p, end);
+    entry.objectsOffset = static_cast<size_t>(read_value<boost::uint64_t>(p, end));
+    index.insert(std::make_pair(imageName, entry));
+  }
+
+  m_index.swap(index);
+  m_region.swap(region);
+  m_loaded.store(true, std::memory_order_release);
+}
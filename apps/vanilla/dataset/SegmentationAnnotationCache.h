@@ -0,0 +1,132 @@
+/**
+ * vanilla: SegmentationAnnotationCache.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#ifndef H_VANILLA_SEGMENTATIONANNOTATIONCACHE
+#define H_VANILLA_SEGMENTATIONANNOTATIONCACHE
+
+#include "../core/RLEMask.h"
+#include "../core/VOCBox.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <opencv2/core/core.hpp>
+
+class VOCAnnotation;
+
+/**
+ * \brief An instance of this class provides read access to a binary file that caches the object instances of a segmentation dataset.
+ *
+ * Extracting the instances from the class and object PNGs of an image takes tens of milliseconds. The cache stores the result
+ * of doing so once for every image: for each instance, its category id, its box and its mask cropped to the box, as an RLEMask.
+ * The file is memory-mapped the first time it is needed, and each lookup only reads the instances of one image.
+ *
+ * File layout (native byte order):
+ *   header:  "VANSEGC2", uint32 imageCount, uint64 indexOffset
+ *   objects: per object, int32 categoryId, int32 xmin, ymin, xmax, ymax, uint32 maskWidth, maskHeight, runCount, uint32 runs[runCount]
+ *   index:   per image, uint32 nameLength, char name[nameLength], uint32 imageWidth, imageHeight, objectCount, uint64 objectsOffset
+ *
+ * The runs of a mask are those of its RLEMask (column-major, alternating between background and foreground), and its top-left
+ * corner is the top-left corner of the box.
+ */
+class SegmentationAnnotationCache
+{
+  //#################### NESTED TYPES ####################
+public:
+  /**
+   * \brief An instance of this struct represents an object instance stored in the cache.
+   */
+  struct CachedObject
+  {
+    /** The category id of the object. */
+    size_t categoryId;
+
+    /** The bounding box of the object, in the coordinates of the full image. */
+    VOCBox box;
+
+    /** The mask of the object, cropped to its bounding box. */
+    RLEMask mask;
+  };
+
+private:
+  /**
+   * \brief An instance of this struct represents the index entry for an image.
+   */
+  struct IndexEntry
+  {
+    size_t imageHeight;
+    size_t imageWidth;
+    size_t objectCount;
+    size_t objectsOffset;
+  };
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The index of the cache, mapping image names to their entries (read on first use). */
+  mutable std::map<std::string,IndexEntry> m_index;
+
+  /** Whether or not the file has been mapped and its index read. */
+  mutable std::atomic<bool> m_loaded;
+
+  /** The mutex used to make sure the file is only loaded once. */
+  mutable boost::mutex m_loadMutex;
+
+  /** The path to the cache file. */
+  std::string m_path;
+
+  /** The memory-mapped contents of the file. */
+  mutable boost::interprocess::mapped_region m_region;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs an object that reads the specified cache file on demand.
+   *
+   * \param path  The path to the cache file.
+   */
+  explicit SegmentationAnnotationCache(const std::string& path);
+
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Extracts the object instances of every image of a segmentation dataset and writes them to a cache file.
+   *
+   * \param path                  The path to the cache file to write.
+   * \param imageNameToAnnotation The annotations of the dataset, which must all be segmentation annotations.
+   */
+  static void build(const std::string& path, const std::map<std::string,boost::shared_ptr<const VOCAnnotation> >& imageNameToAnnotation);
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Looks up the object instances of the specified image.
+   *
+   * \param imageName The name of the image.
+   * \param objects   A vector into which to read the object instances of the image.
+   * \param imageSize A variable into which to write the size of the image.
+   * \return          true, if the image is in the cache, or false otherwise.
+   */
+  bool lookup(const std::string& imageName, std::vector<CachedObject>& objects, cv::Size& imageSize) const;
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Memory-maps the cache file and reads its index, if this has not already been done.
+   */
+  void ensure_loaded() const;
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<const SegmentationAnnotationCache> SegmentationAnnotationCache_CPtr;
+
+#endif
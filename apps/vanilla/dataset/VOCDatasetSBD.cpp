@@ -36,6 +36,11 @@ VOCDatasetSBD::VOCDatasetSBD(const std::string& rootDir)
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
+void VOCDatasetSBD::build_annotation_cache() const
+{
+  SegmentationAnnotationCache::build(get_annotation_cache_path(), m_imageNameToAnnotation);
+}
+
 std::string VOCDatasetSBD::get_competition_code(VOCSplit vocSplit, bool seenNonVOCData) const
 {
   return "compX_sbd_" + get_split_name(vocSplit);
@@ -76,10 +81,20 @@ void VOCDatasetSBD::visualise_annotation(const std::string& imagePath) const
 
 //#################### PRIVATE MEMBER FUNCTIONS ####################
 
+std::string VOCDatasetSBD::get_annotation_cache_path() const
+{
+  return m_rootDir + "/sbd-annotation-cache.bin";
+}
+
 void VOCDatasetSBD::initialise_annotation()
 {
   VOCAnnotation::set_category_count(m_categories.size());
 
+  SegmentationAnnotationCache_CPtr cache;
+  const std::string cachePath = get_annotation_cache_path();
+  if(boost::filesystem::exists(cachePath)) cache.reset(new SegmentationAnnotationCache(cachePath));
+  else std::cout << "No annotation cache found at " << cachePath << ": the annotations will be read from the PNGs (run with --buildAnnotationCache to create one)\n";
+
   std::vector<std::string> imagePaths = get_image_paths(VOC_2012, VOC_TRAINVAL, VOC_JPEG);
   for(size_t i = 0, size = imagePaths.size(); i < size; ++i)
   {
@@ -87,7 +102,7 @@ void VOCDatasetSBD::initialise_annotation()
     std::string imageName = imagePath.stem().string();
     std::string segmentationClassAnnotationPath = imagePath.parent_path().parent_path().string() + "/SBDSegmentationClass/" + imageName + ".png";
     std::string segmentationObjectAnnotationPath = imagePath.parent_path().parent_path().string() + "/SBDSegmentationObject/" + imageName + ".png";
-    VOCAnnotation_Ptr annotation(new VOCSegmentationAnnotation(segmentationClassAnnotationPath, segmentationObjectAnnotationPath));
+    VOCAnnotation_Ptr annotation(new VOCSegmentationAnnotation(segmentationClassAnnotationPath, segmentationObjectAnnotationPath, cache));
     m_imageNameToAnnotation.insert(std::make_pair(imageName,annotation));
   }
 }
@@ -28,10 +28,18 @@ public:
   /** Override. */
   virtual std::string get_competition_code(VOCSplit vocSplit, bool seenNonVOCData) const;
 
+  /** Override. */
+  virtual void build_annotation_cache() const;
+
   friend std::ostream& operator<<(std::ostream& os, const VOCDatasetSBD& d);
 
   //#################### PRIVATE MEMBER FUNCTIONS #################### 
 private:
+  /**
+   * \brief Gets the path to the annotation cache of the dataset.
+   */
+  std::string get_annotation_cache_path() const;
+
   /** Override. */
   void initialise_annotation();
 };
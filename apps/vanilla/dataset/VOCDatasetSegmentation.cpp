@@ -35,6 +35,11 @@ VOCDatasetSegmentation::VOCDatasetSegmentation(const std::string& rootDir)
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
+void VOCDatasetSegmentation::build_annotation_cache() const
+{
+  SegmentationAnnotationCache::build(get_annotation_cache_path(), m_imageNameToAnnotation);
+}
+
 std::string VOCDatasetSegmentation::get_competition_code(VOCSplit vocSplit, bool seenNonVOCData) const
 {
   return "comp5_seg_" + get_split_name(vocSplit);
@@ -87,10 +92,20 @@ void VOCDatasetSegmentation::visualise_annotation(const std::string& imagePath)
 
 //#################### PRIVATE MEMBER FUNCTIONS ####################
 
+std::string VOCDatasetSegmentation::get_annotation_cache_path() const
+{
+  return m_rootDir + "/segmentation-annotation-cache.bin";
+}
+
 void VOCDatasetSegmentation::initialise_annotation()
 {
   VOCAnnotation::set_category_count(m_categories.size());
 
+  SegmentationAnnotationCache_CPtr cache;
+  const std::string cachePath = get_annotation_cache_path();
+  if(boost::filesystem::exists(cachePath)) cache.reset(new SegmentationAnnotationCache(cachePath));
+  else std::cout << "No annotation cache found at " << cachePath << ": the annotations will be read from the PNGs (run with --buildAnnotationCache to create one)\n";
+
   std::vector<std::string> imagePaths = get_image_paths(VOC_ALLYEARS, VOC_TRAINVAL, VOC_JPEG);
   for(size_t i = 0, size = imagePaths.size(); i < size; ++i)
   {
@@ -98,7 +113,7 @@ void VOCDatasetSegmentation::initialise_annotation()
     std::string imageName = imagePath.stem().string();
     std::string segmentationClassAnnotationPath = imagePath.parent_path().parent_path().string() + "/SegmentationClass/" + imageName + ".png";
     std::string segmentationObjectAnnotationPath = imagePath.parent_path().parent_path().string() + "/SegmentationObject/" + imageName + ".png";
-    VOCAnnotation_Ptr annotation(new VOCSegmentationAnnotation(segmentationClassAnnotationPath, segmentationObjectAnnotationPath));
+    VOCAnnotation_Ptr annotation(new VOCSegmentationAnnotation(segmentationClassAnnotationPath, segmentationObjectAnnotationPath, cache));
     m_imageNameToAnnotation.insert(std::make_pair(imageName,annotation));
   }
 }
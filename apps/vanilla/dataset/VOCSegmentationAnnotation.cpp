@@ -10,17 +10,29 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 #include <tvgutil/containers/MapUtil.h>
 using namespace tvgutil;
 
+//#################### LOCAL CONSTANTS ####################
+
+static const int minBoxWidth(4);
+static const int minBoxHeight(4);
+static const int minPixelsInMask(10);
+
+/** The most instances that can share a label image, whose ids run from 1 (0 is the background). */
+static const size_t maxInstancesPerLabelImage(255);
+
 //#################### CONSTRUCTORS ####################
 
-VOCSegmentationAnnotation::VOCSegmentationAnnotation(const std::string& segmentationClassAnnotationPath, const std::string& segmentationObjectAnnotationPath)
+VOCSegmentationAnnotation::VOCSegmentationAnnotation(const std::string& segmentationClassAnnotationPath, const std::string& segmentationObjectAnnotationPath, const SegmentationAnnotationCache_CPtr& cache)
 : VOCAnnotation(),
   m_segmentationClassAnnotationPath(segmentationClassAnnotationPath),
-  m_segmentationObjectAnnotationPath(segmentationObjectAnnotationPath)
+  m_segmentationObjectAnnotationPath(segmentationObjectAnnotationPath),
+  m_cache(cache)
 {
   read_annotation(segmentationClassAnnotationPath);
 }
@@ -28,8 +40,122 @@ VOCSegmentationAnnotation::VOCSegmentationAnnotation(const std::string& segmenta
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
 std::vector<VOCObject> VOCSegmentationAnnotation::get_objects(const boost::optional<DataTransformation>& dataTransformation) const
+{
+  if(m_cache)
+  {
+    std::vector<SegmentationAnnotationCache::CachedObject> cachedObjects;
+    cv::Size imageSize;
+    if(m_cache->lookup(imageName, cachedObjects, imageSize)) return get_objects_from_cache(cachedObjects, imageSize, dataTransformation);
+  }
+
+  return get_objects_from_label_images(dataTransformation);
+}
+
+std::vector<VOCObject> VOCSegmentationAnnotation::get_objects_from_cache(const std::vector<SegmentationAnnotationCache::CachedObject>& cachedObjects, const cv::Size& imageSize, const boost::optional<DataTransformation>& dataTransformation) const
+{
+  std::vector<VOCObject> objects;
+  objects.reserve(cachedObjects.size());
+
+  if(!dataTransformation)
+  {
+    for(size_t i = 0, size = cachedObjects.size(); i < size; ++i)
+    {
+      const SegmentationAnnotationCache::CachedObject& cachedObject = cachedObjects[i];
+      std::string categoryName = MapUtil::lookup(VOCAnnotation::get_category_id_to_name(), cachedObject.categoryId);
+      objects.push_back(VOCObject(false, Shape(cachedObject.box, cachedObject.mask), categoryName, cachedObject.categoryId));
+    }
+    return objects;
+  }
+
+  // Instances read from the label images cannot overlap, so they can nearly always be pasted into a single label image
+  // with distinct ids and transformed together. Any that do overlap go into further label images, so that none hides
+  // another. The label transformation samples the nearest pixel, so each mask is transformed exactly as it would have
+  // been as part of the PNG.
+  std::vector<std::vector<size_t> > layers;
+  for(size_t i = 0, size = cachedObjects.size(); i < size; ++i)
+  {
+    const RLEMask& mask = cachedObjects[i].mask;
+    size_t layerIndex = 0;
+    for(size_t layerCount = layers.size(); layerIndex < layerCount; ++layerIndex)
+    {
+      const std::vector<size_t>& layer = layers[layerIndex];
+      if(layer.size() >= maxInstancesPerLabelImage) continue;
+
+      bool overlaps = false;
+      for(size_t j = 0, layerSize = layer.size(); j < layerSize && !overlaps; ++j)
+      {
+        overlaps = mask.calculate_intersection_area(cachedObjects[layer[j]].mask) > 0;
+      }
+      if(!overlaps) break;
+    }
+
+    if(layerIndex == layers.size()) layers.push_back(std::vector<size_t>());
+    layers[layerIndex].push_back(i);
+  }
+
+  std::vector<boost::optional<VOCObject> > transformedObjects(cachedObjects.size());
+  cv::Mat1b labelImage(imageSize);
+  for(size_t layerIndex = 0, layerCount = layers.size(); layerIndex < layerCount; ++layerIndex)
+  {
+    // Label each instance in the layer with its (1-based) position in the layer.
+    const std::vector<size_t>& layer = layers[layerIndex];
+    const int layerSize = static_cast<int>(layer.size());
+    labelImage.setTo(cv::Scalar(0));
+    for(int k = 0; k < layerSize; ++k)
+    {
+      const RLEMask& mask = cachedObjects[layer[k]].mask;
+      labelImage(cv::Rect(mask.get_offset(), mask.get_size())).setTo(cv::Scalar(k + 1), mask.decode());
+    }
+
+    const cv::Mat1b transformedImage = (*dataTransformation).apply_label_image_transformation(labelImage);
+
+    // Find the box and the number of pixels of each transformed instance in one pass over the image.
+    std::vector<int> xmins(layerSize, transformedImage.cols), ymins(layerSize, transformedImage.rows), xmaxs(layerSize, -1), ymaxs(layerSize, -1);
+    std::vector<int> pixelCounts(layerSize, 0);
+    for(int y = 0; y < transformedImage.rows; ++y)
+    {
+      const unsigned char *row = transformedImage.ptr<unsigned char>(y);
+      for(int x = 0; x < transformedImage.cols; ++x)
+      {
+        if(row[x] == 0) continue;
+        const int k = row[x] - 1;
+        xmins[k] = std::min(xmins[k], x);
+        xmaxs[k] = std::max(xmaxs[k], x);
+        ymins[k] = std::min(ymins[k], y);
+        ymaxs[k] = std::max(ymaxs[k], y);
+        ++pixelCounts[k];
+      }
+    }
+
+    for(int k = 0; k < layerSize; ++k)
+    {
+      // Apply the same size filters as get_objects_from_label_images.
+      if(pixelCounts[k] <= minPixelsInMask) continue;
+
+      VOCBox vbox(xmins[k], ymins[k], xmaxs[k], ymaxs[k]);
+      if(vbox.w() <= minBoxWidth || vbox.h() <= minBoxHeight) continue;
+
+      cv::Mat1b croppedMask = (transformedImage(Util::to_rect(vbox)) == k + 1);
+      vbox = (*dataTransformation).apply_scale_and_clip_to_network_size(vbox, Size(imageSize.width, imageSize.height, 1));
+
+      const size_t categoryId = cachedObjects[layer[k]].categoryId;
+      std::string categoryName = MapUtil::lookup(VOCAnnotation::get_category_id_to_name(), categoryId);
+      transformedObjects[layer[k]] = VOCObject(false, Shape(vbox, croppedMask), categoryName, categoryId);
+    }
+  }
+
+  for(size_t i = 0, size = transformedObjects.size(); i < size; ++i)
+  {
+    if(transformedObjects[i]) objects.push_back(*transformedObjects[i]);
+  }
+
+  return objects;
+}
+
+std::vector<VOCObject> VOCSegmentationAnnotation::get_objects_from_label_images(const boost::optional<DataTransformation>& dataTransformation, cv::Size *imageSize) const
 {
   cv::Mat3b objectSegmentationColourMap = load_object_annotation();
+  if(imageSize) *imageSize = objectSegmentationColourMap.size();
   cv::Mat1b objectSegmentation = Util::convert_colourmap_to_category(objectSegmentationColourMap, VOCAnnotation::get_colour_to_category_id_hash());
   if(dataTransformation) objectSegmentation = (*dataTransformation).apply_label_image_transformation(objectSegmentation);
   std::set<uint8_t> idsToIgnore;
@@ -90,10 +216,6 @@ std::vector<VOCObject> VOCSegmentationAnnotation::get_objects(const boost::optio
         cv::imshow("segmentMask" + boost::lexical_cast<std::string>(j), segmentMasks[j]);
         cv::waitKey();
 #endif
-        const int minBoxWidth(4);
-        const int minBoxHeight(4);
-        const int minPixelsInMask(10);
-
         if(pixelCount > minPixelsInMask)
         {
           //std::cout << "assigned object: " << i << " to segment: " << j << std::endl;
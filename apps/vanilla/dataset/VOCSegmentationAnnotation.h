@@ -6,6 +6,7 @@
 #ifndef H_VANILLA_VOCSEGMENTATIONANNOTATION
 #define H_VANILLA_VOCSEGMENTATIONANNOTATION
 
+#include "SegmentationAnnotationCache.h"
 #include "VOCAnnotation.h"
 
 #include <opencv2/core/core.hpp>
@@ -17,9 +18,14 @@ public:
   std::string m_segmentationClassAnnotationPath;
   std::string m_segmentationObjectAnnotationPath;
 
+  //#################### PRIVATE MEMBER VARIABLES ####################
+private:
+  /** An optional cache of the object instances of the dataset, which is used in preference to the PNGs if it contains the image. */
+  SegmentationAnnotationCache_CPtr m_cache;
+
   //#################### CONSTRUCTORS ####################
 public:
-  VOCSegmentationAnnotation(const std::string& segmentationClassAnnotationPath, const std::string& segmentationObjectAnnotationPath);
+  VOCSegmentationAnnotation(const std::string& segmentationClassAnnotationPath, const std::string& segmentationObjectAnnotationPath, const SegmentationAnnotationCache_CPtr& cache = SegmentationAnnotationCache_CPtr());
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
@@ -29,6 +35,29 @@ public:
   /** Override. */
   virtual std::vector<VOCObject> get_objects(const boost::optional<DataTransformation>& dataTransformation = boost::none) const;
 
+  /**
+   * \brief Extracts the objects in the image from its class and object annotation PNGs, bypassing the cache.
+   *
+   * \param dataTransformation An optional transformation to apply to the label images before extracting the objects.
+   * \param imageSize          An optional variable into which to write the size of the (untransformed) image.
+   * \return                   The objects in the image.
+   */
+  std::vector<VOCObject> get_objects_from_label_images(const boost::optional<DataTransformation>& dataTransformation = boost::none, cv::Size *imageSize = NULL) const;
+
+  /**
+   * \brief Makes the objects in the image from the instances stored for it in the cache.
+   *
+   * If a transformation is specified, the instance masks are pasted with distinct ids into a label image of the
+   * original size, which is then transformed once, exactly as the PNGs would have been. Instances that overlap are
+   * put into separate label images, so the result matches that of get_objects_from_label_images even then.
+   *
+   * \param cachedObjects      The instances stored in the cache.
+   * \param imageSize          The size of the image.
+   * \param dataTransformation An optional transformation to apply to the instances.
+   * \return                   The objects in the image.
+   */
+  std::vector<VOCObject> get_objects_from_cache(const std::vector<SegmentationAnnotationCache::CachedObject>& cachedObjects, const cv::Size& imageSize, const boost::optional<DataTransformation>& dataTransformation) const;
+
   /** Override. */
   //virtual void save(const std::string& saveDir) const;
 
@@ -3,6 +3,7 @@
  * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
  */
 
+#include "DarknetUtil.h"
 #include "Demo.h"
 #include "Evaluator.h"
 #include "Tester.h"
@@ -38,7 +39,12 @@ using namespace boost::asio::ip;
 
 #include <boost/shared_ptr.hpp>
 
+#include <darknet/low_rank.h>
+#include <darknet/memory_planner.h>
+#include <darknet/parallel.h>
 #include <darknet/parser.h>
+#include <darknet/profiler.h>
+#include <darknet/weights_file.h>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -54,6 +60,7 @@ using namespace tvgutil;
 
 #include <tvgshape/ShapeDescriptorCalculator.h>
 #include <tvgshape/BinaryMaskShapeDescriptorCalculator.h>
+#include <tvgshape/NativeAEShapeDescriptorCalculator.h>
 #include <tvgshape/RadialShapeDescriptorCalculator.h>
 #ifdef WITH_TORCH
 #include <tvgshape/AEShapeDescriptorCalculator.h>
@@ -67,20 +74,36 @@ using namespace tvgplot;
 
 struct CommandLineArguments
 {
+  size_t batchSize;
+  bool buildAnnotationCache;
+  size_t calibrationImages;
+  bool checkAutoencoder;
+  std::string convertWeights;
   std::string dataDir;
   std::string dataset;
   bool debugFlag;
   float detectionThreshold;
   std::string encoding;
+  std::string factorize;
   int gpuId;
   std::string imagePath;
+  size_t inputSize;
+  std::vector<size_t> inputSizes;
+  bool int8;
+  size_t loaderWorkers;
+  bool maskNMS;
   std::string mode;
   std::string networkConfigurationFile;
+  std::string profile;
+  size_t rank;
+  std::vector<size_t> ranks;
   std::string saveDir;
   unsigned int seed;
   size_t shapeparams;
   std::string task;
+  int threads;
   std::string timeStamp;
+  bool torchAutoencoder;
   std::string videoFile;
   std::string weightsFile;
 };
@@ -108,20 +131,40 @@ std::string get_unique_stamp(const CommandLineArguments& args)
 
 std::ostream& operator<<(std::ostream& os, const CommandLineArguments& args)
 {
+  os << "batchSize: " << args.batchSize << '\n';
+  os << "buildAnnotationCache: " << args.buildAnnotationCache << '\n';
+  os << "calibrationImages: " << args.calibrationImages << '\n';
+  os << "checkAutoencoder: " << args.checkAutoencoder << '\n';
+  os << "convertWeights: " << args.convertWeights << '\n';
   os << "dataDir: " << args.dataDir << '\n';
   os << "dataset: " << args.dataset << '\n';
   os << "debugFlag: " << args.debugFlag << '\n';
   os << "detectionThreshold: " << args.detectionThreshold << '\n';
   os << "encoding: " << args.encoding << '\n';
+  os << "factorize: " << args.factorize << '\n';
   os << "gpuId: " << args.gpuId << '\n';
   os << "imagePath: " << args.imagePath << '\n';
+  os << "inputSize: " << args.inputSize << '\n';
+  os << "inputSizes:";
+  for(size_t i = 0; i < args.inputSizes.size(); ++i) os << ' ' << args.inputSizes[i];
+  os << '\n';
+  os << "int8: " << args.int8 << '\n';
+  os << "loaderWorkers: " << args.loaderWorkers << '\n';
+  os << "maskNMS: " << args.maskNMS << '\n';
   os << "mode: " << args.mode << '\n';
   os << "networkConfgurationFile: " << args.networkConfigurationFile << '\n';
+  os << "profile: " << args.profile << '\n';
+  os << "rank: " << args.rank << '\n';
+  os << "ranks:";
+  for(size_t i = 0; i < args.ranks.size(); ++i) os << ' ' << args.ranks[i];
+  os << '\n';
   os << "saveDir: " << args.saveDir << '\n';
   os << "seed: " << args.seed << '\n';
   os << "shapeparams: " << args.shapeparams << '\n';
   os << "task: " << args.task << '\n';
+  os << "threads: " << args.threads << '\n';
   os << "timeStamp: " << args.timeStamp << '\n';
+  os << "torchAutoencoder: " << args.torchAutoencoder << '\n';
   os << "videoFile: " << args.videoFile << '\n';
   os << "weightsFile: " << args.weightsFile << '\n';
   return os;
@@ -239,20 +282,36 @@ bool parse_command_line(int argc, char *argv[], CommandLineArguments& args)
   po::options_description genericOptions("Generic options");
   genericOptions.add_options()
     ("help", "produce help message")
+    ("batchSize", po::value<size_t>(&args.batchSize)->default_value(1), "number of images per forward pass when evaluating")
+    ("buildAnnotationCache", po::bool_switch(&args.buildAnnotationCache)->default_value(false), "preprocess the annotations of the dataset into a binary cache, and exit")
+    ("calibrationImages", po::value<size_t>(&args.calibrationImages)->default_value(200), "number of training images used to calibrate the int8 quantization")
+    ("checkAutoencoder", po::bool_switch(&args.checkAutoencoder)->default_value(false), "compare the native shape autoencoder with the Torch reference set written by export_autoenc.lua, and exit")
+    ("convertWeights", po::value<std::string>(&args.convertWeights)->default_value(""), "convert the weights file to the memory-mapped format, write it to this path, and exit")
     ("dataDir,d", po::value<std::string>(&args.dataDir), "data directory")
     ("dataset", po::value<std::string>(&args.dataset)->default_value(""), "dataset name: [vocdet, vocseg, sbd, coco]")
     ("debug", po::bool_switch(&args.debugFlag)->default_value(false), "debug flag")
     ("detectionTreshold,t", po::value<float>(&args.detectionThreshold)->default_value(0.001f), "detection threshold")
     ("encoding", po::value<std::string>(&args.encoding)->default_value("bbox"), "shape encoding: [bbox, mask, maskdt, radial, embedding]")
+    ("factorize", po::value<std::string>(&args.factorize)->default_value(""), "factorise the first connected layer to --rank, write the configuration to this path and the weights beside it, and exit")
     ("gpuId,g", po::value<int>(&args.gpuId)->default_value(0), "gpu id")
     ("image,i", po::value<std::string>(&args.imagePath)->default_value(""), "image path")
+    ("inputSize", po::value<size_t>(&args.inputSize)->default_value(0), "side length of the square images the network is run on at inference time (0 = the size in the configuration file)")
+    ("inputSizes", po::value<std::vector<size_t> >(&args.inputSizes)->multitoken(), "input sizes at which evaluate also reports the mAPVol and latency (the detection head still sees the trunk output averaged to the grid it was trained on)")
+    ("int8", po::bool_switch(&args.int8)->default_value(false), "run the convolutional and connected layers in int8 (evaluate also reports the change in mAP against fp32)")
+    ("loaderWorkers", po::value<size_t>(&args.loaderWorkers)->default_value(0), "number of threads that decode and resize the images when evaluating (0 = every hardware thread when running on the GPU, otherwise the ones --threads leaves free, but at least two)")
+    ("maskNMS", po::bool_switch(&args.maskNMS)->default_value(false), "during non-maximal suppression, compare detections whose boxes overlap by the IoU of their masks rather than of their boxes")
     ("mode,m", po::value<std::string>(&args.mode), "program mode: [train, test, evaluate, demo]")
     ("networkConfigurationFile,n", po::value<std::string>(&args.networkConfigurationFile)->default_value("yolo.cfg"), "network configuration file")
+    ("profile", po::value<std::string>(&args.profile)->default_value(""), "time every layer of the network, print the per-layer profile at the end of the run and save it to this path as a Chrome trace")
+    ("rank", po::value<size_t>(&args.rank)->default_value(512), "rank to which --factorize factorises the first connected layer")
+    ("ranks", po::value<std::vector<size_t> >(&args.ranks)->multitoken(), "ranks at which evaluate also reports the mAPVol and latency with the first connected layer factorised")
     ("saveDir", po::value<std::string>(&args.saveDir)->default_value(""), "directory to save demo output")
     ("seed", po::value<unsigned int>(&args.seed)->default_value(12345), "seed for random number generation")
     ("shapeparams", po::value<size_t>(&args.shapeparams)->default_value(256), "The number of parameters in the shape encoding")
     ("task", po::value<std::string>(&args.task)->default_value("detection"), "task [detection, shapeprediction)")
+    ("threads", po::value<int>(&args.threads)->default_value(0), "number of CPU threads used by the network layers (0 = use the [net] setting, or one per core)")
     ("timeStamp", po::value<std::string>(&args.timeStamp)->default_value(""), "time stamp")
+    ("torchAutoencoder", po::bool_switch(&args.torchAutoencoder)->default_value(false), "run the shape autoencoder in Torch rather than natively (only if built with Torch)")
     ("videoFile", po::value<std::string>(&args.videoFile)->default_value(""), "path to a video file")
     ("weightsFile,w", po::value<std::string>(&args.weightsFile)->default_value(""), "initial weights file")
     ;
@@ -568,45 +627,102 @@ void modify_line(std::string& line, const std::string& paramName, const std::str
   line = paramName + '=' + paramValue;
 }
 
+/**
+ * Finds the line that sets an option in the last section of a given type in a configuration file.
+ */
+size_t find_option_line(const std::vector<std::string>& lines, const std::string& sectionHeader, const std::string& paramName)
+{
+  size_t sectionBegin = lines.size();
+  for(size_t i = 0; i < lines.size(); ++i)
+  {
+    if(lines[i].compare(0, sectionHeader.size(), sectionHeader) == 0) sectionBegin = i;
+  }
+
+  for(size_t i = sectionBegin + 1; i < lines.size() && (lines[i].empty() || lines[i][0] != '['); ++i)
+  {
+    if(lines[i].compare(0, paramName.size() + 1, paramName + '=') == 0) return i;
+  }
+
+  throw std::runtime_error("The parameter '" + paramName + "' is not in the last " + sectionHeader + " section");
+}
+
 #define blc(x) boost::lexical_cast<std::string>(x)
+/**
+ * The suffix that create_configuration_file adds to the name of a configuration file, which
+ * the names of the weights files trained with it must contain.
+ */
+std::string get_configuration_suffix(const DetectionSettings& ds)
+{
+  return '-' + ds.encoding
+    + '-' + 'c' + blc(ds.categoryCount)
+    + '-' + "sp" + blc(ds.paramsPerShapeEncoding);
+}
+
 std::string create_configuration_file(const std::string& networkConfigurationFile, size_t batch, size_t subdivisions, const DetectionSettings& ds)
 {
   // Read in the configuration file.
   std::ifstream ifs(networkConfigurationFile);
   std::vector<std::string> lines = LineUtil::extract_lines(ifs);
 
-  modify_line(lines[1], "batch", blc(batch));
+  // The options are found by section rather than by line, so that factorised configurations (which have an extra layer) can be modified too.
+  modify_line(lines[find_option_line(lines, "[net]", "batch")], "batch", blc(batch));
 
-  modify_line(lines[2], "subdivisions", blc(subdivisions));
+  modify_line(lines[find_option_line(lines, "[net]", "subdivisions")], "subdivisions", blc(subdivisions));
 
   size_t connections = ds.gridSideLength * ds.gridSideLength
                     * ((ds.paramsPerConfidenceScore + ds.paramsPerBox + ds.paramsPerShapeEncoding)*ds.boxesPerCell + ds.categoryCount);
-  modify_line(lines[217], "output", blc(connections));
+  modify_line(lines[find_option_line(lines, "[connected]", "output")], "output", blc(connections));
 
   const std::string sClasses = blc(ds.categoryCount);
-  modify_line(lines[221], "classes", sClasses);
+  modify_line(lines[find_option_line(lines, "[detection]", "classes")], "classes", sClasses);
 
   const std::string sShapeParams = blc(ds.paramsPerShapeEncoding);
-  modify_line(lines[223], "shapeparams", sShapeParams);
+  modify_line(lines[find_option_line(lines, "[detection]", "shapeparams")], "shapeparams", sShapeParams);
 
   const std::string sShapeScale = blc(ds.shapeScale);
-  modify_line(lines[234], "shape_scale", sShapeScale);
+  modify_line(lines[find_option_line(lines, "[detection]", "shape_scale")], "shape_scale", sShapeScale);
 
   std::string dir = (boost::filesystem::path(networkConfigurationFile)).parent_path().string();
   std::string stem = (boost::filesystem::path(networkConfigurationFile)).stem().string();
   std::string ext = (boost::filesystem::path(networkConfigurationFile)).extension().string();
 
-  std::string newFile = dir + '/' + stem
-    + '-' +ds.encoding
-    + '-' + 'c'+sClasses
-    + '-' + "sp"+sShapeParams
-    + ext;
+  std::string newFile = dir + '/' + stem + get_configuration_suffix(ds) + ext;
   std::ofstream ofs(newFile);
   LineUtil::output_lines(ofs, lines);
 
   // Save the configuration file.
   return newFile;
 }
+
+/**
+ * Writes a copy of a configuration file in which layer layerIndex (a connected layer) is preceded by
+ * the first, linear layer of its low-rank factorisation, and returns the path to which the weights of
+ * the factorised network should be saved so that they can be loaded with the new configuration.
+ */
+std::string create_factorized_configuration_file(const std::string& networkConfigurationFile, const std::string& factorizedConfigurationFile, int layerIndex, size_t rank, const DetectionSettings& ds)
+{
+  std::ifstream ifs(networkConfigurationFile);
+  std::vector<std::string> lines = LineUtil::extract_lines(ifs);
+
+  // The sections are the [net] section followed by one section per layer.
+  int section = -1;
+  std::vector<std::string>::iterator it = lines.begin();
+  for(; it != lines.end(); ++it)
+  {
+    if(!it->empty() && (*it)[0] == '[' && section++ == layerIndex) break;
+  }
+  if(it == lines.end()) throw std::runtime_error("The configuration file has no layer " + blc(layerIndex));
+
+  const std::string firstLayer[] = { "[connected]", "output=" + blc(rank), "activation=linear", "#" };
+  lines.insert(it, firstLayer, firstLayer + 4);
+
+  std::ofstream ofs(factorizedConfigurationFile);
+  if(!ofs) throw std::runtime_error("Could not write: " + factorizedConfigurationFile);
+  LineUtil::output_lines(ofs, lines);
+
+  boost::filesystem::path path(factorizedConfigurationFile);
+  return (path.parent_path() / (path.stem().string() + get_configuration_suffix(ds) + ".weights")).string();
+}
 #undef BLC
 
 #if 1
@@ -663,6 +779,13 @@ int main(int argc, char *argv[])
   }
   else if(args.dataset.empty() && (args.mode == "train" || args.mode == "evaluate")) throw std::runtime_error("Invalid dataset: " + args.dataset);
 
+  if(args.buildAnnotationCache)
+  {
+    if(!dataset) throw std::runtime_error("A dataset must be specified to build its annotation cache");
+    dataset->build_annotation_cache();
+    return 0;
+  }
+
   // Set up the parameters for the specific embedding.
   float shapeScale(0.1f);
   boost::optional<ShapeDescriptorCalculator_CPtr> shapeDescriptorCalculator(nullptr);
@@ -681,21 +804,40 @@ int main(int argc, char *argv[])
     shapeScale = 1.0f;
     shapeDescriptorCalculator = ShapeDescriptorCalculator_CPtr(new RadialShapeDescriptorCalculator());
   }
-#ifdef WITH_TORCH
   else if(args.encoding == "embedding")
   {
     shapeScale = 0.15f;
-    static lua_State *L;
-    static bool done = false;
-    if(!done)
+    const std::string autoencoderDir = args.dataDir + "/models/autoencoder";
+    const std::string sShapeParams = boost::lexical_cast<std::string>(args.shapeparams);
+
+    // The native autoencoder is converted from the Torch model by resources/torch/export_autoenc.lua, which also writes the reference set.
+    if(args.checkAutoencoder)
     {
-      L = luaL_newstate();
-      done = true;
+      NativeAEShapeDescriptorCalculator autoencoder(autoencoderDir + "/model_" + sShapeParams + ".ae", static_cast<int>(args.shapeparams));
+      NativeAEShapeDescriptorCalculator::ReferenceComparison comparison = autoencoder.compare_with_reference(autoencoderDir + "/reference_" + sShapeParams + ".ae");
+      std::cout << "Largest descriptor difference: " << comparison.maxDescriptorError << '\n'
+                << "Largest decoded mask difference: " << comparison.maxMaskError << '\n'
+                << "Mask pixels on the other side of the threshold: " << comparison.mismatchedPixels << " of " << comparison.pixelCount << '\n';
+      return 0;
     }
 
-    shapeDescriptorCalculator = ShapeDescriptorCalculator_CPtr(new AEShapeDescriptorCalculator(L, Util::resources_dir().string() + "/torch/autoenc.lua", args.dataDir + "/models/autoencoder", args.shapeparams));
-  }
+#ifdef WITH_TORCH
+    if(args.torchAutoencoder)
+    {
+      static lua_State *L;
+      static bool done = false;
+      if(!done)
+      {
+        L = luaL_newstate();
+        done = true;
+      }
+
+      shapeDescriptorCalculator = ShapeDescriptorCalculator_CPtr(new AEShapeDescriptorCalculator(L, Util::resources_dir().string() + "/torch/autoenc.lua", autoencoderDir, args.shapeparams));
+    }
+    else
 #endif
+    shapeDescriptorCalculator = ShapeDescriptorCalculator_CPtr(new NativeAEShapeDescriptorCalculator(autoencoderDir + "/model_" + sShapeParams + ".ae", static_cast<int>(args.shapeparams)));
+  }
   else throw std::runtime_error("Invalid embedding: " + args.encoding);
 
   // This needs to change if the embedding is smaller than the nubmer of parameters in the shape mask.
@@ -722,7 +864,9 @@ int main(int argc, char *argv[])
     onlyObjectness,      //onlyObjectness
     overlapThreshold,    // overlapThreshold
     shapeScale,          // The factor by which to scale the shape error derivatives
-    useSquare            // useSquare
+    useSquare,           // useSquare
+    args.inputSize,      // inputSize
+    args.maskNMS         // maskNMS
     );
 
   std::cout << detectionSettings << std::endl;
@@ -737,6 +881,11 @@ int main(int argc, char *argv[])
     if(host_name() == "mikesapi-tvg-laptop"){ batch = 64; subdivisions = 8; }
     if(host_name() == "sjvision"){ batch = 8; subdivisions = 2; }
   }
+  else if(args.mode == "evaluate")
+  {
+    // Allocate the network buffers for a full evaluation batch.
+    batch = std::max<size_t>(args.batchSize, 1);
+  }
 
   std::string modifiedNetworkConfigFile = create_configuration_file(args.networkConfigurationFile, batch, subdivisions, detectionSettings);
   std::string configurationName = (boost::filesystem::path(modifiedNetworkConfigFile)).stem().string();
@@ -744,6 +893,10 @@ int main(int argc, char *argv[])
   // Create the network and load the weights.
   network net = parse_network_cfg(const_cast<char*>(modifiedNetworkConfigFile.c_str()));
 
+  // A thread count given on the command line overrides the one in the [net] section.
+  if(args.threads > 0) set_cpu_threads(args.threads);
+  const size_t loaderWorkers = args.loaderWorkers > 0 ? args.loaderWorkers : DarknetUtil::default_loader_worker_count();
+
   if((args.weightsFile.find(configurationName) == std::string::npos) && (args.weightsFile.find("extraction") == std::string::npos))
   {
     // TODO try to load a default.
@@ -752,6 +905,30 @@ int main(int argc, char *argv[])
   }
   load_weights(&net, const_cast<char*>(args.weightsFile.c_str()));
 
+  // The converted weights can be loaded in place of the original ones, since load_weights recognises either format.
+  if(!args.convertWeights.empty())
+  {
+    save_mapped_weights_upto(net, const_cast<char*>(args.convertWeights.c_str()), net.n);
+    return 0;
+  }
+
+  // The factorised configuration and weights can be used in place of the original ones.
+  if(!args.factorize.empty())
+  {
+    int layerIndex = find_factorizable_layer(net);
+    if(layerIndex < 0) throw std::runtime_error("The network has no connected layer to factorise");
+
+    low_rank_factors factors = factorize_connected_layer(net.layers[layerIndex], static_cast<int>(args.rank));
+    network factorized = make_factorized_network(net, layerIndex, factors, factors.rank);
+    std::string factorizedWeightsFile = create_factorized_configuration_file(args.networkConfigurationFile, args.factorize, layerIndex, args.rank, detectionSettings);
+    save_weights(factorized, const_cast<char*>(factorizedWeightsFile.c_str()));
+    std::cout << "Saved the rank " << args.rank << " network to " << args.factorize << " and " << factorizedWeightsFile << '\n';
+
+    free_factorized_network(&factorized, layerIndex);
+    free_low_rank_factors(factors);
+    return 0;
+  }
+
   // Get a time-stamp to uniquely identify this run of experiments.
   std::string timeStamp;
   if(args.timeStamp.empty()) timeStamp = TimeUtil::get_iso_timestamp();
@@ -763,8 +940,34 @@ int main(int argc, char *argv[])
   {
     // Set up the network.
     set_batch_network(&net, 1);
+
+    // The batch normalisation statistics are fixed at inference time, so they can be folded into the weights.
+    fold_batchnorm_network(&net);
+
+    // Nothing is backpropagated at inference time, so the layer outputs can share a few arenas and the training buffers can go.
+    plan_inference_memory(&net);
   }
 
+  if(mode == TRAIN && args.inputSize != 0) throw std::runtime_error("The input size can only be changed for inference");
+
+  // The quantization can be requested on the command line or by the [net] section of the configuration file.
+  const bool int8 = args.int8 || net.quantize;
+  if(int8 && !args.ranks.empty()) throw std::runtime_error("The low-rank evaluation is only supported in fp32");
+  if(int8 && !args.inputSizes.empty()) throw std::runtime_error("The input size evaluation is only supported in fp32");
+  if(!args.ranks.empty() && !args.inputSizes.empty()) throw std::runtime_error("The low-rank and input size evaluations cannot be run together");
+  std::vector<std::string> calibrationImagePaths;
+  if(int8)
+  {
+    if(mode == TRAIN) throw std::runtime_error("int8 quantization is only supported for inference");
+    if(!dataset) throw std::runtime_error("A dataset must be specified to calibrate the int8 quantization");
+    calibrationImagePaths = dataset->get_image_paths(year, VOC_TRAIN, VOC_JPEG, args.calibrationImages);
+
+    // When evaluating, the evaluator quantizes the network itself once it has the fp32 results to compare against.
+    if(mode != EVALUATE) DarknetUtil::quantize(net, calibrationImagePaths, loaderWorkers);
+  }
+
+  if(!args.profile.empty()) enable_network_profiling(&net);
+
   switch (mode)
   {
   case TRAIN:
@@ -804,13 +1007,13 @@ int main(int argc, char *argv[])
 
 #define MAPVOL
 #if defined(MAP)
-      Evaluator vocDetectionEvaluator(dataset, detectionSettings, shapeDescriptorCalculator);
+      Evaluator vocDetectionEvaluator(dataset, detectionSettings, shapeDescriptorCalculator, args.batchSize, loaderWorkers);
       const double overlapThreshold(0.5);
       float map = vocDetectionEvaluator.calculate_map(net, saveResultsPath, year, VOC_VAL, get_unique_stamp(args), overlapThreshold, maxImagesToEvaluateOn);
       std::cout << "\nmAP: " << map << std::endl;
 
 #elif defined(MAPVOL)
-      Evaluator vocDetectionEvaluator(dataset, detectionSettings, shapeDescriptorCalculator);
+      Evaluator vocDetectionEvaluator(dataset, detectionSettings, shapeDescriptorCalculator, args.batchSize, loaderWorkers);
       // Standard overlap threshold from ECCV2014 Hariharan evaluation on Pascal + SBD.
       std::vector<double> overlapThresholds = NumberSequenceGenerator::generate_stepped(0.1, 0.1, 0.9);
       if(args.dataset == "coco")
@@ -818,12 +1021,16 @@ int main(int argc, char *argv[])
         overlapThresholds = NumberSequenceGenerator::generate_stepped(0.5, 0.05, 0.95);
       }
 
-      float mapVol = vocDetectionEvaluator.calculate_map_vol(net, saveResultsPath, year, VOC_VAL, get_unique_stamp(args), overlapThresholds, maxImagesToEvaluateOn);
+      float mapVol;
+      if(!args.ranks.empty()) mapVol = vocDetectionEvaluator.calculate_map_vol_low_rank(net, args.ranks, saveResultsPath, year, VOC_VAL, get_unique_stamp(args), overlapThresholds, maxImagesToEvaluateOn);
+      else if(!args.inputSizes.empty()) mapVol = vocDetectionEvaluator.calculate_map_vol_input_sizes(net, args.inputSizes, saveResultsPath, year, VOC_VAL, get_unique_stamp(args), overlapThresholds, maxImagesToEvaluateOn);
+      else if(int8) mapVol = vocDetectionEvaluator.calculate_map_vol_int8(net, calibrationImagePaths, saveResultsPath, year, VOC_VAL, get_unique_stamp(args), overlapThresholds, maxImagesToEvaluateOn);
+      else mapVol = vocDetectionEvaluator.calculate_map_vol(net, saveResultsPath, year, VOC_VAL, get_unique_stamp(args), overlapThresholds, maxImagesToEvaluateOn);
       std::cout << "\nmAPVol: " << mapVol << std::endl;
 
 #elif defined(SAVETOPBOTTOM)
       detectionSettings.detectionThreshold = 0.2;
-      Evaluator vocDetectionEvaluator(dataset, detectionSettings, shapeDescriptorCalculator);
+      Evaluator vocDetectionEvaluator(dataset, detectionSettings, shapeDescriptorCalculator, args.batchSize, loaderWorkers);
       vocDetectionEvaluator.find_save_best_worst(net, saveResultsPath, year, VOC_VAL);
 #endif
       , seconds, evaluationCalculationTime); std::cout << evaluationCalculationTime << std::endl;
@@ -857,6 +1064,13 @@ int main(int argc, char *argv[])
     throw std::runtime_error("No valid mode selected");
   }
 
+  if(net.profile)
+  {
+    print_network_profile(net, stdout);
+    save_network_profile_trace(net, args.profile.c_str());
+    std::cout << "Saved the layer profile to " << args.profile << '\n';
+  }
+
   return 0;
 }
 #endif
@@ -0,0 +1,138 @@
+-- Converts a shape autoencoder trained in Torch to the model file read by
+-- tvgshape::NativeAEShapeDescriptorCalculator, and writes a reference set of
+-- masks, descriptors and decoded masks computed by Torch against which the
+-- native networks can be checked (see --checkAutoencoder in vanilla).
+--
+-- Usage: th export_autoenc.lua <modelDir> <descriptorSize> [referenceCount]
+--
+-- Reads <modelDir>/model_<descriptorSize>.net (as autoenc.lua does) and writes
+-- <modelDir>/model_<descriptorSize>.ae and <modelDir>/reference_<descriptorSize>.ae.
+-- As in autoenc.lua, the encoder is modules 1 and 2 of the model and the
+-- decoder is module 3. The networks are exported in evaluation mode, so noise
+-- and dropout modules are left out.
+
+require 'torch'
+require 'nn'
+pcall(require, 'cunn')
+pcall(require, 'dpnn')
+
+local VERSION = 1
+local MASK_SIDE = 64
+local LINEAR, AFFINE, RELU, LEAKY_RELU, SIGMOID, TANH = 1, 2, 3, 4, 5, 6
+
+-- Modules that do nothing to a single flattened input at inference time.
+local passthrough = {
+	['nn.Copy'] = true, ['nn.Dropout'] = true, ['nn.Identity'] = true, ['nn.Reshape'] = true,
+	['nn.View'] = true, ['nn.WhiteNoise'] = true
+}
+
+local function flatten(module, layers)
+	local name = torch.typename(module)
+	if name == 'nn.Sequential' then
+		for i = 1, #module.modules do
+			flatten(module.modules[i], layers)
+		end
+	elseif name == 'nn.Linear' then
+		local bias = module.bias and module.bias:float() or torch.FloatTensor(module.weight:size(1)):zero()
+		table.insert(layers, {type = LINEAR, weight = module.weight:float(), bias = bias})
+	elseif name == 'nn.BatchNormalization' then
+		-- Inference-time batch normalisation is a per-feature affine map.
+		local invstd
+		if module.running_var then
+			invstd = module.running_var:float():clone():add(module.eps):sqrt():pow(-1)
+		else
+			invstd = module.running_std:float():clone()
+		end
+		local scale = module.weight and invstd:cmul(module.weight:float()) or invstd
+		local shift = module.bias and module.bias:float():clone() or torch.FloatTensor(scale:size(1)):zero()
+		shift:add(-1, torch.cmul(module.running_mean:float(), scale))
+		table.insert(layers, {type = AFFINE, weight = scale, bias = shift})
+	elseif name == 'nn.ReLU' then
+		table.insert(layers, {type = RELU})
+	elseif name == 'nn.LeakyReLU' then
+		table.insert(layers, {type = LEAKY_RELU, negval = module.negval})
+	elseif name == 'nn.Sigmoid' then
+		table.insert(layers, {type = SIGMOID})
+	elseif name == 'nn.Tanh' then
+		table.insert(layers, {type = TANH})
+	elseif not passthrough[name] then
+		error('export_autoenc.lua: cannot export a module of type ' .. name)
+	end
+end
+
+local function write_network(f, layers, inputs)
+	f:writeInt(#layers)
+	for _, layer in ipairs(layers) do
+		local outputs = layer.weight and layer.weight:size(1) or inputs
+		f:writeInt(layer.type)
+		f:writeInt(inputs)
+		f:writeInt(outputs)
+		if layer.type == LINEAR or layer.type == AFFINE then
+			f:writeFloat(layer.weight:clone():storage())
+			f:writeFloat(layer.bias:clone():storage())
+		elseif layer.type == LEAKY_RELU then
+			f:writeFloat(layer.negval)
+		end
+		inputs = outputs
+	end
+end
+
+local function random_ellipse()
+	local mask = torch.FloatTensor(MASK_SIDE, MASK_SIDE):zero()
+	local cx, cy = torch.uniform(16, 48), torch.uniform(16, 48)
+	local rx, ry = torch.uniform(6, 28), torch.uniform(6, 28)
+	for y = 1, MASK_SIDE do
+		for x = 1, MASK_SIDE do
+			if ((x - cx) / rx)^2 + ((y - cy) / ry)^2 <= 1 then mask[y][x] = 1 end
+		end
+	end
+	return mask:view(MASK_SIDE * MASK_SIDE)
+end
+
+local modelDir = arg[1]
+local descSize = tonumber(arg[2])
+local referenceCount = tonumber(arg[3] or 100)
+if not modelDir or not descSize then
+	error('usage: th export_autoenc.lua <modelDir> <descriptorSize> [referenceCount]')
+end
+
+torch.manualSeed(1234567890)
+local model = torch.load(modelDir .. '/model_' .. descSize .. '.net', 'ascii'):float()
+model:evaluate()
+
+local encoder = nn.Sequential():add(model:get(1)):add(model:get(2))
+local decoder = model:get(3)
+
+local encoderLayers, decoderLayers = {}, {}
+flatten(encoder, encoderLayers)
+flatten(decoder, decoderLayers)
+
+local f = torch.DiskFile(modelDir .. '/model_' .. descSize .. '.ae', 'w'):binary()
+f:writeInt(VERSION)
+f:writeInt(MASK_SIDE)
+f:writeInt(descSize)
+write_network(f, encoderLayers, MASK_SIDE * MASK_SIDE)
+write_network(f, decoderLayers, descSize)
+f:close()
+
+-- The reference set runs each mask through Torch on its own, as autoenc.lua does.
+local masks = torch.FloatTensor(referenceCount, MASK_SIDE * MASK_SIDE)
+local descriptors = torch.FloatTensor(referenceCount, descSize)
+local decoded = torch.FloatTensor(referenceCount, MASK_SIDE * MASK_SIDE)
+for i = 1, referenceCount do
+	masks[i]:copy(random_ellipse())
+	descriptors[i]:copy(encoder:forward(masks[i]:clone()):view(-1))
+	decoded[i]:copy(decoder:forward(descriptors[i]:clone()):view(-1))
+end
+
+f = torch.DiskFile(modelDir .. '/reference_' .. descSize .. '.ae', 'w'):binary()
+f:writeInt(VERSION)
+f:writeInt(referenceCount)
+f:writeInt(MASK_SIDE)
+f:writeInt(descSize)
+f:writeFloat(masks:storage())
+f:writeFloat(descriptors:storage())
+f:writeFloat(decoded:storage())
+f:close()
+
+print('Wrote ' .. modelDir .. '/model_' .. descSize .. '.ae and ' .. modelDir .. '/reference_' .. descSize .. '.ae')
@@ -19,6 +19,8 @@ float activate(float x, ACTIVATION a);
 float gradient(float x, ACTIVATION a);
 void gradient_array(const float *x, const int n, const ACTIVATION a, float *delta);
 void activate_array(float *x, const int n, const ACTIVATION a);
+/* The instruction set activate_array runs the leaky, relu and logistic activations with on this CPU. */
+const char *activation_cpu_kernel_name();
 #ifdef WITH_CUDA
 void activate_array_ongpu(float *x, int n, ACTIVATION a);
 void gradient_array_ongpu(float *x, int n, ACTIVATION a, float *delta);
@@ -1,10 +1,19 @@
 #ifndef BLAS_H
 #define BLAS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void pm(int M, int N, float *A);
 float *random_matrix(int rows, int cols);
 void time_random_matrix(int TA, int TB, int m, int k, int n);
 
 void test_blas();
+/* The instruction set of the kernels axpy_cpu, scal_cpu, fill_cpu, mean_cpu, variance_cpu and normalize_cpu use for contiguous arrays. */
+const char *blas_cpu_kernel_name();
+/* Checks the SIMD element-wise and activation kernels against the scalar loops and reports their speed. */
+void benchmark_blas_cpu();
 
 void const_cpu(int N, float ALPHA, float *X, int INCX);
 void constrain_ongpu(int N, float ALPHA, float * X, int INCX);
@@ -71,4 +80,9 @@ void mult_add_into_gpu(int num, float *a, float *b, float *c);
 
 
 #endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
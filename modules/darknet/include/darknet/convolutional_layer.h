@@ -44,6 +44,7 @@ void backward_bias(float *bias_updates, float *delta, int batch, int n, int size
 
 int convolutional_out_height(convolutional_layer layer);
 int convolutional_out_width(convolutional_layer layer);
+size_t get_workspace_size(layer l);
 void rescale_filters(convolutional_layer l, float scale, float trans);
 void rgbgr_filters(convolutional_layer l);
 
@@ -1,5 +1,10 @@
 #ifndef GEMM_H
 #define GEMM_H
+#include "activations.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 void gemm_bin(int M, int N, int K, float ALPHA, 
         char  *A, int lda, 
@@ -18,6 +23,22 @@ void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA,
         float BETA,
         float *C, int ldc);
 
+/*
+ * C = activation(op(A)*op(B) + bias), where the bias is indexed by the row
+ * of C (row_bias) and/or its column (col_bias); either may be null. The
+ * bias and activation are applied to each tile of C as soon as it is
+ * complete, while it is still in cache, and C is overwritten rather than
+ * accumulated into, so it need not be cleared first.
+ */
+void gemm_cpu_bias_activate(int TA, int TB, int M, int N, int K,
+        float *A, int lda,
+        float *B, int ldb,
+        float *C, int ldc,
+        const float *row_bias, const float *col_bias, ACTIVATION activation);
+
+const char *gemm_cpu_kernel_name();
+void benchmark_gemm_cpu();
+
 #ifdef WITH_CUDA
 void gemm_ongpu(int TA, int TB, int M, int N, int K, float ALPHA, 
         float *A_gpu, int lda, 
@@ -31,4 +52,9 @@ void gemm_gpu(int TA, int TB, int M, int N, int K, float ALPHA,
         float BETA,
         float *C, int ldc);
 #endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
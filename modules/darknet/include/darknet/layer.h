@@ -172,6 +172,18 @@ struct layer{
 
     float *binary_input;
 
+    int quantized;
+    int quantized_inputs;
+    float input_scale;
+    float input_range_sum;
+    int input_range_count;
+    signed char *quantized_weights;
+    float *quantized_scales;
+    float *quantized_biases;
+
+    int winograd;
+    float *winograd_filters;
+
     size_t workspace_size;
 
     #ifdef WITH_CUDA
@@ -0,0 +1,54 @@
+#ifndef LOW_RANK_H
+#define LOW_RANK_H
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Low-rank factorisation of connected layers.
+ *
+ * The weights W (outputs x inputs) of a connected layer are replaced by the
+ * product of two thin matrices from their truncated SVD, W ~ U_r S_r V_r^T:
+ * a linear connected layer with inputs x rank weights S_r^1/2 V_r^T, followed
+ * by a connected layer with rank x outputs weights U_r S_r^1/2 that keeps the
+ * original biases, batch normalisation and activation. The singular values
+ * are split evenly between the two so that neither factor's range dwarfs the
+ * other's, which keeps both quantisable to int8.
+ *
+ * The pair are two ordinary connected layers, so a factorised network is
+ * saved, loaded and run like any other; in the configuration file the first
+ * layer is a new [connected] section inserted before the factorised one.
+ *
+ * The SVD is found by randomised subspace iteration, so a factorisation at
+ * the largest rank of interest can be truncated to any smaller rank without
+ * being recomputed.
+ */
+
+typedef struct low_rank_factors {
+    int inputs, outputs, rank;
+    float *first;           /* rank x inputs */
+    float *second;          /* outputs x rank */
+    float *singular_values;
+} low_rank_factors;
+
+/* The index of the first connected layer of a network, or -1 if it has none. */
+int find_factorizable_layer(network net);
+
+/* Factorises the weights of a connected layer to the given rank. */
+low_rank_factors factorize_connected_layer(layer l, int rank);
+void free_low_rank_factors(low_rank_factors f);
+
+/*
+ * A network that shares all the layers of net but layer i, which is replaced by the first
+ * rank (at most f.rank) factors of its weights. Free it with free_factorized_network.
+ */
+network make_factorized_network(network net, int i, low_rank_factors f, int rank);
+void free_factorized_network(network *net, int i);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef MEMORY_PLANNER_H
+#define MEMORY_PLANNER_H
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Inference-mode activation memory planning.
+ *
+ * Every layer allocates its own output when the network is parsed, but at
+ * inference time most outputs are dead as soon as the next layer has read
+ * them. The planner works out when each output is last read (by the next
+ * layer, or by a later route or shortcut layer that names it), and lets
+ * outputs whose lifetimes do not overlap share the same buffer. For a plain
+ * chain of layers this comes down to two arenas used in turn; the output of
+ * the network is never overwritten.
+ *
+ * The buffers that only backpropagation uses (deltas, parameter updates, the
+ * batch normalisation statistics and maxpool indexes) are released at the
+ * same time, so a planned network can only be used for inference, on the
+ * CPU, and can no longer be resized.
+ */
+
+/* Replaces the layers' outputs with shared arenas and releases their training buffers. */
+void plan_inference_memory(network *net);
+
+/* Frees the buffers of a layer that only the backward pass and the weight updates use, and returns the number of bytes freed. */
+size_t release_training_buffers(layer *l);
+
+/* Detaches the layers from the arenas and frees them. Called by free_network. */
+void release_activation_arenas(network *net);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -16,6 +16,7 @@ typedef struct network{
     float *workspace;
     int n;
     int batch;
+    int allocated_batch;
     int *seen;
     float epoch;
     int subdivisions;
@@ -42,6 +43,16 @@ typedef struct network{
     int h, w, c;
     int max_crop;
     int min_crop;
+    int quantize;
+
+    void *weights_mapping;
+    size_t weights_mapping_size;
+
+    float **activation_arenas;
+    int activation_arena_count;
+
+    struct resolution_plan *resolution_plans;
+    struct network_profile *profile;
 
     #ifdef WITH_CUDA
     float **input_gpu;
@@ -78,6 +89,8 @@ char *get_layer_string(LAYER_TYPE a);
 
 network make_network(int n);
 void forward_network(network net, network_state state);
+/* Runs layer i on state.input; state.workspace must already point at the network's workspace. */
+void forward_network_layer(network net, network_state state, int i);
 void backward_network(network net, network_state state);
 void update_network(network net);
 
@@ -105,6 +118,8 @@ void print_network(network net);
 void visualize_network(network net);
 int resize_network(network *net, int w, int h);
 void set_batch_network(network *net, int b);
+/* Folds the batch normalisation of the convolutional and connected layers into their weights and biases (inference only). */
+void fold_batchnorm_network(network *net);
 int get_network_input_size(network net);
 float get_network_cost(network net);
 
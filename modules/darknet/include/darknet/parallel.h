@@ -0,0 +1,31 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Processes the half-open range [begin, end) of a parallel_for. */
+typedef void (*parallel_fn)(void *ctx, int begin, int end);
+
+/*
+ * Sets the number of threads used by the CPU layers (0 means one per physical
+ * core, or one per online processor if the core topology cannot be read).
+ * Must not be called while another thread is inside parallel_for.
+ */
+void set_cpu_threads(int n);
+int get_cpu_threads();
+
+/*
+ * Splits [0, n) into at most get_cpu_threads() contiguous ranges of at least
+ * `grain` items and runs fn on each, the calling thread taking the first one.
+ * Returns once every range is done. Nested calls, and calls made while the
+ * pool is busy with another caller's work, run serially on the calling thread.
+ */
+void parallel_for(int n, int grain, parallel_fn fn, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
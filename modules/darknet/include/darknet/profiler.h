@@ -0,0 +1,61 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include "network.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Opt-in per-layer profiling of the forward, backward and update passes.
+ *
+ * Once enable_network_profiling has been called, forward_network,
+ * backward_network and update_network (and their GPU versions) time every
+ * layer they run; on the GPU the device is synchronised around each layer so
+ * the time is that of the layer's kernels. The FLOPs and bytes of each layer
+ * are estimated from its geometry. A network that is not being profiled only
+ * pays for a null check per layer.
+ *
+ * The results can be printed as a table or saved as a Chrome trace
+ * (chrome://tracing or https://ui.perfetto.dev). The resolution plans of a
+ * profiled network are profiled too, each in its own table and trace track.
+ */
+
+typedef enum {
+    PROFILE_FORWARD, PROFILE_BACKWARD, PROFILE_UPDATE
+} profile_phase;
+
+typedef struct profile_event {
+    int layer;
+    profile_phase phase;
+    int batch;
+    double start, duration;
+} profile_event;
+
+typedef struct network_profile {
+    int n;
+    int *calls;
+    double *seconds;
+    double *flops;
+    profile_event *events;
+    int event_count, event_capacity;
+    double origin;
+} network_profile;
+
+void enable_network_profiling(network *net);
+/* Frees the profile of a network. Called by free_network. */
+void disable_network_profiling(network *net);
+void reset_network_profile(network *net);
+
+double profile_layer_start();
+void profile_layer_end(network net, int i, profile_phase phase, double start);
+
+void print_network_profile(network net, FILE *fp);
+void save_network_profile_trace(network net, const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Post-training int8 inference for the convolutional and connected layers.
+ *
+ * Weights are quantised symmetrically per output channel, and the input of
+ * each layer with a single scale calibrated from the activations seen on a
+ * few representative images. The layers then multiply int8 x int8 into
+ * int32 and requantise, fold batch normalisation and the bias, and apply
+ * the activation in one pass as each output is written, so their outputs
+ * stay fp32 for the layers that follow. The fp32 weights are released.
+ * The first layer, which sees the raw image, is left in fp32.
+ *
+ * Quantised networks can only be used for inference, and only on the CPU.
+ */
+
+/* Runs the network on a batch of calibration images and records the range of the input of every layer that can be quantised. */
+void calibrate_quantization(network net, float *input);
+
+/* Quantises the calibrated layers and switches them to int8 inference. */
+void quantize_network(network *net);
+
+void forward_convolutional_layer_int8(layer l, network_state state);
+void forward_connected_layer_int8(layer l, network_state state);
+
+const char *int8_cpu_kernel_name();
+void benchmark_int8_cpu();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
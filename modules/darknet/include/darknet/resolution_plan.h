@@ -0,0 +1,52 @@
+#ifndef RESOLUTION_PLAN_H
+#define RESOLUTION_PLAN_H
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Inference at input resolutions other than the one a network was built for.
+ *
+ * A plan is a copy of the network's layers, resized for one input size, that
+ * shares the weights of the network but has its own outputs and workspace
+ * (laid out with plan_inference_memory), so plans for several resolutions can
+ * be kept alongside the network and reused from one request to the next.
+ *
+ * Only the fully-convolutional part of the network is resized: the trunk of
+ * convolutional, pooling, route and shortcut layers up to the first layer
+ * with a fixed input size (a connected, local or detection layer). If the
+ * trunk's output at the new resolution differs from the one the head was
+ * trained on, it is resampled to that size (averaging the feature map over
+ * each cell of the head's grid), so the head keeps its weights and the
+ * detection grid keeps covering the whole image.
+ *
+ * Plans are built on first use, only on the CPU, and are not thread-safe.
+ * They copy the layers as they are when the plan is made, so folding,
+ * quantising or resizing the network drops its plans.
+ */
+
+typedef struct resolution_plan {
+    int w, h;
+    network net;
+    int head;
+    int head_w, head_h;
+    float *head_input;
+    struct resolution_plan *next;
+} resolution_plan;
+
+/* Returns the plan for a w x h input, making it the first time the size is asked for. */
+resolution_plan *get_resolution_plan(network *net, int w, int h);
+
+/* Runs a batch of w x h images through a plan and returns its output. */
+float *predict_resolution_plan(resolution_plan *p, float *input, int batch);
+
+/* Frees the plans of a network. Called by free_network. */
+void free_resolution_plans(network *net);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef WEIGHTS_FILE_H
+#define WEIGHTS_FILE_H
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A mapped weights file holds the parameters of a network exactly as the
+ * layers use them (already transposed where the legacy format needs it),
+ * each array aligned to 64 bytes, so it can be mmap'ed and the layers pointed
+ * straight into the mapping. The mapping is private and copy-on-write: every
+ * process that maps the file shares its pages until it writes to them (e.g.
+ * when training), and nothing is read until a page is first touched.
+ *
+ * Layout: a 64-byte header ("DNWMAP01", version, seen, layer and tensor
+ * counts, table offset), a table of {layer, sublayer, field, offset, count}
+ * entries in load order, then the arrays themselves.
+ */
+
+/* Returns 1 if the file starts with the mapped weights magic, 0 otherwise. */
+int is_mapped_weights_file(char *filename);
+
+/* Writes the parameters of the first `cutoff` layers to a mapped weights file. */
+void save_mapped_weights_upto(network net, char *filename, int cutoff);
+
+/*
+ * Maps a mapped weights file and points the parameters of the first `cutoff`
+ * layers into it, freeing the buffers they replace.
+ */
+void load_mapped_weights_upto(network *net, char *filename, int cutoff);
+
+/*
+ * Detaches the layers from the mapping and unmaps it. Called by free_network;
+ * the layers' parameter pointers that pointed into the mapping are cleared.
+ */
+void release_mapped_weights(network *net);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef WINOGRAD_H
+#define WINOGRAD_H
+#include "activations.h"
+#include "layer.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Winograd convolution for 3x3 stride-1 convolutional layers on the CPU.
+ *
+ * F(m x m, 3x3) computes each m x m tile of the output from an (m+2) x (m+2)
+ * tile of the input: the input tiles and the filters are transformed, the
+ * transformed values are multiplied channel by channel (one GEMM for each of
+ * the (m+2)^2 positions in a tile), and the products are transformed back.
+ * F(2x2) does 2.25x fewer multiplies than im2col + GEMM and F(4x4) 4x fewer,
+ * at the cost of the transforms and (for F(4x4)) some precision.
+ *
+ * The tile size is chosen per layer from its channel counts and output size
+ * when the layer is made or resized (l.winograd is 0 for the im2col path),
+ * using thresholds measured with benchmark_winograd_cpu. The transformed
+ * filters (l.winograd_filters) must be recomputed with
+ * transform_winograd_filters whenever l.filters changes.
+ */
+
+/* Chooses the tile size of a convolutional layer and (re)computes its transformed filters. */
+void setup_winograd_layer(layer *l);
+
+size_t get_winograd_workspace_size(layer l);
+
+/* Recomputes l.winograd_filters from l.filters; does nothing for layers that do not use Winograd. */
+void transform_winograd_filters(layer l);
+
+/*
+ * Convolves one image: output = activation(conv(input) + biases), biases may be null.
+ * The workspace must hold get_winograd_workspace_size(l) bytes.
+ */
+void winograd_convolution(layer l, const float *input, float *output, float *workspace, const float *biases, ACTIVATION activation);
+
+void benchmark_winograd_cpu();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,10 +1,16 @@
 #include "activations.h"
+#include "parallel.h"
 
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ACTIVATION_X86
+#include <immintrin.h>
+#endif
+
 char *get_activation_string(ACTIVATION a)
 {
     switch(a){
@@ -92,12 +98,189 @@ float activate(float x, ACTIVATION a)
     return 0;
 }
 
-void activate_array(float *x, const int n, const ACTIVATION a)
+/* Whole-array versions of the activations the network layers use most, on a contiguous array. */
+typedef struct {
+    const char *name;
+    void (*leaky)(float *x, int n);
+    void (*relu)(float *x, int n);
+    void (*logistic)(float *x, int n);
+} activation_kernel;
+
+static void leaky_array_c(float *x, int n)
 {
     int i;
-    for(i = 0; i < n; ++i){
-        x[i] = activate(x[i], a);
+    for(i = 0; i < n; ++i) x[i] = leaky_activate(x[i]);
+}
+
+static void relu_array_c(float *x, int n)
+{
+    int i;
+    for(i = 0; i < n; ++i) x[i] = relu_activate(x[i]);
+}
+
+static void logistic_array_c(float *x, int n)
+{
+    int i;
+    for(i = 0; i < n; ++i) x[i] = logistic_activate(x[i]);
+}
+
+#ifdef ACTIVATION_X86
+
+/* Multiplies the negative values by .1 in double precision, as leaky_activate does, so the results are the same. */
+__attribute__((target("avx2,fma")))
+static void leaky_array_avx2(float *x, int n)
+{
+    const __m256d slope = _mm256_set1_pd(.1);
+    const __m256 zero = _mm256_setzero_ps();
+    int i;
+    for(i = 0; i + 8 <= n; i += 8){
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m128 lo = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), slope));
+        __m128 hi = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), slope));
+        __m256 scaled = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+        _mm256_storeu_ps(x + i, _mm256_blendv_ps(scaled, v, _mm256_cmp_ps(v, zero, _CMP_GT_OQ)));
+    }
+    for(; i < n; ++i) x[i] = leaky_activate(x[i]);
+}
+
+__attribute__((target("avx2,fma")))
+static void relu_array_avx2(float *x, int n)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    int i;
+    for(i = 0; i + 8 <= n; i += 8){
+        __m256 v = _mm256_loadu_ps(x + i);
+        _mm256_storeu_ps(x + i, _mm256_and_ps(v, _mm256_cmp_ps(v, zero, _CMP_GT_OQ)));
+    }
+    for(; i < n; ++i) x[i] = relu_activate(x[i]);
+}
+
+/* exp(x) as 2^k * exp(r) with |r| <= ln(2)/2 and the Cephes expf polynomial for exp(r): within 2 ulp of expf. */
+__attribute__((target("avx2,fma")))
+static inline __m256 exp_avx2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.3f));
+    __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(0.693359375f), x);
+    r = _mm256_fnmadd_ps(k, _mm256_set1_ps(-2.12194440e-4f), r);
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1)));
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+__attribute__((target("avx2,fma")))
+static void logistic_array_avx2(float *x, int n)
+{
+    const __m256 one = _mm256_set1_ps(1);
+    const __m256 sign = _mm256_set1_ps(-0.f);
+    int i;
+    for(i = 0; i + 8 <= n; i += 8){
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256 e = exp_avx2(_mm256_xor_ps(v, sign));
+        _mm256_storeu_ps(x + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
     }
+    for(; i < n; ++i) x[i] = logistic_activate(x[i]);
+}
+
+#endif
+
+static const activation_kernel activation_kernels[] = {
+#ifdef ACTIVATION_X86
+    {"avx2-fma", leaky_array_avx2, relu_array_avx2, logistic_array_avx2},
+#endif
+    {"c", leaky_array_c, relu_array_c, logistic_array_c}
+};
+
+static int activation_kernel_supported(const activation_kernel *k)
+{
+#ifdef ACTIVATION_X86
+    if(!strcmp(k->name, "avx2-fma")) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    return 1;
+}
+
+static const activation_kernel *activation_cpu_kernel()
+{
+    static const activation_kernel *selected = 0;
+    if(!selected){
+        int i;
+        int n = sizeof(activation_kernels)/sizeof(activation_kernels[0]);
+        for(i = 0; i < n; ++i){
+            if(activation_kernel_supported(&activation_kernels[i])) break;
+        }
+        selected = &activation_kernels[i < n ? i : n-1];
+    }
+    return selected;
+}
+
+const char *activation_cpu_kernel_name()
+{
+    return activation_cpu_kernel()->name;
+}
+
+typedef struct{
+    float *x;
+    ACTIVATION a;
+} activate_args;
+
+#define ACTIVATE_LOOP(f) for(i = 0; i < n; ++i) x[i] = f(x[i]); break
+
+/* Switches on the activation once per chunk rather than once per element. */
+static void activate_range(void *ctx, int begin, int end)
+{
+    activate_args *args = (activate_args *)ctx;
+    const activation_kernel *k = activation_cpu_kernel();
+    float *x = args->x + begin;
+    int n = end - begin;
+    int i;
+    switch(args->a){
+        case LINEAR:
+            break;
+        case LEAKY:
+            k->leaky(x, n);
+            break;
+        case RELU:
+            k->relu(x, n);
+            break;
+        case LOGISTIC:
+            k->logistic(x, n);
+            break;
+        case LOGGY:
+            ACTIVATE_LOOP(loggy_activate);
+        case ELU:
+            ACTIVATE_LOOP(elu_activate);
+        case RELIE:
+            ACTIVATE_LOOP(relie_activate);
+        case RAMP:
+            ACTIVATE_LOOP(ramp_activate);
+        case TANH:
+            ACTIVATE_LOOP(tanh_activate);
+        case PLSE:
+            ACTIVATE_LOOP(plse_activate);
+        case STAIR:
+            ACTIVATE_LOOP(stair_activate);
+        case HARDTAN:
+            ACTIVATE_LOOP(hardtan_activate);
+        case LHTAN:
+            ACTIVATE_LOOP(lhtan_activate);
+    }
+}
+
+#undef ACTIVATE_LOOP
+
+void activate_array(float *x, const int n, const ACTIVATION a)
+{
+    if(a == LINEAR) return;
+    activate_args args;
+    args.x = x;
+    args.a = a;
+    parallel_for(n, 1 << 15, activate_range, &args);
 }
 
 float gradient(float x, ACTIVATION a)
@@ -1,6 +1,197 @@
 #include "blas.h"
+#include "activations.h"
+#include "parallel.h"
+#include "utils.h"
 #include "math.h"
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLAS_X86
+#include <immintrin.h>
+#endif
+
+/* Kernels for the contiguous (unit stride) case of the element-wise routines below. */
+typedef struct {
+    const char *name;
+    void (*axpy)(int n, float alpha, const float *x, float *y);
+    void (*scal)(int n, float alpha, float *x);
+    void (*fill)(int n, float alpha, float *x);
+    float (*sum)(int n, const float *x);
+    float (*sum_squared_diff)(int n, const float *x, float mean);
+    void (*normalize)(int n, float *x, float mean, float scale);
+} blas_kernel;
+
+static void axpy_c(int n, float alpha, const float *x, float *y)
+{
+    int i;
+    for(i = 0; i < n; ++i) y[i] += alpha*x[i];
+}
+
+static void scal_c(int n, float alpha, float *x)
+{
+    int i;
+    for(i = 0; i < n; ++i) x[i] *= alpha;
+}
+
+static void fill_c(int n, float alpha, float *x)
+{
+    int i;
+    for(i = 0; i < n; ++i) x[i] = alpha;
+}
+
+static float sum_c(int n, const float *x)
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i;
+    for(i = 0; i + 4 <= n; i += 4){
+        s0 += x[i];
+        s1 += x[i+1];
+        s2 += x[i+2];
+        s3 += x[i+3];
+    }
+    for(; i < n; ++i) s0 += x[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+static float sum_squared_diff_c(int n, const float *x, float mean)
+{
+    float s0 = 0, s1 = 0;
+    int i;
+    for(i = 0; i + 2 <= n; i += 2){
+        float d0 = x[i] - mean, d1 = x[i+1] - mean;
+        s0 += d0*d0;
+        s1 += d1*d1;
+    }
+    for(; i < n; ++i) s0 += (x[i] - mean)*(x[i] - mean);
+    return s0 + s1;
+}
+
+static void normalize_c(int n, float *x, float mean, float scale)
+{
+    int i;
+    for(i = 0; i < n; ++i) x[i] = (x[i] - mean)*scale;
+}
+
+#ifdef BLAS_X86
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2(int n, float alpha, const float *x, float *y)
+{
+    __m256 a = _mm256_set1_ps(alpha);
+    int i;
+    for(i = 0; i + 16 <= n; i += 16){
+        _mm256_storeu_ps(y + i,     _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i),     _mm256_loadu_ps(y + i)));
+        _mm256_storeu_ps(y + i + 8, _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+    }
+    for(; i < n; ++i) y[i] += alpha*x[i];
+}
+
+__attribute__((target("avx2,fma")))
+static void scal_avx2(int n, float alpha, float *x)
+{
+    __m256 a = _mm256_set1_ps(alpha);
+    int i;
+    for(i = 0; i + 8 <= n; i += 8) _mm256_storeu_ps(x + i, _mm256_mul_ps(a, _mm256_loadu_ps(x + i)));
+    for(; i < n; ++i) x[i] *= alpha;
+}
+
+__attribute__((target("avx2,fma")))
+static void fill_avx2(int n, float alpha, float *x)
+{
+    __m256 a = _mm256_set1_ps(alpha);
+    int i;
+    for(i = 0; i + 8 <= n; i += 8) _mm256_storeu_ps(x + i, a);
+    for(; i < n; ++i) x[i] = alpha;
+}
+
+__attribute__((target("avx2,fma")))
+static float hsum_avx2(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2,fma")))
+static float sum_avx2(int n, const float *x)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    int i;
+    for(i = 0; i + 16 <= n; i += 16){
+        s0 = _mm256_add_ps(s0, _mm256_loadu_ps(x + i));
+        s1 = _mm256_add_ps(s1, _mm256_loadu_ps(x + i + 8));
+    }
+    float s = hsum_avx2(_mm256_add_ps(s0, s1));
+    for(; i < n; ++i) s += x[i];
+    return s;
+}
+
+__attribute__((target("avx2,fma")))
+static float sum_squared_diff_avx2(int n, const float *x, float mean)
+{
+    __m256 m = _mm256_set1_ps(mean);
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    int i;
+    for(i = 0; i + 16 <= n; i += 16){
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(x + i), m);
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(x + i + 8), m);
+        s0 = _mm256_fmadd_ps(d0, d0, s0);
+        s1 = _mm256_fmadd_ps(d1, d1, s1);
+    }
+    float s = hsum_avx2(_mm256_add_ps(s0, s1));
+    for(; i < n; ++i) s += (x[i] - mean)*(x[i] - mean);
+    return s;
+}
+
+__attribute__((target("avx2,fma")))
+static void normalize_avx2(int n, float *x, float mean, float scale)
+{
+    __m256 m = _mm256_set1_ps(mean);
+    __m256 a = _mm256_set1_ps(scale);
+    int i;
+    for(i = 0; i + 8 <= n; i += 8) _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), m), a));
+    for(; i < n; ++i) x[i] = (x[i] - mean)*scale;
+}
+
+#endif
+
+static const blas_kernel blas_kernels[] = {
+#ifdef BLAS_X86
+    {"avx2-fma", axpy_avx2, scal_avx2, fill_avx2, sum_avx2, sum_squared_diff_avx2, normalize_avx2},
+#endif
+    {"c", axpy_c, scal_c, fill_c, sum_c, sum_squared_diff_c, normalize_c}
+};
+
+static int blas_kernel_supported(const blas_kernel *k)
+{
+#ifdef BLAS_X86
+    if(!strcmp(k->name, "avx2-fma")) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    return 1;
+}
+
+static const blas_kernel *blas_cpu_kernel()
+{
+    static const blas_kernel *selected = 0;
+    if(!selected){
+        int i;
+        int n = sizeof(blas_kernels)/sizeof(blas_kernels[0]);
+        for(i = 0; i < n; ++i){
+            if(blas_kernel_supported(&blas_kernels[i])) break;
+        }
+        selected = &blas_kernels[i < n ? i : n-1];
+    }
+    return selected;
+}
+
+const char *blas_cpu_kernel_name()
+{
+    return blas_cpu_kernel()->name;
+}
 
 void weighted_sum_cpu(float *a, float *b, float *s, int n, float *c)
 {
@@ -36,49 +227,78 @@ void shortcut_cpu(int batch, int w1, int h1, int c1, float *add, int w2, int h2,
     }
 }
 
+/* The statistics are accumulated plane by plane (or row by row for spatial == 1), so x is read in order. */
 void mean_cpu(float *x, int batch, int filters, int spatial, float *mean)
 {
+    const blas_kernel *k = blas_cpu_kernel();
     float scale = 1./(batch * spatial);
-    int i,j,k;
-    for(i = 0; i < filters; ++i){
-        mean[i] = 0;
-        for(j = 0; j < batch; ++j){
-            for(k = 0; k < spatial; ++k){
-                int index = j*filters*spatial + i*spatial + k;
-                mean[i] += x[index];
-            }
+    int i,j;
+    for(i = 0; i < filters; ++i) mean[i] = 0;
+    for(j = 0; j < batch; ++j){
+        float *row = x + (size_t)j*filters*spatial;
+        if(spatial == 1){
+            k->axpy(filters, 1, row, mean);
+        } else {
+            for(i = 0; i < filters; ++i) mean[i] += k->sum(spatial, row + i*spatial);
         }
-        mean[i] *= scale;
     }
+    k->scal(filters, scale, mean);
 }
 
 void variance_cpu(float *x, float *mean, int batch, int filters, int spatial, float *variance)
 {
+    const blas_kernel *k = blas_cpu_kernel();
     float scale = 1./(batch * spatial - 1);
-    int i,j,k;
-    for(i = 0; i < filters; ++i){
-        variance[i] = 0;
-        for(j = 0; j < batch; ++j){
-            for(k = 0; k < spatial; ++k){
-                int index = j*filters*spatial + i*spatial + k;
-                variance[i] += pow((x[index] - mean[i]), 2);
-            }
+    int i,j;
+    for(i = 0; i < filters; ++i) variance[i] = 0;
+    for(j = 0; j < batch; ++j){
+        float *row = x + (size_t)j*filters*spatial;
+        if(spatial == 1){
+            for(i = 0; i < filters; ++i) variance[i] += (row[i] - mean[i])*(row[i] - mean[i]);
+        } else {
+            for(i = 0; i < filters; ++i) variance[i] += k->sum_squared_diff(spatial, row + i*spatial, mean[i]);
         }
-        variance[i] *= scale;
+    }
+    k->scal(filters, scale, variance);
+}
+
+typedef struct{
+    float *x;
+    float *mean;
+    float *variance;
+    int filters;
+    int spatial;
+} normalize_args;
+
+static inline float normalize_scale(float variance)
+{
+    return 1./(sqrt(variance) + .000001f);
+}
+
+static void normalize_planes(void *ctx, int begin, int end)
+{
+    normalize_args *a = (normalize_args *)ctx;
+    const blas_kernel *k = blas_cpu_kernel();
+    int p;
+    for(p = begin; p < end; ++p){
+        int f = p % a->filters;
+        k->normalize(a->spatial, a->x + (size_t)p*a->spatial, a->mean[f], normalize_scale(a->variance[f]));
     }
 }
 
 void normalize_cpu(float *x, float *mean, float *variance, int batch, int filters, int spatial)
 {
-    int b, f, i;
-    for(b = 0; b < batch; ++b){
-        for(f = 0; f < filters; ++f){
-            for(i = 0; i < spatial; ++i){
-                int index = b*filters*spatial + f*spatial + i;
-                x[index] = (x[index] - mean[f])/(sqrt(variance[f]) + .000001f);
-            }
+    if(spatial == 1){
+        /* One value per filter: normalise each row of the batch as a vector. */
+        int i, j;
+        for(j = 0; j < batch; ++j){
+            float *row = x + (size_t)j*filters;
+            for(i = 0; i < filters; ++i) row[i] = (row[i] - mean[i])*normalize_scale(variance[i]);
         }
+        return;
     }
+    normalize_args a = {x, mean, variance, filters, spatial};
+    parallel_for(batch*filters, 1 + (1 << 15)/spatial, normalize_planes, &a);
 }
 
 void const_cpu(int N, float ALPHA, float *X, int INCX)
@@ -101,24 +321,40 @@ void pow_cpu(int N, float ALPHA, float *X, int INCX, float *Y, int INCY)
 
 void axpy_cpu(int N, float ALPHA, float *X, int INCX, float *Y, int INCY)
 {
+    if(INCX == 1 && INCY == 1){
+        blas_cpu_kernel()->axpy(N, ALPHA, X, Y);
+        return;
+    }
     int i;
     for(i = 0; i < N; ++i) Y[i*INCY] += ALPHA*X[i*INCX];
 }
 
 void scal_cpu(int N, float ALPHA, float *X, int INCX)
 {
+    if(INCX == 1){
+        blas_cpu_kernel()->scal(N, ALPHA, X);
+        return;
+    }
     int i;
     for(i = 0; i < N; ++i) X[i*INCX] *= ALPHA;
 }
 
 void fill_cpu(int N, float ALPHA, float *X, int INCX)
 {
+    if(INCX == 1){
+        blas_cpu_kernel()->fill(N, ALPHA, X);
+        return;
+    }
     int i;
     for(i = 0; i < N; ++i) X[i*INCX] = ALPHA;
 }
 
 void copy_cpu(int N, float *X, int INCX, float *Y, int INCY)
 {
+    if(INCX == 1 && INCY == 1){
+        if(X != Y && N > 0) memmove(Y, X, N*sizeof(float));
+        return;
+    }
     int i;
     for(i = 0; i < N; ++i) Y[i*INCY] = X[i*INCX];
 }
@@ -158,3 +394,144 @@ float dot_cpu(int N, float *X, int INCX, float *Y, int INCY)
     return dot;
 }
 
+
+/* The strided scalar loops the routines above used before they had SIMD kernels, to check them against. */
+static void mean_reference(float *x, int batch, int filters, int spatial, float *mean)
+{
+    float scale = 1./(batch * spatial);
+    int i,j,k;
+    for(i = 0; i < filters; ++i){
+        mean[i] = 0;
+        for(j = 0; j < batch; ++j){
+            for(k = 0; k < spatial; ++k) mean[i] += x[j*filters*spatial + i*spatial + k];
+        }
+        mean[i] *= scale;
+    }
+}
+
+static void variance_reference(float *x, float *mean, int batch, int filters, int spatial, float *variance)
+{
+    float scale = 1./(batch * spatial - 1);
+    int i,j,k;
+    for(i = 0; i < filters; ++i){
+        variance[i] = 0;
+        for(j = 0; j < batch; ++j){
+            for(k = 0; k < spatial; ++k) variance[i] += pow((x[j*filters*spatial + i*spatial + k] - mean[i]), 2);
+        }
+        variance[i] *= scale;
+    }
+}
+
+static void normalize_reference(float *x, float *mean, float *variance, int batch, int filters, int spatial)
+{
+    int b, f, i;
+    for(b = 0; b < batch; ++b){
+        for(f = 0; f < filters; ++f){
+            double std = sqrt(variance[f]) + .000001f;
+            for(i = 0; i < spatial; ++i){
+                int index = b*filters*spatial + f*spatial + i;
+                x[index] = (x[index] - mean[f])/std;
+            }
+        }
+    }
+}
+
+static float max_relative_error(const float *x, const float *y, int n)
+{
+    float e = 0;
+    int i;
+    for(i = 0; i < n; ++i){
+        float d = fabs(x[i] - y[i])/(fabs(y[i]) + 1e-6f);
+        if(d > e) e = d;
+    }
+    return e;
+}
+
+void benchmark_blas_cpu()
+{
+    /* The output of the second convolutional layer of yolo.cfg at 448x448 (192 x 112 x 112), batch 2. */
+    const int batch = 2, filters = 192, spatial = 112*112;
+    const int n = batch*filters*spatial;
+    const int repeats = 20;
+    const ACTIVATION activations[] = {LEAKY, RELU, LOGISTIC};
+    float *x = calloc(n, sizeof(float));
+    float *y = calloc(n, sizeof(float));
+    float *z = calloc(n, sizeof(float));
+    float *mean = calloc(4096, sizeof(float));
+    float *variance = calloc(4096, sizeof(float));
+    float *mean_ref = calloc(4096, sizeof(float));
+    float *variance_ref = calloc(4096, sizeof(float));
+    int i, r, a;
+    for(i = 0; i < n; ++i) x[i] = rand_normal()*2 + .5;
+
+    printf("CPU element-wise kernels: %s (activations: %s), %d x %d x %d floats\n", blas_cpu_kernel_name(), activation_cpu_kernel_name(), batch, filters, spatial);
+
+    for(a = 0; a < (int)(sizeof(activations)/sizeof(activations[0])); ++a){
+        double t0, reference = 0, vectorised = 0;
+        for(r = 0; r < repeats; ++r){
+            memcpy(y, x, n*sizeof(float));
+            memcpy(z, x, n*sizeof(float));
+            t0 = what_time_is_it_now();
+            for(i = 0; i < n; ++i) y[i] = activate(y[i], activations[a]);
+            reference += what_time_is_it_now() - t0;
+            t0 = what_time_is_it_now();
+            activate_array(z, n, activations[a]);
+            vectorised += what_time_is_it_now() - t0;
+        }
+        printf("  %-8s per element %7.3f ms, whole array %7.3f ms, max relative error %g\n", get_activation_string(activations[a]),
+                1000*reference/repeats, 1000*vectorised/repeats, max_relative_error(z, y, n));
+    }
+
+    double t0 = what_time_is_it_now();
+    for(r = 0; r < repeats; ++r){
+        mean_reference(x, batch, filters, spatial, mean_ref);
+        variance_reference(x, mean_ref, batch, filters, spatial, variance_ref);
+    }
+    double reference = what_time_is_it_now() - t0;
+    t0 = what_time_is_it_now();
+    for(r = 0; r < repeats; ++r){
+        mean_cpu(x, batch, filters, spatial, mean);
+        variance_cpu(x, mean, batch, filters, spatial, variance);
+    }
+    double vectorised = what_time_is_it_now() - t0;
+    printf("  mean + variance  strided %7.3f ms, by plane %7.3f ms, max relative error %g, %g\n", 1000*reference/repeats, 1000*vectorised/repeats,
+            max_relative_error(mean, mean_ref, filters), max_relative_error(variance, variance_ref, filters));
+
+    reference = vectorised = 0;
+    for(r = 0; r < repeats; ++r){
+        memcpy(y, x, n*sizeof(float));
+        memcpy(z, x, n*sizeof(float));
+        t0 = what_time_is_it_now();
+        normalize_reference(y, mean_ref, variance_ref, batch, filters, spatial);
+        reference += what_time_is_it_now() - t0;
+        t0 = what_time_is_it_now();
+        normalize_cpu(z, mean_ref, variance_ref, batch, filters, spatial);
+        vectorised += what_time_is_it_now() - t0;
+    }
+    printf("  normalize        strided %7.3f ms, by plane %7.3f ms, max relative error %g\n", 1000*reference/repeats, 1000*vectorised/repeats, max_relative_error(z, y, n));
+
+    /* The connected-layer layout: one value per filter, a row per image. */
+    mean_reference(x, 64, 4096, 1, mean_ref);
+    mean_cpu(x, 64, 4096, 1, mean);
+    variance_reference(x, mean_ref, 64, 4096, 1, variance_ref);
+    variance_cpu(x, mean_ref, 64, 4096, 1, variance);
+    printf("  mean, variance with spatial = 1: max relative error %g, %g\n", max_relative_error(mean, mean_ref, 4096), max_relative_error(variance, variance_ref, 4096));
+
+    memcpy(y, x, n*sizeof(float));
+    memcpy(z, x, n*sizeof(float));
+    t0 = what_time_is_it_now();
+    for(r = 0; r < repeats; ++r) for(i = 0; i < n; ++i) y[i] += .5f*x[i];
+    reference = what_time_is_it_now() - t0;
+    t0 = what_time_is_it_now();
+    for(r = 0; r < repeats; ++r) axpy_cpu(n, .5f, x, 1, z, 1);
+    vectorised = what_time_is_it_now() - t0;
+    printf("  axpy             scalar  %7.3f ms, kernel   %7.3f ms, max relative error %g\n", 1000*reference/repeats, 1000*vectorised/repeats, max_relative_error(z, y, n));
+
+    free(x);
+    free(y);
+    free(z);
+    free(mean);
+    free(variance);
+    free(mean_ref);
+    free(variance_ref);
+}
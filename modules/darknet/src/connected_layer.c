@@ -4,6 +4,7 @@
 #include "cuda.h"
 #include "blas.h"
 #include "gemm.h"
+#include "quantize.h"
 
 #include <math.h>
 #include <stdio.h>
@@ -114,6 +115,14 @@ void update_connected_layer(connected_layer l, int batch, float learning_rate, f
 void forward_connected_layer(connected_layer l, network_state state)
 {
     int i;
+    if(l.quantized){
+        forward_connected_layer_int8(l, state);
+        return;
+    }
+    if(!l.batch_normalize){
+        gemm_cpu_bias_activate(0,1,l.batch,l.outputs,l.inputs,state.input,l.inputs,l.weights,l.inputs,l.output,l.outputs,0,l.biases,l.activation);
+        return;
+    }
     fill_cpu(l.outputs*l.batch, 0, l.output, 1);
     int m = l.batch;
     int k = l.inputs;
@@ -187,7 +196,8 @@ void denormalize_connected_layer(layer l)
 {
     int i, j;
     for(i = 0; i < l.outputs; ++i){
-        float scale = l.scales[i]/sqrt(l.rolling_variance[i] + .00001);
+        /* The same normalisation as normalize_cpu, so that folding leaves the output unchanged. */
+        float scale = l.scales[i]/(sqrt(l.rolling_variance[i]) + .000001f);
         for(j = 0; j < l.inputs; ++j){
             l.weights[i*l.inputs + j] *= scale;
         }
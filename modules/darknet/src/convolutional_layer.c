@@ -5,6 +5,9 @@
 #include "col2im.h"
 #include "blas.h"
 #include "gemm.h"
+#include "parallel.h"
+#include "quantize.h"
+#include "winograd.h"
 #include <malloc.h>
 #include <stdio.h>
 #include <time.h>
@@ -105,7 +108,17 @@ image get_convolutional_delta(convolutional_layer l)
 }
 */
 
+/* A 1x1 stride-1 convolution multiplies its input in place: the input is already c x (h*w), and im2col would only copy it. */
+static int is_direct_convolution(layer l)
+{
+#ifdef WITH_CUDA
+    if(gpu_index >= 0) return 0;
+#endif
+    return l.size == 1 && l.stride == 1;
+}
+
 size_t get_workspace_size(layer l){
+    if(l.quantized) return (size_t)l.out_h*l.out_w*l.quantized_inputs;
 #ifdef WITH_CUDNN5
     size_t most = 0;
     size_t s = 0;
@@ -135,7 +148,9 @@ size_t get_workspace_size(layer l){
     if (s > most) most = s;
     return most;
 #else
-    return (size_t)l.out_h*l.out_w*l.size*l.size*l.c*sizeof(float);
+    size_t im2col_size = is_direct_convolution(l) ? 0 : (size_t)l.out_h*l.out_w*l.size*l.size*l.c*sizeof(float);
+    size_t winograd_size = get_winograd_workspace_size(l);
+    return (winograd_size > im2col_size) ? winograd_size : im2col_size;
 #endif
 }
 
@@ -287,6 +302,7 @@ convolutional_layer make_convolutional_layer(int batch, int h, int w, int c, int
     cudnn_convolutional_setup(&l);
 #endif
 #endif
+    setup_winograd_layer(&l);
     l.workspace_size = get_workspace_size(l);
     l.activation = activation;
 
@@ -299,12 +315,14 @@ void denormalize_convolutional_layer(convolutional_layer l)
 {
     int i, j;
     for(i = 0; i < l.n; ++i){
-        float scale = l.scales[i]/sqrt(l.rolling_variance[i] + .00001);
+        /* The same normalisation as normalize_cpu, so that folding leaves the output unchanged. */
+        float scale = l.scales[i]/(sqrt(l.rolling_variance[i]) + .000001f);
         for(j = 0; j < l.c*l.size*l.size; ++j){
             l.filters[i*l.c*l.size*l.size + j] *= scale;
         }
         l.biases[i] -= l.rolling_mean[i] * scale;
     }
+    transform_winograd_filters(l);
 }
 
 void test_convolutional_layer()
@@ -359,33 +377,55 @@ void resize_convolutional_layer(convolutional_layer *l, int w, int h)
     cudnn_convolutional_setup(l);
 #endif
 #endif
+    setup_winograd_layer(l);
     l->workspace_size = get_workspace_size(*l);
 }
 
-void add_bias(float *output, float *biases, int batch, int n, int size)
+typedef struct{
+    float *output;
+    float *values;
+    int n;
+    int size;
+} bias_args;
+
+static void add_bias_planes(void *ctx, int begin, int end)
 {
-    int i,j,b;
-    for(b = 0; b < batch; ++b){
-        for(i = 0; i < n; ++i){
-            for(j = 0; j < size; ++j){
-                output[(b*n + i)*size + j] += biases[i];
-            }
+    bias_args *a = (bias_args *)ctx;
+    int p,j;
+    for(p = begin; p < end; ++p){
+        float bias = a->values[p % a->n];
+        float *out = a->output + p*a->size;
+        for(j = 0; j < a->size; ++j){
+            out[j] += bias;
         }
     }
 }
 
-void scale_bias(float *output, float *scales, int batch, int n, int size)
+static void scale_bias_planes(void *ctx, int begin, int end)
 {
-    int i,j,b;
-    for(b = 0; b < batch; ++b){
-        for(i = 0; i < n; ++i){
-            for(j = 0; j < size; ++j){
-                output[(b*n + i)*size + j] *= scales[i];
-            }
+    bias_args *a = (bias_args *)ctx;
+    int p,j;
+    for(p = begin; p < end; ++p){
+        float scale = a->values[p % a->n];
+        float *out = a->output + p*a->size;
+        for(j = 0; j < a->size; ++j){
+            out[j] *= scale;
         }
     }
 }
 
+void add_bias(float *output, float *biases, int batch, int n, int size)
+{
+    bias_args a = {output, biases, n, size};
+    parallel_for(batch*n, 1 + (1 << 15)/size, add_bias_planes, &a);
+}
+
+void scale_bias(float *output, float *scales, int batch, int n, int size)
+{
+    bias_args a = {output, scales, n, size};
+    parallel_for(batch*n, 1 + (1 << 15)/size, scale_bias_planes, &a);
+}
+
 void backward_bias(float *bias_updates, float *delta, int batch, int n, int size)
 {
     int i,b;
@@ -402,6 +442,30 @@ void forward_convolutional_layer(convolutional_layer l, network_state state)
     int out_w = convolutional_out_width(l);
     int i;
 
+    if(l.quantized){
+        forward_convolutional_layer_int8(l, state);
+        return;
+    }
+
+    /* Without batch normalisation (or with it folded into the filters), the bias and activation are applied by the GEMM. */
+    if(!l.batch_normalize && !l.binary && !l.xnor){
+        int m = l.n;
+        int k = l.size*l.size*l.c;
+        int n = out_h*out_w;
+        for(i = 0; i < l.batch; ++i){
+            if(l.winograd){
+                winograd_convolution(l, state.input + i*l.c*l.h*l.w, l.output + i*n*m, state.workspace, l.biases, l.activation);
+                continue;
+            }
+            float *b = state.input + i*l.c*l.h*l.w;
+            if(!is_direct_convolution(l)){
+                im2col_cpu(b, l.c, l.h, l.w, l.size, l.stride, l.pad, state.workspace);
+                b = state.workspace;
+            }
+            gemm_cpu_bias_activate(0,0,m,n,k,l.filters,k,b,n,l.output + i*n*m,n,l.biases,0,l.activation);
+        }
+        return;
+    }
 
     fill_cpu(l.outputs*l.batch, 0, l.output, 1);
 
@@ -458,9 +522,15 @@ void forward_convolutional_layer(convolutional_layer l, network_state state)
         float *c = l.output;
 
         for(i = 0; i < l.batch; ++i){
-            im2col_cpu(state.input, l.c, l.h, l.w, 
-                    l.size, l.stride, l.pad, b);
-            gemm(0,0,m,n,k,1,a,k,b,n,1,c,n);
+            if(l.winograd){
+                winograd_convolution(l, state.input, c, b, 0, LINEAR);
+            } else if(is_direct_convolution(l)){
+                gemm(0,0,m,n,k,1,a,k,state.input,n,1,c,n);
+            } else {
+                im2col_cpu(state.input, l.c, l.h, l.w, 
+                        l.size, l.stride, l.pad, b);
+                gemm(0,0,m,n,k,1,a,k,b,n,1,c,n);
+            }
             c += n*m;
             state.input += l.c*l.h*l.w;
         }
@@ -493,13 +563,23 @@ void backward_convolutional_layer(convolutional_layer l, network_state state)
 
         float *im = state.input+i*l.c*l.h*l.w;
 
-        im2col_cpu(im, l.c, l.h, l.w, 
-                l.size, l.stride, l.pad, b);
+        if(is_direct_convolution(l)){
+            b = im;
+        } else {
+            im2col_cpu(im, l.c, l.h, l.w, 
+                    l.size, l.stride, l.pad, b);
+        }
         gemm(0,1,m,n,k,1,a,k,b,k,1,c,n);
 
         if(state.delta){
             a = l.filters;
             b = l.delta + i*m*k;
+
+            /* col2im only accumulates into the delta, so the direct case can accumulate straight into it. */
+            if(is_direct_convolution(l)){
+                gemm(1,0,n,k,m,1,a,n,b,k,1,state.delta+i*l.c*l.h*l.w,k);
+                continue;
+            }
             c = state.workspace;
 
             gemm(1,0,n,k,m,1,a,n,b,k,0,c,k);
@@ -518,6 +598,7 @@ void update_convolutional_layer(convolutional_layer l, int batch, float learning
     axpy_cpu(size, -decay*batch, l.filters, 1, l.filter_updates, 1);
     axpy_cpu(size, learning_rate/batch, l.filter_updates, 1, l.filters, 1);
     scal_cpu(size, momentum, l.filter_updates, 1);
+    transform_winograd_filters(l);
 }
 
 /*
@@ -538,6 +619,7 @@ void rgbgr_filters(convolutional_layer l)
             rgbgr_image(im);
         }
     }
+    transform_winograd_filters(l);
 }
 
 void rescale_filters(convolutional_layer l, float scale, float trans)
@@ -551,6 +633,7 @@ void rescale_filters(convolutional_layer l, float scale, float trans)
             l.biases[i] += sum*trans;
         }
     }
+    transform_winograd_filters(l);
 }
 
 image *get_filters(convolutional_layer l)
@@ -1,9 +1,17 @@
 #include "gemm.h"
+#include "activations.h"
 #include "utils.h"
+#include "parallel.h"
 #include "../include/darknet/cuda.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEMM_X86
+#include <immintrin.h>
+#endif
 
 void gemm_bin(int M, int N, int K, float ALPHA, 
         char  *A, int lda, 
@@ -37,31 +45,6 @@ float *random_matrix(int rows, int cols)
     return m;
 }
 
-void time_random_matrix(int TA, int TB, int m, int k, int n)
-{
-    float *a;
-    if(!TA) a = random_matrix(m,k);
-    else a = random_matrix(k,m);
-    int lda = (!TA)?k:m;
-    float *b;
-    if(!TB) b = random_matrix(k,n);
-    else b = random_matrix(n,k);
-    int ldb = (!TB)?n:k;
-
-    float *c = random_matrix(m,n);
-    int i;
-    clock_t start = clock(), end;
-    for(i = 0; i<10; ++i){
-        gemm_cpu(TA,TB,m,n,k,1,a,lda,b,ldb,1,c,n);
-    }
-    end = clock();
-    printf("Matrix Multiplication %dx%d * %dx%d, TA=%d, TB=%d: %lf ms\n",m,k,k,n, TA, TB, (float)(end-start)/CLOCKS_PER_SEC);
-    free(a);
-    free(b);
-    free(c);
-}
-
-
 void gemm(int TA, int TB, int M, int N, int K, float ALPHA, 
         float *A, int lda, 
         float *B, int ldb,
@@ -137,20 +120,496 @@ void gemm_tt(int M, int N, int K, float ALPHA,
     }
 }
 
+/*
+ * Blocked CPU GEMM.
+ *
+ * C += ALPHA * op(A) * op(B) is computed in the usual three-level blocking
+ * scheme: a KC x NC slice of op(B) is packed into NR-wide column panels
+ * (kept in L3), an MC x KC block of op(A) is packed, pre-scaled by ALPHA,
+ * into MR-high row panels (kept in L2), and an MR x NR register-blocked
+ * micro-kernel then streams through one panel of each (the B panel stays
+ * in L1). Packing also absorbs the TA/TB transposes, so a single
+ * micro-kernel serves all four variants.
+ *
+ * The micro-kernel is picked once at runtime from the features the CPU
+ * supports: AVX2+FMA (6x16), SSE (4x8) or portable C (4x4).
+ */
+
+#define GEMM_MC 120
+#define GEMM_KC 256
+#define GEMM_NC 2048
+#define GEMM_MR_MAX 8
+#define GEMM_NR_MAX 16
+#define GEMM_ALIGN 64
+
+/* Products smaller than this many flops are not worth waking the thread pool for. */
+#define GEMM_PARALLEL_FLOP (1 << 20)
+
+typedef void (*gemm_micro_kernel)(int kc, const float *a, const float *b, float *c, int ldc);
+typedef float (*gemm_dot_kernel)(int n, const float *x, const float *y);
+
+typedef struct{
+    const char *name;
+    int mr;
+    int nr;
+    gemm_micro_kernel kernel;
+    gemm_dot_kernel dot;
+} gemm_kernel;
+
+/* A bias per row and/or per column of C, then an activation, applied to C once it is complete. */
+typedef struct{
+    const float *row_bias;
+    const float *col_bias;
+    ACTIVATION activation;
+} gemm_epilogue;
+
+static void gemm_kernel_c_4x4(int kc, const float *a, const float *b, float *c, int ldc)
+{
+    float acc[4][4] = {{0}};
+    int p, i, j;
+    for(p = 0; p < kc; ++p){
+        for(i = 0; i < 4; ++i){
+            for(j = 0; j < 4; ++j){
+                acc[i][j] += a[i]*b[j];
+            }
+        }
+        a += 4;
+        b += 4;
+    }
+    for(i = 0; i < 4; ++i){
+        for(j = 0; j < 4; ++j){
+            c[i*ldc + j] += acc[i][j];
+        }
+    }
+}
 
-void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA, 
-        float *A, int lda, 
+static float gemm_dot_c(int n, const float *x, const float *y)
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i;
+    for(i = 0; i + 4 <= n; i += 4){
+        s0 += x[i]*y[i];
+        s1 += x[i+1]*y[i+1];
+        s2 += x[i+2]*y[i+2];
+        s3 += x[i+3]*y[i+3];
+    }
+    for(; i < n; ++i) s0 += x[i]*y[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef GEMM_X86
+
+__attribute__((target("sse")))
+static void gemm_kernel_sse_4x8(int kc, const float *a, const float *b, float *c, int ldc)
+{
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+    __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+    __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+    int p;
+    for(p = 0; p < kc; ++p){
+        __m128 b0 = _mm_load_ps(b);
+        __m128 b1 = _mm_load_ps(b + 4);
+        __m128 ai;
+        ai = _mm_load1_ps(a + 0); c00 = _mm_add_ps(c00, _mm_mul_ps(ai, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(ai, b1));
+        ai = _mm_load1_ps(a + 1); c10 = _mm_add_ps(c10, _mm_mul_ps(ai, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(ai, b1));
+        ai = _mm_load1_ps(a + 2); c20 = _mm_add_ps(c20, _mm_mul_ps(ai, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(ai, b1));
+        ai = _mm_load1_ps(a + 3); c30 = _mm_add_ps(c30, _mm_mul_ps(ai, b0)); c31 = _mm_add_ps(c31, _mm_mul_ps(ai, b1));
+        a += 4;
+        b += 8;
+    }
+#define GEMM_SSE_STORE_ROW(r, lo, hi) \
+    _mm_storeu_ps(c + (r)*ldc,     _mm_add_ps(_mm_loadu_ps(c + (r)*ldc),     lo)); \
+    _mm_storeu_ps(c + (r)*ldc + 4, _mm_add_ps(_mm_loadu_ps(c + (r)*ldc + 4), hi));
+    GEMM_SSE_STORE_ROW(0, c00, c01)
+    GEMM_SSE_STORE_ROW(1, c10, c11)
+    GEMM_SSE_STORE_ROW(2, c20, c21)
+    GEMM_SSE_STORE_ROW(3, c30, c31)
+#undef GEMM_SSE_STORE_ROW
+}
+
+__attribute__((target("sse")))
+static float gemm_dot_sse(int n, const float *x, const float *y)
+{
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    float t[4];
+    int i;
+    for(i = 0; i + 8 <= n; i += 8){
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i),     _mm_loadu_ps(y + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+    }
+    _mm_storeu_ps(t, _mm_add_ps(s0, s1));
+    for(; i < n; ++i) t[0] += x[i]*y[i];
+    return (t[0] + t[1]) + (t[2] + t[3]);
+}
+
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2_6x16(int kc, const float *a, const float *b, float *c, int ldc)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    int p;
+    for(p = 0; p < kc; ++p){
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+        __m256 ai;
+        ai = _mm256_broadcast_ss(a + 0); c00 = _mm256_fmadd_ps(ai, b0, c00); c01 = _mm256_fmadd_ps(ai, b1, c01);
+        ai = _mm256_broadcast_ss(a + 1); c10 = _mm256_fmadd_ps(ai, b0, c10); c11 = _mm256_fmadd_ps(ai, b1, c11);
+        ai = _mm256_broadcast_ss(a + 2); c20 = _mm256_fmadd_ps(ai, b0, c20); c21 = _mm256_fmadd_ps(ai, b1, c21);
+        ai = _mm256_broadcast_ss(a + 3); c30 = _mm256_fmadd_ps(ai, b0, c30); c31 = _mm256_fmadd_ps(ai, b1, c31);
+        ai = _mm256_broadcast_ss(a + 4); c40 = _mm256_fmadd_ps(ai, b0, c40); c41 = _mm256_fmadd_ps(ai, b1, c41);
+        ai = _mm256_broadcast_ss(a + 5); c50 = _mm256_fmadd_ps(ai, b0, c50); c51 = _mm256_fmadd_ps(ai, b1, c51);
+        a += 6;
+        b += 16;
+    }
+#define GEMM_AVX_STORE_ROW(r, lo, hi) \
+    _mm256_storeu_ps(c + (r)*ldc,     _mm256_add_ps(_mm256_loadu_ps(c + (r)*ldc),     lo)); \
+    _mm256_storeu_ps(c + (r)*ldc + 8, _mm256_add_ps(_mm256_loadu_ps(c + (r)*ldc + 8), hi));
+    GEMM_AVX_STORE_ROW(0, c00, c01)
+    GEMM_AVX_STORE_ROW(1, c10, c11)
+    GEMM_AVX_STORE_ROW(2, c20, c21)
+    GEMM_AVX_STORE_ROW(3, c30, c31)
+    GEMM_AVX_STORE_ROW(4, c40, c41)
+    GEMM_AVX_STORE_ROW(5, c50, c51)
+#undef GEMM_AVX_STORE_ROW
+}
+
+__attribute__((target("avx2,fma")))
+static float gemm_dot_avx2(int n, const float *x, const float *y)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    float t[8];
+    int i;
+    for(i = 0; i + 16 <= n; i += 16){
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i),     _mm256_loadu_ps(y + i),     s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), s1);
+    }
+    _mm256_storeu_ps(t, _mm256_add_ps(s0, s1));
+    for(; i < n; ++i) t[0] += x[i]*y[i];
+    return ((t[0] + t[1]) + (t[2] + t[3])) + ((t[4] + t[5]) + (t[6] + t[7]));
+}
+
+#endif
+
+static const gemm_kernel gemm_kernels[] = {
+#ifdef GEMM_X86
+    {"avx2-fma", 6, 16, gemm_kernel_avx2_6x16, gemm_dot_avx2},
+    {"sse", 4, 8, gemm_kernel_sse_4x8, gemm_dot_sse},
+#endif
+    {"c", 4, 4, gemm_kernel_c_4x4, gemm_dot_c}
+};
+
+static int gemm_kernel_supported(const gemm_kernel *k)
+{
+#ifdef GEMM_X86
+    if(!strcmp(k->name, "avx2-fma")) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if(!strcmp(k->name, "sse")) return __builtin_cpu_supports("sse");
+#endif
+    return 1;
+}
+
+static const gemm_kernel *gemm_cpu_kernel()
+{
+    static const gemm_kernel *selected = 0;
+    if(!selected){
+        int i;
+        int n = sizeof(gemm_kernels)/sizeof(gemm_kernels[0]);
+        for(i = 0; i < n; ++i){
+            if(gemm_kernel_supported(&gemm_kernels[i])) break;
+        }
+        selected = &gemm_kernels[i < n ? i : n-1];
+    }
+    return selected;
+}
+
+const char *gemm_cpu_kernel_name()
+{
+    return gemm_cpu_kernel()->name;
+}
+
+static float *gemm_aligned_alloc(size_t n, void **base)
+{
+    *base = malloc(n*sizeof(float) + GEMM_ALIGN);
+    if(!*base) malloc_error();
+    return (float *)(((size_t)*base + GEMM_ALIGN - 1) & ~(size_t)(GEMM_ALIGN - 1));
+}
+
+/* Applies the epilogue to the rows x cols block of C whose top-left element is element (row0, col0) of the product. */
+static void gemm_apply_epilogue(const gemm_epilogue *e, int row0, int col0, int rows, int cols, float *C, int ldc)
+{
+    int i, j;
+    for(i = 0; i < rows; ++i){
+        float *c = C + i*ldc;
+        float rb = e->row_bias ? e->row_bias[row0 + i] : 0;
+        if(e->col_bias){
+            const float *cb = e->col_bias + col0;
+            for(j = 0; j < cols; ++j) c[j] += rb + cb[j];
+        } else if(rb != 0){
+            for(j = 0; j < cols; ++j) c[j] += rb;
+        }
+        switch(e->activation){
+            case LINEAR:
+                break;
+            case LEAKY:
+                for(j = 0; j < cols; ++j) c[j] = (c[j] > 0) ? c[j] : .1f*c[j];
+                break;
+            case RELU:
+                for(j = 0; j < cols; ++j) c[j] = (c[j] > 0) ? c[j] : 0;
+                break;
+            default:
+                activate_array(c, cols, e->activation);
+        }
+    }
+}
+
+/* Packs the mc x kc block of ALPHA*op(A) whose top-left element is A into mr-high row panels. */
+static void gemm_pack_a(int TA, int mc, int kc, float ALPHA, const float *A, int lda, int mr, float *packed)
+{
+    int i, p, r;
+    for(i = 0; i < mc; i += mr){
+        int rows = (mc - i < mr) ? mc - i : mr;
+        for(p = 0; p < kc; ++p){
+            if(!TA){
+                for(r = 0; r < rows; ++r) packed[r] = ALPHA*A[(i+r)*lda + p];
+            } else {
+                const float *a = A + p*lda + i;
+                for(r = 0; r < rows; ++r) packed[r] = ALPHA*a[r];
+            }
+            for(r = rows; r < mr; ++r) packed[r] = 0;
+            packed += mr;
+        }
+    }
+}
+
+/* Packs the kc x nc slice of op(B) whose top-left element is B into nr-wide column panels. */
+static void gemm_pack_b(int TB, int kc, int nc, const float *B, int ldb, int nr, float *packed)
+{
+    int j, p, r;
+    for(j = 0; j < nc; j += nr){
+        int cols = (nc - j < nr) ? nc - j : nr;
+        for(p = 0; p < kc; ++p){
+            if(!TB){
+                memcpy(packed, B + p*ldb + j, cols*sizeof(float));
+            } else {
+                for(r = 0; r < cols; ++r) packed[r] = B[(j+r)*ldb + p];
+            }
+            for(r = cols; r < nr; ++r) packed[r] = 0;
+            packed += nr;
+        }
+    }
+}
+
+/* With overwrite set, each tile of C is cleared before the first panel is added to it; with e set
+ * (on the last panel), the epilogue is applied to each tile straight after it, while it is in L1. */
+static void gemm_macro_kernel(const gemm_kernel *k, int mc, int nc, int kc, const float *packed_a, const float *packed_b, float *C, int ldc,
+        int overwrite, const gemm_epilogue *e, int row0, int col0)
+{
+    int mr = k->mr;
+    int nr = k->nr;
+    float tile[GEMM_MR_MAX*GEMM_NR_MAX];
+    int ir, jr, i, j;
+    for(jr = 0; jr < nc; jr += nr){
+        int cols = (nc - jr < nr) ? nc - jr : nr;
+        const float *b = packed_b + jr*kc;
+        for(ir = 0; ir < mc; ir += mr){
+            int rows = (mc - ir < mr) ? mc - ir : mr;
+            const float *a = packed_a + ir*kc;
+            float *c = C + ir*ldc + jr;
+            if(overwrite){
+                for(i = 0; i < rows; ++i) memset(c + i*ldc, 0, cols*sizeof(float));
+            }
+            if(rows == mr && cols == nr){
+                k->kernel(kc, a, b, c, ldc);
+            } else {
+                memset(tile, 0, mr*nr*sizeof(float));
+                k->kernel(kc, a, b, tile, nr);
+                for(i = 0; i < rows; ++i){
+                    for(j = 0; j < cols; ++j){
+                        c[i*ldc + j] += tile[i*nr + j];
+                    }
+                }
+            }
+            if(e) gemm_apply_epilogue(e, row0 + ir, col0 + jr, rows, cols, c, ldc);
+        }
+    }
+}
+
+static void gemm_blocked(const gemm_kernel *k, int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda,
+        float *B, int ldb,
+        float *C, int ldc,
+        int overwrite, const gemm_epilogue *e)
+{
+    int mr = k->mr;
+    int nr = k->nr;
+    int kc_max = (K < GEMM_KC) ? K : GEMM_KC;
+    int mc_max = (M < GEMM_MC) ? (M + mr - 1)/mr*mr : GEMM_MC;
+    int nc_max = (N < GEMM_NC) ? (N + nr - 1)/nr*nr : GEMM_NC;
+    void *base_a, *base_b;
+    float *packed_a = gemm_aligned_alloc((size_t)mc_max*kc_max, &base_a);
+    float *packed_b = gemm_aligned_alloc((size_t)kc_max*nc_max, &base_b);
+    int jc, pc, ic;
+
+    for(jc = 0; jc < N; jc += GEMM_NC){
+        int nc = (N - jc < GEMM_NC) ? N - jc : GEMM_NC;
+        for(pc = 0; pc < K; pc += GEMM_KC){
+            int kc = (K - pc < GEMM_KC) ? K - pc : GEMM_KC;
+            gemm_pack_b(TB, kc, nc, TB ? B + jc*ldb + pc : B + pc*ldb + jc, ldb, nr, packed_b);
+            for(ic = 0; ic < M; ic += GEMM_MC){
+                int mc = (M - ic < GEMM_MC) ? M - ic : GEMM_MC;
+                gemm_pack_a(TA, mc, kc, ALPHA, TA ? A + pc*lda + ic : A + ic*lda + pc, lda, mr, packed_a);
+                gemm_macro_kernel(k, mc, nc, kc, packed_a, packed_b, C + ic*ldc + jc, ldc,
+                        overwrite && pc == 0, (pc + kc >= K) ? e : 0, ic, jc);
+            }
+        }
+    }
+
+    free(base_a);
+    free(base_b);
+}
+
+/* With only a few rows of op(A) (e.g. connected layers at batch 1) the product is memory bound:
+ * packing B would double the traffic, so A*B^T is evaluated directly as contiguous dot products. */
+static void gemm_nt_dot(const gemm_kernel *k, int M, int N, int K, float ALPHA,
+        float *A, int lda,
         float *B, int ldb,
-        float BETA,
         float *C, int ldc)
 {
-    //printf("cpu: %d %d %d %d %d %f %d %d %f %d\n",TA, TB, M, N, K, ALPHA, lda, ldb, BETA, ldc);
     int i, j;
     for(i = 0; i < M; ++i){
         for(j = 0; j < N; ++j){
-            C[i*ldc + j] *= BETA;
+            C[i*ldc + j] += ALPHA*k->dot(K, A + i*lda, B + j*ldb);
+        }
+    }
+}
+
+static void gemm_cpu_serial(const gemm_kernel *k, int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda,
+        float *B, int ldb,
+        float BETA,
+        float *C, int ldc,
+        const gemm_epilogue *e)
+{
+    int i, j;
+    int blocked = !(M < k->mr && !TA);
+    /* The blocked path clears C tile by tile instead of in a separate sweep. */
+    int overwrite = blocked && BETA == 0 && K > 0;
+    if(BETA == 0 && !overwrite){
+        /* Clear C rather than scaling it, so that it need not be initialised (0*NaN would be NaN). */
+        for(i = 0; i < M && N > 0; ++i){
+            memset(C + i*ldc, 0, N*sizeof(float));
+        }
+    } else if(BETA != 1 && !overwrite){
+        for(i = 0; i < M; ++i){
+            for(j = 0; j < N; ++j){
+                C[i*ldc + j] *= BETA;
+            }
         }
     }
+    if(M <= 0 || N <= 0) return;
+    if(K <= 0){
+        if(e) gemm_apply_epilogue(e, 0, 0, M, N, C, ldc);
+        return;
+    }
+
+    if(blocked){
+        gemm_blocked(k, TA, TB, M, N, K, ALPHA, A, lda, B, ldb, C, ldc, overwrite, e);
+        return;
+    }
+    if(TB){
+        gemm_nt_dot(k, M, N, K, ALPHA, A, lda, B, ldb, C, ldc);
+    } else {
+        gemm_nn(M, N, K, ALPHA, A, lda, B, ldb, C, ldc);
+    }
+    if(e) gemm_apply_epilogue(e, 0, 0, M, N, C, ldc);
+}
+
+typedef struct{
+    const gemm_kernel *k;
+    int TA, TB, M, N, K;
+    float ALPHA;
+    float *A;
+    int lda;
+    float *B;
+    int ldb;
+    float BETA;
+    float *C;
+    int ldc;
+    const gemm_epilogue *e;
+    int split_m;
+    int block;
+} gemm_job;
+
+static void gemm_range(void *ctx, int begin, int end)
+{
+    gemm_job *g = (gemm_job *)ctx;
+    int dim = g->split_m ? g->M : g->N;
+    int b = begin*g->block;
+    int e = end*g->block;
+    gemm_epilogue epilogue;
+    if(e > dim) e = dim;
+    /* Offset the bias along the split dimension to match the strip. */
+    if(g->e){
+        epilogue = *g->e;
+        if(g->split_m && epilogue.row_bias) epilogue.row_bias += b;
+        if(!g->split_m && epilogue.col_bias) epilogue.col_bias += b;
+    }
+    if(g->split_m){
+        gemm_cpu_serial(g->k, g->TA, g->TB, e - b, g->N, g->K, g->ALPHA,
+                g->TA ? g->A + b : g->A + b*g->lda, g->lda,
+                g->B, g->ldb,
+                g->BETA, g->C + b*g->ldc, g->ldc, g->e ? &epilogue : 0);
+    } else {
+        gemm_cpu_serial(g->k, g->TA, g->TB, g->M, e - b, g->K, g->ALPHA,
+                g->A, g->lda,
+                g->TB ? g->B + b*g->ldb : g->B + b, g->ldb,
+                g->BETA, g->C + b, g->ldc, g->e ? &epilogue : 0);
+    }
+}
+
+/* Splits C into independent row or column strips (whichever gives the larger strips in
+ * micro-tiles) and hands them to the CPU thread pool. */
+static void gemm_cpu_with(const gemm_kernel *k, int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda,
+        float *B, int ldb,
+        float BETA,
+        float *C, int ldc,
+        const gemm_epilogue *e)
+{
+    double flop = 2.*M*N*K;
+    gemm_job g;
+    int blocks;
+    double flop_per_block;
+    if(flop < GEMM_PARALLEL_FLOP || get_cpu_threads() <= 1){
+        gemm_cpu_serial(k, TA, TB, M, N, K, ALPHA, A, lda, B, ldb, BETA, C, ldc, e);
+        return;
+    }
+
+    g.k = k;
+    g.TA = TA; g.TB = TB;
+    g.M = M; g.N = N; g.K = K;
+    g.ALPHA = ALPHA;
+    g.A = A; g.lda = lda;
+    g.B = B; g.ldb = ldb;
+    g.BETA = BETA;
+    g.C = C; g.ldc = ldc;
+    g.e = e;
+    g.split_m = (M + k->mr - 1)/k->mr > (N + k->nr - 1)/k->nr;
+    g.block = g.split_m ? k->mr : k->nr;
+    blocks = ((g.split_m ? M : N) + g.block - 1)/g.block;
+    flop_per_block = flop/blocks;
+    parallel_for(blocks, (int)(GEMM_PARALLEL_FLOP/flop_per_block) + 1, gemm_range, &g);
+}
+
+static void gemm_reference(int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda,
+        float *B, int ldb,
+        float *C, int ldc)
+{
     if(!TA && !TB)
         gemm_nn(M, N, K, ALPHA,A,lda, B, ldb,C,ldc);
     else if(TA && !TB)
@@ -161,6 +620,161 @@ void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA,
         gemm_tt(M, N, K, ALPHA,A,lda, B, ldb,C,ldc);
 }
 
+void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA, 
+        float *A, int lda, 
+        float *B, int ldb,
+        float BETA,
+        float *C, int ldc)
+{
+    //printf("cpu: %d %d %d %d %d %f %d %d %f %d\n",TA, TB, M, N, K, ALPHA, lda, ldb, BETA, ldc);
+    gemm_cpu_with(gemm_cpu_kernel(), TA, TB, M, N, K, ALPHA, A, lda, B, ldb, BETA, C, ldc, 0);
+}
+
+void gemm_cpu_bias_activate(int TA, int TB, int M, int N, int K,
+        float *A, int lda,
+        float *B, int ldb,
+        float *C, int ldc,
+        const float *row_bias, const float *col_bias, ACTIVATION activation)
+{
+    gemm_epilogue e;
+    e.row_bias = row_bias;
+    e.col_bias = col_bias;
+    e.activation = activation;
+    gemm_cpu_with(gemm_cpu_kernel(), TA, TB, M, N, K, 1, A, lda, B, ldb, 0, C, ldc, &e);
+}
+
+static void time_gemm_kernel(const gemm_kernel *kernel, int TA, int TB, int m, int k, int n)
+{
+    float *a = random_matrix(m, k);
+    float *b = random_matrix(k, n);
+    float *c = calloc(m*n, sizeof(float));
+    int lda = (!TA)?k:m;
+    int ldb = (!TB)?n:k;
+    double flop = 2.*m*n*k;
+    int iter = 0;
+    double start, elapsed;
+
+    /* Warm up once, then repeat until we have at least a quarter of a second of samples. */
+    gemm_cpu_with(kernel,TA,TB,m,n,k,1,a,lda,b,ldb,1,c,n,0);
+    start = what_time_is_it_now();
+    do{
+        gemm_cpu_with(kernel,TA,TB,m,n,k,1,a,lda,b,ldb,1,c,n,0);
+        ++iter;
+        elapsed = what_time_is_it_now() - start;
+    } while(elapsed < .25 && iter < 1000);
+
+    printf("  %-9s %9.3lf ms %8.2lf GFLOP/s\n", kernel->name, 1000.*elapsed/iter, flop*iter/elapsed/1e9);
+    free(a);
+    free(b);
+    free(c);
+}
+
+static double gemm_max_error(const gemm_kernel *kernel, int TA, int TB, int m, int k, int n)
+{
+    float *a = random_matrix(m, k);
+    float *b = random_matrix(k, n);
+    float *c = random_matrix(m, n);
+    float *c_ref = calloc(m*n, sizeof(float));
+    int lda = (!TA)?k:m;
+    int ldb = (!TB)?n:k;
+    double err = 0;
+    int i;
+    memcpy(c_ref, c, m*n*sizeof(float));
+    gemm_cpu_with(kernel,TA,TB,m,n,k,.5,a,lda,b,ldb,1,c,n,0);
+    gemm_reference(TA,TB,m,n,k,.5,a,lda,b,ldb,c_ref,n);
+    for(i = 0; i < m*n; ++i){
+        double d = fabs(c[i] - c_ref[i])/(fabs(c_ref[i]) + 1);
+        if(d > err) err = d;
+    }
+    free(a);
+    free(b);
+    free(c);
+    free(c_ref);
+    return err;
+}
+
+/* Compares gemm_cpu_bias_activate with the naive loops followed by a separate bias and leaky pass. */
+static double gemm_epilogue_max_error(int TB, int m, int k, int n)
+{
+    float *a = random_matrix(m, k);
+    float *b = random_matrix(k, n);
+    float *bias = random_matrix(1, TB ? n : m);
+    float *c = random_matrix(m, n);
+    float *c_ref = calloc(m*n, sizeof(float));
+    int ldb = (!TB)?n:k;
+    double err = 0;
+    int i;
+    /* Centre A so that the leaky slope is exercised too. */
+    for(i = 0; i < m*k; ++i) a[i] -= .5;
+    gemm_cpu_bias_activate(0,TB,m,n,k,a,k,b,ldb,c,n, TB ? 0 : bias, TB ? bias : 0, LEAKY);
+    gemm_reference(0,TB,m,n,k,1,a,k,b,ldb,c_ref,n);
+    for(i = 0; i < m*n; ++i){
+        float v = c_ref[i] + bias[TB ? i%n : i/n];
+        double d;
+        v = (v > 0) ? v : .1f*v;
+        d = fabs(c[i] - v)/(fabs(v) + 1);
+        if(d > err) err = d;
+    }
+    free(a);
+    free(b);
+    free(bias);
+    free(c);
+    free(c_ref);
+    return err;
+}
+
+void time_random_matrix(int TA, int TB, int m, int k, int n)
+{
+    int i;
+    int count = sizeof(gemm_kernels)/sizeof(gemm_kernels[0]);
+    printf("Matrix Multiplication %dx%d * %dx%d, TA=%d, TB=%d:\n",m,k,k,n, TA, TB);
+    for(i = 0; i < count; ++i){
+        if(gemm_kernel_supported(&gemm_kernels[i])) time_gemm_kernel(&gemm_kernels[i], TA, TB, m, k, n);
+    }
+}
+
+void benchmark_gemm_cpu()
+{
+    /* {TA, TB, M, K, N} for the convolutional layers of yolo.cfg at 448x448 (M = filters,
+     * K = size*size*c, N = out_h*out_w), followed by the two connected layers at batch 1. */
+    static const int shapes[][5] = {
+        {0,0,   64, 147, 50176},
+        {0,0,  192, 576, 12544},
+        {0,0,  128, 192,  3136},
+        {0,0,  256,1152,  3136},
+        {0,0,  256, 256,  3136},
+        {0,0,  512,2304,  3136},
+        {0,0,  256, 512,   784},
+        {0,0,  512,2304,   784},
+        {0,0,  512, 512,   784},
+        {0,0, 1024,4608,   784},
+        {0,0,  512,1024,   196},
+        {0,0, 1024,4608,   196},
+        {0,0, 1024,9216,   196},
+        {0,0, 1024,9216,    49},
+        {0,1,    1,50176, 4096},
+        {0,1,    1,4096,  1470},
+        /* The weight-gradient and delta GEMMs of the last connected layer. */
+        {1,0, 1470,   1, 4096},
+        {0,0,    1,1470, 4096}
+    };
+    int count = sizeof(gemm_kernels)/sizeof(gemm_kernels[0]);
+    int i, t;
+
+    printf("CPU GEMM kernel: %s, %d threads\n", gemm_cpu_kernel_name(), get_cpu_threads());
+    for(i = 0; i < count; ++i){
+        if(!gemm_kernel_supported(&gemm_kernels[i])) continue;
+        for(t = 0; t < 4; ++t){
+            printf("  %-9s TA=%d, TB=%d: max relative error vs naive %g\n", gemm_kernels[i].name, t/2, t%2, gemm_max_error(&gemm_kernels[i], t/2, t%2, 37, 301, 53));
+        }
+    }
+    printf("  bias + leaky epilogue: max relative error vs separate passes %g (row bias), %g (column bias, one row)\n",
+            gemm_epilogue_max_error(0, 37, 301, 53), gemm_epilogue_max_error(1, 1, 301, 53));
+    for(i = 0; i < (int)(sizeof(shapes)/sizeof(shapes[0])); ++i){
+        time_random_matrix(shapes[i][0], shapes[i][1], shapes[i][2], shapes[i][3], shapes[i][4]);
+    }
+}
+
 #ifdef WITH_CUDA
 
 #include <math.h>
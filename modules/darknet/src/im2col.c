@@ -1,5 +1,7 @@
 #include "im2col.h"
+#include "parallel.h"
 #include <stdio.h>
+#include <string.h>
 float im2col_get_pixel(float *im, int height, int width, int channels,
                         int row, int col, int channel, int pad)
 {
@@ -13,32 +15,80 @@ float im2col_get_pixel(float *im, int height, int width, int channels,
 
 //From Berkeley Vision's Caffe!
 //https://github.com/BVLC/caffe/blob/master/LICENSE
-void im2col_cpu(float* data_im,
-     int channels,  int height,  int width,
-     int ksize,  int stride, int pad, float* data_col) 
+typedef struct{
+    float *data_im;
+    int channels, height, width;
+    int ksize, stride, pad;
+    int height_col, width_col;
+    float *data_col;
+} im2col_args;
+
+/*
+ * Each row of the column matrix is one (channel, kernel offset) pair. For every output row it
+ * reads one image row, so the columns that fall inside the image are a single contiguous
+ * segment (strided when stride > 1) and only the padding at either end needs zeroing.
+ */
+static void im2col_rows(void *ctx, int begin, int end)
 {
+    im2col_args *a = (im2col_args *)ctx;
     int c,h,w;
-    int height_col = (height - ksize) / stride + 1;
-    int width_col = (width - ksize) / stride + 1;
-    if (pad){
-        height_col = 1 + (height-1) / stride;
-        width_col = 1 + (width-1) / stride;
-        pad = ksize/2;
-    }
-    int channels_col = channels * ksize * ksize;
-    for (c = 0; c < channels_col; ++c) {
+    int ksize = a->ksize;
+    int stride = a->stride;
+    int height_col = a->height_col;
+    int width_col = a->width_col;
+    for (c = begin; c < end; ++c) {
         int w_offset = c % ksize;
         int h_offset = (c / ksize) % ksize;
         int c_im = c / ksize / ksize;
+        const float *im = a->data_im + (size_t)c_im*a->height*a->width;
+        int col_offset = w_offset - a->pad;
+
+        /* The output columns whose input column col_offset + w*stride lies in [0, width). */
+        int w_begin = (col_offset >= 0) ? 0 : (-col_offset + stride - 1) / stride;
+        int w_end = (a->width - 1 - col_offset >= 0) ? (a->width - 1 - col_offset) / stride + 1 : 0;
+        if (w_end > width_col) w_end = width_col;
+        if (w_begin > w_end) w_begin = w_end;
+
         for (h = 0; h < height_col; ++h) {
-            for (w = 0; w < width_col; ++w) {
-                int im_row = h_offset + h * stride;
-                int im_col = w_offset + w * stride;
-                int col_index = (c * height_col + h) * width_col + w;
-                data_col[col_index] = im2col_get_pixel(data_im, height, width, channels,
-                        im_row, im_col, c_im, pad);
+            int im_row = h_offset + h * stride - a->pad;
+            float *col = a->data_col + ((size_t)c * height_col + h) * width_col;
+            if (im_row < 0 || im_row >= a->height) {
+                memset(col, 0, width_col * sizeof(float));
+                continue;
+            }
+            const float *row = im + (size_t)im_row * a->width + col_offset;
+            if (w_begin > 0) memset(col, 0, w_begin * sizeof(float));
+            if (stride == 1) {
+                memcpy(col + w_begin, row + w_begin, (w_end - w_begin) * sizeof(float));
+            } else {
+                for (w = w_begin; w < w_end; ++w) col[w] = row[w * stride];
             }
+            if (w_end < width_col) memset(col + w_end, 0, (width_col - w_end) * sizeof(float));
         }
     }
 }
 
+void im2col_cpu(float* data_im,
+     int channels,  int height,  int width,
+     int ksize,  int stride, int pad, float* data_col) 
+{
+    im2col_args a;
+    a.height_col = (height - ksize) / stride + 1;
+    a.width_col = (width - ksize) / stride + 1;
+    if (pad){
+        a.height_col = 1 + (height-1) / stride;
+        a.width_col = 1 + (width-1) / stride;
+        pad = ksize/2;
+    }
+    a.data_im = data_im;
+    a.channels = channels;
+    a.height = height;
+    a.width = width;
+    a.ksize = ksize;
+    a.stride = stride;
+    a.pad = pad;
+    a.data_col = data_col;
+    int channels_col = channels * ksize * ksize;
+    parallel_for(channels_col, 1 + (1 << 14)/(a.height_col*a.width_col), im2col_rows, &a);
+}
+
@@ -27,6 +27,10 @@ void free_layer(layer l)
     if(l.output)         free(l.output);
     if(l.squared)        free(l.squared);
     if(l.norms)          free(l.norms);
+    if(l.quantized_weights) free(l.quantized_weights);
+    if(l.quantized_scales)  free(l.quantized_scales);
+    if(l.quantized_biases)  free(l.quantized_biases);
+    if(l.winograd_filters)  free(l.winograd_filters);
 
 #ifdef WITH_CUDA
     if(l.indexes_gpu)          cuda_free((float *)l.indexes_gpu);
@@ -0,0 +1,253 @@
+#include "low_rank.h"
+#include "connected_layer.h"
+#include "memory_planner.h"
+#include "resolution_plan.h"
+#include "gemm.h"
+#include "cuda.h"
+#include "utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Extra directions sampled beyond the rank, and passes of subspace iteration; with both the leading singular vectors come out to float precision. */
+#define LOW_RANK_OVERSAMPLING 10
+#define LOW_RANK_POWER_ITERATIONS 2
+#define MAX_JACOBI_SWEEPS 50
+
+int find_factorizable_layer(network net)
+{
+    int i;
+    for(i = 0; i < net.n; ++i){
+        if(net.layers[i].type == CONNECTED) return i;
+    }
+    return -1;
+}
+
+/* Orthonormalises the rows of a k x n matrix in place (modified Gram-Schmidt, applied twice so the result stays orthogonal in float). */
+static void orthonormalize_rows(float *a, int k, int n)
+{
+    int pass, i, j, x;
+    for(pass = 0; pass < 2; ++pass){
+        for(i = 0; i < k; ++i){
+            float *r = a + (size_t)i*n;
+            for(j = 0; j < i; ++j){
+                const float *q = a + (size_t)j*n;
+                double dot = 0;
+                for(x = 0; x < n; ++x) dot += (double)r[x]*q[x];
+                for(x = 0; x < n; ++x) r[x] -= dot*q[x];
+            }
+            double norm = 0;
+            for(x = 0; x < n; ++x) norm += (double)r[x]*r[x];
+            float scale = (norm > 0) ? 1./sqrt(norm) : 0;
+            for(x = 0; x < n; ++x) r[x] *= scale;
+        }
+    }
+}
+
+/*
+ * Cyclic Jacobi eigendecomposition of a symmetric k x k matrix. On return the diagonal of a
+ * holds the eigenvalues and the columns of v the corresponding eigenvectors.
+ */
+static void symmetric_eigen(double *a, double *v, int k)
+{
+    int sweep, p, q, r;
+    for(p = 0; p < k; ++p){
+        for(q = 0; q < k; ++q) v[p*k + q] = (p == q);
+    }
+    for(sweep = 0; sweep < MAX_JACOBI_SWEEPS; ++sweep){
+        double off = 0, diagonal = 0;
+        for(p = 0; p < k; ++p){
+            diagonal += a[p*k + p]*a[p*k + p];
+            for(q = p+1; q < k; ++q) off += a[p*k + q]*a[p*k + q];
+        }
+        if(off <= 1e-30*diagonal) break;
+        for(p = 0; p < k; ++p){
+            for(q = p+1; q < k; ++q){
+                double apq = a[p*k + q];
+                if(apq == 0) continue;
+                double theta = (a[q*k + q] - a[p*k + p])/(2*apq);
+                double t = ((theta >= 0) ? 1 : -1)/(fabs(theta) + sqrt(theta*theta + 1));
+                double c = 1/sqrt(t*t + 1);
+                double s = t*c;
+                for(r = 0; r < k; ++r){
+                    double arp = a[r*k + p], arq = a[r*k + q];
+                    a[r*k + p] = c*arp - s*arq;
+                    a[r*k + q] = s*arp + c*arq;
+                }
+                for(r = 0; r < k; ++r){
+                    double apr = a[p*k + r], aqr = a[q*k + r];
+                    a[p*k + r] = c*apr - s*aqr;
+                    a[q*k + r] = s*apr + c*aqr;
+                }
+                for(r = 0; r < k; ++r){
+                    double vrp = v[r*k + p], vrq = v[r*k + q];
+                    v[r*k + p] = c*vrp - s*vrq;
+                    v[r*k + q] = s*vrp + c*vrq;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * The SVD comes from a k-dimensional basis Q of the range of W (k = rank + oversampling):
+ * with B = Q^T W and B B^T = E L E^T, the leading singular values of W are sqrt(L) and
+ * W ~ (Q E) (E^T B), so only the k x k matrix B B^T has to be decomposed.
+ */
+low_rank_factors factorize_connected_layer(layer l, int rank)
+{
+    if(l.type != CONNECTED) error("Only connected layers can be factorised");
+    if(l.quantized) error("Cannot factorise a quantized layer");
+    int m = l.outputs;
+    int n = l.inputs;
+    int smaller = (m < n) ? m : n;
+    if(rank < 1 || rank >= smaller) error("The rank must be less than both the inputs and the outputs of the layer");
+    int k = rank + LOW_RANK_OVERSAMPLING;
+    if(k > smaller) k = smaller;
+    int i, j;
+
+#ifdef WITH_CUDA
+    if(gpu_index >= 0) pull_connected_layer(l);
+#endif
+    float *w = l.weights;
+    float *b = calloc((size_t)k*n, sizeof(float));
+    float *qt = calloc((size_t)k*m, sizeof(float));
+    float *gram = calloc((size_t)k*k, sizeof(float));
+    double *a = calloc((size_t)k*k, sizeof(double));
+    double *e = calloc((size_t)k*k, sizeof(double));
+    if(!b || !qt || !gram || !a || !e) malloc_error();
+
+    /* The rows of qt span the range of W times k random vectors, sharpened by subspace iteration. */
+    for(i = 0; i < k*n; ++i) b[i] = rand_normal();
+    gemm(0,1,k,m,n,1,b,n,w,n,0,qt,m);
+    orthonormalize_rows(qt, k, m);
+    for(i = 0; i < LOW_RANK_POWER_ITERATIONS; ++i){
+        memset(b, 0, (size_t)k*n*sizeof(float));
+        gemm(0,0,k,n,m,1,qt,m,w,n,0,b,n);
+        memset(qt, 0, (size_t)k*m*sizeof(float));
+        gemm(0,1,k,m,n,1,b,n,w,n,0,qt,m);
+        orthonormalize_rows(qt, k, m);
+    }
+    memset(b, 0, (size_t)k*n*sizeof(float));
+    gemm(0,0,k,n,m,1,qt,m,w,n,0,b,n);
+    gemm(0,1,k,k,n,1,b,n,b,n,0,gram,k);
+
+    for(i = 0; i < k*k; ++i) a[i] = gram[i];
+    symmetric_eigen(a, e, k);
+
+    /* Order the eigenvectors by decreasing eigenvalue. */
+    int *order = calloc(k, sizeof(int));
+    if(!order) malloc_error();
+    for(i = 0; i < k; ++i) order[i] = i;
+    for(i = 1; i < k; ++i){
+        int o = order[i];
+        for(j = i; j > 0 && a[order[j-1]*k + order[j-1]] < a[o*k + o]; --j) order[j] = order[j-1];
+        order[j] = o;
+    }
+
+    low_rank_factors f;
+    f.inputs = n;
+    f.outputs = m;
+    f.rank = rank;
+    f.first = calloc((size_t)rank*n, sizeof(float));
+    f.second = calloc((size_t)m*rank, sizeof(float));
+    f.singular_values = calloc(rank, sizeof(float));
+    float *left = calloc((size_t)k*rank, sizeof(float));
+    float *right = calloc((size_t)k*rank, sizeof(float));
+    if(!f.first || !f.second || !f.singular_values || !left || !right) malloc_error();
+
+    /* first = S^-1/2 E^T B and second = Q E S^1/2, with E truncated to its leading columns. */
+    double largest = sqrt(fmax(a[order[0]*k + order[0]], 0));
+    for(i = 0; i < rank; ++i){
+        double sigma = sqrt(fmax(a[order[i]*k + order[i]], 0));
+        f.singular_values[i] = sigma;
+        if(sigma <= 1e-12*largest) continue;
+        for(j = 0; j < k; ++j){
+            left[j*rank + i] = e[j*k + order[i]]/sqrt(sigma);
+            right[j*rank + i] = e[j*k + order[i]]*sqrt(sigma);
+        }
+    }
+    gemm(1,0,rank,n,k,1,left,rank,b,n,0,f.first,n);
+    gemm(1,0,m,rank,k,1,qt,m,right,rank,0,f.second,rank);
+
+    free(order);
+    free(left);
+    free(right);
+    free(b);
+    free(qt);
+    free(gram);
+    free(a);
+    free(e);
+    return f;
+}
+
+void free_low_rank_factors(low_rank_factors f)
+{
+    free(f.first);
+    free(f.second);
+    free(f.singular_values);
+}
+
+network make_factorized_network(network net, int i, low_rank_factors f, int rank)
+{
+    if(i < 0 || i >= net.n) error("No such layer");
+    layer l = net.layers[i];
+    if(l.type != CONNECTED || l.inputs != f.inputs || l.outputs != f.outputs) error("The factors do not match the layer");
+    if(rank < 1 || rank > f.rank) error("The rank must be between 1 and that of the factors");
+    int j, r;
+    /* Inserting a layer moves the ones after it, which would break any indexes that reach back past it. */
+    for(j = i+1; j < net.n; ++j){
+        if(net.layers[j].type == ROUTE || net.layers[j].type == SHORTCUT) error("Cannot factorise a layer followed by route or shortcut layers");
+    }
+
+    network fnet = net;
+    fnet.n = net.n + 1;
+    fnet.layers = calloc(fnet.n, sizeof(layer));
+    if(!fnet.layers) malloc_error();
+    memcpy(fnet.layers, net.layers, i*sizeof(layer));
+    memcpy(fnet.layers + i + 2, net.layers + i + 1, (net.n - i - 1)*sizeof(layer));
+    fnet.resolution_plans = 0;
+    fnet.profile = 0;
+
+    /* The pair must hold as many images as the rest of the network, which may have been allocated for a larger batch than it now runs. */
+    int batch = (net.allocated_batch > l.batch) ? net.allocated_batch : l.batch;
+    layer first = make_connected_layer(batch, l.inputs, rank, LINEAR, 0);
+    layer second = make_connected_layer(batch, rank, l.outputs, l.activation, l.batch_normalize);
+    first.batch = second.batch = l.batch;
+    memcpy(first.weights, f.first, (size_t)rank*l.inputs*sizeof(float));
+    for(r = 0; r < l.outputs; ++r){
+        memcpy(second.weights + (size_t)r*rank, f.second + (size_t)r*f.rank, rank*sizeof(float));
+    }
+    memcpy(second.biases, l.biases, l.outputs*sizeof(float));
+    if(l.batch_normalize){
+        memcpy(second.scales, l.scales, l.outputs*sizeof(float));
+        memcpy(second.rolling_mean, l.rolling_mean, l.outputs*sizeof(float));
+        memcpy(second.rolling_variance, l.rolling_variance, l.outputs*sizeof(float));
+    }
+#ifdef WITH_CUDA
+    if(gpu_index >= 0){
+        push_connected_layer(first);
+        push_connected_layer(second);
+    }
+#endif
+    /* The other layers of a planned network no longer have their training buffers, so neither should the pair. */
+    if(net.activation_arenas){
+        release_training_buffers(&first);
+        release_training_buffers(&second);
+    }
+    fnet.layers[i] = first;
+    fnet.layers[i+1] = second;
+    return fnet;
+}
+
+void free_factorized_network(network *net, int i)
+{
+    free_resolution_plans(net);
+    free_layer(net->layers[i]);
+    free_layer(net->layers[i+1]);
+    free(net->layers);
+    net->layers = 0;
+    net->n = 0;
+}
@@ -1,9 +1,14 @@
 #include "maxpool_layer.h"
 #include "cuda.h"
+#include "parallel.h"
 #include <malloc.h>
 #include <stdio.h>
 #include <float.h>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 /*
 image get_maxpool_image(maxpool_layer l)
 {
@@ -76,9 +81,18 @@ void resize_maxpool_layer(maxpool_layer *l, int w, int h)
     #endif
 }
 
-void forward_maxpool_layer(const maxpool_layer l, network_state state)
+typedef struct{
+    const maxpool_layer *l;
+    float *input;
+    int train;
+} maxpool_args;
+
+static void forward_maxpool_planes(void *ctx, int begin, int end)
 {
-    int b,i,j,k,m,n;
+    const maxpool_layer l = *((maxpool_args *)ctx)->l;
+    float *input = ((maxpool_args *)ctx)->input;
+    int train = ((maxpool_args *)ctx)->train;
+    int p,b,i,j,k,m,n;
     int w_offset = (-l.size-1)/2 + 1;
     int h_offset = (-l.size-1)/2 + 1;
 
@@ -86,33 +100,85 @@ void forward_maxpool_layer(const maxpool_layer l, network_state state)
     int w = (l.w-1)/l.stride + 1;
     int c = l.c;
 
-    for(b = 0; b < l.batch; ++b){
-        for(k = 0; k < c; ++k){
-            for(i = 0; i < h; ++i){
-                for(j = 0; j < w; ++j){
-                    int out_index = j + w*(i + h*(k + c*b));
-                    float max = -FLT_MAX;
-                    int max_i = -1;
-                    for(n = 0; n < l.size; ++n){
-                        for(m = 0; m < l.size; ++m){
-                            int cur_h = h_offset + i*l.stride + n;
-                            int cur_w = w_offset + j*l.stride + m;
-                            int index = cur_w + l.w*(cur_h + l.h*(k + b*l.c));
-                            int valid = (cur_h >= 0 && cur_h < l.h &&
-                                         cur_w >= 0 && cur_w < l.w);
-                            float val = (valid != 0) ? state.input[index] : -FLT_MAX;
-                            max_i = (val > max) ? index : max_i;
-                            max   = (val > max) ? val   : max;
-                        }
+    for(p = begin; p < end; ++p){
+        b = p / c;
+        k = p % c;
+        for(i = 0; i < h; ++i){
+            for(j = 0; j < w; ++j){
+                int out_index = j + w*(i + h*(k + c*b));
+                float max = -FLT_MAX;
+                int max_i = -1;
+                for(n = 0; n < l.size; ++n){
+                    for(m = 0; m < l.size; ++m){
+                        int cur_h = h_offset + i*l.stride + n;
+                        int cur_w = w_offset + j*l.stride + m;
+                        int index = cur_w + l.w*(cur_h + l.h*(k + b*l.c));
+                        int valid = (cur_h >= 0 && cur_h < l.h &&
+                                     cur_w >= 0 && cur_w < l.w);
+                        float val = (valid != 0) ? input[index] : -FLT_MAX;
+                        max_i = (val > max) ? index : max_i;
+                        max   = (val > max) ? val   : max;
                     }
-                    l.output[out_index] = max;
-                    l.indexes[out_index] = max_i;
                 }
+                l.output[out_index] = max;
+                if(train) l.indexes[out_index] = max_i;
             }
         }
     }
 }
 
+/*
+ * The 2x2 stride-2 pool at inference time, which needs no indexes: the max of each row pair,
+ * then of each pair of columns, four outputs at a time. A window that hangs over the right or
+ * bottom edge of an odd-sized input covers only the pixels inside it.
+ */
+static void forward_maxpool_2x2_planes(void *ctx, int begin, int end)
+{
+    const maxpool_layer l = *((maxpool_args *)ctx)->l;
+    float *input = ((maxpool_args *)ctx)->input;
+    int p,i,j;
+    int pairs = l.w/2;
+
+    for(p = begin; p < end; ++p){
+        const float *in = input + (size_t)p*l.h*l.w;
+        float *out = l.output + (size_t)p*l.out_h*l.out_w;
+        for(i = 0; i < l.out_h; ++i){
+            const float *r0 = in + (size_t)2*i*l.w;
+            const float *r1 = (2*i + 1 < l.h) ? r0 + l.w : r0;
+            float *o = out + (size_t)i*l.out_w;
+            j = 0;
+#ifdef __SSE__
+            for(; j + 4 <= pairs; j += 4){
+                __m128 a = _mm_max_ps(_mm_loadu_ps(r0 + 2*j), _mm_loadu_ps(r1 + 2*j));
+                __m128 b = _mm_max_ps(_mm_loadu_ps(r0 + 2*j + 4), _mm_loadu_ps(r1 + 2*j + 4));
+                __m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+                __m128 odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+                _mm_storeu_ps(o + j, _mm_max_ps(even, odd));
+            }
+#endif
+            for(; j < pairs; ++j){
+                float a = (r0[2*j] > r1[2*j]) ? r0[2*j] : r1[2*j];
+                float b = (r0[2*j+1] > r1[2*j+1]) ? r0[2*j+1] : r1[2*j+1];
+                o[j] = (a > b) ? a : b;
+            }
+            if(l.out_w > pairs) o[pairs] = (r0[2*pairs] > r1[2*pairs]) ? r0[2*pairs] : r1[2*pairs];
+        }
+    }
+}
+
+void forward_maxpool_layer(const maxpool_layer l, network_state state)
+{
+    maxpool_args args;
+    args.l = &l;
+    args.input = state.input;
+    args.train = state.train;
+    if(!state.train && l.size == 2 && l.stride == 2){
+        parallel_for(l.batch*l.c, 1 + (1 << 16)/(l.h*l.w), forward_maxpool_2x2_planes, &args);
+        return;
+    }
+    parallel_for(l.batch*l.c, 1 + (1 << 14)/(l.out_h*l.out_w*l.size*l.size), forward_maxpool_planes, &args);
+}
+
 void backward_maxpool_layer(const maxpool_layer l, network_state state)
 {
     int i;
@@ -0,0 +1,193 @@
+#include "memory_planner.h"
+#include "utils.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MB (1024.*1024.)
+
+/* Layers that, at inference time, only read their input (and the outputs of the layers a route or shortcut names) and write their own output. */
+static int is_plannable(layer l)
+{
+    switch(l.type){
+        case CONVOLUTIONAL:
+        case DECONVOLUTIONAL:
+        case CONNECTED:
+        case LOCAL:
+        case MAXPOOL:
+        case AVGPOOL:
+        case ACTIVE:
+        case BATCHNORM:
+        case NORMALIZATION:
+        case SOFTMAX:
+        case DETECTION:
+        case CROP:
+        case ROUTE:
+        case SHORTCUT:
+        case DROPOUT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void release_buffer(float **p, size_t *bytes)
+{
+    if(!*p) return;
+    *bytes += malloc_usable_size(*p);
+    free(*p);
+    *p = 0;
+}
+
+size_t release_training_buffers(layer *l)
+{
+    size_t bytes = 0;
+    release_buffer(&l->delta, &bytes);
+    release_buffer(&l->filter_updates, &bytes);
+    release_buffer(&l->weight_updates, &bytes);
+    release_buffer(&l->bias_updates, &bytes);
+    release_buffer(&l->scale_updates, &bytes);
+    release_buffer(&l->mean, &bytes);
+    release_buffer(&l->variance, &bytes);
+    release_buffer(&l->mean_delta, &bytes);
+    release_buffer(&l->variance_delta, &bytes);
+    release_buffer(&l->x, &bytes);
+    release_buffer(&l->x_norm, &bytes);
+    /* Maxpool layers only record where each maximum came from when training. */
+    if(l->indexes){
+        bytes += malloc_usable_size(l->indexes);
+        free(l->indexes);
+        l->indexes = 0;
+    }
+    return bytes;
+}
+
+static void mark_read(int *last_read, const int *owner, int buffer_layer, int reader)
+{
+    int b = owner[buffer_layer];
+    if(b >= 0 && reader > last_read[b]) last_read[b] = reader;
+}
+
+void plan_inference_memory(network *net)
+{
+#ifdef WITH_CUDA
+    if(gpu_index >= 0){
+        fprintf(stderr, "Activation memory planning is only supported on the CPU\n");
+        return;
+    }
+#endif
+    if(net->activation_arenas) return;
+
+    int n = net->n;
+    int *owner = calloc(n, sizeof(int));
+    int *last_read = calloc(n, sizeof(int));
+    int *arena_of = calloc(n, sizeof(int));
+    size_t *arena_size = calloc(n, sizeof(size_t));
+    int *arena_holder = calloc(n, sizeof(int));
+    if(!owner || !last_read || !arena_of || !arena_size || !arena_holder) malloc_error();
+    int arena_count = 0;
+    int i, j, a;
+
+    /* A dropout layer passes its input through, so it shares the buffer of the layer before it. Unplannable layers keep their own. */
+    for(i = 0; i < n; ++i){
+        layer l = net->layers[i];
+        if(l.type == DROPOUT && i > 0) owner[i] = owner[i-1];
+        else if(is_plannable(l) && l.type != DROPOUT) owner[i] = i;
+        else owner[i] = -1;
+        last_read[i] = i;
+    }
+
+    /* Each layer reads the output of the one before it; routes and shortcuts also read the layers they name. */
+    for(i = 0; i < n; ++i){
+        layer l = net->layers[i];
+        if(i > 0) mark_read(last_read, owner, i-1, i);
+        if(l.type == ROUTE){
+            for(j = 0; j < l.n; ++j) mark_read(last_read, owner, l.input_layers[j], i);
+        } else if(l.type == SHORTCUT){
+            mark_read(last_read, owner, l.index, i);
+        }
+    }
+
+    /* The caller reads the network output once the forward pass is done. */
+    for(i = n-1; i > 0; --i) if(net->layers[i].type != COST) break;
+    mark_read(last_read, owner, i, n);
+    mark_read(last_read, owner, n-1, n);
+
+    /* Walk the layers in order, returning an arena once its output is dead and handing each new output the best-fitting free arena. */
+    size_t before = 0;
+    for(a = 0; a < n; ++a) arena_holder[a] = -1;
+    for(i = 0; i < n; ++i){
+        for(a = 0; a < arena_count; ++a){
+            int h = arena_holder[a];
+            if(h >= 0 && last_read[h] < i) arena_holder[a] = -1;
+        }
+        if(owner[i] != i) continue;
+
+        layer l = net->layers[i];
+        int batch = (net->allocated_batch > l.batch) ? net->allocated_batch : l.batch;
+        size_t size = (size_t)l.outputs*batch;
+        before += size*sizeof(float);
+
+        int fit = -1, largest = -1;
+        for(a = 0; a < arena_count; ++a){
+            if(arena_holder[a] >= 0) continue;
+            if(arena_size[a] >= size && (fit < 0 || arena_size[a] < arena_size[fit])) fit = a;
+            if(largest < 0 || arena_size[a] > arena_size[largest]) largest = a;
+        }
+        int best = (fit >= 0) ? fit : largest;
+        if(best < 0) best = arena_count++;
+        if(arena_size[best] < size) arena_size[best] = size;
+        arena_holder[best] = i;
+        arena_of[i] = best;
+    }
+
+    net->activation_arenas = calloc(arena_count, sizeof(float *));
+    if(arena_count && !net->activation_arenas) malloc_error();
+    net->activation_arena_count = arena_count;
+    size_t after = 0;
+    for(a = 0; a < arena_count; ++a){
+        net->activation_arenas[a] = calloc(arena_size[a], sizeof(float));
+        if(!net->activation_arenas[a]) malloc_error();
+        after += arena_size[a]*sizeof(float);
+    }
+
+    size_t released = 0;
+    for(i = 0; i < n; ++i){
+        layer *l = &net->layers[i];
+        if(owner[i] == i){
+            released += release_training_buffers(l);
+            free(l->output);
+            l->output = net->activation_arenas[arena_of[i]];
+        } else if(owner[i] >= 0){
+            l->output = net->layers[owner[i]].output;
+            l->delta = 0;
+        }
+    }
+    net->output = get_network_output(*net);
+
+    fprintf(stderr, "Activation memory: %.1f MB before planning (%.1f MB of outputs, %.1f MB of training buffers), %.1f MB after in %d arenas\n",
+            (before + released)/MB, before/MB, released/MB, after/MB, arena_count);
+
+    free(owner);
+    free(last_read);
+    free(arena_of);
+    free(arena_size);
+    free(arena_holder);
+}
+
+void release_activation_arenas(network *net)
+{
+    int i, a;
+    if(!net->activation_arenas) return;
+    for(i = 0; i < net->n; ++i){
+        layer *l = &net->layers[i];
+        for(a = 0; a < net->activation_arena_count; ++a){
+            if(l->output == net->activation_arenas[a]) l->output = 0;
+        }
+    }
+    for(a = 0; a < net->activation_arena_count; ++a) free(net->activation_arenas[a]);
+    free(net->activation_arenas);
+    net->activation_arenas = 0;
+    net->activation_arena_count = 0;
+}
@@ -24,6 +24,10 @@
 #include "dropout_layer.h"
 #include "route_layer.h"
 #include "shortcut_layer.h"
+#include "weights_file.h"
+#include "memory_planner.h"
+#include "resolution_plan.h"
+#include "profiler.h"
 
 int get_current_batch(network net)
 {
@@ -135,56 +139,63 @@ network make_network(int n)
     return net;
 }
 
+void forward_network_layer(network net, network_state state, int i)
+{
+    state.index = i;
+    layer l = net.layers[i];
+    if(l.delta){
+        scal_cpu(l.outputs * l.batch, 0, l.delta, 1);
+    }
+    if(l.type == CONVOLUTIONAL){
+        forward_convolutional_layer(l, state);
+    } else if(l.type == DECONVOLUTIONAL){
+        forward_deconvolutional_layer(l, state);
+    } else if(l.type == ACTIVE){
+        forward_activation_layer(l, state);
+    } else if(l.type == LOCAL){
+        forward_local_layer(l, state);
+    } else if(l.type == NORMALIZATION){
+        forward_normalization_layer(l, state);
+    } else if(l.type == BATCHNORM){
+        forward_batchnorm_layer(l, state);
+    } else if(l.type == DETECTION){
+        forward_detection_layer(l, state);
+    } else if(l.type == CONNECTED){
+        forward_connected_layer(l, state);
+    } else if(l.type == RNN){
+        forward_rnn_layer(l, state);
+    } else if(l.type == GRU){
+        forward_gru_layer(l, state);
+    } else if(l.type == CRNN){
+        forward_crnn_layer(l, state);
+    } else if(l.type == CROP){
+        forward_crop_layer(l, state);
+    } else if(l.type == COST){
+        forward_cost_layer(l, state);
+    } else if(l.type == SOFTMAX){
+        forward_softmax_layer(l, state);
+    } else if(l.type == MAXPOOL){
+        forward_maxpool_layer(l, state);
+    } else if(l.type == AVGPOOL){
+        forward_avgpool_layer(l, state);
+    } else if(l.type == DROPOUT){
+        forward_dropout_layer(l, state);
+    } else if(l.type == ROUTE){
+        forward_route_layer(l, net);
+    } else if(l.type == SHORTCUT){
+        forward_shortcut_layer(l, state);
+    }
+}
+
 void forward_network(network net, network_state state)
 {
     state.workspace = net.workspace;
     int i;
     for(i = 0; i < net.n; ++i){
-        state.index = i;
-        layer l = net.layers[i];
-        if(l.delta){
-            scal_cpu(l.outputs * l.batch, 0, l.delta, 1);
-        }
-        if(l.type == CONVOLUTIONAL){
-            forward_convolutional_layer(l, state);
-        } else if(l.type == DECONVOLUTIONAL){
-            forward_deconvolutional_layer(l, state);
-        } else if(l.type == ACTIVE){
-            forward_activation_layer(l, state);
-        } else if(l.type == LOCAL){
-            forward_local_layer(l, state);
-        } else if(l.type == NORMALIZATION){
-            forward_normalization_layer(l, state);
-        } else if(l.type == BATCHNORM){
-            forward_batchnorm_layer(l, state);
-        } else if(l.type == DETECTION){
-            forward_detection_layer(l, state);
-        } else if(l.type == CONNECTED){
-            forward_connected_layer(l, state);
-        } else if(l.type == RNN){
-            forward_rnn_layer(l, state);
-        } else if(l.type == GRU){
-            forward_gru_layer(l, state);
-        } else if(l.type == CRNN){
-            forward_crnn_layer(l, state);
-        } else if(l.type == CROP){
-            forward_crop_layer(l, state);
-        } else if(l.type == COST){
-            forward_cost_layer(l, state);
-        } else if(l.type == SOFTMAX){
-            forward_softmax_layer(l, state);
-        } else if(l.type == MAXPOOL){
-            forward_maxpool_layer(l, state);
-        } else if(l.type == AVGPOOL){
-            forward_avgpool_layer(l, state);
-        } else if(l.type == DROPOUT){
-            forward_dropout_layer(l, state);
-        } else if(l.type == ROUTE){
-            forward_route_layer(l, net);
-        } else if(l.type == SHORTCUT){
-            forward_shortcut_layer(l, state);
-        }
-        state.input = l.output;
+        double start = net.profile ? profile_layer_start() : 0;
+        forward_network_layer(net, state, i);
+        if(net.profile) profile_layer_end(net, i, PROFILE_FORWARD, start);
+        state.input = net.layers[i].output;
     }
 }
 
@@ -195,6 +206,7 @@ void update_network(network net)
     float rate = get_current_rate(net);
     for(i = 0; i < net.n; ++i){
         layer l = net.layers[i];
+        double start = net.profile ? profile_layer_start() : 0;
         if(l.type == CONVOLUTIONAL){
             update_convolutional_layer(l, update_batch, rate, net.momentum, net.decay);
         } else if(l.type == DECONVOLUTIONAL){
@@ -210,6 +222,7 @@ void update_network(network net)
         } else if(l.type == LOCAL){
             update_local_layer(l, update_batch, rate, net.momentum, net.decay);
         }
+        if(net.profile) profile_layer_end(net, i, PROFILE_UPDATE, start);
     }
 }
 
@@ -265,6 +278,7 @@ void backward_network(network net, network_state state)
             state.delta = prev.delta;
         }
         layer l = net.layers[i];
+        double start = net.profile ? profile_layer_start() : 0;
         if(l.type == CONVOLUTIONAL){
             backward_convolutional_layer(l, state);
         } else if(l.type == DECONVOLUTIONAL){
@@ -302,6 +316,7 @@ void backward_network(network net, network_state state)
         } else if(l.type == SHORTCUT){
             backward_shortcut_layer(l, state);
         }
+        if(net.profile) profile_layer_end(net, i, PROFILE_BACKWARD, start);
     }
 }
 
@@ -392,8 +407,33 @@ float train_network_batch(network net, data d, int n)
 }
 */
 
+void fold_batchnorm_network(network *net)
+{
+    int i;
+    free_resolution_plans(net);
+    for(i = 0; i < net->n; ++i){
+        layer *l = &net->layers[i];
+        if(!l->batch_normalize || l->quantized) continue;
+        if(l->type == CONVOLUTIONAL){
+            denormalize_convolutional_layer(*l);
+#ifdef WITH_CUDA
+            if(gpu_index >= 0) push_convolutional_layer(*l);
+#endif
+        } else if(l->type == CONNECTED){
+            denormalize_connected_layer(*l);
+#ifdef WITH_CUDA
+            if(gpu_index >= 0) push_connected_layer(*l);
+#endif
+        } else {
+            continue;
+        }
+        l->batch_normalize = 0;
+    }
+}
+
 void set_batch_network(network *net, int b)
 {
+    if(net->allocated_batch && b > net->allocated_batch) error("Batch size exceeds the batch the network buffers were allocated for");
     net->batch = b;
     int i;
     for(i = 0; i < net->n; ++i){
@@ -410,6 +450,8 @@ int resize_network(network *net, int w, int h)
 {
     int i;
     //if(w == net->w && h == net->h) return 0;
+    if(net->activation_arenas) error("Cannot resize a network whose activation memory has been planned");
+    free_resolution_plans(net);
     net->w = w;
     net->h = h;
     int inputs = 0;
@@ -447,6 +489,7 @@ int resize_network(network *net, int w, int h)
         free(net->workspace);
         net->workspace = calloc(1, workspace_size);
 #endif
+    net->allocated_batch = net->batch;
     //fprintf(stderr, " Done!\n");
     return 0;
 }
@@ -667,6 +710,10 @@ float network_accuracy_multi(network net, data d, int n)
 void free_network(network net)
 {
     int i;
+    release_mapped_weights(&net);
+    free_resolution_plans(&net);
+    release_activation_arenas(&net);
+    disable_network_profiling(&net);
     for(i = 0; i < net.n; ++i){
         free_layer(net.layers[i]);
     }
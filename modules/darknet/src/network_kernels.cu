@@ -33,6 +33,7 @@ extern "C" {
 #include "route_layer.h"
 #include "shortcut_layer.h"
 #include "blas.h"
+#include "profiler.h"
 }
 
 float * get_network_output_gpu_layer(network net, int i);
@@ -46,6 +47,7 @@ void forward_network_gpu(network net, network_state state)
     for(i = 0; i < net.n; ++i){
         state.index = i;
         layer l = net.layers[i];
+        double start = net.profile ? profile_layer_start() : 0;
         if(l.delta_gpu){
             fill_ongpu(l.outputs * l.batch, 0, l.delta_gpu, 1);
         }
@@ -88,6 +90,7 @@ void forward_network_gpu(network net, network_state state)
         } else if(l.type == SHORTCUT){
             forward_shortcut_layer_gpu(l, state);
         }
+        if(net.profile) profile_layer_end(net, i, PROFILE_FORWARD, start);
         state.input = l.output_gpu;
     }
 }
@@ -101,6 +104,7 @@ void backward_network_gpu(network net, network_state state)
     for(i = net.n-1; i >= 0; --i){
         state.index = i;
         layer l = net.layers[i];
+        double start = net.profile ? profile_layer_start() : 0;
         if(i == 0){
             state.input = original_input;
             state.delta = original_delta;
@@ -146,6 +150,7 @@ void backward_network_gpu(network net, network_state state)
         } else if(l.type == SHORTCUT){
             backward_shortcut_layer_gpu(l, state);
         }
+        if(net.profile) profile_layer_end(net, i, PROFILE_BACKWARD, start);
     }
 }
 
@@ -156,6 +161,7 @@ void update_network_gpu(network net)
     float rate = get_current_rate(net);
     for(i = 0; i < net.n; ++i){
         layer l = net.layers[i];
+        double start = net.profile ? profile_layer_start() : 0;
         if(l.type == CONVOLUTIONAL){
             update_convolutional_layer_gpu(l, update_batch, rate, net.momentum, net.decay);
         } else if(l.type == DECONVOLUTIONAL){
@@ -171,6 +177,7 @@ void update_network_gpu(network net)
         } else if(l.type == LOCAL){
             update_local_layer_gpu(l, update_batch, rate, net.momentum, net.decay);
         }
+        if(net.profile) profile_layer_end(net, i, PROFILE_UPDATE, start);
     }
 }
 
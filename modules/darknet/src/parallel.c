@@ -0,0 +1,231 @@
+#include "parallel.h"
+#include "utils.h"
+#include <stdlib.h>
+
+#ifdef _MSC_VER
+
+void set_cpu_threads(int n)
+{
+}
+
+int get_cpu_threads()
+{
+    return 1;
+}
+
+void parallel_for(int n, int grain, parallel_fn fn, void *ctx)
+{
+    if(n > 0) fn(ctx, 0, n);
+}
+
+#else
+
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/*
+ * A persistent pool of worker threads. Each parallel_for publishes one job,
+ * bumps the generation counter and wakes the workers; worker i runs range i
+ * of the job while the caller runs range 0, then the caller waits for the
+ * pending count to drop to zero.
+ */
+typedef struct{
+    pthread_t *threads;
+    int nthreads;
+    int requested;
+
+    pthread_mutex_t submit;
+    pthread_mutex_t mutex;
+    pthread_cond_t work;
+    pthread_cond_t done;
+
+    parallel_fn fn;
+    void *ctx;
+    int n;
+    int active;
+    int pending;
+    unsigned generation;
+    int quit;
+} thread_pool;
+
+static thread_pool pool = {0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static __thread int in_parallel_region = 0;
+
+static void run_range(int id)
+{
+    int begin = (int)((long long)pool.n*id/pool.active);
+    int end = (int)((long long)pool.n*(id+1)/pool.active);
+    if(begin < end) pool.fn(pool.ctx, begin, end);
+}
+
+static void *parallel_worker(void *arg)
+{
+    int id = (int)(size_t)arg;
+    unsigned seen = 0;
+    in_parallel_region = 1;
+
+    pthread_mutex_lock(&pool.mutex);
+    for(;;){
+        while(pool.generation == seen && !pool.quit) pthread_cond_wait(&pool.work, &pool.mutex);
+        if(pool.quit) break;
+        seen = pool.generation;
+        if(id < pool.active){
+            pthread_mutex_unlock(&pool.mutex);
+            run_range(id);
+            pthread_mutex_lock(&pool.mutex);
+            if(--pool.pending == 0) pthread_cond_signal(&pool.done);
+        }
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    return 0;
+}
+
+static void stop_workers()
+{
+    int i;
+    if(!pool.threads) return;
+    pthread_mutex_lock(&pool.mutex);
+    pool.quit = 1;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.mutex);
+    for(i = 1; i < pool.nthreads; ++i) pthread_join(pool.threads[i], 0);
+    free(pool.threads);
+    pool.threads = 0;
+    pool.nthreads = 0;
+    pool.quit = 0;
+}
+
+static void start_workers(int n)
+{
+    int i;
+    pool.threads = calloc(n, sizeof(pthread_t));
+    pool.nthreads = n;
+    pool.generation = 0;
+    /* Slot 0 is the calling thread. */
+    for(i = 1; i < n; ++i){
+        if(pthread_create(&pool.threads[i], 0, parallel_worker, (void *)(size_t)i)) error("Thread creation failed");
+    }
+}
+
+void set_cpu_threads(int n)
+{
+    pthread_mutex_lock(&pool.submit);
+    if(n != pool.requested){
+        stop_workers();
+        pool.requested = n;
+    }
+    pthread_mutex_unlock(&pool.submit);
+}
+
+static int read_cpu_topology(int cpu, const char *name)
+{
+    char path[128];
+    int value = -1;
+    FILE *file;
+    sprintf(path, "/sys/devices/system/cpu/cpu%d/%s", cpu, name);
+    file = fopen(path, "r");
+    if(!file) return -1;
+    if(fscanf(file, "%d", &value) != 1) value = -1;
+    fclose(file);
+    return value;
+}
+
+/*
+ * Counts the physical cores of the online processors, as the distinct
+ * (package, core) pairs in sysfs, or returns 0 if the topology is not
+ * available. The layers are bound by the FMA units, which hyperthreads on the
+ * same core share, so a second thread per core only adds contention.
+ */
+static int count_physical_cores()
+{
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    int *packages, *cores;
+    int i, j, n = 0;
+    if(cpus <= 0) return 0;
+    packages = calloc(cpus, sizeof(int));
+    cores = calloc(cpus, sizeof(int));
+    if(!packages || !cores) malloc_error();
+    for(i = 0; i < cpus; ++i){
+        int package, core;
+        /* cpu0 usually cannot be taken offline, so it has no online file. */
+        if(read_cpu_topology(i, "online") == 0) continue;
+        package = read_cpu_topology(i, "topology/physical_package_id");
+        core = read_cpu_topology(i, "topology/core_id");
+        if(package < 0 || core < 0){
+            n = 0;
+            break;
+        }
+        for(j = 0; j < n; ++j) if(packages[j] == package && cores[j] == core) break;
+        if(j == n){
+            packages[n] = package;
+            cores[n] = core;
+            ++n;
+        }
+    }
+    free(packages);
+    free(cores);
+    return n;
+}
+
+static int default_threads = 0;
+static pthread_once_t default_threads_once = PTHREAD_ONCE_INIT;
+
+static void find_default_threads()
+{
+    default_threads = count_physical_cores();
+    if(default_threads <= 0){
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        default_threads = n > 0 ? (int)n : 1;
+    }
+}
+
+int get_cpu_threads()
+{
+    if(pool.requested > 0) return pool.requested;
+    pthread_once(&default_threads_once, find_default_threads);
+    return default_threads;
+}
+
+void parallel_for(int n, int grain, parallel_fn fn, void *ctx)
+{
+    int threads, active;
+    if(n <= 0) return;
+    if(grain < 1) grain = 1;
+
+    threads = get_cpu_threads();
+    active = (n + grain - 1)/grain;
+    if(active > threads) active = threads;
+    if(active <= 1 || in_parallel_region || pthread_mutex_trylock(&pool.submit)){
+        fn(ctx, 0, n);
+        return;
+    }
+
+    if(pool.nthreads != threads){
+        stop_workers();
+        start_workers(threads);
+    }
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.n = n;
+    pool.active = active;
+    pool.pending = active - 1;
+    ++pool.generation;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.mutex);
+
+    in_parallel_region = 1;
+    run_range(0);
+    in_parallel_region = 0;
+
+    pthread_mutex_lock(&pool.mutex);
+    while(pool.pending) pthread_cond_wait(&pool.done, &pool.mutex);
+    pthread_mutex_unlock(&pool.mutex);
+
+    pthread_mutex_unlock(&pool.submit);
+}
+
+#endif
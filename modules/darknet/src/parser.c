@@ -25,7 +25,10 @@
 #include "shortcut_layer.h"
 #include "list.h"
 #include "option_list.h"
+#include "parallel.h"
 #include "utils.h"
+#include "weights_file.h"
+#include "winograd.h"
 
 typedef struct{
     char *type;
@@ -465,6 +468,7 @@ void parse_net_options(list *options, network *net)
     net->inputs = option_find_int_quiet(options, "inputs", net->h * net->w * net->c);
     net->max_crop = option_find_int_quiet(options, "max_crop",net->w*2);
     net->min_crop = option_find_int_quiet(options, "min_crop",net->w);
+    net->quantize = option_find_int_quiet(options, "quantize", 0);
 
     if(!net->inputs && !(net->h && net->w && net->c)) error("No input parameters supplied");
 
@@ -507,6 +511,9 @@ void parse_net_options(list *options, network *net)
         net->power = option_find_float(options, "power", 1);
     }
     net->max_batches = option_find_int(options, "max_batches", 0);
+
+    int threads = option_find_int_quiet(options, "threads", 0);
+    if(threads) set_cpu_threads(threads);
 }
 
 network parse_network_cfg(char *filename)
@@ -521,6 +528,7 @@ network parse_network_cfg(char *filename)
     list *options = s->options;
     if(!is_network(s)) error("First section must be [net] or [network]");
     parse_net_options(options, &net);
+    net.allocated_batch = net.batch;
 
     params.h = net.h;
     params.w = net.w;
@@ -1049,6 +1057,7 @@ void load_convolutional_weights(layer l, FILE *fp)
     if (l.flipped) {
         transpose_matrix(l.filters, l.c*l.size*l.size, l.n);
     }
+    transform_winograd_filters(l);
     //if (l.binary) binarize_filters(l.filters, l.n, l.c*l.size*l.size, l.filters);
 #ifdef WITH_CUDA
     if(gpu_index >= 0){
@@ -1060,6 +1069,11 @@ void load_convolutional_weights(layer l, FILE *fp)
 
 void load_weights_upto(network *net, char *filename, int cutoff)
 {
+    if(is_mapped_weights_file(filename)){
+        load_mapped_weights_upto(net, filename, cutoff);
+        return;
+    }
+
     fprintf(stderr, "Loading weights from %s...", filename);
     fflush(stdout);
     FILE *fp = fopen(filename, "rb");
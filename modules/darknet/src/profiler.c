@@ -0,0 +1,256 @@
+#include "profiler.h"
+#include "cuda.h"
+#include "resolution_plan.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROFILE_PHASES 3
+#define MAX_PROFILE_EVENTS (1 << 20)
+
+static const char *phase_names[PROFILE_PHASES] = {"forward", "backward", "update"};
+
+static void synchronize_device()
+{
+#ifdef WITH_CUDA
+    if(gpu_index >= 0) check_error(cudaDeviceSynchronize());
+#endif
+}
+
+void enable_network_profiling(network *net)
+{
+    if(net->profile) return;
+    network_profile *p = calloc(1, sizeof(network_profile));
+    if(!p) malloc_error();
+    p->n = net->n;
+    p->calls = calloc(PROFILE_PHASES*net->n, sizeof(int));
+    p->seconds = calloc(PROFILE_PHASES*net->n, sizeof(double));
+    p->flops = calloc(PROFILE_PHASES*net->n, sizeof(double));
+    if(!p->calls || !p->seconds || !p->flops) malloc_error();
+    p->origin = what_time_is_it_now();
+    net->profile = p;
+
+    /* Plans made from now on pick up profiling when they are built; the existing ones start here. */
+    resolution_plan *plan;
+    for(plan = net->resolution_plans; plan; plan = plan->next){
+        enable_network_profiling(&plan->net);
+        plan->net.profile->origin = p->origin;
+    }
+}
+
+void disable_network_profiling(network *net)
+{
+    network_profile *p = net->profile;
+    if(!p) return;
+    resolution_plan *plan;
+    for(plan = net->resolution_plans; plan; plan = plan->next) disable_network_profiling(&plan->net);
+    free(p->calls);
+    free(p->seconds);
+    free(p->flops);
+    free(p->events);
+    free(p);
+    net->profile = 0;
+}
+
+void reset_network_profile(network *net)
+{
+    network_profile *p = net->profile;
+    if(!p) return;
+    int i;
+    for(i = 0; i < PROFILE_PHASES*p->n; ++i){
+        p->calls[i] = 0;
+        p->seconds[i] = 0;
+        p->flops[i] = 0;
+    }
+    p->event_count = 0;
+    p->origin = what_time_is_it_now();
+
+    resolution_plan *plan;
+    for(plan = net->resolution_plans; plan; plan = plan->next){
+        reset_network_profile(&plan->net);
+        if(plan->net.profile) plan->net.profile->origin = p->origin;
+    }
+}
+
+/* The number of weights the layer multiplies its input by. */
+static double layer_weights(layer l)
+{
+    switch(l.type){
+        case CONVOLUTIONAL:
+        case DECONVOLUTIONAL:
+            return (double)l.n*l.c*l.size*l.size;
+        case LOCAL:
+            return (double)l.out_h*l.out_w*l.n*l.c*l.size*l.size;
+        case CONNECTED:
+            return (double)l.inputs*l.outputs;
+        default:
+            return 0;
+    }
+}
+
+/* Floating-point operations in one forward pass over the batch, counting a multiply-add as two. */
+static double layer_forward_flops(layer l)
+{
+    switch(l.type){
+        case CONVOLUTIONAL:
+        case LOCAL:
+            return 2.*l.out_h*l.out_w*l.n*l.c*l.size*l.size*l.batch;
+        case DECONVOLUTIONAL:
+            return 2.*l.h*l.w*l.c*l.n*l.size*l.size*l.batch;
+        case CONNECTED:
+            return 2.*l.inputs*l.outputs*l.batch;
+        case MAXPOOL:
+            return (double)l.outputs*l.size*l.size*l.batch;
+        default:
+            return (double)l.outputs*l.batch;
+    }
+}
+
+/*
+ * Estimated FLOPs and bytes of memory traffic for one call of a layer in each phase.
+ * The backward pass of a layer with weights computes both the input and the weight gradients
+ * (twice the forward work); the update reads and writes the weights and their updates.
+ */
+static void layer_cost(layer l, profile_phase phase, double *flops, double *bytes)
+{
+    double weights = layer_weights(l);
+    double weight_bytes = l.quantized ? weights : 4*weights;
+    double forward_flops = layer_forward_flops(l);
+    double forward_bytes = 4.*(l.inputs + l.outputs)*l.batch + weight_bytes;
+    switch(phase){
+        case PROFILE_FORWARD:
+            *flops = forward_flops;
+            *bytes = forward_bytes;
+            break;
+        case PROFILE_BACKWARD:
+            *flops = weights ? 2*forward_flops : forward_flops;
+            *bytes = 2*forward_bytes;
+            break;
+        case PROFILE_UPDATE:
+            *flops = 5*weights;
+            *bytes = 16*weights;
+            break;
+    }
+}
+
+double profile_layer_start()
+{
+    synchronize_device();
+    return what_time_is_it_now();
+}
+
+void profile_layer_end(network net, int i, profile_phase phase, double start)
+{
+    network_profile *p = net.profile;
+    synchronize_device();
+    double duration = what_time_is_it_now() - start;
+    if(i >= p->n) return;
+    double flops, bytes;
+    layer_cost(net.layers[i], phase, &flops, &bytes);
+    p->calls[phase*p->n + i] += 1;
+    p->seconds[phase*p->n + i] += duration;
+    p->flops[phase*p->n + i] += flops;
+
+    /* The trace keeps the first MAX_PROFILE_EVENTS layer runs; the totals keep counting after that. */
+    if(p->event_count == p->event_capacity){
+        if(p->event_capacity >= MAX_PROFILE_EVENTS) return;
+        int capacity = p->event_capacity ? 2*p->event_capacity : 1024;
+        profile_event *events = realloc(p->events, capacity*sizeof(profile_event));
+        if(!events) malloc_error();
+        p->events = events;
+        p->event_capacity = capacity;
+    }
+    profile_event *e = &p->events[p->event_count++];
+    e->layer = i;
+    e->phase = phase;
+    e->batch = net.layers[i].batch;
+    e->start = start - p->origin;
+    e->duration = duration;
+}
+
+static void print_profile_table(network net, FILE *fp)
+{
+    network_profile *p = net.profile;
+    int i, phase;
+    double total = 0;
+    for(i = 0; i < PROFILE_PHASES*p->n; ++i) total += p->seconds[i];
+
+    fprintf(fp, "%5s %-14s %-16s %10s %10s %10s %10s %10s %9s %7s\n",
+            "layer", "type", "output", "fwd ms", "bwd ms", "upd ms", "fwd MFLOP", "fwd MB", "GFLOP/s", "time");
+    double total_flops = 0;
+    for(i = 0; i < p->n && i < net.n; ++i){
+        layer l = net.layers[i];
+        double ms[PROFILE_PHASES];
+        double seconds = 0, flops = 0;
+        double forward_flops = 0, forward_bytes = 0;
+        for(phase = 0; phase < PROFILE_PHASES; ++phase){
+            int calls = p->calls[phase*p->n + i];
+            ms[phase] = calls ? 1000*p->seconds[phase*p->n + i]/calls : 0;
+            seconds += p->seconds[phase*p->n + i];
+            flops += p->flops[phase*p->n + i];
+        }
+        layer_cost(l, PROFILE_FORWARD, &forward_flops, &forward_bytes);
+        total_flops += flops;
+        char shape[32];
+        snprintf(shape, sizeof(shape), "%d x %d x %d", l.out_w, l.out_h, l.out_c);
+        fprintf(fp, "%5d %-14s %-16s %10.3f %10.3f %10.3f %10.1f %10.1f %9.1f %6.1f%%\n",
+                i, get_layer_string(l.type), shape, ms[PROFILE_FORWARD], ms[PROFILE_BACKWARD], ms[PROFILE_UPDATE],
+                forward_flops/1e6, forward_bytes/(1024.*1024.), seconds ? flops/seconds/1e9 : 0, total ? 100*seconds/total : 0);
+    }
+    fprintf(fp, "Total: %.3f ms, %.1f GFLOP/s\n", 1000*total, total ? total_flops/total/1e9 : 0);
+}
+
+void print_network_profile(network net, FILE *fp)
+{
+    if(!net.profile) return;
+    print_profile_table(net, fp);
+
+    /* The plans that were run follow, one table per input resolution. */
+    resolution_plan *plan;
+    for(plan = net.resolution_plans; plan; plan = plan->next){
+        if(!plan->net.profile || !plan->net.profile->event_count) continue;
+        fprintf(fp, "\n%d x %d input:\n", plan->w, plan->h);
+        print_profile_table(plan->net, fp);
+    }
+}
+
+/* Writes the events of a network as the Chrome trace thread tid, separating them from the events written before. */
+static void write_trace_events(network net, int tid, FILE *fp, int *written)
+{
+    network_profile *p = net.profile;
+    int i;
+    for(i = 0; i < p->event_count; ++i){
+        profile_event e = p->events[i];
+        layer l = net.layers[e.layer];
+        l.batch = e.batch;
+        double flops, bytes;
+        layer_cost(l, e.phase, &flops, &bytes);
+        fprintf(fp, "%s{\"name\":\"%d %s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                "\"args\":{\"layer\":%d,\"output\":\"%d x %d x %d\",\"batch\":%d,\"flops\":%.0f,\"bytes\":%.0f}}\n",
+                (*written)++ ? "," : "", e.layer, get_layer_string(l.type), phase_names[e.phase], tid, 1e6*e.start, 1e6*e.duration,
+                e.layer, l.out_w, l.out_h, l.out_c, l.batch, flops, bytes);
+    }
+}
+
+void save_network_profile_trace(network net, const char *filename)
+{
+    if(!net.profile) return;
+    FILE *fp = fopen(filename, "w");
+    if(!fp) file_error((char *)filename);
+    int written = 0;
+    fprintf(fp, "{\"traceEvents\":[\n");
+    write_trace_events(net, 0, fp, &written);
+
+    /* Each plan gets a track of its own, named after its input resolution. */
+    int tid = 1;
+    resolution_plan *plan;
+    for(plan = net.resolution_plans; plan; plan = plan->next, ++tid){
+        if(!plan->net.profile || !plan->net.profile->event_count) continue;
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%d x %d\"}}\n",
+                written++ ? "," : "", tid, plan->w, plan->h);
+        write_trace_events(plan->net, tid, fp, &written);
+    }
+    fprintf(fp, "],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(fp);
+}
@@ -0,0 +1,584 @@
+#include "quantize.h"
+#include "activations.h"
+#include "convolutional_layer.h"
+#include "parallel.h"
+#include "resolution_plan.h"
+#include "utils.h"
+#include "cuda.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INT8_X86
+#include <immintrin.h>
+#endif
+
+/* Rows of int8 weights and columns are padded with zeros to a whole number of SIMD registers. */
+#define INT8_ALIGN 32
+#define INT8_MAX_VALUE 127
+
+/* An int8 GEMM task covers INT8_MC weight rows and INT8_NC columns, so its weights stay in L2. */
+#define INT8_MC 32
+#define INT8_NC 64
+
+typedef int (*int8_dot_kernel)(int k, const signed char *w, const signed char *x);
+typedef void (*int8_dot4_kernel)(int k, const signed char *w, const signed char *x, int ldx, int *out);
+
+typedef struct{
+    const char *name;
+    int8_dot_kernel dot;
+    int8_dot4_kernel dot4;
+} int8_kernel;
+
+static int int8_dot_c(int k, const signed char *w, const signed char *x)
+{
+    int s = 0;
+    int i;
+    for(i = 0; i < k; ++i) s += w[i]*x[i];
+    return s;
+}
+
+static void int8_dot4_c(int k, const signed char *w, const signed char *x, int ldx, int *out)
+{
+    int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i;
+    for(i = 0; i < k; ++i){
+        int wi = w[i];
+        s0 += wi*x[i];
+        s1 += wi*x[i + ldx];
+        s2 += wi*x[i + 2*ldx];
+        s3 += wi*x[i + 3*ldx];
+    }
+    out[0] = s0;
+    out[1] = s1;
+    out[2] = s2;
+    out[3] = s3;
+}
+
+#ifdef INT8_X86
+
+/*
+ * maddubs and dpbusd multiply unsigned by signed bytes, so the products
+ * w*x are formed as |w| * (x*sign(w)). Neither operand is ever -128, so
+ * maddubs cannot saturate: each pair sums to at most 2*127*127.
+ */
+
+__attribute__((target("avx2")))
+static inline int int8_hsum_avx2(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+static int int8_dot_avx2(int k, const signed char *w, const signed char *x)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    int i;
+    for(i = 0; i < k; i += 32){
+        __m256i wv = _mm256_loadu_si256((const __m256i *)(w + i));
+        __m256i xv = _mm256_loadu_si256((const __m256i *)(x + i));
+        __m256i p = _mm256_maddubs_epi16(_mm256_sign_epi8(wv, wv), _mm256_sign_epi8(xv, wv));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(p, ones));
+    }
+    return int8_hsum_avx2(acc);
+}
+
+__attribute__((target("avx2")))
+static void int8_dot4_avx2(int k, const signed char *w, const signed char *x, int ldx, int *out)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+    int i;
+    for(i = 0; i < k; i += 32){
+        __m256i wv = _mm256_loadu_si256((const __m256i *)(w + i));
+        __m256i aw = _mm256_sign_epi8(wv, wv);
+#define INT8_AVX2_ACCUMULATE(acc, r) \
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(aw, \
+                    _mm256_sign_epi8(_mm256_loadu_si256((const __m256i *)(x + (r)*ldx + i)), wv)), ones));
+        INT8_AVX2_ACCUMULATE(acc0, 0)
+        INT8_AVX2_ACCUMULATE(acc1, 1)
+        INT8_AVX2_ACCUMULATE(acc2, 2)
+        INT8_AVX2_ACCUMULATE(acc3, 3)
+#undef INT8_AVX2_ACCUMULATE
+    }
+    out[0] = int8_hsum_avx2(acc0);
+    out[1] = int8_hsum_avx2(acc1);
+    out[2] = int8_hsum_avx2(acc2);
+    out[3] = int8_hsum_avx2(acc3);
+}
+
+__attribute__((target("avx2,avx512vnni,avx512vl")))
+static int int8_dot_vnni(int k, const signed char *w, const signed char *x)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int i;
+    for(i = 0; i < k; i += 32){
+        __m256i wv = _mm256_loadu_si256((const __m256i *)(w + i));
+        __m256i xv = _mm256_loadu_si256((const __m256i *)(x + i));
+        acc = _mm256_dpbusd_epi32(acc, _mm256_sign_epi8(wv, wv), _mm256_sign_epi8(xv, wv));
+    }
+    return int8_hsum_avx2(acc);
+}
+
+__attribute__((target("avx2,avx512vnni,avx512vl")))
+static void int8_dot4_vnni(int k, const signed char *w, const signed char *x, int ldx, int *out)
+{
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+    int i;
+    for(i = 0; i < k; i += 32){
+        __m256i wv = _mm256_loadu_si256((const __m256i *)(w + i));
+        __m256i aw = _mm256_sign_epi8(wv, wv);
+#define INT8_VNNI_ACCUMULATE(acc, r) \
+        acc = _mm256_dpbusd_epi32(acc, aw, _mm256_sign_epi8(_mm256_loadu_si256((const __m256i *)(x + (r)*ldx + i)), wv));
+        INT8_VNNI_ACCUMULATE(acc0, 0)
+        INT8_VNNI_ACCUMULATE(acc1, 1)
+        INT8_VNNI_ACCUMULATE(acc2, 2)
+        INT8_VNNI_ACCUMULATE(acc3, 3)
+#undef INT8_VNNI_ACCUMULATE
+    }
+    out[0] = int8_hsum_avx2(acc0);
+    out[1] = int8_hsum_avx2(acc1);
+    out[2] = int8_hsum_avx2(acc2);
+    out[3] = int8_hsum_avx2(acc3);
+}
+
+#endif
+
+static const int8_kernel int8_kernels[] = {
+#ifdef INT8_X86
+    {"avx512-vnni", int8_dot_vnni, int8_dot4_vnni},
+    {"avx2", int8_dot_avx2, int8_dot4_avx2},
+#endif
+    {"c", int8_dot_c, int8_dot4_c}
+};
+
+static int int8_kernel_supported(const int8_kernel *k)
+{
+#ifdef INT8_X86
+    if(!strcmp(k->name, "avx512-vnni")) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl");
+    if(!strcmp(k->name, "avx2")) return __builtin_cpu_supports("avx2");
+#endif
+    return 1;
+}
+
+static const int8_kernel *int8_cpu_kernel()
+{
+    static const int8_kernel *selected = 0;
+    if(!selected){
+        int i;
+        int n = sizeof(int8_kernels)/sizeof(int8_kernels[0]);
+        for(i = 0; i < n; ++i){
+            if(int8_kernel_supported(&int8_kernels[i])) break;
+        }
+        selected = &int8_kernels[i < n ? i : n-1];
+    }
+    return selected;
+}
+
+const char *int8_cpu_kernel_name()
+{
+    return int8_cpu_kernel()->name;
+}
+
+static inline signed char quantize_value(float x, float inv_scale)
+{
+    float v = x*inv_scale;
+    if(v > INT8_MAX_VALUE) v = INT8_MAX_VALUE;
+    if(v < -INT8_MAX_VALUE) v = -INT8_MAX_VALUE;
+    return (signed char)(v >= 0 ? (int)(v + .5f) : -(int)(.5f - v));
+}
+
+static inline float int8_activate(float x, ACTIVATION a)
+{
+    if(a == LEAKY) return (x > 0) ? x : .1f*x;
+    if(a == LINEAR) return x;
+    return activate(x, a);
+}
+
+/*
+ * Int8 GEMM with a fused epilogue.
+ *
+ * Computes out[i*out_row + j*out_col] = activation(scales[i]*(W_i . X_j) + biases[i])
+ * for the m x k weights W and the n x k columns X (both int8, rows padded
+ * to k), so convolutions (columns are output pixels) and connected layers
+ * (columns are images) share one routine with different output strides.
+ */
+
+typedef struct{
+    const int8_kernel *kernel;
+    int m, n, k;
+    const signed char *weights;
+    const signed char *columns;
+    const float *scales;
+    const float *biases;
+    ACTIVATION activation;
+    float *out;
+    int out_row;
+    int out_col;
+    int column_blocks;
+} int8_gemm_job;
+
+static void int8_gemm_range(void *ctx, int begin, int end)
+{
+    int8_gemm_job *g = (int8_gemm_job *)ctx;
+    int t, i, j, r;
+    int acc[4];
+    for(t = begin; t < end; ++t){
+        int i0 = (t / g->column_blocks) * INT8_MC;
+        int j0 = (t % g->column_blocks) * INT8_NC;
+        int i1 = (i0 + INT8_MC < g->m) ? i0 + INT8_MC : g->m;
+        int j1 = (j0 + INT8_NC < g->n) ? j0 + INT8_NC : g->n;
+        for(i = i0; i < i1; ++i){
+            const signed char *w = g->weights + (size_t)i*g->k;
+            float scale = g->scales[i];
+            float bias = g->biases[i];
+            float *out = g->out + (size_t)i*g->out_row;
+            for(j = j0; j + 4 <= j1; j += 4){
+                g->kernel->dot4(g->k, w, g->columns + (size_t)j*g->k, g->k, acc);
+                for(r = 0; r < 4; ++r){
+                    out[(size_t)(j + r)*g->out_col] = int8_activate(scale*acc[r] + bias, g->activation);
+                }
+            }
+            for(; j < j1; ++j){
+                int a = g->kernel->dot(g->k, w, g->columns + (size_t)j*g->k);
+                out[(size_t)j*g->out_col] = int8_activate(scale*a + bias, g->activation);
+            }
+        }
+    }
+}
+
+static void int8_gemm(const int8_kernel *kernel, int m, int n, int k, const signed char *weights, const signed char *columns,
+        const float *scales, const float *biases, ACTIVATION activation, float *out, int out_row, int out_col)
+{
+    int8_gemm_job g;
+    int tasks;
+    g.kernel = kernel;
+    g.m = m; g.n = n; g.k = k;
+    g.weights = weights;
+    g.columns = columns;
+    g.scales = scales;
+    g.biases = biases;
+    g.activation = activation;
+    g.out = out;
+    g.out_row = out_row;
+    g.out_col = out_col;
+    g.column_blocks = (n + INT8_NC - 1)/INT8_NC;
+    tasks = (m + INT8_MC - 1)/INT8_MC * g.column_blocks;
+    parallel_for(tasks, 1, int8_gemm_range, &g);
+}
+
+/* Quantises a convolution's input straight into an out_h*out_w x k matrix of int8 patches (im2col, transposed). */
+
+typedef struct{
+    const float *im;
+    int channels, height, width;
+    int ksize, stride, pad;
+    int out_w;
+    int k;
+    float inv_scale;
+    signed char *columns;
+} int8_im2col_job;
+
+static void int8_im2col_rows(void *ctx, int begin, int end)
+{
+    int8_im2col_job *a = (int8_im2col_job *)ctx;
+    int y, x, c, ky, kx;
+    for(y = begin; y < end; ++y){
+        for(x = 0; x < a->out_w; ++x){
+            signed char *col = a->columns + ((size_t)y*a->out_w + x)*a->k;
+            int idx = 0;
+            for(c = 0; c < a->channels; ++c){
+                const float *plane = a->im + (size_t)c*a->height*a->width;
+                for(ky = 0; ky < a->ksize; ++ky){
+                    int iy = y*a->stride - a->pad + ky;
+                    for(kx = 0; kx < a->ksize; ++kx){
+                        int ix = x*a->stride - a->pad + kx;
+                        float v = (iy >= 0 && iy < a->height && ix >= 0 && ix < a->width) ? plane[iy*a->width + ix] : 0;
+                        col[idx++] = quantize_value(v, a->inv_scale);
+                    }
+                }
+            }
+            memset(col + idx, 0, a->k - idx);
+        }
+    }
+}
+
+void forward_convolutional_layer_int8(layer l, network_state state)
+{
+    int out_h = convolutional_out_height(l);
+    int out_w = convolutional_out_width(l);
+    int n = out_h*out_w;
+    signed char *columns = (signed char *)state.workspace;
+    int8_im2col_job a;
+    int i;
+
+    a.channels = l.c; a.height = l.h; a.width = l.w;
+    a.ksize = l.size; a.stride = l.stride; a.pad = l.pad ? l.size/2 : 0;
+    a.out_w = out_w;
+    a.k = l.quantized_inputs;
+    a.inv_scale = 1.f/l.input_scale;
+    a.columns = columns;
+    for(i = 0; i < l.batch; ++i){
+        a.im = state.input + (size_t)i*l.c*l.h*l.w;
+        parallel_for(out_h, 1, int8_im2col_rows, &a);
+        int8_gemm(int8_cpu_kernel(), l.n, n, l.quantized_inputs, l.quantized_weights, columns,
+                l.quantized_scales, l.quantized_biases, l.activation, l.output + (size_t)i*l.outputs, n, 1);
+    }
+}
+
+void forward_connected_layer_int8(layer l, network_state state)
+{
+    signed char *rows = (signed char *)state.workspace;
+    float inv_scale = 1.f/l.input_scale;
+    int b, i;
+    for(b = 0; b < l.batch; ++b){
+        const float *x = state.input + (size_t)b*l.inputs;
+        signed char *row = rows + (size_t)b*l.quantized_inputs;
+        for(i = 0; i < l.inputs; ++i) row[i] = quantize_value(x[i], inv_scale);
+        memset(row + l.inputs, 0, l.quantized_inputs - l.inputs);
+    }
+    int8_gemm(int8_cpu_kernel(), l.outputs, l.batch, l.quantized_inputs, l.quantized_weights, rows,
+            l.quantized_scales, l.quantized_biases, l.activation, l.output, 1, l.outputs);
+}
+
+/* The first layer stays fp32: it sees the raw image, and with only three input channels int8 gains nothing there. */
+static int is_quantizable(network net, int i)
+{
+    layer l = net.layers[i];
+    if(i == 0) return 0;
+    return (l.type == CONVOLUTIONAL && !l.binary && !l.xnor) || l.type == CONNECTED;
+}
+
+void calibrate_quantization(network net, float *input)
+{
+    int i, b, j;
+    network_state state = {0};
+    state.net = net;
+    state.input = input;
+    state.workspace = net.workspace;
+    /* The input of each layer is read just before it runs, since planned activations reuse the buffers of earlier layers. */
+    for(i = 0; i < net.n; ++i){
+        layer *l = &net.layers[i];
+        const float *x = state.input;
+        if(is_quantizable(net, i)){
+            /* The scale is the mean of the per-image maxima, which a single outlying image cannot stretch. */
+            for(b = 0; b < l->batch; ++b){
+                float range = 0;
+                for(j = 0; j < l->inputs; ++j){
+                    float v = fabsf(x[(size_t)b*l->inputs + j]);
+                    if(v > range) range = v;
+                }
+                l->input_range_sum += range;
+                ++l->input_range_count;
+            }
+        }
+        forward_network_layer(net, state, i);
+        state.input = l->output;
+    }
+}
+
+static void quantize_layer(network *net, layer *l)
+{
+    int rows = (l->type == CONVOLUTIONAL) ? l->n : l->outputs;
+    int cols = (l->type == CONVOLUTIONAL) ? l->c*l->size*l->size : l->inputs;
+    float **weights = (l->type == CONVOLUTIONAL) ? &l->filters : &l->weights;
+    float range = l->input_range_sum/l->input_range_count;
+    char *mapping = net->weights_mapping;
+    int i, j;
+
+    l->input_scale = (range > 0) ? range/INT8_MAX_VALUE : 1.f/INT8_MAX_VALUE;
+    l->quantized_inputs = (cols + INT8_ALIGN - 1)/INT8_ALIGN*INT8_ALIGN;
+    l->quantized_weights = calloc((size_t)rows*l->quantized_inputs, sizeof(signed char));
+    l->quantized_scales = calloc(rows, sizeof(float));
+    l->quantized_biases = calloc(rows, sizeof(float));
+    if(!l->quantized_weights || !l->quantized_scales || !l->quantized_biases) malloc_error();
+
+    for(i = 0; i < rows; ++i){
+        const float *w = *weights + (size_t)i*cols;
+        signed char *q = l->quantized_weights + (size_t)i*l->quantized_inputs;
+        float bn_scale = 1, bn_mean = 0;
+        float max = 0;
+        float scale;
+        for(j = 0; j < cols; ++j){
+            if(fabsf(w[j]) > max) max = fabsf(w[j]);
+        }
+        scale = (max > 0) ? max/INT8_MAX_VALUE : 1;
+        for(j = 0; j < cols; ++j) q[j] = quantize_value(w[j], 1.f/scale);
+
+        /* Inference-time batch normalisation is a per-channel affine map, so it folds into the requantisation. */
+        if(l->batch_normalize){
+            bn_scale = l->scales[i]/(sqrt(l->rolling_variance[i]) + .000001f);
+            bn_mean = l->rolling_mean[i];
+        }
+        l->quantized_scales[i] = scale*l->input_scale*bn_scale;
+        l->quantized_biases[i] = l->biases[i] - bn_mean*bn_scale;
+    }
+
+    /* Weights that live in a mapped weights file are left to the page cache. */
+    if(!mapping || (char *)*weights < mapping || (char *)*weights >= mapping + net->weights_mapping_size) free(*weights);
+    *weights = 0;
+    free(l->winograd_filters);
+    l->winograd_filters = 0;
+    l->winograd = 0;
+
+    l->quantized = 1;
+    if(l->type == CONVOLUTIONAL){
+        l->workspace_size = get_workspace_size(*l);
+    } else {
+        int batch = (net->allocated_batch > l->batch) ? net->allocated_batch : l->batch;
+        l->workspace_size = (size_t)batch*l->quantized_inputs;
+    }
+}
+
+void quantize_network(network *net)
+{
+    size_t workspace_size = 0;
+    int i;
+#ifdef WITH_CUDA
+    if(gpu_index >= 0) error("Int8 inference is only supported on the CPU");
+#endif
+    free_resolution_plans(net);
+    for(i = 0; i < net->n; ++i){
+        layer *l = &net->layers[i];
+        if(is_quantizable(*net, i) && !l->quantized){
+            if(l->input_range_count == 0) error("Calibrate the network before quantizing it");
+            quantize_layer(net, l);
+        }
+        if(l->workspace_size > workspace_size) workspace_size = l->workspace_size;
+    }
+    free(net->workspace);
+    net->workspace = calloc(1, workspace_size);
+    if(workspace_size && !net->workspace) malloc_error();
+    fprintf(stderr, "Quantized the network to int8 (%s kernel)\n", int8_cpu_kernel_name());
+}
+
+static signed char *random_int8_matrix(int rows, int cols)
+{
+    signed char *m = calloc((size_t)rows*cols, sizeof(signed char));
+    int i;
+    for(i = 0; i < rows*cols; ++i) m[i] = (signed char)(rand() % (2*INT8_MAX_VALUE + 1) - INT8_MAX_VALUE);
+    return m;
+}
+
+static void time_int8_kernel(const int8_kernel *kernel, int m, int k, int n, const float *scales, const float *biases)
+{
+    signed char *w = random_int8_matrix(m, k);
+    signed char *x = random_int8_matrix(n, k);
+    float *out = calloc((size_t)m*n, sizeof(float));
+    double op = 2.*m*n*k;
+    int iter = 0;
+    double start, elapsed;
+
+    int8_gemm(kernel, m, n, k, w, x, scales, biases, LEAKY, out, n, 1);
+    start = what_time_is_it_now();
+    do{
+        int8_gemm(kernel, m, n, k, w, x, scales, biases, LEAKY, out, n, 1);
+        ++iter;
+        elapsed = what_time_is_it_now() - start;
+    } while(elapsed < .25 && iter < 1000);
+
+    printf("  %-11s %9.3lf ms %8.2lf GOP/s\n", kernel->name, 1000.*elapsed/iter, op*iter/elapsed/1e9);
+    free(w);
+    free(x);
+    free(out);
+}
+
+/* Runs a random convolution in fp32 and in int8, and returns the largest error of the int8 output relative to the largest fp32 output. */
+static float int8_convolution_error(int h, int w, int c, int n, int size, int stride, int pad)
+{
+    layer l = make_convolutional_layer(1, h, w, c, n, size, stride, pad, LEAKY, 0, 0, 0);
+    network net = {0};
+    network_state state = {0};
+    float *input = calloc(l.inputs, sizeof(float));
+    float *expected = calloc(l.outputs, sizeof(float));
+    float max_error = 0, max_output = 0;
+    int i;
+
+    for(i = 0; i < l.inputs; ++i) input[i] = rand_uniform(-1, 1);
+    for(i = 0; i < l.n; ++i) l.biases[i] = rand_uniform(-.1, .1);
+    state.input = input;
+    state.workspace = calloc(1, l.workspace_size);
+    forward_convolutional_layer(l, state);
+    memcpy(expected, l.output, l.outputs*sizeof(float));
+    free(state.workspace);
+
+    /* The inputs lie in [-1,1], so the calibrated range is 1. */
+    l.input_range_sum = 1;
+    l.input_range_count = 1;
+    quantize_layer(&net, &l);
+    state.workspace = calloc(1, l.workspace_size);
+    forward_convolutional_layer_int8(l, state);
+    for(i = 0; i < l.outputs; ++i){
+        if(fabsf(l.output[i] - expected[i]) > max_error) max_error = fabsf(l.output[i] - expected[i]);
+        if(fabsf(expected[i]) > max_output) max_output = fabsf(expected[i]);
+    }
+
+    free(state.workspace);
+    free(input);
+    free(expected);
+    free_layer(l);
+    return (max_output > 0) ? max_error/max_output : max_error;
+}
+
+void benchmark_int8_cpu()
+{
+    /* {M, K, N} for the convolutional layers of yolo.cfg at 448x448, followed by the two connected layers at batch 1. */
+    static const int shapes[][3] = {
+        {  64, 147, 50176},
+        { 192, 576, 12544},
+        { 256,1152,  3136},
+        { 512,2304,  3136},
+        {1024,4608,   784},
+        {1024,9216,   196},
+        {1024,9216,    49},
+        {4096,50176,    1},
+        {1470,4096,     1}
+    };
+    int count = sizeof(int8_kernels)/sizeof(int8_kernels[0]);
+    float *scales = calloc(4096, sizeof(float));
+    float *biases = calloc(4096, sizeof(float));
+    int i, s;
+
+    for(i = 0; i < 4096; ++i) scales[i] = 1;
+    printf("CPU int8 kernel: %s, %d threads\n", int8_cpu_kernel_name(), get_cpu_threads());
+    for(i = 0; i < count; ++i){
+        int m = 37, n = 53, k = 320;
+        signed char *w, *x;
+        float *out, *out_ref;
+        int errors = 0;
+        int j;
+        if(!int8_kernel_supported(&int8_kernels[i])) continue;
+        w = random_int8_matrix(m, k);
+        x = random_int8_matrix(n, k);
+        out = calloc(m*n, sizeof(float));
+        out_ref = calloc(m*n, sizeof(float));
+        int8_gemm(&int8_kernels[i], m, n, k, w, x, scales, biases, LINEAR, out, n, 1);
+        for(j = 0; j < m*n; ++j) out_ref[j] = int8_dot_c(k, w + (j/n)*k, x + (j%n)*k);
+        for(j = 0; j < m*n; ++j) errors += out[j] != out_ref[j];
+        printf("  %-11s mismatches vs naive: %d\n", int8_kernels[i].name, errors);
+        free(w);
+        free(x);
+        free(out);
+        free(out_ref);
+    }
+    /* A 1x1 layer with pad=1 (which darknet treats as no padding) and a padded 3x3 layer, as in yolo.cfg. */
+    printf("  int8 vs fp32 convolution, 1x1 pad=1: max error %.4f of the output range\n", int8_convolution_error(14, 14, 64, 32, 1, 1, 1));
+    printf("  int8 vs fp32 convolution, 3x3 pad=1: max error %.4f of the output range\n", int8_convolution_error(14, 14, 64, 32, 3, 1, 1));
+    for(s = 0; s < (int)(sizeof(shapes)/sizeof(shapes[0])); ++s){
+        int k = (shapes[s][1] + INT8_ALIGN - 1)/INT8_ALIGN*INT8_ALIGN;
+        printf("Int8 Matrix Multiplication %dx%d * %dx%d:\n", shapes[s][0], shapes[s][1], shapes[s][1], shapes[s][2]);
+        for(i = 0; i < count; ++i){
+            if(int8_kernel_supported(&int8_kernels[i])) time_int8_kernel(&int8_kernels[i], shapes[s][0], k, shapes[s][2], scales, biases);
+        }
+    }
+    free(scales);
+    free(biases);
+}
@@ -0,0 +1,307 @@
+#include "resolution_plan.h"
+#include "convolutional_layer.h"
+#include "memory_planner.h"
+#include "profiler.h"
+#include "winograd.h"
+#include "cuda.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Layers whose output size follows from the size of their input. */
+static int is_trunk_layer(layer l)
+{
+    switch(l.type){
+        case CONVOLUTIONAL:
+        case MAXPOOL:
+        case AVGPOOL:
+        case ACTIVE:
+        case BATCHNORM:
+        case ROUTE:
+        case SHORTCUT:
+        case DROPOUT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Layers that can run in a plan: the trunk, and a head whose input size stays fixed. */
+static int is_plan_layer(layer l)
+{
+    if(l.type == CONVOLUTIONAL && (l.binary || l.xnor)) return 0;
+    switch(l.type){
+        case CONNECTED:
+        case LOCAL:
+        case SOFTMAX:
+        case DETECTION:
+            return 1;
+        default:
+            return is_trunk_layer(l);
+    }
+}
+
+/* Sets the input size of layer i of a trunk, and the sizes that follow from it. */
+static void set_trunk_layer_input(layer *layers, int i, int w, int h, int c)
+{
+    layer *l = &layers[i];
+    int j;
+    switch(l->type){
+        case CONVOLUTIONAL:
+            l->w = w;
+            l->h = h;
+            l->out_w = convolutional_out_width(*l);
+            l->out_h = convolutional_out_height(*l);
+            break;
+        case MAXPOOL:
+            l->w = w;
+            l->h = h;
+            l->out_w = (w-1)/l->stride + 1;
+            l->out_h = (h-1)/l->stride + 1;
+            break;
+        case AVGPOOL:
+            l->w = w;
+            l->h = h;
+            l->out_w = 1;
+            l->out_h = 1;
+            break;
+        case ROUTE:
+            l->out_w = layers[l->input_layers[0]].out_w;
+            l->out_h = layers[l->input_layers[0]].out_h;
+            l->out_c = 0;
+            for(j = 0; j < l->n; ++j){
+                layer in = layers[l->input_layers[j]];
+                if(in.out_w != l->out_w || in.out_h != l->out_h) error("Cannot route layers of different sizes at this resolution");
+                l->out_c += in.out_c;
+            }
+            break;
+        case SHORTCUT:
+            l->w = layers[l->index].out_w;
+            l->h = layers[l->index].out_h;
+            l->c = layers[l->index].out_c;
+            l->out_w = w;
+            l->out_h = h;
+            break;
+        default:
+            l->w = w;
+            l->h = h;
+            l->c = c;
+            l->out_w = w;
+            l->out_h = h;
+            l->out_c = c;
+            break;
+    }
+    l->outputs = l->out_w*l->out_h*l->out_c;
+    l->inputs = (l->type == ROUTE) ? l->outputs : w*h*c;
+}
+
+/* Resizes the trunk of a set of layers for a w x h x c input and returns the index of the first layer that needs a fixed input size. */
+static int resize_trunk(layer *layers, int n, int w, int h, int c)
+{
+    int i;
+    for(i = 0; i < n && is_trunk_layer(layers[i]); ++i){
+        set_trunk_layer_input(layers, i, w, h, c);
+        w = layers[i].out_w;
+        h = layers[i].out_h;
+        c = layers[i].out_c;
+    }
+    return i;
+}
+
+/* Clears the buffers a plan's copy of a layer must not share with the network; plan_inference_memory gives it its own output. */
+static void detach_layer_buffers(layer *l)
+{
+    l->output = 0;
+    l->delta = 0;
+    l->indexes = 0;
+    l->rand = 0;
+    l->cost = 0;
+    l->squared = 0;
+    l->norms = 0;
+    l->spatial_mean = 0;
+    l->x = 0;
+    l->x_norm = 0;
+    l->mean = 0;
+    l->variance = 0;
+    l->mean_delta = 0;
+    l->variance_delta = 0;
+    l->filter_updates = 0;
+    l->weight_updates = 0;
+    l->bias_updates = 0;
+    l->scale_updates = 0;
+}
+
+/* Averages each w x h plane of the input over the cells of an out_w x out_h grid. */
+static void resample_planes(const float *input, int w, int h, int planes, float *output, int out_w, int out_h)
+{
+    int p, i, j, x, y;
+    for(p = 0; p < planes; ++p){
+        const float *in = input + (size_t)p*w*h;
+        float *out = output + (size_t)p*out_w*out_h;
+        for(i = 0; i < out_h; ++i){
+            int y0 = i*h/out_h;
+            int y1 = ((i+1)*h + out_h - 1)/out_h;
+            for(j = 0; j < out_w; ++j){
+                int x0 = j*w/out_w;
+                int x1 = ((j+1)*w + out_w - 1)/out_w;
+                float sum = 0;
+                for(y = y0; y < y1; ++y){
+                    for(x = x0; x < x1; ++x) sum += in[y*w + x];
+                }
+                out[i*out_w + j] = sum/((y1 - y0)*(x1 - x0));
+            }
+        }
+    }
+}
+
+static resolution_plan *make_resolution_plan(network *net, int w, int h)
+{
+    int n, i;
+    for(n = net->n; n > 1; --n) if(net->layers[n-1].type != COST) break;
+    for(i = 0; i < n; ++i){
+        if(!is_plan_layer(net->layers[i])) error("This network cannot be run at other input resolutions");
+    }
+
+    /* The sizes the head was trained on, taken from the trunk at the network's own resolution. */
+    layer *base = calloc(n, sizeof(layer));
+    if(!base) malloc_error();
+    memcpy(base, net->layers, n*sizeof(layer));
+    int head = resize_trunk(base, n, net->w, net->h, net->c);
+    if(head == 0) error("The first layer of the network needs a fixed input size");
+    layer trained = base[head-1];
+    free(base);
+
+    resolution_plan *p = calloc(1, sizeof(resolution_plan));
+    if(!p) malloc_error();
+    p->w = w;
+    p->h = h;
+    p->net = *net;
+    p->net.n = n;
+    p->net.w = w;
+    p->net.h = h;
+    p->net.inputs = w*h*net->c;
+    p->net.workspace = 0;
+    p->net.weights_mapping = 0;
+    p->net.weights_mapping_size = 0;
+    p->net.activation_arenas = 0;
+    p->net.activation_arena_count = 0;
+    p->net.resolution_plans = 0;
+    p->net.profile = 0;
+    p->net.layers = calloc(n, sizeof(layer));
+    if(!p->net.layers) malloc_error();
+    memcpy(p->net.layers, net->layers, n*sizeof(layer));
+    for(i = 0; i < n; ++i) detach_layer_buffers(&p->net.layers[i]);
+
+    p->head = resize_trunk(p->net.layers, n, w, h, net->c);
+    layer last = p->net.layers[p->head-1];
+    if(p->head < n && (last.out_w != trained.out_w || last.out_h != trained.out_h)){
+        int batch = (net->allocated_batch > net->batch) ? net->allocated_batch : net->batch;
+        p->head_w = trained.out_w;
+        p->head_h = trained.out_h;
+        p->head_input = calloc((size_t)trained.outputs*batch, sizeof(float));
+        if(!p->head_input) malloc_error();
+    }
+
+    size_t workspace_size = 0;
+    for(i = 0; i < n; ++i){
+        layer *l = &p->net.layers[i];
+        if(i < p->head && l->type == CONVOLUTIONAL){
+            if(!l->quantized){
+                /* Keep sharing the network's transformed filters when the new size picks the same tile. */
+                l->winograd = 0;
+                l->winograd_filters = 0;
+                setup_winograd_layer(l);
+                if(l->winograd && l->winograd == net->layers[i].winograd){
+                    free(l->winograd_filters);
+                    l->winograd_filters = net->layers[i].winograd_filters;
+                }
+            }
+            l->workspace_size = get_workspace_size(*l);
+        } else if(i < p->head && l->type == ROUTE){
+            int j;
+            l->input_sizes = calloc(l->n, sizeof(int));
+            if(!l->input_sizes) malloc_error();
+            for(j = 0; j < l->n; ++j) l->input_sizes[j] = p->net.layers[l->input_layers[j]].outputs;
+        }
+        if(l->workspace_size > workspace_size) workspace_size = l->workspace_size;
+    }
+    if(workspace_size){
+        p->net.workspace = calloc(1, workspace_size);
+        if(!p->net.workspace) malloc_error();
+    }
+
+    fprintf(stderr, "Planning %d x %d inference: ", w, h);
+    plan_inference_memory(&p->net);
+
+    /* A plan has its own profile, since its layers cost what they do at its size, but shares the network's clock. */
+    if(net->profile){
+        enable_network_profiling(&p->net);
+        p->net.profile->origin = net->profile->origin;
+    }
+    return p;
+}
+
+resolution_plan *get_resolution_plan(network *net, int w, int h)
+{
+#ifdef WITH_CUDA
+    if(gpu_index >= 0) error("Resolution plans are only supported on the CPU");
+#endif
+    resolution_plan *p;
+    for(p = net->resolution_plans; p; p = p->next){
+        if(p->w == w && p->h == h) return p;
+    }
+    p = make_resolution_plan(net, w, h);
+    p->next = net->resolution_plans;
+    net->resolution_plans = p;
+    return p;
+}
+
+float *predict_resolution_plan(resolution_plan *p, float *input, int batch)
+{
+    if(p->net.batch != batch) set_batch_network(&p->net, batch);
+
+    network_state state;
+    state.net = p->net;
+    state.index = 0;
+    state.input = input;
+    state.truth = 0;
+    state.train = 0;
+    state.delta = 0;
+    state.workspace = p->net.workspace;
+    int i;
+    for(i = 0; i < p->net.n; ++i){
+        if(i == p->head && p->head_input){
+            /* The head reads the trunk's output at the size it was trained on. */
+            layer last = p->net.layers[i-1];
+            resample_planes(state.input, last.out_w, last.out_h, last.out_c*batch, p->head_input, p->head_w, p->head_h);
+            state.input = p->head_input;
+        }
+        double start = p->net.profile ? profile_layer_start() : 0;
+        forward_network_layer(p->net, state, i);
+        if(p->net.profile) profile_layer_end(p->net, i, PROFILE_FORWARD, start);
+        state.input = p->net.layers[i].output;
+    }
+    return get_network_output(p->net);
+}
+
+void free_resolution_plans(network *net)
+{
+    while(net->resolution_plans){
+        resolution_plan *p = net->resolution_plans;
+        int i;
+        release_activation_arenas(&p->net);
+        disable_network_profiling(&p->net);
+        for(i = 0; i < p->head; ++i){
+            layer l = p->net.layers[i];
+            if(l.winograd_filters && l.winograd_filters != net->layers[i].winograd_filters) free(l.winograd_filters);
+            if(l.type == ROUTE) free(l.input_sizes);
+        }
+        free(p->net.layers);
+        free(p->net.workspace);
+        free(p->head_input);
+        net->resolution_plans = p->next;
+        free(p);
+    }
+}
@@ -162,6 +162,13 @@ float sec(clock_t clocks)
     return (float)clocks/CLOCKS_PER_SEC;
 }
 
+double what_time_is_it_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec*1e-9;
+}
+
 void top_k(float *a, int n, int k, int *index)
 {
     int i,j;
@@ -0,0 +1,293 @@
+#include "weights_file.h"
+#include "batchnorm_layer.h"
+#include "connected_layer.h"
+#include "convolutional_layer.h"
+#include "deconvolutional_layer.h"
+#include "local_layer.h"
+#include "utils.h"
+#include "winograd.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WEIGHTS_MAGIC "DNWMAP01"
+#define WEIGHTS_VERSION 1
+#define WEIGHTS_ALIGNMENT 64
+#define MAX_SUBLAYERS 6
+#define MAX_TENSORS 6
+
+typedef enum {
+    FIELD_BIASES, FIELD_SCALES, FIELD_ROLLING_MEAN, FIELD_ROLLING_VARIANCE, FIELD_FILTERS, FIELD_WEIGHTS
+} weights_field;
+
+typedef struct {
+    char magic[8];
+    int32_t version;
+    int32_t seen;
+    int32_t layer_count;
+    int32_t tensor_count;
+    uint64_t table_offset;
+    char reserved[32];
+} weights_header;
+
+typedef struct {
+    int32_t layer;
+    int32_t sublayer;
+    int32_t field;
+    int32_t reserved;
+    uint64_t offset;
+    uint64_t count;
+} weights_entry;
+
+typedef struct {
+    float **data;
+    int field;
+    size_t count;
+} weights_tensor;
+
+/* The layers whose parameters are stored for a network layer: its recurrent sublayers, or the layer itself. */
+static int get_sublayers(layer *l, layer **subs)
+{
+    if(l->type == RNN || l->type == CRNN){
+        subs[0] = l->input_layer;
+        subs[1] = l->self_layer;
+        subs[2] = l->output_layer;
+        return 3;
+    }
+    if(l->type == GRU){
+        subs[0] = l->input_z_layer;
+        subs[1] = l->input_r_layer;
+        subs[2] = l->input_h_layer;
+        subs[3] = l->state_z_layer;
+        subs[4] = l->state_r_layer;
+        subs[5] = l->state_h_layer;
+        return 6;
+    }
+    subs[0] = l;
+    return 1;
+}
+
+static void add_tensor(weights_tensor *t, int *n, float **data, int field, size_t count)
+{
+    t[*n].data = data;
+    t[*n].field = field;
+    t[*n].count = count;
+    ++*n;
+}
+
+/* The parameter arrays of a layer, in the order in which the legacy format stores them. */
+static int get_tensors(layer *l, weights_tensor *t)
+{
+    int n = 0;
+    int load_scales = l->batch_normalize && !l->dontloadscales;
+    if(l->type == CONVOLUTIONAL){
+        add_tensor(t, &n, &l->biases, FIELD_BIASES, l->n);
+        if(load_scales){
+            add_tensor(t, &n, &l->scales, FIELD_SCALES, l->n);
+            add_tensor(t, &n, &l->rolling_mean, FIELD_ROLLING_MEAN, l->n);
+            add_tensor(t, &n, &l->rolling_variance, FIELD_ROLLING_VARIANCE, l->n);
+        }
+        add_tensor(t, &n, &l->filters, FIELD_FILTERS, (size_t)l->n*l->c*l->size*l->size);
+    } else if(l->type == DECONVOLUTIONAL){
+        add_tensor(t, &n, &l->biases, FIELD_BIASES, l->n);
+        add_tensor(t, &n, &l->filters, FIELD_FILTERS, (size_t)l->n*l->c*l->size*l->size);
+    } else if(l->type == CONNECTED){
+        add_tensor(t, &n, &l->biases, FIELD_BIASES, l->outputs);
+        add_tensor(t, &n, &l->weights, FIELD_WEIGHTS, (size_t)l->outputs*l->inputs);
+        if(load_scales){
+            add_tensor(t, &n, &l->scales, FIELD_SCALES, l->outputs);
+            add_tensor(t, &n, &l->rolling_mean, FIELD_ROLLING_MEAN, l->outputs);
+            add_tensor(t, &n, &l->rolling_variance, FIELD_ROLLING_VARIANCE, l->outputs);
+        }
+    } else if(l->type == BATCHNORM){
+        add_tensor(t, &n, &l->scales, FIELD_SCALES, l->c);
+        add_tensor(t, &n, &l->rolling_mean, FIELD_ROLLING_MEAN, l->c);
+        add_tensor(t, &n, &l->rolling_variance, FIELD_ROLLING_VARIANCE, l->c);
+    } else if(l->type == LOCAL){
+        add_tensor(t, &n, &l->biases, FIELD_BIASES, l->outputs);
+        add_tensor(t, &n, &l->filters, FIELD_FILTERS, (size_t)l->size*l->size*l->c*l->n*l->out_w*l->out_h);
+    }
+    return n;
+}
+
+static uint64_t align_offset(uint64_t offset)
+{
+    return (offset + WEIGHTS_ALIGNMENT - 1) / WEIGHTS_ALIGNMENT * WEIGHTS_ALIGNMENT;
+}
+
+static void push_layer(layer l)
+{
+#ifdef WITH_CUDA
+    if(gpu_index < 0) return;
+    if(l.type == CONVOLUTIONAL) push_convolutional_layer(l);
+    if(l.type == DECONVOLUTIONAL) push_deconvolutional_layer(l);
+    if(l.type == CONNECTED) push_connected_layer(l);
+    if(l.type == BATCHNORM) push_batchnorm_layer(l);
+    if(l.type == LOCAL) push_local_layer(l);
+#endif
+}
+
+int is_mapped_weights_file(char *filename)
+{
+    char magic[8];
+    FILE *fp = fopen(filename, "rb");
+    if(!fp) return 0;
+    int ok = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, WEIGHTS_MAGIC, sizeof(magic)) == 0;
+    fclose(fp);
+    return ok;
+}
+
+void save_mapped_weights_upto(network net, char *filename, int cutoff)
+{
+    fprintf(stderr, "Saving mapped weights to %s\n", filename);
+    FILE *fp = fopen(filename, "wb");
+    if(!fp) file_error(filename);
+
+    int layer_count = net.n < cutoff ? net.n : cutoff;
+    weights_entry *entries = 0;
+    int tensor_count = 0;
+    int i, s, k;
+
+    /* Lay out the table, then the arrays after it. */
+    for(i = 0; i < layer_count; ++i){
+        layer *subs[MAX_SUBLAYERS];
+        int sub_count = get_sublayers(&net.layers[i], subs);
+        for(s = 0; s < sub_count; ++s){
+            weights_tensor t[MAX_TENSORS];
+            int n = get_tensors(subs[s], t);
+            entries = realloc(entries, (tensor_count + n) * sizeof(weights_entry));
+            if(!entries) malloc_error();
+            for(k = 0; k < n; ++k){
+                weights_entry *e = &entries[tensor_count++];
+                memset(e, 0, sizeof(weights_entry));
+                e->layer = i;
+                e->sublayer = s;
+                e->field = t[k].field;
+                e->count = t[k].count;
+            }
+        }
+    }
+
+    uint64_t offset = align_offset(sizeof(weights_header) + (uint64_t)tensor_count * sizeof(weights_entry));
+    for(k = 0; k < tensor_count; ++k){
+        entries[k].offset = offset;
+        offset = align_offset(offset + entries[k].count * sizeof(float));
+    }
+
+    weights_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WEIGHTS_MAGIC, sizeof(header.magic));
+    header.version = WEIGHTS_VERSION;
+    header.seen = *net.seen;
+    header.layer_count = layer_count;
+    header.tensor_count = tensor_count;
+    header.table_offset = sizeof(weights_header);
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(entries, sizeof(weights_entry), tensor_count, fp);
+
+    static const char padding[WEIGHTS_ALIGNMENT] = {0};
+    k = 0;
+    for(i = 0; i < layer_count; ++i){
+        layer *subs[MAX_SUBLAYERS];
+        int sub_count = get_sublayers(&net.layers[i], subs);
+        for(s = 0; s < sub_count; ++s){
+            weights_tensor t[MAX_TENSORS];
+            int n, j;
+            n = get_tensors(subs[s], t);
+            for(j = 0; j < n; ++j, ++k){
+                long pos = ftell(fp);
+                fwrite(padding, 1, entries[k].offset - pos, fp);
+                fwrite(*t[j].data, sizeof(float), t[j].count, fp);
+            }
+        }
+    }
+
+    free(entries);
+    fclose(fp);
+}
+
+void load_mapped_weights_upto(network *net, char *filename, int cutoff)
+{
+    fprintf(stderr, "Mapping weights from %s...", filename);
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) file_error(filename);
+    struct stat st;
+    if(fstat(fd, &st) != 0) file_error(filename);
+    size_t size = st.st_size;
+    if(size < sizeof(weights_header)) error("Mapped weights file is truncated");
+
+    /* A private mapping shares the file's pages until a process writes to them. */
+    char *base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) file_error(filename);
+
+    weights_header header;
+    memcpy(&header, base, sizeof(header));
+    if(memcmp(header.magic, WEIGHTS_MAGIC, sizeof(header.magic)) != 0) error("Not a mapped weights file");
+    if(header.version != WEIGHTS_VERSION) error("Unsupported mapped weights version");
+    if(header.table_offset + (uint64_t)header.tensor_count * sizeof(weights_entry) > size) error("Mapped weights file is truncated");
+
+    if(net->weights_mapping) release_mapped_weights(net);
+    *net->seen = header.seen;
+
+    const weights_entry *entries = (const weights_entry *)(base + header.table_offset);
+    int layer_count = net->n < cutoff ? net->n : cutoff;
+    int k = 0;
+    int i, s, j;
+    for(i = 0; i < layer_count; ++i){
+        layer *l = &net->layers[i];
+        layer *subs[MAX_SUBLAYERS];
+        int sub_count = get_sublayers(l, subs);
+        for(s = 0; s < sub_count; ++s){
+            weights_tensor t[MAX_TENSORS];
+            int n = get_tensors(subs[s], t);
+            for(j = 0; j < n; ++j, ++k){
+                const weights_entry *e = &entries[k];
+                if(k >= header.tensor_count || e->layer != i || e->sublayer != s || e->field != t[j].field || e->count != t[j].count){
+                    error("Mapped weights file does not match the network");
+                }
+                if(e->offset % WEIGHTS_ALIGNMENT != 0 || e->offset + e->count * sizeof(float) > size) error("Mapped weights file is corrupt");
+                if(l->dontload) continue;
+                free(*t[j].data);
+                *t[j].data = (float *)(base + e->offset);
+            }
+            if(l->dontload) continue;
+            transform_winograd_filters(*subs[s]);
+            push_layer(*subs[s]);
+        }
+    }
+
+    net->weights_mapping = base;
+    net->weights_mapping_size = size;
+    fprintf(stderr, "Done!\n");
+}
+
+void release_mapped_weights(network *net)
+{
+    if(!net->weights_mapping) return;
+    char *begin = net->weights_mapping;
+    char *end = begin + net->weights_mapping_size;
+    int i, s, j;
+    for(i = 0; i < net->n; ++i){
+        layer *subs[MAX_SUBLAYERS];
+        int sub_count = get_sublayers(&net->layers[i], subs);
+        for(s = 0; s < sub_count; ++s){
+            weights_tensor t[MAX_TENSORS];
+            if(!subs[s]) continue;
+            int n = get_tensors(subs[s], t);
+            for(j = 0; j < n; ++j){
+                char *p = (char *)*t[j].data;
+                if(p >= begin && p < end) *t[j].data = 0;
+            }
+        }
+    }
+    munmap(net->weights_mapping, net->weights_mapping_size);
+    net->weights_mapping = 0;
+    net->weights_mapping_size = 0;
+}
@@ -0,0 +1,446 @@
+#include "winograd.h"
+#include "cuda.h"
+#include "gemm.h"
+#include "im2col.h"
+#include "parallel.h"
+#include "utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/* Tiles along a row are transformed WINOGRAD_LANES at a time, one per vector lane. */
+#define WINOGRAD_LANES 8
+#define WINOGRAD_MAX_ALPHA 6
+
+/*
+ * Chosen from benchmark_winograd_cpu (avx2-fma GEMM, one thread), against im2col + GEMM.
+ * F(4x4) needs 28x28 outputs and 64 channels: 64 -> 64 runs at 1.0x on 28x28 and 1.4-2.1x
+ * on 56x56 and up, but with 16 or 32 channels it ranges from 0.68x to 1.1x (0.83x for
+ * 16 -> 32 at 112x112, 0.87x for 32 -> 32 at 28x28). Below 28x28 the tiles are mostly
+ * padding and F(4x4) loses on all but a few shapes; F(2x2) only gains reliably at 14x14 from
+ * 256 channels (0.8x at 64, 0.9-1.0x at 128, 1.0-1.7x from 256), and at 7x7 only with 1024
+ * (0.9x at 512, 1.1-1.6x at 1024). The small shapes are noisy from run to run.
+ */
+#define WINOGRAD_MIN_CHANNELS 64
+#define WINOGRAD_F4_MIN_SIZE 28
+#define WINOGRAD_F2_MIN_SIZE 14
+#define WINOGRAD_F2_MIN_CHANNELS 256
+#define WINOGRAD_SMALL_MIN_CHANNELS 1024
+
+typedef float winograd_vec __attribute__((vector_size(WINOGRAD_LANES*sizeof(float))));
+
+typedef struct{
+    int m;            /* output tile size */
+    int alpha;        /* input tile size, m + 2 */
+    const float *bt;  /* alpha x alpha input transform */
+    const float *g;   /* alpha x 3 filter transform */
+    const float *at;  /* m x alpha output transform */
+} winograd_transform;
+
+static const float f2_bt[] = {
+    1,  0, -1,  0,
+    0,  1,  1,  0,
+    0, -1,  1,  0,
+    0,  1,  0, -1
+};
+static const float f2_g[] = {
+    1,   0,  0,
+    .5, .5, .5,
+    .5,-.5, .5,
+    0,   0,  1
+};
+static const float f2_at[] = {
+    1, 1,  1,  0,
+    0, 1, -1, -1
+};
+
+static const float f4_bt[] = {
+    4,  0, -5,  0, 1, 0,
+    0, -4, -4,  1, 1, 0,
+    0,  4, -4, -1, 1, 0,
+    0, -2, -1,  2, 1, 0,
+    0,  2, -1, -2, 1, 0,
+    0,  4,  0, -5, 0, 1
+};
+static const float f4_g[] = {
+    1/4.,      0,      0,
+    -1/6.,  -1/6., -1/6.,
+    -1/6.,   1/6., -1/6.,
+    1/24.,  1/12.,  1/6.,
+    1/24., -1/12.,  1/6.,
+    0,          0,      1
+};
+static const float f4_at[] = {
+    1, 1,  1, 1,  1, 0,
+    0, 1, -1, 2, -2, 0,
+    0, 1,  1, 4,  4, 0,
+    0, 1, -1, 8, -8, 1
+};
+
+static const winograd_transform winograd_f2 = {2, 4, f2_bt, f2_g, f2_at};
+static const winograd_transform winograd_f4 = {4, 6, f4_bt, f4_g, f4_at};
+
+static const winograd_transform *get_transform(int m)
+{
+    return (m == 4) ? &winograd_f4 : &winograd_f2;
+}
+
+static int tile_count(int size, int m)
+{
+    return (size + m - 1)/m;
+}
+
+/*
+ * y = left * x * right^T for r x p left, s x q right and p x q x. It is always inlined with
+ * constant matrices and unrolled, so the zeros and ones of the transforms fold away.
+ */
+static inline __attribute__((always_inline)) void transform_tile(const float *left, int r, const float *right, int s, int p, int q, const winograd_vec *x, winograd_vec *y)
+{
+    winograd_vec tmp[WINOGRAD_MAX_ALPHA*WINOGRAD_MAX_ALPHA];
+    int i, j, k;
+#pragma GCC unroll 6
+    for(i = 0; i < r; ++i){
+#pragma GCC unroll 6
+        for(j = 0; j < q; ++j){
+            winograd_vec acc = {0};
+#pragma GCC unroll 6
+            for(k = 0; k < p; ++k){
+                float c = left[i*p + k];
+                if(c == 1) acc += x[k*q + j];
+                else if(c == -1) acc -= x[k*q + j];
+                else if(c != 0) acc += c*x[k*q + j];
+            }
+            tmp[i*q + j] = acc;
+        }
+    }
+#pragma GCC unroll 6
+    for(i = 0; i < r; ++i){
+#pragma GCC unroll 6
+        for(j = 0; j < s; ++j){
+            winograd_vec acc = {0};
+#pragma GCC unroll 6
+            for(k = 0; k < q; ++k){
+                float c = right[j*q + k];
+                if(c == 1) acc += tmp[i*q + k];
+                else if(c == -1) acc -= tmp[i*q + k];
+                else if(c != 0) acc += c*tmp[i*q + k];
+            }
+            y[i*s + j] = acc;
+        }
+    }
+}
+
+static int select_winograd_tile(layer l)
+{
+    if(l.size != 3 || l.stride != 1 || l.binary || l.xnor) return 0;
+    int size = (l.out_w < l.out_h) ? l.out_w : l.out_h;
+    if(l.c < WINOGRAD_MIN_CHANNELS || l.n < WINOGRAD_MIN_CHANNELS) return 0;
+    if(size >= WINOGRAD_F4_MIN_SIZE) return 4;
+    if(size >= WINOGRAD_F2_MIN_SIZE) return (l.c >= WINOGRAD_F2_MIN_CHANNELS) ? 2 : 0;
+    return (l.c >= WINOGRAD_SMALL_MIN_CHANNELS) ? 2 : 0;
+}
+
+void setup_winograd_layer(layer *l)
+{
+    int tile = select_winograd_tile(*l);
+#ifdef WITH_CUDA
+    if(gpu_index >= 0) tile = 0;
+#endif
+    if(tile != l->winograd){
+        free(l->winograd_filters);
+        l->winograd_filters = 0;
+        l->winograd = tile;
+        if(tile){
+            int alpha = get_transform(tile)->alpha;
+            l->winograd_filters = calloc((size_t)alpha*alpha*l->n*l->c, sizeof(float));
+            if(!l->winograd_filters) malloc_error();
+        }
+    }
+    transform_winograd_filters(*l);
+}
+
+size_t get_winograd_workspace_size(layer l)
+{
+    if(!l.winograd) return 0;
+    const winograd_transform *t = get_transform(l.winograd);
+    size_t tiles = (size_t)tile_count(l.out_h, t->m)*tile_count(l.out_w, t->m);
+    return (size_t)t->alpha*t->alpha*tiles*(l.c + l.n)*sizeof(float);
+}
+
+void transform_winograd_filters(layer l)
+{
+    if(!l.winograd || !l.winograd_filters || !l.filters) return;
+    const winograd_transform *t = get_transform(l.winograd);
+    int alpha = t->alpha;
+    int o, c, i, j, k;
+    for(o = 0; o < l.n; ++o){
+        for(c = 0; c < l.c; ++c){
+            const float *g = l.filters + ((size_t)o*l.c + c)*9;
+            float tmp[WINOGRAD_MAX_ALPHA*3];
+            for(i = 0; i < alpha; ++i){
+                for(j = 0; j < 3; ++j){
+                    float sum = 0;
+                    for(k = 0; k < 3; ++k) sum += t->g[i*3 + k]*g[k*3 + j];
+                    tmp[i*3 + j] = sum;
+                }
+            }
+            /* Stored as alpha^2 matrices of n x c, the left operands of the per-position GEMMs. */
+            for(i = 0; i < alpha; ++i){
+                for(j = 0; j < alpha; ++j){
+                    float sum = 0;
+                    for(k = 0; k < 3; ++k) sum += tmp[i*3 + k]*t->g[j*3 + k];
+                    l.winograd_filters[((size_t)(i*alpha + j)*l.n + o)*l.c + c] = sum;
+                }
+            }
+        }
+    }
+}
+
+typedef struct{
+    layer l;
+    const float *input;
+    float *v;
+    const float *mv;
+    float *output;
+    const float *biases;
+    ACTIVATION activation;
+    int tiles_h, tiles_w;
+} winograd_args;
+
+static inline __attribute__((always_inline)) void transform_input(const winograd_transform *t, winograd_args *a, int begin, int end)
+{
+    int m = t->m, alpha = t->alpha;
+    int h = a->l.h, w = a->l.w, pad = a->l.pad;
+    size_t tiles = (size_t)a->tiles_h*a->tiles_w;
+    int c, ty, tx, i, j, v;
+    winograd_vec d[WINOGRAD_MAX_ALPHA*WINOGRAD_MAX_ALPHA];
+    winograd_vec u[WINOGRAD_MAX_ALPHA*WINOGRAD_MAX_ALPHA];
+
+    for(c = begin; c < end; ++c){
+        const float *in = a->input + (size_t)c*h*w;
+        for(ty = 0; ty < a->tiles_h; ++ty){
+            int y0 = ty*m - pad;
+            for(tx = 0; tx < a->tiles_w; tx += WINOGRAD_LANES){
+                int x0 = tx*m - pad;
+                int lanes = a->tiles_w - tx < WINOGRAD_LANES ? a->tiles_w - tx : WINOGRAD_LANES;
+                int inside = y0 >= 0 && y0 + alpha <= h && x0 >= 0 && x0 + (lanes-1)*m + alpha <= w;
+                for(i = 0; i < alpha; ++i){
+                    int y = y0 + i;
+                    const float *row = in + (size_t)y*w;
+                    for(j = 0; j < alpha; ++j){
+                        winograd_vec e = {0};
+                        if(inside){
+                            for(v = 0; v < lanes; ++v) e[v] = row[x0 + v*m + j];
+                        } else if(y >= 0 && y < h){
+                            for(v = 0; v < lanes; ++v){
+                                int x = x0 + v*m + j;
+                                if(x >= 0 && x < w) e[v] = row[x];
+                            }
+                        }
+                        d[i*alpha + j] = e;
+                    }
+                }
+                transform_tile(t->bt, alpha, t->bt, alpha, alpha, alpha, d, u);
+                for(i = 0; i < alpha*alpha; ++i){
+                    float *dst = a->v + ((size_t)i*a->l.c + c)*tiles + (size_t)ty*a->tiles_w + tx;
+                    memcpy(dst, &u[i], lanes*sizeof(float));
+                }
+            }
+        }
+    }
+}
+
+static inline float activate_output(float x, ACTIVATION a)
+{
+    switch(a){
+        case LINEAR:
+            return x;
+        case LEAKY:
+            return (x > 0) ? x : .1f*x;
+        case RELU:
+            return x*(x > 0);
+        default:
+            return activate(x, a);
+    }
+}
+
+static inline __attribute__((always_inline)) void transform_output(const winograd_transform *t, winograd_args *a, int begin, int end)
+{
+    int m = t->m, alpha = t->alpha;
+    int out_h = a->l.out_h, out_w = a->l.out_w;
+    size_t tiles = (size_t)a->tiles_h*a->tiles_w;
+    int o, ty, tx, i, j, v;
+    winograd_vec x[WINOGRAD_MAX_ALPHA*WINOGRAD_MAX_ALPHA];
+    winograd_vec y[WINOGRAD_MAX_ALPHA*WINOGRAD_MAX_ALPHA];
+
+    for(o = begin; o < end; ++o){
+        float bias = a->biases ? a->biases[o] : 0;
+        float *out = a->output + (size_t)o*out_h*out_w;
+        for(ty = 0; ty < a->tiles_h; ++ty){
+            for(tx = 0; tx < a->tiles_w; tx += WINOGRAD_LANES){
+                int lanes = a->tiles_w - tx < WINOGRAD_LANES ? a->tiles_w - tx : WINOGRAD_LANES;
+                for(i = 0; i < alpha*alpha; ++i){
+                    const float *src = a->mv + ((size_t)i*a->l.n + o)*tiles + (size_t)ty*a->tiles_w + tx;
+                    winograd_vec e = {0};
+                    memcpy(&e, src, lanes*sizeof(float));
+                    x[i] = e;
+                }
+                transform_tile(t->at, m, t->at, m, alpha, alpha, x, y);
+                for(i = 0; i < m; ++i){
+                    int oy = ty*m + i;
+                    if(oy >= out_h) break;
+                    float *row = out + (size_t)oy*out_w;
+                    for(v = 0; v < lanes; ++v){
+                        for(j = 0; j < m; ++j){
+                            int ox = (tx + v)*m + j;
+                            if(ox < out_w) row[ox] = activate_output(y[i*m + j][v] + bias, a->activation);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* One instance of the transforms for each tile size, so that the transform matrices are constants. */
+static void transform_input_f2(void *ctx, int begin, int end) { transform_input(&winograd_f2, (winograd_args *)ctx, begin, end); }
+static void transform_input_f4(void *ctx, int begin, int end) { transform_input(&winograd_f4, (winograd_args *)ctx, begin, end); }
+static void transform_output_f2(void *ctx, int begin, int end) { transform_output(&winograd_f2, (winograd_args *)ctx, begin, end); }
+static void transform_output_f4(void *ctx, int begin, int end) { transform_output(&winograd_f4, (winograd_args *)ctx, begin, end); }
+
+void winograd_convolution(layer l, const float *input, float *output, float *workspace, const float *biases, ACTIVATION activation)
+{
+    const winograd_transform *t = get_transform(l.winograd);
+    int positions = t->alpha*t->alpha;
+    int tiles_h = tile_count(l.out_h, t->m);
+    int tiles_w = tile_count(l.out_w, t->m);
+    int tiles = tiles_h*tiles_w;
+    float *v = workspace;
+    float *mv = workspace + (size_t)positions*l.c*tiles;
+    int i;
+
+    winograd_args a = {l, input, v, mv, output, biases, activation, tiles_h, tiles_w};
+    parallel_for(l.c, 1, (t->m == 4) ? transform_input_f4 : transform_input_f2, &a);
+
+    /* One (n x c) * (c x tiles) product for each position in a tile. */
+    for(i = 0; i < positions; ++i){
+        gemm_cpu_bias_activate(0, 0, l.n, tiles, l.c,
+                l.winograd_filters + (size_t)i*l.n*l.c, l.c,
+                v + (size_t)i*l.c*tiles, tiles,
+                mv + (size_t)i*l.n*tiles, tiles,
+                0, 0, LINEAR);
+    }
+
+    parallel_for(l.n, 1, (t->m == 4) ? transform_output_f4 : transform_output_f2, &a);
+}
+
+static double elapsed_ms(struct timeval start)
+{
+    struct timeval now;
+    gettimeofday(&now, 0);
+    return (now.tv_sec - start.tv_sec)*1000. + (now.tv_usec - start.tv_usec)/1000.;
+}
+
+static double time_im2col(layer l, const float *input, float *output, float *workspace, int repeats)
+{
+    int m = l.n, k = l.c*9, n = l.out_h*l.out_w;
+    int r;
+    struct timeval start;
+    gettimeofday(&start, 0);
+    for(r = 0; r < repeats; ++r){
+        im2col_cpu((float *)input, l.c, l.h, l.w, l.size, l.stride, l.pad, workspace);
+        gemm_cpu_bias_activate(0, 0, m, n, k, l.filters, k, workspace, n, output, n, l.biases, 0, l.activation);
+    }
+    return elapsed_ms(start)/repeats;
+}
+
+static double time_winograd(layer l, const float *input, float *output, float *workspace, int repeats)
+{
+    int r;
+    struct timeval start;
+    gettimeofday(&start, 0);
+    for(r = 0; r < repeats; ++r){
+        winograd_convolution(l, input, output, workspace, l.biases, l.activation);
+    }
+    return elapsed_ms(start)/repeats;
+}
+
+void benchmark_winograd_cpu()
+{
+    /* {c, n, size} for the 3x3 stride-1 layers of yolo.cfg at 448x448, and smaller channel counts to place the thresholds. */
+    static const int shapes[][3] = {
+        {  16,  32, 112},
+        {  32,  64, 112},
+        {  64, 192, 112},
+        { 128, 256,  56},
+        { 256, 512,  56},
+        { 256, 512,  28},
+        { 512,1024,  28},
+        { 512,1024,  14},
+        {1024,1024,  14},
+        {1024,1024,   7},
+        {  32,  32, 112},
+        {  32,  32,  28},
+        {  64,  64,  28},
+        {  64,  64,  14},
+        { 128, 128,  14},
+        { 256, 256,  14},
+        { 256, 256,   7},
+        { 512, 512,   7}
+    };
+    int s, i;
+    printf("Winograd convolution vs im2col + GEMM (%s), %d threads:\n", gemm_cpu_kernel_name(), get_cpu_threads());
+    for(s = 0; s < (int)(sizeof(shapes)/sizeof(shapes[0])); ++s){
+        layer l = {0};
+        int tile;
+        l.c = shapes[s][0];
+        l.n = shapes[s][1];
+        l.h = l.w = l.out_h = l.out_w = shapes[s][2];
+        l.size = 3;
+        l.stride = 1;
+        l.pad = 1;
+        l.activation = LEAKY;
+        l.filters = calloc((size_t)l.n*l.c*9, sizeof(float));
+        l.biases = calloc(l.n, sizeof(float));
+        for(i = 0; i < l.n*l.c*9; ++i) l.filters[i] = rand_uniform(-1, 1)/sqrt(l.c*9);
+        for(i = 0; i < l.n; ++i) l.biases[i] = rand_uniform(-.1, .1);
+
+        size_t im2col_size = (size_t)l.out_h*l.out_w*l.c*9;
+        size_t output_size = (size_t)l.out_h*l.out_w*l.n;
+        float *input = calloc((size_t)l.c*l.h*l.w, sizeof(float));
+        float *reference = calloc(output_size, sizeof(float));
+        float *output = calloc(output_size, sizeof(float));
+        for(i = 0; i < l.c*l.h*l.w; ++i) input[i] = rand_uniform(0, 1);
+
+        float *workspace = calloc(im2col_size, sizeof(float));
+        int repeats = 1 + (int)(2e9/((double)output_size*l.c*9*2));
+        double base = time_im2col(l, input, reference, workspace, repeats);
+        free(workspace);
+        printf("  %4d -> %4d at %3dx%-3d  im2col %8.2f ms", l.c, l.n, l.w, l.h, base);
+
+        for(tile = 2; tile <= 4; tile += 2){
+            float max_error = 0;
+            l.winograd = tile;
+            l.winograd_filters = calloc((size_t)get_transform(tile)->alpha*get_transform(tile)->alpha*l.n*l.c, sizeof(float));
+            transform_winograd_filters(l);
+            workspace = calloc(get_winograd_workspace_size(l), 1);
+            double ms = time_winograd(l, input, output, workspace, repeats);
+            for(i = 0; i < (int)output_size; ++i){
+                float e = fabs(output[i] - reference[i])/(fabs(reference[i]) + 1);
+                if(e > max_error) max_error = e;
+            }
+            printf("  F(%dx%d,3x3) %8.2f ms (%.2fx, error %.1e)", tile, tile, ms, base/ms, max_error);
+            free(workspace);
+            free(l.winograd_filters);
+        }
+        printf("\n");
+        free(l.filters);
+        free(l.biases);
+        free(input);
+        free(reference);
+        free(output);
+    }
+}
@@ -0,0 +1,141 @@
+/**
+ * tvgshape: BitMask.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#ifndef H_TVGSHAPE_BITMASK
+#define H_TVGSHAPE_BITMASK
+
+#include <ostream>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <opencv2/core/core.hpp>
+
+namespace tvgshape {
+
+/**
+ * \brief An instance of this class represents a binary mask placed in an image, packed 64 pixels to a word.
+ *
+ * Each row of the mask starts a new word, so rows can be addressed independently, and the bits past the end
+ * of a row are always zero. Bit j of word k of a row holds the pixel at x = 64k + j. The area of the mask is
+ * counted once when it is packed, so the intersection of two masks, which is an AND and a popcount per word,
+ * is all that is needed to compute their union and IoU as well. As with RLEMask, the mask covers a rectangle
+ * of the image whose top-left corner is at the specified offset, so masks with different rectangles can be
+ * compared; masks with the same rectangle (the common case) are compared with a single vectorised pass.
+ */
+class BitMask
+{
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The number of foreground pixels in the mask. */
+  size_t m_area;
+
+  /** The position of the top-left corner of the mask in the image. */
+  cv::Point m_offset;
+
+  /** The size of the mask. */
+  cv::Size m_size;
+
+  /** The packed rows of the mask. */
+  std::vector<boost::uint64_t> m_words;
+
+  /** The number of words used to store each row. */
+  int m_wordsPerRow;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs an empty mask.
+   */
+  BitMask();
+
+  /**
+   * \brief Packs a mask, treating every non-zero pixel as foreground.
+   *
+   * \param mask    The mask.
+   * \param offset  The position of the top-left corner of the mask in the image.
+   */
+  explicit BitMask(const cv::Mat1b& mask, const cv::Point& offset = cv::Point(0, 0));
+
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the name of the popcount kernel chosen for this CPU (e.g. "avx2").
+   */
+  static const char *kernel_name();
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the number of foreground pixels in the mask.
+   */
+  size_t area() const;
+
+  /**
+   * \brief Calculates the intersection over union of this mask and another one.
+   *
+   * \param rhs The other mask.
+   * \return    The IoU of the two masks (which is NaN if neither mask has any foreground).
+   */
+  double calculate_IoU(const BitMask& rhs) const;
+
+  /**
+   * \brief Calculates the number of pixels that are foreground in both this mask and another one.
+   *
+   * \param rhs The other mask.
+   * \return    The area of the intersection of the two masks.
+   */
+  size_t calculate_intersection_area(const BitMask& rhs) const;
+
+  /**
+   * \brief Calculates the number of pixels that are foreground in either this mask or another one.
+   *
+   * \param rhs The other mask.
+   * \return    The area of the union of the two masks.
+   */
+  size_t calculate_union_area(const BitMask& rhs) const;
+
+  /**
+   * \brief Gets whether or not the mask covers no pixels at all.
+   */
+  bool empty() const;
+
+  /**
+   * \brief Gets the position of the top-left corner of the mask in the image.
+   */
+  const cv::Point& get_offset() const;
+
+  /**
+   * \brief Gets the size of the mask.
+   */
+  const cv::Size& get_size() const;
+
+  /**
+   * \brief Unpacks the mask.
+   *
+   * \return  The mask, with foreground pixels set to 255 and background pixels set to 0.
+   */
+  cv::Mat1b to_mat() const;
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Gets the 64 bits of a row that start at the specified bit (which may be negative or past the end of the row, where the bits are zero).
+   */
+  boost::uint64_t bits_at(int y, int bit) const;
+
+  /**
+   * \brief Gets a pointer to the words of a row.
+   */
+  const boost::uint64_t *row(int y) const;
+};
+
+//#################### OUTPUT ####################
+
+std::ostream& operator<<(std::ostream& os, const BitMask& m);
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * tvgshape: NativeAEShapeDescriptorCalculator.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#ifndef H_TVGSHAPE_NATIVEAESHAPEDESCRIPTORCALCULATOR
+#define H_TVGSHAPE_NATIVEAESHAPEDESCRIPTORCALCULATOR
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "ShapeDescriptorCalculator.h"
+
+namespace tvgshape {
+
+/**
+ * \brief An instance of this class uses the encoder and decoder of a shape autoencoder, run in C++, to convert between masks and their descriptors.
+ *
+ * The networks are read once, from a model converted from Torch by resources/torch/export_autoenc.lua, and are only read thereafter,
+ * so unlike AEShapeDescriptorCalculator this needs neither Torch nor a lock, and a single calculator can be shared between threads.
+ * The descriptors passed to to_masks are decoded together, one matrix product per layer.
+ */
+class NativeAEShapeDescriptorCalculator : public ShapeDescriptorCalculator
+{
+  //#################### ENUMERATIONS ####################
+private:
+  /** The layer types that export_autoenc.lua can write (their values are those in the model file). */
+  enum LayerType
+  {
+    LINEAR = 1,
+    AFFINE = 2,
+    RELU = 3,
+    LEAKY_RELU = 4,
+    SIGMOID = 5,
+    TANH = 6
+  };
+
+  //#################### NESTED TYPES ####################
+private:
+  /**
+   * \brief An instance of this struct represents a layer of the encoder or decoder.
+   */
+  struct Layer
+  {
+    LayerType type;
+
+    /** The weights (outputs x inputs) of a linear layer, or the scales (1 x outputs) of an affine one. */
+    cv::Mat1f weights;
+
+    /** The biases (1 x outputs) of a linear or affine layer. */
+    cv::Mat1f biases;
+
+    /** The slope of a leaky ReLU for negative inputs. */
+    float negativeSlope;
+  };
+
+public:
+  /**
+   * \brief An instance of this struct records how closely the calculator reproduces the outputs of the Torch model on a reference set.
+   */
+  struct ReferenceComparison
+  {
+    /** The largest absolute difference between a descriptor and the one Torch computed from the same mask. */
+    float maxDescriptorError;
+
+    /** The largest absolute difference between a decoded mask value (in [0,1]) and the one Torch decoded from the same descriptor. */
+    float maxMaskError;
+
+    /** The number of pixels of the decoded masks that end up on the other side of the binary mask threshold. */
+    size_t mismatchedPixels;
+
+    /** The number of pixels in all the decoded masks. */
+    size_t pixelCount;
+  };
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The threshold above which a pixel of a decoded mask is part of the shape. */
+  int m_binaryMaskThreshold;
+
+  /** The layers of the decoder, which maps a descriptor to a maskSide x maskSide mask. */
+  std::vector<Layer> m_decoder;
+
+  /** The size of the descriptors. */
+  int m_descriptorSize;
+
+  /** The layers of the encoder, which maps a maskSide x maskSide mask to a descriptor. */
+  std::vector<Layer> m_encoder;
+
+  /** The side length of the masks the autoencoder works with. */
+  int m_maskSide;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a calculator from a converted autoencoder model.
+   *
+   * \param modelFilename        The model file written by export_autoenc.lua.
+   * \param descriptorSize       The size of the descriptors (which must match the model).
+   * \param binaryMaskThreshold  The threshold above which a pixel of a decoded mask is part of the shape.
+   * \throws std::runtime_error  If the model cannot be read or does not match the descriptor size.
+   */
+  NativeAEShapeDescriptorCalculator(const std::string& modelFilename, int descriptorSize, int binaryMaskThreshold = 128);
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Compares the outputs of the calculator with those of the Torch model on the reference set written alongside the model by export_autoenc.lua.
+   *
+   * \param referenceFilename    The reference file.
+   * \return                     The comparison.
+   * \throws std::runtime_error  If the reference file cannot be read or does not match the model.
+   */
+  ReferenceComparison compare_with_reference(const std::string& referenceFilename) const;
+
+  /** Override */
+  virtual std::vector<float> from_mask(const cv::Mat1b& mask, size_t descriptorSize) const;
+
+  /** Override */
+  virtual cv::Mat1b to_mask(const std::vector<float>& descriptor, const cv::Size& maskSize) const;
+
+  /** Override */
+  virtual std::vector<cv::Mat1b> to_masks(const std::vector<std::vector<float> >& descriptors, const std::vector<cv::Size>& maskSizes) const;
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Turns a row of decoder output into a binary mask of the specified size.
+   */
+  cv::Mat1b make_mask(const cv::Mat1f& decoded, const cv::Size& maskSize) const;
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Reads the layers of a network from a model file.
+   */
+  static std::vector<Layer> read_network(std::istream& is);
+
+  /**
+   * \brief Runs a batch of inputs (one per row) through a network.
+   */
+  static cv::Mat1f run_network(const std::vector<Layer>& layers, const cv::Mat1f& input);
+};
+
+}
+
+#endif
@@ -47,18 +47,64 @@ public:
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
-  /** Override */
+  /**
+   * \brief Fits a descriptor to a mask.
+   *
+   * The candidates (one per centre and mode) are cast and scored against the mask in parallel, using an IoU estimated
+   * from the scanline spans of each candidate's polygon rather than a rasterised mask. Only the candidates whose
+   * estimate is close to the best one are then decoded with to_mask and scored exactly, in the same order as the
+   * exhaustive search, so the result matches from_mask_exhaustive unless the estimate is far out.
+   */
   virtual std::vector<float> from_mask(const cv::Mat1b& originalMask, size_t descriptorSize) const;
 
+  /**
+   * \brief Fits a descriptor to a mask by decoding every candidate with to_mask and scoring it exactly.
+   *
+   * This is much slower than from_mask, against which it serves as the reference.
+   */
+  std::vector<float> from_mask_exhaustive(const cv::Mat1b& originalMask, size_t descriptorSize) const;
+
   /** Override */
   virtual cv::Mat1b to_mask(const std::vector<float>& descriptor, const cv::Size& maskSize) const;
 
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
   /**
-   * \brief TODO
+   * \brief Casts the rays of the descriptors of both modes for the specified centre (the modes differ only in where a ray stops).
+   */
+  void cast_rays(const cv::Mat1b& mask, float cx, float cy, const std::vector<float>& cosines, const std::vector<float>& sines,
+                 std::vector<float>& insideOutDescriptor, std::vector<float>& outsideInDescriptor) const;
+
+  /**
+   * \brief Estimates the IoU of the mask that to_mask would decode from a descriptor with the original mask.
+   *
+   * The polygon that to_mask draws is intersected with the row through the sample point of each row of the
+   * original mask, and the foreground pixels inside the resulting spans are counted from per-row prefix sums.
+   */
+  double estimate_IoU(const std::vector<float>& descriptor, const cv::Size& maskSize, const std::vector<float>& cosines, const std::vector<float>& sines,
+                      const std::vector<int>& rowPrefixSums, int maskArea) const;
+
+  /**
+   * \brief Gets the canvas (m_outputMaskSize x m_outputMaskSize) vertices of the polygon that to_mask draws for a descriptor.
+   */
+  std::vector<cv::Point2i> make_contour(const std::vector<float>& descriptor, const std::vector<float>& cosines, const std::vector<float>& sines) const;
+
+  /**
+   * \brief Makes the mask that is fitted, from the original mask.
+   */
+  cv::Mat1b make_input_mask(const cv::Mat1b& originalMask) const;
+
+  /**
+   * \brief Makes the candidate centres, in the order in which they are searched.
+   */
+  std::vector<cv::Point2f> make_centres() const;
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Tabulates the direction of each ray of a descriptor of the specified size.
    */
-  std::vector<float> from_mask(const cv::Mat1b& mask, size_t descriptorSize, Mode mode, float cx, float cy) const;
+  static void make_direction_table(size_t descriptorSize, std::vector<float>& cosines, std::vector<float>& sines);
 };
 
 }
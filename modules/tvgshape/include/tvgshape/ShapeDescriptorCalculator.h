@@ -36,6 +36,27 @@ public:
    * \brief TODO
    */
   virtual cv::Mat1b to_mask(const std::vector<float>& descriptor, const cv::Size& maskSize) const = 0;
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Converts a set of descriptors (e.g. those of all the detections in an image) to masks.
+   *
+   * By default the descriptors are converted one at a time; calculators that can share work between them override this.
+   *
+   * \param descriptors  The descriptors.
+   * \param maskSizes    The size of the mask to make from each descriptor.
+   * \return             The masks.
+   */
+  virtual std::vector<cv::Mat1b> to_masks(const std::vector<std::vector<float> >& descriptors, const std::vector<cv::Size>& maskSizes) const
+  {
+    std::vector<cv::Mat1b> masks(descriptors.size());
+    for(size_t i = 0, size = descriptors.size(); i < size; ++i)
+    {
+      masks[i] = to_mask(descriptors[i], maskSizes[i]);
+    }
+    return masks;
+  }
 };
 
 typedef boost::shared_ptr<ShapeDescriptorCalculator> ShapeDescriptorCalculator_Ptr;
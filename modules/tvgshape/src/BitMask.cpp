@@ -0,0 +1,342 @@
+/**
+ * tvgshape: BitMask.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#include "BitMask.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define BITMASK_X86
+  #include <immintrin.h>
+#endif
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+namespace {
+
+//#################### LOCAL TYPES ####################
+
+/**
+ * \brief An instance of this struct represents an implementation of the kernel that counts the set bits of the AND of two arrays of words.
+ *
+ * The area of a mask is the same count for the AND of the mask with itself, so this is the only kernel that is needed.
+ */
+struct PopcountKernel
+{
+  const char *name;
+  size_t (*and_popcount)(const boost::uint64_t *a, const boost::uint64_t *b, size_t n);
+};
+
+//#################### LOCAL FUNCTIONS ####################
+
+inline size_t popcount_word(boost::uint64_t x)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<size_t>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+size_t and_popcount_c(const boost::uint64_t *a, const boost::uint64_t *b, size_t n)
+{
+  size_t result = 0;
+  for(size_t i = 0; i < n; ++i) result += popcount_word(a[i] & b[i]);
+  return result;
+}
+
+#ifdef BITMASK_X86
+
+__attribute__((target("popcnt")))
+size_t and_popcount_popcnt(const boost::uint64_t *a, const boost::uint64_t *b, size_t n)
+{
+  // Four independent sums, so that consecutive popcnt instructions do not wait on each other.
+  size_t s0 = 0, s1 = 0, s2 = 0, s3 = 0, i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    s0 += __builtin_popcountll(a[i] & b[i]);
+    s1 += __builtin_popcountll(a[i+1] & b[i+1]);
+    s2 += __builtin_popcountll(a[i+2] & b[i+2]);
+    s3 += __builtin_popcountll(a[i+3] & b[i+3]);
+  }
+  for(; i < n; ++i) s0 += __builtin_popcountll(a[i] & b[i]);
+  return s0 + s1 + s2 + s3;
+}
+
+/*
+ * Counts the bits of each nibble with a 16-entry table lookup (vpshufb), accumulating the per-byte counts for up to
+ * 31 iterations (each adds at most 8 to a byte) before summing them into 64-bit lanes with vpsadbw.
+ */
+__attribute__((target("avx2,popcnt")))
+size_t and_popcount_avx2(const boost::uint64_t *a, const boost::uint64_t *b, size_t n)
+{
+  const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+  const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+
+  __m256i total = zero;
+  size_t i = 0;
+  const size_t vectorEnd = n - n % 4;
+  while(i < vectorEnd)
+  {
+    __m256i counts = zero;
+    const size_t blockEnd = std::min(vectorEnd, i + 4 * 31);
+    for(; i < blockEnd; i += 4)
+    {
+      const __m256i v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+      const __m256i lo = _mm256_and_si256(v, lowNibbles);
+      const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibbles);
+      counts = _mm256_add_epi8(counts, _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi)));
+    }
+    total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, zero));
+  }
+
+  boost::uint64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+  size_t result = static_cast<size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+  for(; i < n; ++i) result += __builtin_popcountll(a[i] & b[i]);
+  return result;
+}
+
+#endif
+
+/** The kernels, in order of preference. */
+const PopcountKernel popcount_kernels[] = {
+#ifdef BITMASK_X86
+  { "avx2", and_popcount_avx2 },
+  { "popcnt", and_popcount_popcnt },
+#endif
+  { "c", and_popcount_c }
+};
+
+bool popcount_kernel_supported(const PopcountKernel& kernel)
+{
+#ifdef BITMASK_X86
+  if(std::strcmp(kernel.name, "avx2") == 0) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+  if(std::strcmp(kernel.name, "popcnt") == 0) return __builtin_cpu_supports("popcnt") != 0;
+#endif
+  return true;
+}
+
+const PopcountKernel *select_popcount_kernel()
+{
+  const size_t kernelCount = sizeof(popcount_kernels) / sizeof(popcount_kernels[0]);
+  for(size_t i = 0; i < kernelCount; ++i)
+  {
+    if(popcount_kernel_supported(popcount_kernels[i])) return &popcount_kernels[i];
+  }
+  return &popcount_kernels[kernelCount - 1];
+}
+
+const PopcountKernel& popcount_kernel()
+{
+  static const PopcountKernel *kernel = select_popcount_kernel();
+  return *kernel;
+}
+
+/**
+ * \brief Packs a row of pixels into words, setting the bit of every non-zero pixel.
+ *
+ * Each word is built up in a register and stored once (the pixels are chars, so they could alias the words).
+ */
+void pack_row(const unsigned char *pixels, int width, boost::uint64_t *words)
+{
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+#endif
+  for(int x = 0; x < width; x += 64)
+  {
+    const int end = std::min(width, x + 64);
+    boost::uint64_t word = 0;
+    int i = x;
+#ifdef __SSE2__
+    // Compare 16 pixels at a time with zero and gather the results into 16 bits with a byte movemask.
+    for(; i + 16 <= end; i += 16)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+      const boost::uint64_t zeroBits = static_cast<boost::uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)));
+      word |= (~zeroBits & 0xffffULL) << (i - x);
+    }
+
+    // Finish the row with the 16 pixels that end it, dropping those that have already been packed.
+    if(i < end && end >= 16)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + end - 16));
+      const boost::uint64_t zeroBits = static_cast<boost::uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)));
+      word |= ((~zeroBits & 0xffffULL) >> (16 - (end - i))) << (i - x);
+      i = end;
+    }
+#endif
+    for(; i < end; ++i)
+    {
+      word |= static_cast<boost::uint64_t>(pixels[i] != 0) << (i - x);
+    }
+    words[x / 64] = word;
+  }
+}
+
+}
+
+namespace tvgshape {
+
+//#################### CONSTRUCTORS ####################
+
+BitMask::BitMask()
+: m_area(0), m_offset(0, 0), m_size(0, 0), m_wordsPerRow(0)
+{}
+
+BitMask::BitMask(const cv::Mat1b& mask, const cv::Point& offset)
+: m_area(0), m_offset(offset), m_size(mask.size()), m_wordsPerRow((mask.cols + 63) / 64)
+{
+  // A mask with no pixels has no words, and so no rows to pack (even if it has a height).
+  m_words.assign(static_cast<size_t>(m_wordsPerRow) * mask.rows, 0);
+  if(m_words.empty()) return;
+
+  for(int y = 0; y < mask.rows; ++y)
+  {
+    pack_row(mask.ptr<unsigned char>(y), mask.cols, &m_words[static_cast<size_t>(y) * m_wordsPerRow]);
+  }
+
+  m_area = popcount_kernel().and_popcount(&m_words[0], &m_words[0], m_words.size());
+}
+
+//#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+const char *BitMask::kernel_name()
+{
+  return popcount_kernel().name;
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+size_t BitMask::area() const
+{
+  return m_area;
+}
+
+double BitMask::calculate_IoU(const BitMask& rhs) const
+{
+  const size_t intersectionArea = calculate_intersection_area(rhs);
+  const size_t unionArea = m_area + rhs.m_area - intersectionArea;
+  if(unionArea == 0) return std::numeric_limits<double>::quiet_NaN();
+  return static_cast<double>(intersectionArea) / unionArea;
+}
+
+size_t BitMask::calculate_intersection_area(const BitMask& rhs) const
+{
+  // Early out if the rectangles covered by the masks do not overlap.
+  const cv::Rect overlap = cv::Rect(m_offset, m_size) & cv::Rect(rhs.m_offset, rhs.m_size);
+  if(overlap.area() <= 0 || m_area == 0 || rhs.m_area == 0) return 0;
+
+  const PopcountKernel& kernel = popcount_kernel();
+
+  // If the masks have the same rectangle, their words line up and the rows are contiguous, so they can be compared in one pass.
+  if(m_offset == rhs.m_offset && m_size == rhs.m_size)
+  {
+    return kernel.and_popcount(&m_words[0], &rhs.m_words[0], m_words.size());
+  }
+
+  // If the masks start at the same x, their words still line up, and the bits past the end of the narrower rows are zero.
+  if(m_offset.x == rhs.m_offset.x)
+  {
+    const int wordCount = std::min(m_wordsPerRow, rhs.m_wordsPerRow);
+    size_t result = 0;
+    for(int y = overlap.y, yEnd = overlap.y + overlap.height; y < yEnd; ++y)
+    {
+      result += kernel.and_popcount(row(y - m_offset.y), rhs.row(y - rhs.m_offset.y), wordCount);
+    }
+    return result;
+  }
+
+  // Otherwise, shift the bits of the other mask into line with each word of this one that covers the overlap.
+  const int bitShift = m_offset.x - rhs.m_offset.x;
+  const int wordBegin = (overlap.x - m_offset.x) / 64;
+  const int wordEnd = (overlap.x + overlap.width - m_offset.x + 63) / 64;
+  size_t result = 0;
+  for(int y = overlap.y, yEnd = overlap.y + overlap.height; y < yEnd; ++y)
+  {
+    const boost::uint64_t *words = row(y - m_offset.y);
+    for(int k = wordBegin; k < wordEnd; ++k)
+    {
+      result += popcount_word(words[k] & rhs.bits_at(y - rhs.m_offset.y, 64 * k + bitShift));
+    }
+  }
+  return result;
+}
+
+size_t BitMask::calculate_union_area(const BitMask& rhs) const
+{
+  return m_area + rhs.m_area - calculate_intersection_area(rhs);
+}
+
+bool BitMask::empty() const
+{
+  return m_size.area() == 0;
+}
+
+const cv::Point& BitMask::get_offset() const
+{
+  return m_offset;
+}
+
+const cv::Size& BitMask::get_size() const
+{
+  return m_size;
+}
+
+cv::Mat1b BitMask::to_mat() const
+{
+  cv::Mat1b mask = cv::Mat1b::zeros(m_size);
+  if(m_words.empty()) return mask;
+
+  for(int y = 0; y < m_size.height; ++y)
+  {
+    const boost::uint64_t *words = row(y);
+    unsigned char *pixels = mask.ptr<unsigned char>(y);
+    for(int x = 0; x < m_size.width; ++x)
+    {
+      if((words[x / 64] >> (x % 64)) & 1) pixels[x] = 255;
+    }
+  }
+  return mask;
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+boost::uint64_t BitMask::bits_at(int y, int bit) const
+{
+  if(bit <= -64 || bit >= 64 * m_wordsPerRow) return 0;
+
+  const boost::uint64_t *words = row(y);
+  if(bit < 0) return words[0] << -bit;
+
+  const int k = bit / 64, shift = bit % 64;
+  boost::uint64_t result = words[k] >> shift;
+  if(shift != 0 && k + 1 < m_wordsPerRow) result |= words[k + 1] << (64 - shift);
+  return result;
+}
+
+const boost::uint64_t *BitMask::row(int y) const
+{
+  return &m_words[static_cast<size_t>(y) * m_wordsPerRow];
+}
+
+//#################### OUTPUT ####################
+
+std::ostream& operator<<(std::ostream& os, const BitMask& m)
+{
+  os << "BitMask(" << m.get_offset().x << ',' << m.get_offset().y << ' ' << m.get_size().width << 'x' << m.get_size().height
+     << ", area " << m.area() << ')';
+  return os;
+}
+
+}
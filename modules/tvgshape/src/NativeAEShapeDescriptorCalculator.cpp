@@ -0,0 +1,242 @@
+/**
+ * tvgshape: NativeAEShapeDescriptorCalculator.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#include "NativeAEShapeDescriptorCalculator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+
+#include "ShapeDescriptorUtil.h"
+
+namespace {
+
+/** The version of the model and reference files written by export_autoenc.lua. */
+const int FILE_VERSION = 1;
+
+int read_int(std::istream& is)
+{
+  int value;
+  if(!is.read(reinterpret_cast<char*>(&value), sizeof(int))) throw std::runtime_error("Unexpected end of autoencoder file");
+  return value;
+}
+
+void read_floats(std::istream& is, cv::Mat1f& m, int rows, int cols)
+{
+  m.create(rows, cols);
+  if(!is.read(reinterpret_cast<char*>(m.ptr<float>()), sizeof(float) * rows * cols)) throw std::runtime_error("Unexpected end of autoencoder file");
+}
+
+}
+
+namespace tvgshape {
+
+//#################### CONSTRUCTORS ####################
+
+NativeAEShapeDescriptorCalculator::NativeAEShapeDescriptorCalculator(const std::string& modelFilename, int descriptorSize, int binaryMaskThreshold)
+: m_binaryMaskThreshold(binaryMaskThreshold), m_descriptorSize(descriptorSize)
+{
+  std::ifstream fs(modelFilename.c_str(), std::ios::binary);
+  if(!fs) throw std::runtime_error("Could not open the autoencoder model: " + modelFilename);
+
+  if(read_int(fs) != FILE_VERSION) throw std::runtime_error("Unknown autoencoder model version: " + modelFilename);
+  m_maskSide = read_int(fs);
+  if(read_int(fs) != descriptorSize)
+  {
+    throw std::runtime_error("The autoencoder model " + modelFilename + " does not have descriptors of size " + boost::lexical_cast<std::string>(descriptorSize));
+  }
+
+  m_encoder = read_network(fs);
+  m_decoder = read_network(fs);
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+NativeAEShapeDescriptorCalculator::ReferenceComparison NativeAEShapeDescriptorCalculator::compare_with_reference(const std::string& referenceFilename) const
+{
+  std::ifstream fs(referenceFilename.c_str(), std::ios::binary);
+  if(!fs) throw std::runtime_error("Could not open the autoencoder reference: " + referenceFilename);
+
+  if(read_int(fs) != FILE_VERSION) throw std::runtime_error("Unknown autoencoder reference version: " + referenceFilename);
+  int count = read_int(fs);
+  if(read_int(fs) != m_maskSide || read_int(fs) != m_descriptorSize) throw std::runtime_error("The autoencoder reference does not match the model: " + referenceFilename);
+
+  const int pixelsPerMask = m_maskSide * m_maskSide;
+  cv::Mat1f masks, descriptors, decoded;
+  read_floats(fs, masks, count, pixelsPerMask);
+  read_floats(fs, descriptors, count, m_descriptorSize);
+  read_floats(fs, decoded, count, pixelsPerMask);
+
+  // The decoder is compared on the descriptors Torch computed, so that the errors of the encoder do not carry over.
+  cv::Mat1f nativeDescriptors = run_network(m_encoder, masks);
+  cv::Mat1f nativeDecoded = run_network(m_decoder, descriptors);
+
+  ReferenceComparison comparison;
+  comparison.maxDescriptorError = static_cast<float>(cv::norm(nativeDescriptors, descriptors, cv::NORM_INF));
+  comparison.maxMaskError = static_cast<float>(cv::norm(nativeDecoded, decoded, cv::NORM_INF));
+  comparison.mismatchedPixels = 0;
+  comparison.pixelCount = static_cast<size_t>(count) * pixelsPerMask;
+  for(int i = 0; i < count; ++i)
+  {
+    for(int j = 0; j < pixelsPerMask; ++j)
+    {
+      // The same quantisation and threshold as make_mask (before resizing).
+      int nativeValue = static_cast<unsigned char>(std::min(std::max(nativeDecoded(i,j) * 255.0f, 0.0f), 255.0f));
+      int torchValue = static_cast<unsigned char>(std::min(std::max(decoded(i,j) * 255.0f, 0.0f), 255.0f));
+      if((nativeValue > m_binaryMaskThreshold) != (torchValue > m_binaryMaskThreshold)) ++comparison.mismatchedPixels;
+    }
+  }
+
+  return comparison;
+}
+
+std::vector<float> NativeAEShapeDescriptorCalculator::from_mask(const cv::Mat1b& mask, size_t descriptorSize) const
+{
+  if(descriptorSize != static_cast<size_t>(m_descriptorSize)) throw std::runtime_error("The descriptor size does not match that of the autoencoder");
+
+  cv::Mat1b resizedMask;
+  cv::resize(mask, resizedMask, cv::Size(m_maskSide, m_maskSide), 0.0, 0.0, cv::INTER_AREA);
+
+  std::vector<float> linearisedMask = ShapeDescriptorUtil::make_gray_image(resizedMask, 1/255.0f);
+  cv::Mat1f descriptor = run_network(m_encoder, cv::Mat1f(linearisedMask, false).reshape(1, 1));
+  return std::vector<float>(descriptor.begin(), descriptor.end());
+}
+
+cv::Mat1b NativeAEShapeDescriptorCalculator::to_mask(const std::vector<float>& descriptor, const cv::Size& maskSize) const
+{
+  return to_masks(std::vector<std::vector<float> >(1, descriptor), std::vector<cv::Size>(1, maskSize))[0];
+}
+
+std::vector<cv::Mat1b> NativeAEShapeDescriptorCalculator::to_masks(const std::vector<std::vector<float> >& descriptors, const std::vector<cv::Size>& maskSizes) const
+{
+  std::vector<cv::Mat1b> masks(descriptors.size());
+  if(descriptors.empty()) return masks;
+
+  cv::Mat1f input(static_cast<int>(descriptors.size()), m_descriptorSize);
+  for(size_t i = 0, size = descriptors.size(); i < size; ++i)
+  {
+    if(descriptors[i].size() != static_cast<size_t>(m_descriptorSize)) throw std::runtime_error("The descriptor size does not match that of the autoencoder");
+    std::copy(descriptors[i].begin(), descriptors[i].end(), input[static_cast<int>(i)]);
+  }
+
+  cv::Mat1f decoded = run_network(m_decoder, input);
+  for(size_t i = 0, size = descriptors.size(); i < size; ++i)
+  {
+    masks[i] = make_mask(decoded.row(static_cast<int>(i)), maskSizes[i]);
+  }
+  return masks;
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+cv::Mat1b NativeAEShapeDescriptorCalculator::make_mask(const cv::Mat1f& decoded, const cv::Size& maskSize) const
+{
+  // The same steps as AEShapeDescriptorCalculator::to_mask, so that both give the same masks for the same decoder output.
+  std::vector<float> linearisedMask(decoded.begin(), decoded.end());
+  cv::Mat1b outputMask = ShapeDescriptorUtil::make_gray_image(linearisedMask, m_maskSide, m_maskSide, 255.0f);
+
+  cv::Mat1b finalMask;
+  cv::resize(outputMask, finalMask, maskSize, 0.0, 0.0, cv::INTER_CUBIC);
+  cv::threshold(finalMask, finalMask, m_binaryMaskThreshold, 255, cv::THRESH_BINARY);
+  return finalMask;
+}
+
+//#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+
+std::vector<NativeAEShapeDescriptorCalculator::Layer> NativeAEShapeDescriptorCalculator::read_network(std::istream& is)
+{
+  int layerCount = read_int(is);
+  std::vector<Layer> layers(layerCount);
+  for(int i = 0; i < layerCount; ++i)
+  {
+    Layer& layer = layers[i];
+    layer.type = static_cast<LayerType>(read_int(is));
+    int inputs = read_int(is);
+    int outputs = read_int(is);
+    layer.negativeSlope = 0.0f;
+
+    switch(layer.type)
+    {
+      case LINEAR:
+        read_floats(is, layer.weights, outputs, inputs);
+        read_floats(is, layer.biases, 1, outputs);
+        break;
+      case AFFINE:
+        read_floats(is, layer.weights, 1, outputs);
+        read_floats(is, layer.biases, 1, outputs);
+        break;
+      case LEAKY_RELU:
+      {
+        cv::Mat1f slope;
+        read_floats(is, slope, 1, 1);
+        layer.negativeSlope = slope(0,0);
+        break;
+      }
+      case RELU:
+      case SIGMOID:
+      case TANH:
+        break;
+      default:
+        throw std::runtime_error("Unknown autoencoder layer type: " + boost::lexical_cast<std::string>(layer.type));
+    }
+  }
+  return layers;
+}
+
+cv::Mat1f NativeAEShapeDescriptorCalculator::run_network(const std::vector<Layer>& layers, const cv::Mat1f& input)
+{
+  cv::Mat1f x = input.clone();
+  for(size_t i = 0, size = layers.size(); i < size; ++i)
+  {
+    const Layer& layer = layers[i];
+    switch(layer.type)
+    {
+      case LINEAR:
+      {
+        if(x.cols != layer.weights.cols) throw std::runtime_error("The input does not match the size of the autoencoder layer");
+        cv::Mat1f y;
+        cv::gemm(x, layer.weights, 1.0, cv::noArray(), 0.0, y, cv::GEMM_2_T);
+        for(int r = 0; r < y.rows; ++r) y.row(r) += layer.biases;
+        x = y;
+        break;
+      }
+      case AFFINE:
+        for(int r = 0; r < x.rows; ++r)
+        {
+          cv::Mat1f row = x.row(r);
+          cv::multiply(row, layer.weights, row);
+          row += layer.biases;
+        }
+        break;
+      case RELU:
+        x = cv::max(x, 0.0f);
+        break;
+      case LEAKY_RELU:
+        for(cv::Mat1f::iterator it = x.begin(), iend = x.end(); it != iend; ++it)
+        {
+          if(*it < 0.0f) *it *= layer.negativeSlope;
+        }
+        break;
+      case SIGMOID:
+        for(cv::Mat1f::iterator it = x.begin(), iend = x.end(); it != iend; ++it)
+        {
+          *it = 1.0f / (1.0f + std::exp(-*it));
+        }
+        break;
+      case TANH:
+        for(cv::Mat1f::iterator it = x.begin(), iend = x.end(); it != iend; ++it)
+        {
+          *it = std::tanh(*it);
+        }
+        break;
+    }
+  }
+  return x;
+}
+
+}
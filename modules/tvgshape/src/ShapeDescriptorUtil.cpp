@@ -5,6 +5,8 @@
 
 #include "ShapeDescriptorUtil.h"
 
+#include "BitMask.h"
+
 namespace tvgshape {
 
 //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
@@ -13,17 +15,7 @@ double ShapeDescriptorUtil::calculate_IoU(const cv::Mat1b& mask1, const cv::Mat1
 {
   if(mask1.size() != mask2.size()) return 0.0;
 
-  const unsigned char *p1 = mask1.data;
-  const unsigned char *p2 = mask2.data;
-
-  double Intersection = 0.0, Union = 0.0;
-  for(size_t i = 0, size = mask1.rows * mask1.cols; i < size; ++i)
-  {
-    if(p1[i] && p2[i]) ++Intersection;
-    if(p1[i] || p2[i]) ++Union;
-  }
-
-  return Intersection / Union;
+  return BitMask(mask1).calculate_IoU(BitMask(mask2));
 }
 
 bool ShapeDescriptorUtil::is_perfect_square(size_t k)
@@ -0,0 +1,332 @@
+/**
+ * tvgutil: SPSCQueue.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016, All rights reserved.
+ */
+
+#ifndef H_TVGUTIL_SPSCQUEUE
+#define H_TVGUTIL_SPSCQUEUE
+
+#include <atomic>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/chrono/chrono.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+
+namespace tvgutil {
+
+/**
+ * \brief An instance of an instantiation of this class template represents a bounded queue that passes items
+ *        from exactly one producer thread to exactly one consumer thread.
+ *
+ * Pushes and pops that do not need to wait only touch two atomic indices. A thread that finds the queue full
+ * (or empty) sleeps on a condition variable until the other side makes progress, a timeout expires or the
+ * queue is closed. Closing the queue marks the end of the stream: the consumer can still pop the remaining
+ * items, after which pop returns false, and any further push is refused.
+ */
+template <typename T>
+class SPSCQueue
+{
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The slots of the ring buffer. */
+  std::vector<T> m_buffer;
+
+  /** The maximum number of items the queue can hold. */
+  size_t m_capacity;
+
+  /** Whether or not the queue has been closed. */
+  std::atomic<bool> m_closed;
+
+  /** Whether or not the consumer is (about to start) waiting for an item. */
+  std::atomic<bool> m_consumerWaiting;
+
+  /** Signalled when an item is pushed or the queue is closed. */
+  boost::condition_variable m_itemPushed;
+
+  /** Signalled when an item is popped or the queue is closed. */
+  boost::condition_variable m_itemPopped;
+
+  /** The mutex used by the waiting side (never taken by a push or pop that can proceed straight away). */
+  boost::mutex m_mutex;
+
+  /** Whether or not the producer is (about to start) waiting for a free slot. */
+  std::atomic<bool> m_producerWaiting;
+
+  // Padding that keeps the two indices on separate cache lines, so that the producer and consumer do not contend for them.
+  char m_padding0[64];
+
+  /** The number of items popped so far (written only by the consumer). */
+  std::atomic<size_t> m_head;
+
+  char m_padding1[64];
+
+  /** The number of items pushed so far (written only by the producer). */
+  std::atomic<size_t> m_tail;
+
+  char m_padding2[64];
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a queue that can hold up to the specified number of items.
+   *
+   * \param capacity  The maximum number of items the queue can hold.
+   */
+  explicit SPSCQueue(size_t capacity)
+  : m_buffer(capacity),
+    m_capacity(capacity),
+    m_closed(false),
+    m_consumerWaiting(false),
+    m_producerWaiting(false),
+    m_head(0),
+    m_tail(0)
+  {
+    if(capacity < 1) throw std::runtime_error("Cannot create a single-producer single-consumer queue with zero capacity");
+  }
+
+  //#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+  // Deliberately private and unimplemented.
+  SPSCQueue(const SPSCQueue&);
+  SPSCQueue& operator=(const SPSCQueue&);
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the maximum number of items the queue can hold.
+   *
+   * \return  The capacity of the queue.
+   */
+  size_t capacity() const
+  {
+    return m_capacity;
+  }
+
+  /**
+   * \brief Closes the queue, waking up any thread that is waiting on it.
+   *
+   * Either side may close the queue: the producer to signal the end of the stream, or the consumer to tell
+   * the producer that no more items are wanted.
+   */
+  void close()
+  {
+    m_closed.store(true);
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_itemPushed.notify_all();
+    m_itemPopped.notify_all();
+  }
+
+  /**
+   * \brief Gets whether or not the queue has been closed.
+   *
+   * \return  true, if the queue has been closed, or false otherwise.
+   */
+  bool closed() const
+  {
+    return m_closed.load();
+  }
+
+  /**
+   * \brief Waits until an item is available and moves it out of the queue.
+   *
+   * \param item  The variable into which to move the item.
+   * \return      true, if an item was popped, or false if the queue has been closed and drained.
+   */
+  bool pop(T& item)
+  {
+    return pop_until(item, boost::none);
+  }
+
+  /**
+   * \brief Waits up to the specified time for an item to become available and moves it out of the queue.
+   *
+   * \param item    The variable into which to move the item.
+   * \param timeout The maximum time for which to wait.
+   * \return        true, if an item was popped, or false if the wait timed out or the queue has been closed and drained.
+   */
+  template <typename Rep, typename Period>
+  bool pop(T& item, const boost::chrono::duration<Rep,Period>& timeout)
+  {
+    return pop_until(item, boost::chrono::steady_clock::now() + timeout);
+  }
+
+  /**
+   * \brief Waits until there is a free slot and moves the specified item into the queue.
+   *
+   * \param item  The item to push.
+   * \return      true, if the item was pushed, or false if the queue has been closed.
+   */
+  bool push(T&& item)
+  {
+    return push_until(item, boost::none);
+  }
+
+  /**
+   * \brief Waits until there is a free slot and copies the specified item into the queue.
+   *
+   * \param item  The item to push.
+   * \return      true, if the item was pushed, or false if the queue has been closed.
+   */
+  bool push(const T& item)
+  {
+    T copy(item);
+    return push_until(copy, boost::none);
+  }
+
+  /**
+   * \brief Waits up to the specified time for a free slot and moves the specified item into the queue.
+   *
+   * If the item cannot be pushed, it is left untouched.
+   *
+   * \param item    The item to push.
+   * \param timeout The maximum time for which to wait.
+   * \return        true, if the item was pushed, or false if the wait timed out or the queue has been closed.
+   */
+  template <typename Rep, typename Period>
+  bool push(T& item, const boost::chrono::duration<Rep,Period>& timeout)
+  {
+    return push_until(item, boost::chrono::steady_clock::now() + timeout);
+  }
+
+  /**
+   * \brief Gets the number of items currently in the queue.
+   *
+   * \return  The number of items in the queue (only exact if neither side is active).
+   */
+  size_t size() const
+  {
+    return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+  }
+
+  /**
+   * \brief Pops an item from the queue if one is available, without waiting.
+   *
+   * \param item  The variable into which to move the item.
+   * \return      true, if an item was popped, or false otherwise.
+   */
+  bool try_pop(T& item)
+  {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if(m_tail.load(std::memory_order_acquire) == head) return false;
+
+    T& slot = m_buffer[head % m_capacity];
+    item = std::move(slot);
+
+    // Reset the slot so that it does not keep alive any resources shared with the popped item.
+    slot = T();
+
+    m_head.store(head + 1, std::memory_order_release);
+    notify(m_producerWaiting, m_itemPopped);
+    return true;
+  }
+
+  /**
+   * \brief Moves an item into the queue if there is a free slot, without waiting.
+   *
+   * If the item cannot be pushed, it is left untouched.
+   *
+   * \param item  The item to push.
+   * \return      true, if the item was pushed, or false if the queue is full or has been closed.
+   */
+  bool try_push(T& item)
+  {
+    if(m_closed.load(std::memory_order_relaxed)) return false;
+
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if(tail - m_head.load(std::memory_order_acquire) == m_capacity) return false;
+
+    m_buffer[tail % m_capacity] = std::move(item);
+    m_tail.store(tail + 1, std::memory_order_release);
+    notify(m_consumerWaiting, m_itemPushed);
+    return true;
+  }
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Wakes up the other side if it is waiting.
+   *
+   * The fence pairs with the one in wait_until: either the waiting thread sees the index that has just been
+   * published, or this thread sees its waiting flag and signals it under the mutex.
+   */
+  void notify(const std::atomic<bool>& waiting, boost::condition_variable& cond)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiting.load(std::memory_order_relaxed))
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      cond.notify_one();
+    }
+  }
+
+  bool pop_until(T& item, const boost::optional<boost::chrono::steady_clock::time_point>& deadline)
+  {
+    while(!try_pop(item))
+    {
+      if(m_closed.load())
+      {
+        // The producer may have pushed a last item just before closing the queue.
+        return try_pop(item);
+      }
+
+      if(!wait_until(m_consumerWaiting, m_itemPushed, deadline, &SPSCQueue::can_pop)) return try_pop(item);
+    }
+    return true;
+  }
+
+  bool push_until(T& item, const boost::optional<boost::chrono::steady_clock::time_point>& deadline)
+  {
+    while(!try_push(item))
+    {
+      if(m_closed.load()) return false;
+      if(!wait_until(m_producerWaiting, m_itemPopped, deadline, &SPSCQueue::can_push)) return try_push(item);
+    }
+    return true;
+  }
+
+  bool can_pop() const
+  {
+    return m_tail.load(std::memory_order_acquire) != m_head.load(std::memory_order_relaxed) || m_closed.load();
+  }
+
+  bool can_push() const
+  {
+    return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) != m_capacity || m_closed.load();
+  }
+
+  /**
+   * \brief Sleeps until the specified condition holds or the deadline (if any) passes.
+   *
+   * \return  false, if the deadline passed, or true otherwise.
+   */
+  bool wait_until(std::atomic<bool>& waiting, boost::condition_variable& cond, const boost::optional<boost::chrono::steady_clock::time_point>& deadline, bool (SPSCQueue::*ready)() const)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool result = true;
+    while(!(this->*ready)())
+    {
+      if(!deadline)
+      {
+        cond.wait(lock);
+      }
+      else if(cond.wait_until(lock, *deadline) == boost::cv_status::timeout)
+      {
+        result = (this->*ready)();
+        break;
+      }
+    }
+
+    waiting.store(false, std::memory_order_relaxed);
+    return result;
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * tvgutil: CounterBasedRandomNumberGenerator.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2016. All rights reserved.
+ */
+
+#ifndef H_TVGUTIL_COUNTERBASEDRANDOMNUMBERGENERATOR
+#define H_TVGUTIL_COUNTERBASEDRANDOMNUMBERGENERATOR
+
+#include <limits>
+
+#include <boost/cstdint.hpp>
+#include <boost/random.hpp>
+
+namespace tvgutil {
+
+/**
+ * \brief An instance of this class represents a counter-based random number generator.
+ *
+ * The n-th number of a stream is a hash of the stream's key and n (the SplitMix64 construction), so a stream is
+ * fully determined by its seed and stream identifiers and can be created anywhere at no cost. This makes it
+ * possible to give every unit of parallel work (e.g. every datum of every batch) its own stream, and to get the
+ * same numbers for that work whichever thread ends up doing it.
+ *
+ * Unlike RandomNumberGenerator, an instance of this class is not thread-safe: each thread should use its own.
+ * It models a Boost uniform random number generator, so it can also be used with the Boost.Random distributions.
+ */
+class CounterBasedRandomNumberGenerator
+{
+  //#################### TYPEDEFS ####################
+public:
+  typedef boost::uint64_t result_type;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The index of the next number in the stream. */
+  boost::uint64_t m_counter;
+
+  /** The key that identifies the stream. */
+  boost::uint64_t m_key;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a random number generator for the stream with the specified seed and identifiers.
+   *
+   * \param seed      The seed.
+   * \param stream    The identifier of the stream (e.g. a batch number).
+   * \param substream The identifier of the substream (e.g. the index of an item within a batch).
+   */
+  explicit CounterBasedRandomNumberGenerator(boost::uint64_t seed, boost::uint64_t stream = 0, boost::uint64_t substream = 0)
+  : m_counter(0), m_key(mix(mix(mix(seed) ^ stream) ^ substream))
+  {}
+
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  static result_type max() { return std::numeric_limits<result_type>::max(); }
+  static result_type min() { return 0; }
+
+  //#################### PUBLIC OPERATORS ####################
+public:
+  /**
+   * \brief Generates the next number in the stream.
+   *
+   * \return  A number drawn uniformly from [min(), max()].
+   */
+  result_type operator()()
+  {
+    return mix(m_key + ++m_counter * 0x9E3779B97F4A7C15ULL);
+  }
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Generates a random number from a 1D Gaussian distribution with the specified parameters.
+   *
+   * \param mean  The mean of the Gaussian distribution.
+   * \param sigma The standard deviation of the Gaussian distribution.
+   * \return      The generated number.
+   */
+  template <typename T = float>
+  T generate_from_gaussian(T mean, T sigma)
+  {
+    boost::random::normal_distribution<T> dist(mean, sigma);
+    return dist(*this);
+  }
+
+  /**
+   * \brief Generates a random integer from a uniform distribution over the specified (closed) range.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \return      The generated integer.
+   */
+  int generate_int_from_uniform(int lower, int upper)
+  {
+    boost::random::uniform_int_distribution<int> dist(lower, upper);
+    return dist(*this);
+  }
+
+  /**
+   * \brief Generates a random real number from a uniform distribution over the specified (closed) range.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \return      The generated real number.
+   */
+  template <typename T = float>
+  T generate_real_from_uniform(T lower, T upper)
+  {
+    boost::random::uniform_real_distribution<T> dist(lower, upper);
+    return dist(*this);
+  }
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Scrambles a 64-bit value (the SplitMix64 finaliser).
+   *
+   * \param x The value to scramble.
+   * \return  The scrambled value.
+   */
+  static boost::uint64_t mix(boost::uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,20 @@
+#include <darknet/blas.h>
+#include <darknet/gemm.h>
+#include <darknet/quantize.h>
+#include <darknet/winograd.h>
+
+int main()
+{
+  // Report the GFLOP/s of each CPU GEMM kernel on the layer shapes of yolo.cfg.
+  benchmark_gemm_cpu();
+
+  // Check the int8 kernels and report their throughput on the same shapes.
+  benchmark_int8_cpu();
+
+  // Compare the Winograd convolutions with im2col + GEMM on the 3x3 layers of yolo.cfg.
+  benchmark_winograd_cpu();
+
+  // Check the vectorised activation and element-wise kernels against the scalar code and time both.
+  benchmark_blas_cpu();
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <iostream>
+
+#include <boost/chrono.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <tvgshape/BitMask.h>
+#include <tvgshape/RadialShapeDescriptorCalculator.h>
+using namespace tvgshape;
+
+/**
+ * \brief Calculates the IoU of two masks of the same size byte by byte (as ShapeDescriptorUtil::calculate_IoU used to).
+ */
+double calculate_IoU_bytes(const cv::Mat1b& mask1, const cv::Mat1b& mask2)
+{
+  const unsigned char *p1 = mask1.data;
+  const unsigned char *p2 = mask2.data;
+
+  double Intersection = 0.0, Union = 0.0;
+  for(size_t i = 0, size = mask1.rows * mask1.cols; i < size; ++i)
+  {
+    if(p1[i] && p2[i]) ++Intersection;
+    if(p1[i] || p2[i]) ++Union;
+  }
+
+  return Intersection / Union;
+}
+
+/**
+ * \brief Makes a square mask containing a filled ellipse.
+ */
+cv::Mat1b make_ellipse_mask(int side, float cx, float cy, float rx, float ry)
+{
+  cv::Mat1b mask = cv::Mat1b::zeros(side, side);
+  for(int y = 0; y < side; ++y)
+  {
+    for(int x = 0; x < side; ++x)
+    {
+      float dx = (x - cx * side) / (rx * side), dy = (y - cy * side) / (ry * side);
+      if(dx * dx + dy * dy <= 1.0f) mask(y,x) = 255;
+    }
+  }
+  return mask;
+}
+
+/**
+ * \brief Times a function over enough repetitions to make the clock resolution negligible, returning the nanoseconds per call.
+ */
+template <typename F>
+double time_per_call(const F& f, int repetitions)
+{
+  boost::chrono::high_resolution_clock::time_point t0 = boost::chrono::high_resolution_clock::now();
+  for(int i = 0; i < repetitions; ++i) f();
+  boost::chrono::high_resolution_clock::time_point t1 = boost::chrono::high_resolution_clock::now();
+  return boost::chrono::duration_cast<boost::chrono::nanoseconds>(t1 - t0).count() / static_cast<double>(repetitions);
+}
+
+/**
+ * \brief Compares the byte-wise IoU with the bit-packed one on masks of several sizes.
+ */
+void benchmark_IoU()
+{
+  std::cout << "Comparing the byte-wise and bit-packed mask IoU (popcount kernel: " << BitMask::kernel_name() << ")\n";
+
+  const int sides[] = { 28, 64, 512 };
+  for(size_t i = 0; i < sizeof(sides) / sizeof(sides[0]); ++i)
+  {
+    const int side = sides[i];
+    const cv::Mat1b mask1 = make_ellipse_mask(side, 0.45f, 0.5f, 0.35f, 0.3f);
+    const cv::Mat1b mask2 = make_ellipse_mask(side, 0.55f, 0.5f, 0.3f, 0.35f);
+    const BitMask packed1(mask1), packed2(mask2);
+    const int repetitions = std::max(10, 20000000 / (side * side));
+
+    volatile double sink = 0.0;
+    const double bytesTime = time_per_call([&]() { sink = calculate_IoU_bytes(mask1, mask2); }, repetitions);
+    const double bytesIoU = sink;
+    const double packTime = time_per_call([&]() { sink = static_cast<double>(BitMask(mask2).area()); }, repetitions);
+    const double bitsTime = time_per_call([&]() { sink = packed1.calculate_IoU(packed2); }, repetitions);
+    const double bitsIoU = sink;
+
+    std::cout << side << 'x' << side << ": bytes " << bytesTime << " ns, pack " << packTime << " ns, packed IoU " << bitsTime
+              << " ns (" << bytesTime / bitsTime << "x, " << bytesTime / (packTime + bitsTime) << "x including one pack)"
+              << ", IoU " << bytesIoU << " vs " << bitsIoU << '\n';
+  }
+}
+
+/**
+ * \brief Compares the fast radial descriptor fitting with the exhaustive search on masks of several shapes and sizes.
+ */
+void benchmark_radial_fitting()
+{
+  std::cout << "\nComparing the fast and exhaustive radial descriptor fitting\n";
+
+  // The fast fitting must find a descriptor whose decoded mask is as good a fit, to within this tolerance.
+  const double tolerance = 0.01;
+
+  RadialShapeDescriptorCalculator calculator;
+  const size_t descriptorSizes[] = { 18, 34 };
+  const cv::Size maskSizes[] = { cv::Size(40, 60), cv::Size(150, 100), cv::Size(300, 280) };
+  for(size_t i = 0; i < sizeof(descriptorSizes) / sizeof(descriptorSizes[0]); ++i)
+  {
+    for(size_t j = 0; j < sizeof(maskSizes) / sizeof(maskSizes[0]); ++j)
+    {
+      // An ellipse, and a non-convex shape made of two overlapping ellipses.
+      const cv::Size& size = maskSizes[j];
+      const int side = std::max(size.width, size.height);
+      cv::Mat1b masks[2];
+      cv::resize(make_ellipse_mask(side, 0.5f, 0.45f, 0.4f, 0.3f), masks[0], size, 0.0, 0.0, cv::INTER_NEAREST);
+      cv::resize(make_ellipse_mask(side, 0.35f, 0.4f, 0.25f, 0.3f) | make_ellipse_mask(side, 0.65f, 0.6f, 0.3f, 0.2f), masks[1], size, 0.0, 0.0, cv::INTER_NEAREST);
+
+      for(int k = 0; k < 2; ++k)
+      {
+        std::vector<float> fast, exhaustive;
+        const double fastTime = time_per_call([&]() { fast = calculator.from_mask(masks[k], descriptorSizes[i]); }, 5);
+        const double exhaustiveTime = time_per_call([&]() { exhaustive = calculator.from_mask_exhaustive(masks[k], descriptorSizes[i]); }, 5);
+
+        const BitMask packedMask(masks[k]);
+        const double fastIoU = packedMask.calculate_IoU(BitMask(calculator.to_mask(fast, size)));
+        const double exhaustiveIoU = packedMask.calculate_IoU(BitMask(calculator.to_mask(exhaustive, size)));
+
+        std::cout << (k == 0 ? "ellipse " : "two ellipses ") << size.width << 'x' << size.height << ", " << descriptorSizes[i] << " parameters: fast "
+                  << fastTime / 1e6 << " ms, exhaustive " << exhaustiveTime / 1e6 << " ms (" << exhaustiveTime / fastTime << "x), IoU "
+                  << fastIoU << " vs " << exhaustiveIoU << (fast == exhaustive ? " (same descriptor)" : "")
+                  << (fastIoU < exhaustiveIoU - tolerance ? " OUT OF TOLERANCE" : "") << '\n';
+      }
+    }
+  }
+}
+
+int main()
+{
+  benchmark_IoU();
+  benchmark_radial_fitting();
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <iostream>
+
+#include <boost/chrono.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <core/RLEMask.h>
+
+/**
+ * \brief Makes a square mask containing a filled disc.
+ */
+cv::Mat1b make_disc_mask(int side, float cx, float cy, float r)
+{
+  cv::Mat1b mask = cv::Mat1b::zeros(side, side);
+  for(int y = 0; y < side; ++y)
+  {
+    for(int x = 0; x < side; ++x)
+    {
+      float dx = (x - cx * side) / (r * side), dy = (y - cy * side) / (r * side);
+      if(dx * dx + dy * dy <= 1.0f) mask(y,x) = 255;
+    }
+  }
+  return mask;
+}
+
+/**
+ * \brief Counts the pixels that are non-zero in both of two masks of the same size, byte by byte.
+ */
+size_t calculate_intersection_area_bytes(const cv::Mat1b& mask1, const cv::Mat1b& mask2)
+{
+  const unsigned char *p1 = mask1.data;
+  const unsigned char *p2 = mask2.data;
+
+  size_t result = 0;
+  for(size_t i = 0, size = mask1.rows * mask1.cols; i < size; ++i)
+  {
+    if(p1[i] && p2[i]) ++result;
+  }
+  return result;
+}
+
+/**
+ * \brief Times a function over enough repetitions to make the clock resolution negligible, returning the nanoseconds per call.
+ */
+template <typename F>
+double time_per_call(const F& f, int repetitions)
+{
+  boost::chrono::high_resolution_clock::time_point t0 = boost::chrono::high_resolution_clock::now();
+  for(int i = 0; i < repetitions; ++i) f();
+  boost::chrono::high_resolution_clock::time_point t1 = boost::chrono::high_resolution_clock::now();
+  return boost::chrono::duration_cast<boost::chrono::nanoseconds>(t1 - t0).count() / static_cast<double>(repetitions);
+}
+
+/**
+ * \brief Compares the intersection of two run-length-encoded disc masks with a byte-wise count on masks of several sizes.
+ */
+void benchmark_RLEMask_intersection()
+{
+  std::cout << "Comparing the byte-wise and run-length-encoded mask intersection\n";
+
+  const int sides[] = { 28, 100, 300 };
+  for(size_t i = 0; i < sizeof(sides) / sizeof(sides[0]); ++i)
+  {
+    const int side = sides[i];
+    const cv::Mat1b mask1 = make_disc_mask(side, 0.45f, 0.5f, 0.4f);
+    const cv::Mat1b mask2 = make_disc_mask(side, 0.55f, 0.5f, 0.4f);
+    const RLEMask rle1 = RLEMask::encode(mask1), rle2 = RLEMask::encode(mask2);
+    const int repetitions = std::max(10, 20000000 / (side * side));
+
+    volatile size_t sink = 0;
+    const double bytesTime = time_per_call([&]() { sink = calculate_intersection_area_bytes(mask1, mask2); }, repetitions);
+    const size_t bytesArea = sink;
+    const double rleTime = time_per_call([&]() { sink = rle1.calculate_intersection_area(rle2); }, repetitions);
+    const size_t rleArea = sink;
+
+    std::cout << side << 'x' << side << " (" << rle1.get_counts().size() << " runs): bytes " << bytesTime << " ns, RLE " << rleTime
+              << " ns (" << bytesTime / rleTime << "x), area " << bytesArea << " vs " << rleArea << '\n';
+  }
+}
+
+int main()
+{
+  benchmark_RLEMask_intersection();
+  return 0;
+}
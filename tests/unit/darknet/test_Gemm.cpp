@@ -0,0 +1,71 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <darknet/gemm.h>
+#include <darknet/utils.h>
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Computes op(A)*op(B) for row-major matrices one dot product at a time, in double precision.
+ */
+std::vector<double> reference_gemm(int TA, int TB, int M, int N, int K, const std::vector<float>& A, const std::vector<float>& B)
+{
+  const int lda = TA ? M : K, ldb = TB ? K : N;
+  std::vector<double> C(M * N, 0.0);
+  for(int i = 0; i < M; ++i)
+  {
+    for(int j = 0; j < N; ++j)
+    {
+      for(int k = 0; k < K; ++k)
+      {
+        const float a = TA ? A[k * lda + i] : A[i * lda + k];
+        const float b = TB ? B[j * ldb + k] : B[k * ldb + j];
+        C[i * N + j] += static_cast<double>(a) * b;
+      }
+    }
+  }
+  return C;
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_Gemm)
+
+BOOST_AUTO_TEST_CASE(gemm_cpu_beta_zero_test)
+{
+  srand(12345);
+  const int N = 37, K = 29;
+
+  // With BETA == 0, C should be overwritten without being read, whatever it held and however the product is
+  // evaluated (few rows of op(A), as for connected layers at batch 1, take a different path from many rows).
+  for(int M = 1; M <= 20; M += 3)
+  {
+    for(int TA = 0; TA < 2; ++TA)
+    {
+      for(int TB = 0; TB < 2; ++TB)
+      {
+        std::vector<float> A(M * K), B(K * N);
+        for(size_t i = 0, size = A.size(); i < size; ++i) A[i] = rand_uniform(-1.0f, 1.0f);
+        for(size_t i = 0, size = B.size(); i < size; ++i) B[i] = rand_uniform(-1.0f, 1.0f);
+
+        std::vector<float> C(M * N, std::numeric_limits<float>::quiet_NaN());
+        for(size_t i = 0; i < C.size(); i += 2) C[i] = std::numeric_limits<float>::infinity();
+
+        gemm_cpu(TA, TB, M, N, K, 1.0f, &A[0], TA ? M : K, &B[0], TB ? K : N, 0.0f, &C[0], N);
+
+        const std::vector<double> expected = reference_gemm(TA, TB, M, N, K, A, B);
+        for(int i = 0; i < M * N; ++i)
+        {
+          BOOST_CHECK_SMALL(C[i] - expected[i], 1e-4);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
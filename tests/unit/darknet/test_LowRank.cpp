@@ -0,0 +1,99 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <darknet/low_rank.h>
+#include <darknet/network.h>
+#include <darknet/parser.h>
+#include <darknet/utils.h>
+
+//#################### CONSTANTS ####################
+
+/** The batch the network buffers are allocated for. */
+const int ALLOCATED_BATCH = 4;
+
+/** The number of inputs to the network. */
+const int INPUTS = 32;
+
+/** The number of outputs of the network. */
+const int OUTPUTS = 10;
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Makes a network of two connected layers, allocated for ALLOCATED_BATCH images, from a configuration file
+ *        written to a temporary path.
+ */
+network make_connected_network()
+{
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("low_rank_%%%%-%%%%.cfg");
+  {
+    std::ofstream fs(path.string().c_str());
+    fs << "[net]\nbatch=" << ALLOCATED_BATCH << "\nsubdivisions=1\nheight=1\nwidth=1\nchannels=" << INPUTS << "\n\n"
+       << "[connected]\noutput=24\nactivation=leaky\n\n"
+       << "[connected]\noutput=" << OUTPUTS << "\nactivation=linear\n";
+  }
+
+  network net = parse_network_cfg(const_cast<char*>(path.string().c_str()));
+  boost::filesystem::remove(path);
+  return net;
+}
+
+/**
+ * \brief Runs a batch of images through a network and copies the output.
+ */
+std::vector<float> predict(network& net, std::vector<float>& input, int batch)
+{
+  set_batch_network(&net, batch);
+  const float *output = network_predict(net, &input[0]);
+  return std::vector<float>(output, output + batch * OUTPUTS);
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_LowRank)
+
+BOOST_AUTO_TEST_CASE(make_factorized_network_batch_test)
+{
+  srand(12345);
+  network net = make_connected_network();
+
+  std::vector<float> input(ALLOCATED_BATCH * INPUTS);
+  for(size_t i = 0, size = input.size(); i < size; ++i) input[i] = rand_uniform(-1.0f, 1.0f);
+
+  // Factorise the network while it runs one image at a time: the pair of layers must still be allocated for the batch
+  // the rest of the network was, not for the batch it happened to be running.
+  set_batch_network(&net, 1);
+  const int i = find_factorizable_layer(net);
+  BOOST_REQUIRE_EQUAL(i, 0);
+
+  const int rank = 8;
+  low_rank_factors factors = factorize_connected_layer(net.layers[i], rank);
+  network fnet = make_factorized_network(net, i, factors, rank);
+
+  // Each image of a full batch should come out as it does on its own.
+  const std::vector<float> actual = predict(fnet, input, ALLOCATED_BATCH);
+  BOOST_CHECK_EQUAL(fnet.layers[i].batch, ALLOCATED_BATCH);
+  BOOST_CHECK_EQUAL(fnet.layers[i + 1].batch, ALLOCATED_BATCH);
+  for(int b = 0; b < ALLOCATED_BATCH; ++b)
+  {
+    std::vector<float> image(input.begin() + b * INPUTS, input.begin() + (b + 1) * INPUTS);
+    const std::vector<float> expected = predict(fnet, image, 1);
+    for(int j = 0; j < OUTPUTS; ++j)
+    {
+      BOOST_CHECK_SMALL(actual[b * OUTPUTS + j] - expected[j], 1e-4f);
+    }
+  }
+
+  free_factorized_network(&fnet, i);
+  free_low_rank_factors(factors);
+  free_network(net);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
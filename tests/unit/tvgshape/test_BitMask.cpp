@@ -0,0 +1,183 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include <tvgshape/BitMask.h>
+using namespace tvgshape;
+
+//#################### CONSTANTS ####################
+
+/**
+ * Mask widths that straddle the 16-pixel blocks packed with SSE2 and the 64-pixel words, so that every kind of tail
+ * in the packing and shifting code gets exercised.
+ */
+const int WIDTHS[] = { 1, 5, 15, 16, 17, 31, 63, 64, 65, 79, 100, 127, 128, 129, 191, 200 };
+
+/** The number of widths in WIDTHS. */
+const size_t WIDTH_COUNT = sizeof(WIDTHS) / sizeof(WIDTHS[0]);
+
+/** The horizontal shifts between the masks compared, relative to the first one. */
+const int SHIFTS[] = { -129, -128, -65, -64, -63, -17, -1, 0, 1, 17, 63, 64, 65, 128, 129 };
+
+/** The number of shifts in SHIFTS. */
+const size_t SHIFT_COUNT = sizeof(SHIFTS) / sizeof(SHIFTS[0]);
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Makes a random mask of the specified size in which roughly the specified percentage of pixels are set,
+ *        each to an arbitrary non-zero value.
+ */
+cv::Mat1b make_random_mask(boost::mt19937& rng, int width, int height, int percentSet)
+{
+  boost::random::uniform_int_distribution<int> percent(0, 99), value(1, 255);
+  cv::Mat1b mask = cv::Mat1b::zeros(cv::Size(width, height));
+  for(int y = 0; y < height; ++y)
+  {
+    for(int x = 0; x < width; ++x)
+    {
+      if(percent(rng) < percentSet) mask(y,x) = static_cast<unsigned char>(value(rng));
+    }
+  }
+  return mask;
+}
+
+/**
+ * \brief Counts the non-zero pixels of a mask one byte at a time.
+ */
+size_t reference_area(const cv::Mat1b& mask)
+{
+  size_t result = 0;
+  for(int y = 0; y < mask.rows; ++y)
+  {
+    for(int x = 0; x < mask.cols; ++x)
+    {
+      if(mask(y,x) != 0) ++result;
+    }
+  }
+  return result;
+}
+
+/**
+ * \brief Counts the image pixels that are non-zero in both of two masks placed at the specified offsets, one byte at a time.
+ */
+size_t reference_intersection_area(const cv::Mat1b& lhs, const cv::Point& lhsOffset, const cv::Mat1b& rhs, const cv::Point& rhsOffset)
+{
+  size_t result = 0;
+  for(int y = 0; y < lhs.rows; ++y)
+  {
+    for(int x = 0; x < lhs.cols; ++x)
+    {
+      const int rx = x + lhsOffset.x - rhsOffset.x, ry = y + lhsOffset.y - rhsOffset.y;
+      if(rx < 0 || rx >= rhs.cols || ry < 0 || ry >= rhs.rows) continue;
+      if(lhs(y,x) != 0 && rhs(ry,rx) != 0) ++result;
+    }
+  }
+  return result;
+}
+
+/**
+ * \brief Checks the intersection and union of two masks, in both orders, against a byte-wise count.
+ */
+void check_intersection(const cv::Mat1b& lhs, const cv::Point& lhsOffset, const cv::Mat1b& rhs, const cv::Point& rhsOffset)
+{
+  const BitMask lhsBits(lhs, lhsOffset), rhsBits(rhs, rhsOffset);
+  const size_t expected = reference_intersection_area(lhs, lhsOffset, rhs, rhsOffset);
+  const size_t expectedUnion = reference_area(lhs) + reference_area(rhs) - expected;
+
+  BOOST_CHECK_EQUAL(lhsBits.calculate_intersection_area(rhsBits), expected);
+  BOOST_CHECK_EQUAL(rhsBits.calculate_intersection_area(lhsBits), expected);
+  BOOST_CHECK_EQUAL(lhsBits.calculate_union_area(rhsBits), expectedUnion);
+  BOOST_CHECK_EQUAL(rhsBits.calculate_union_area(lhsBits), expectedUnion);
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_BitMask)
+
+BOOST_AUTO_TEST_CASE(area_test)
+{
+  boost::mt19937 rng(12345);
+  for(size_t i = 0; i < WIDTH_COUNT; ++i)
+  {
+    const cv::Mat1b mask = make_random_mask(rng, WIDTHS[i], 7, 50);
+    const BitMask bits(mask, cv::Point(-3, 5));
+    BOOST_CHECK_EQUAL(bits.area(), reference_area(mask));
+
+    // Unpacking the mask should give back exactly the pixels that were set.
+    const cv::Mat1b unpacked = bits.to_mat();
+    BOOST_REQUIRE(unpacked.size() == mask.size());
+    for(int y = 0; y < mask.rows; ++y)
+    {
+      for(int x = 0; x < mask.cols; ++x)
+      {
+        BOOST_CHECK_EQUAL(unpacked(y,x) != 0, mask(y,x) != 0);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(calculate_intersection_area_shift_test)
+{
+  boost::mt19937 rng(12345);
+  boost::random::uniform_int_distribution<int> dy(-3, 3);
+  for(size_t i = 0; i < WIDTH_COUNT; ++i)
+  {
+    for(size_t j = 0; j < WIDTH_COUNT; j += 3)
+    {
+      const cv::Mat1b lhs = make_random_mask(rng, WIDTHS[i], 6, 60);
+      const cv::Mat1b rhs = make_random_mask(rng, WIDTHS[j], 6, 60);
+      for(size_t k = 0; k < SHIFT_COUNT; ++k)
+      {
+        const cv::Point lhsOffset(10, 20);
+        check_intersection(lhs, lhsOffset, rhs, cv::Point(lhsOffset.x + SHIFTS[k], lhsOffset.y + dy(rng)));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(calculate_intersection_area_random_test)
+{
+  boost::mt19937 rng(12345);
+  boost::random::uniform_int_distribution<int> size(1, 200), offset(-150, 150), percentSet(0, 100);
+  for(int i = 0; i < 200; ++i)
+  {
+    const cv::Mat1b lhs = make_random_mask(rng, size(rng), size(rng) / 10 + 1, percentSet(rng));
+    const cv::Mat1b rhs = make_random_mask(rng, size(rng), size(rng) / 10 + 1, percentSet(rng));
+    check_intersection(lhs, cv::Point(offset(rng), offset(rng) / 10), rhs, cv::Point(offset(rng), offset(rng) / 10));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(empty_test)
+{
+  boost::mt19937 rng(12345);
+  const cv::Mat1b mask = make_random_mask(rng, 70, 5, 50);
+  const BitMask bits(mask, cv::Point(2, 3));
+
+  // A default mask, a mask with no pixels and a mask with no pixels set should intersect nothing.
+  const BitMask defaultBits;
+  const BitMask zeroSizeBits(cv::Mat1b::zeros(cv::Size(0, 5)), cv::Point(2, 3));
+  const BitMask blankBits(cv::Mat1b::zeros(cv::Size(70, 5)), cv::Point(2, 3));
+
+  BOOST_CHECK(defaultBits.empty());
+  BOOST_CHECK(zeroSizeBits.empty());
+  BOOST_CHECK(!blankBits.empty());
+
+  const BitMask *emptyMasks[] = { &defaultBits, &zeroSizeBits, &blankBits };
+  for(size_t i = 0; i < sizeof(emptyMasks) / sizeof(emptyMasks[0]); ++i)
+  {
+    const BitMask& emptyBits = *emptyMasks[i];
+    BOOST_CHECK_EQUAL(emptyBits.area(), 0);
+    BOOST_CHECK_EQUAL(emptyBits.calculate_intersection_area(bits), 0);
+    BOOST_CHECK_EQUAL(bits.calculate_intersection_area(emptyBits), 0);
+    BOOST_CHECK_EQUAL(bits.calculate_union_area(emptyBits), reference_area(mask));
+    BOOST_CHECK(std::isnan(emptyBits.calculate_IoU(emptyBits)));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
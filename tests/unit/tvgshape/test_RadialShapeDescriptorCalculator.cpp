@@ -0,0 +1,90 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include <tvgshape/BitMask.h>
+#include <tvgshape/RadialShapeDescriptorCalculator.h>
+using namespace tvgshape;
+
+//#################### CONSTANTS ####################
+
+/**
+ * The most by which the IoU of the fast fit may fall below that of the exhaustive search. This is the bound documented
+ * at ESTIMATED_IOU_MARGIN in RadialShapeDescriptorCalculator.cpp: 2e - margin, with estimates within e = 0.02.
+ */
+const double IOU_TOLERANCE = 0.01;
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Makes a random mask of the specified size from a few ellipses, the last of which is cut out of the others
+ *        if makeHole is true.
+ */
+cv::Mat1b make_random_mask(boost::mt19937& rng, int width, int height, int ellipseCount, bool makeHole)
+{
+  boost::random::uniform_real_distribution<double> centre(0.25, 0.75), radius(0.1, 0.45);
+
+  std::vector<cv::Vec4d> ellipses(ellipseCount);
+  for(int i = 0; i < ellipseCount; ++i)
+  {
+    ellipses[i] = cv::Vec4d(centre(rng), centre(rng), radius(rng), radius(rng));
+  }
+
+  cv::Mat1b mask(height, width);
+  for(int y = 0; y < height; ++y)
+  {
+    for(int x = 0; x < width; ++x)
+    {
+      bool inside = false;
+      for(int i = 0; i < ellipseCount; ++i)
+      {
+        const cv::Vec4d& e = ellipses[i];
+        double dx = ((x + 0.5) / width - e[0]) / e[2], dy = ((y + 0.5) / height - e[1]) / e[3];
+        if(dx * dx + dy * dy <= 1.0) inside = !(makeHole && i == ellipseCount - 1);
+      }
+      mask(y,x) = inside ? 255 : 0;
+    }
+  }
+
+  return mask;
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_RadialShapeDescriptorCalculator)
+
+BOOST_AUTO_TEST_CASE(from_mask_test)
+{
+  RadialShapeDescriptorCalculator calculator;
+  boost::mt19937 rng(12345);
+  boost::random::uniform_int_distribution<int> side(20, 200), extraEllipses(1, 3);
+
+  for(int i = 0; i < 24; ++i)
+  {
+    // Single ellipses, unions of ellipses and ellipses with a bite taken out of them, at both descriptor sizes.
+    const int kind = i % 3;
+    const int width = side(rng), height = side(rng);
+    const cv::Mat1b mask = make_random_mask(rng, width, height, kind == 0 ? 1 : 1 + extraEllipses(rng), kind == 2);
+    const size_t descriptorSize = (i / 3) % 2 == 0 ? 18 : 34;
+
+    const std::vector<float> fast = calculator.from_mask(mask, descriptorSize);
+    const std::vector<float> exhaustive = calculator.from_mask_exhaustive(mask, descriptorSize);
+    if(fast == exhaustive) continue;
+
+    BOOST_REQUIRE_EQUAL(fast.size(), descriptorSize);
+    BOOST_REQUIRE_EQUAL(exhaustive.size(), descriptorSize);
+
+    const BitMask packedMask(mask);
+    const double fastIoU = packedMask.calculate_IoU(BitMask(calculator.to_mask(fast, mask.size())));
+    const double exhaustiveIoU = packedMask.calculate_IoU(BitMask(calculator.to_mask(exhaustive, mask.size())));
+    BOOST_CHECK_MESSAGE(fastIoU >= exhaustiveIoU - IOU_TOLERANCE, "shape " << i << " (" << width << 'x' << height << ", "
+                        << descriptorSize << " parameters): fast IoU " << fastIoU << ", exhaustive IoU " << exhaustiveIoU);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
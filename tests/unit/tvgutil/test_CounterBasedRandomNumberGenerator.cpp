@@ -0,0 +1,53 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <tvgutil/numbers/CounterBasedRandomNumberGenerator.h>
+using namespace tvgutil;
+
+BOOST_AUTO_TEST_SUITE(test_CounterBasedRandomNumberGenerator)
+
+BOOST_AUTO_TEST_CASE(generate_int_from_uniform_test)
+{
+  CounterBasedRandomNumberGenerator rng(1234);
+  BOOST_CHECK_EQUAL(rng.generate_int_from_uniform(23,23), 23);
+
+  for(int i = 0; i < 1000; ++i)
+  {
+    int x = rng.generate_int_from_uniform(-3,5);
+    BOOST_CHECK(x >= -3 && x <= 5);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(stream_test)
+{
+  // The same seed and stream identifiers always produce the same numbers.
+  CounterBasedRandomNumberGenerator a(1234, 7, 3), b(1234, 7, 3);
+  for(int i = 0; i < 100; ++i)
+  {
+    BOOST_CHECK_EQUAL(a(), b());
+  }
+
+  // Different streams produce different numbers.
+  CounterBasedRandomNumberGenerator c(1234, 7, 4), d(1234, 8, 3), e(1235, 7, 3);
+  CounterBasedRandomNumberGenerator f(1234, 7, 3);
+  const CounterBasedRandomNumberGenerator::result_type x = f();
+  BOOST_CHECK_NE(c(), x);
+  BOOST_CHECK_NE(d(), x);
+  BOOST_CHECK_NE(e(), x);
+}
+
+BOOST_AUTO_TEST_CASE(generate_real_from_uniform_test)
+{
+  CounterBasedRandomNumberGenerator rng(42);
+  double sum = 0.0;
+  const int n = 10000;
+  for(int i = 0; i < n; ++i)
+  {
+    float x = rng.generate_real_from_uniform(0.0f, 1.0f);
+    BOOST_CHECK(x >= 0.0f && x <= 1.0f);
+    sum += x;
+  }
+  BOOST_CHECK_CLOSE(sum / n, 0.5, 2.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,184 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+#include <memory>
+
+#include <boost/chrono/thread_clock.hpp>
+
+#include <tvgutil/containers/CircularQueue.h>
+#include <tvgutil/containers/SPSCQueue.h>
+using namespace tvgutil;
+
+typedef boost::shared_ptr<SPSCQueue<int> > Queue_Ptr;
+
+//#################### HELPERS ####################
+
+struct BenchmarkResult
+{
+  double consumerCpuMilliseconds;
+  double itemsPerSecond;
+};
+
+void produce_into_spsc_queue(const Queue_Ptr& queue, int itemCount, int microsecondsPerItem)
+{
+  for(int i = 0; i < itemCount; ++i)
+  {
+    if(microsecondsPerItem > 0) boost::this_thread::sleep_for(boost::chrono::microseconds(microsecondsPerItem));
+    queue->push(i);
+  }
+  queue->close();
+}
+
+void produce_into_circular_queue(CircularQueue<int>& queue, int itemCount, int microsecondsPerItem)
+{
+  for(int i = 0; i < itemCount; ++i)
+  {
+    if(microsecondsPerItem > 0) boost::this_thread::sleep_for(boost::chrono::microseconds(microsecondsPerItem));
+    while(!queue.push(i));
+  }
+}
+
+BenchmarkResult benchmark_spsc_queue(size_t capacity, int itemCount, int microsecondsPerItem)
+{
+  Queue_Ptr queue(new SPSCQueue<int>(capacity));
+  boost::chrono::thread_clock::time_point cpuStart = boost::chrono::thread_clock::now();
+  boost::chrono::steady_clock::time_point wallStart = boost::chrono::steady_clock::now();
+
+  boost::thread producer(&produce_into_spsc_queue, queue, itemCount, microsecondsPerItem);
+  int item, count = 0;
+  while(queue->pop(item)) ++count;
+  producer.join();
+
+  BenchmarkResult result;
+  result.consumerCpuMilliseconds = boost::chrono::duration<double,boost::milli>(boost::chrono::thread_clock::now() - cpuStart).count();
+  result.itemsPerSecond = count / boost::chrono::duration<double>(boost::chrono::steady_clock::now() - wallStart).count();
+  BOOST_CHECK_EQUAL(count, itemCount);
+  return result;
+}
+
+BenchmarkResult benchmark_circular_queue(size_t capacity, int itemCount, int microsecondsPerItem)
+{
+  // The circular queue leaves a one-slot gap between its read and write positions.
+  CircularQueue<int> queue(capacity + 1);
+  boost::chrono::thread_clock::time_point cpuStart = boost::chrono::thread_clock::now();
+  boost::chrono::steady_clock::time_point wallStart = boost::chrono::steady_clock::now();
+
+  boost::thread producer(&produce_into_circular_queue, boost::ref(queue), itemCount, microsecondsPerItem);
+  int count = 0;
+  while(count < itemCount)
+  {
+    if(queue.pop()) ++count;
+  }
+  producer.join();
+
+  BenchmarkResult result;
+  result.consumerCpuMilliseconds = boost::chrono::duration<double,boost::milli>(boost::chrono::thread_clock::now() - cpuStart).count();
+  result.itemsPerSecond = count / boost::chrono::duration<double>(boost::chrono::steady_clock::now() - wallStart).count();
+  return result;
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_SPSCQueue)
+
+BOOST_AUTO_TEST_CASE(fill_empty_test)
+{
+  SPSCQueue<int> queue(5);
+  for(int i = 0; i < 10; ++i)
+  {
+    int item = i;
+    BOOST_CHECK_EQUAL(queue.try_push(item), i < 5);
+  }
+  BOOST_CHECK_EQUAL(queue.size(), 5);
+
+  for(int i = 0; i < 10; ++i)
+  {
+    int item = -1;
+    BOOST_CHECK_EQUAL(queue.try_pop(item), i < 5);
+    if(i < 5) BOOST_CHECK_EQUAL(item, i);
+  }
+  BOOST_CHECK_EQUAL(queue.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(close_test)
+{
+  SPSCQueue<int> queue(3);
+  queue.push(1);
+  queue.push(2);
+  queue.close();
+
+  // Items pushed before the queue was closed can still be popped, but no new items are accepted.
+  BOOST_CHECK_EQUAL(queue.push(3), false);
+  int item;
+  BOOST_CHECK(queue.pop(item));
+  BOOST_CHECK_EQUAL(item, 1);
+  BOOST_CHECK(queue.pop(item));
+  BOOST_CHECK_EQUAL(item, 2);
+  BOOST_CHECK_EQUAL(queue.pop(item), false);
+}
+
+BOOST_AUTO_TEST_CASE(timeout_test)
+{
+  SPSCQueue<int> queue(1);
+  int item = 0;
+  BOOST_CHECK_EQUAL(queue.pop(item, boost::chrono::milliseconds(10)), false);
+
+  item = 7;
+  BOOST_CHECK(queue.push(item, boost::chrono::milliseconds(10)));
+  int other = 8;
+  BOOST_CHECK_EQUAL(queue.push(other, boost::chrono::milliseconds(10)), false);
+  BOOST_CHECK_EQUAL(other, 8);
+}
+
+BOOST_AUTO_TEST_CASE(move_only_test)
+{
+  SPSCQueue<std::unique_ptr<int> > queue(2);
+  queue.push(std::unique_ptr<int>(new int(42)));
+
+  std::unique_ptr<int> item;
+  BOOST_CHECK(queue.pop(item));
+  BOOST_CHECK_EQUAL(*item, 42);
+}
+
+BOOST_AUTO_TEST_CASE(ordering_test)
+{
+  const int itemCount = 100000;
+  Queue_Ptr queue(new SPSCQueue<int>(7));
+  boost::thread producer(&produce_into_spsc_queue, queue, itemCount, 0);
+
+  int item, expected = 0;
+  while(queue->pop(item))
+  {
+    BOOST_REQUIRE_EQUAL(item, expected);
+    ++expected;
+  }
+  producer.join();
+
+  BOOST_CHECK_EQUAL(expected, itemCount);
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_test)
+{
+  // A slow producer: a blocking consumer should use almost no CPU, whereas a spinning one uses a whole core.
+  const size_t capacity = 1024;
+  const int slowItemCount = 200, microsecondsPerItem = 1000;
+  BenchmarkResult spscSlow = benchmark_spsc_queue(capacity, slowItemCount, microsecondsPerItem);
+  BenchmarkResult circularSlow = benchmark_circular_queue(capacity, slowItemCount, microsecondsPerItem);
+
+  // A fast producer: measures the raw throughput of the two queues.
+  const int fastItemCount = 200000;
+  BenchmarkResult spscFast = benchmark_spsc_queue(capacity, fastItemCount, 0);
+  BenchmarkResult circularFast = benchmark_circular_queue(capacity, fastItemCount, 0);
+
+  std::cout << "Slow producer (" << slowItemCount << " items, " << microsecondsPerItem << "us each), consumer CPU time:\n"
+            << "  SPSCQueue:     " << spscSlow.consumerCpuMilliseconds << "ms\n"
+            << "  CircularQueue: " << circularSlow.consumerCpuMilliseconds << "ms\n"
+            << "Fast producer (" << fastItemCount << " items), throughput:\n"
+            << "  SPSCQueue:     " << spscFast.itemsPerSecond << " items/s\n"
+            << "  CircularQueue: " << circularFast.itemsPerSecond << " items/s\n";
+
+  BOOST_CHECK_LT(spscSlow.consumerCpuMilliseconds, circularSlow.consumerCpuMilliseconds);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
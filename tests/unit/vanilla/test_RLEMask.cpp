@@ -0,0 +1,209 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include <core/RLEMask.h>
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Makes a random mask of the specified size from a few filled rectangles, so that it has runs of various
+ *        lengths, some of which wrap from one column to the next, and then flips a few pixels at random.
+ */
+cv::Mat1b make_random_mask(boost::mt19937& rng, int width, int height)
+{
+  cv::Mat1b mask = cv::Mat1b::zeros(cv::Size(width, height));
+  if(width == 0 || height == 0) return mask;
+
+  boost::random::uniform_int_distribution<int> rectCount(0, 4), x(0, width - 1), y(0, height - 1), percent(0, 99);
+  for(int i = 0, count = rectCount(rng); i < count; ++i)
+  {
+    int x0 = x(rng), x1 = x(rng), y0 = y(rng), y1 = y(rng);
+    if(x1 < x0) std::swap(x0, x1);
+    if(y1 < y0) std::swap(y0, y1);
+    for(int v = y0; v <= y1; ++v)
+    {
+      for(int u = x0; u <= x1; ++u) mask(v,u) = 255;
+    }
+  }
+
+  for(int v = 0; v < height; ++v)
+  {
+    for(int u = 0; u < width; ++u)
+    {
+      if(percent(rng) < 5) mask(v,u) = mask(v,u) != 0 ? 0 : 255;
+    }
+  }
+
+  return mask;
+}
+
+/**
+ * \brief Paints a mask placed at the specified offset in the image into a canvas whose top-left corner is at origin.
+ */
+void paint_mask(const cv::Mat1b& mask, const cv::Point& offset, const cv::Point& origin, cv::Mat1b& canvas)
+{
+  for(int y = 0; y < mask.rows; ++y)
+  {
+    for(int x = 0; x < mask.cols; ++x)
+    {
+      if(mask(y,x) != 0) canvas(y + offset.y - origin.y, x + offset.x - origin.x) = 255;
+    }
+  }
+}
+
+/**
+ * \brief Checks the intersection and union of two masks, in both orders, against the pixel counts of the masks
+ *        painted into a canvas that covers both of them.
+ */
+void check_intersection(const cv::Mat1b& lhs, const cv::Point& lhsOffset, const cv::Mat1b& rhs, const cv::Point& rhsOffset)
+{
+  const cv::Point origin(std::min(lhsOffset.x, rhsOffset.x), std::min(lhsOffset.y, rhsOffset.y));
+  const cv::Size canvasSize(
+    std::max(lhsOffset.x + lhs.cols, rhsOffset.x + rhs.cols) - origin.x,
+    std::max(lhsOffset.y + lhs.rows, rhsOffset.y + rhs.rows) - origin.y
+  );
+
+  cv::Mat1b lhsCanvas = cv::Mat1b::zeros(canvasSize), rhsCanvas = cv::Mat1b::zeros(canvasSize);
+  paint_mask(lhs, lhsOffset, origin, lhsCanvas);
+  paint_mask(rhs, rhsOffset, origin, rhsCanvas);
+  const size_t expectedIntersection = static_cast<size_t>(cv::countNonZero(lhsCanvas & rhsCanvas));
+  const size_t expectedUnion = static_cast<size_t>(cv::countNonZero(lhsCanvas | rhsCanvas));
+
+  const RLEMask lhsRLE = RLEMask::encode(lhs, lhsOffset), rhsRLE = RLEMask::encode(rhs, rhsOffset);
+  BOOST_CHECK_EQUAL(lhsRLE.calculate_intersection_area(rhsRLE), expectedIntersection);
+  BOOST_CHECK_EQUAL(rhsRLE.calculate_intersection_area(lhsRLE), expectedIntersection);
+  BOOST_CHECK_EQUAL(lhsRLE.calculate_union_area(rhsRLE), expectedUnion);
+  BOOST_CHECK_EQUAL(rhsRLE.calculate_union_area(lhsRLE), expectedUnion);
+}
+
+/**
+ * \brief Checks that a mask survives being encoded and decoded, and that the area of the encoding is right.
+ */
+void check_round_trip(const cv::Mat1b& mask, const cv::Point& offset)
+{
+  const RLEMask rle = RLEMask::encode(mask, offset);
+  BOOST_CHECK_EQUAL(rle.area(), static_cast<size_t>(cv::countNonZero(mask)));
+  BOOST_CHECK(rle.get_offset() == offset);
+  BOOST_REQUIRE(rle.get_size() == mask.size());
+
+  const cv::Mat1b decoded = rle.decode();
+  BOOST_REQUIRE(decoded.size() == mask.size());
+  for(int y = 0; y < mask.rows; ++y)
+  {
+    for(int x = 0; x < mask.cols; ++x)
+    {
+      BOOST_CHECK_EQUAL(decoded(y,x) != 0, mask(y,x) != 0);
+    }
+  }
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_RLEMask)
+
+BOOST_AUTO_TEST_CASE(round_trip_test)
+{
+  boost::mt19937 rng(12345);
+  boost::random::uniform_int_distribution<int> size(1, 40), offset(-20, 20);
+  for(int i = 0; i < 100; ++i)
+  {
+    check_round_trip(make_random_mask(rng, size(rng), size(rng)), cv::Point(offset(rng), offset(rng)));
+  }
+
+  // A mask that starts with foreground has an empty first background run, and one that is all foreground has a
+  // single run that spans every column.
+  cv::Mat1b mask = cv::Mat1b::zeros(cv::Size(6, 5));
+  mask(0,0) = 255;
+  check_round_trip(mask, cv::Point(3, 4));
+  BOOST_CHECK_EQUAL(RLEMask::encode(mask).get_counts()[0], 0);
+
+  const cv::Mat1b full(cv::Size(6, 5), 255);
+  check_round_trip(full, cv::Point(0, 0));
+  BOOST_CHECK_EQUAL(RLEMask::encode(full).get_counts().size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(constructor_test)
+{
+  std::vector<boost::uint32_t> counts;
+  counts.push_back(3);
+  counts.push_back(4);
+  counts.push_back(5);
+
+  const RLEMask mask(cv::Point(1, 2), cv::Size(3, 4), counts);
+  BOOST_CHECK_EQUAL(mask.area(), 4);
+
+  // Run lengths that do not cover the mask exactly should be rejected.
+  counts.push_back(1);
+  BOOST_CHECK_THROW(RLEMask(cv::Point(1, 2), cv::Size(3, 4), counts), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(calculate_intersection_area_test)
+{
+  // Two masks that are all foreground, so that each is a single run that wraps through every column. The first
+  // covers image columns 2-6 and rows 3-9, the second columns 5-12 and rows 1-6.
+  const cv::Mat1b lhs(cv::Size(5, 7), 255), rhs(cv::Size(8, 6), 255);
+  check_intersection(lhs, cv::Point(2, 3), rhs, cv::Point(5, 1));
+  BOOST_CHECK_EQUAL(RLEMask::encode(lhs, cv::Point(2, 3)).calculate_intersection_area(RLEMask::encode(rhs, cv::Point(5, 1))), 2 * 4);
+
+  // The same masks, placed so that their rectangles only touch at the edges, or do not meet at all.
+  check_intersection(lhs, cv::Point(0, 0), rhs, cv::Point(5, 0));
+  check_intersection(lhs, cv::Point(0, 0), rhs, cv::Point(0, 7));
+  check_intersection(lhs, cv::Point(-20, -20), rhs, cv::Point(20, 20));
+
+  // Masks whose rectangles overlap, but whose foregrounds do not.
+  cv::Mat1b left = cv::Mat1b::zeros(cv::Size(10, 10)), right = cv::Mat1b::zeros(cv::Size(10, 10));
+  for(int y = 0; y < 10; ++y)
+  {
+    for(int x = 0; x < 5; ++x) left(y,x) = 255;
+    for(int x = 5; x < 10; ++x) right(y,x) = 255;
+  }
+  check_intersection(left, cv::Point(0, 0), right, cv::Point(0, 0));
+  BOOST_CHECK_EQUAL(RLEMask::encode(left).calculate_intersection_area(RLEMask::encode(right)), 0);
+}
+
+BOOST_AUTO_TEST_CASE(calculate_intersection_area_random_test)
+{
+  boost::mt19937 rng(12345);
+  boost::random::uniform_int_distribution<int> size(1, 30), offset(-20, 20);
+  for(int i = 0; i < 300; ++i)
+  {
+    const cv::Mat1b lhs = make_random_mask(rng, size(rng), size(rng));
+    const cv::Mat1b rhs = make_random_mask(rng, size(rng), size(rng));
+    check_intersection(lhs, cv::Point(offset(rng), offset(rng)), rhs, cv::Point(offset(rng), offset(rng)));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(empty_test)
+{
+  const cv::Mat1b full(cv::Size(6, 5), 255);
+  const RLEMask fullRLE = RLEMask::encode(full, cv::Point(1, 1));
+
+  // A default mask, masks with no pixels and a mask with no foreground should intersect nothing.
+  std::vector<RLEMask> emptyMasks;
+  emptyMasks.push_back(RLEMask());
+  emptyMasks.push_back(RLEMask::encode(cv::Mat1b::zeros(cv::Size(0, 0)), cv::Point(2, 2)));
+  emptyMasks.push_back(RLEMask::encode(cv::Mat1b::zeros(cv::Size(0, 5)), cv::Point(2, 2)));
+  emptyMasks.push_back(RLEMask::encode(cv::Mat1b::zeros(cv::Size(6, 5)), cv::Point(1, 1)));
+
+  BOOST_CHECK(emptyMasks[0].empty());
+  BOOST_CHECK(emptyMasks[1].empty());
+  BOOST_CHECK(emptyMasks[2].empty());
+  BOOST_CHECK(!emptyMasks[3].empty());
+
+  for(size_t i = 0, size = emptyMasks.size(); i < size; ++i)
+  {
+    BOOST_CHECK_EQUAL(emptyMasks[i].area(), 0);
+    BOOST_CHECK_EQUAL(emptyMasks[i].calculate_intersection_area(fullRLE), 0);
+    BOOST_CHECK_EQUAL(fullRLE.calculate_intersection_area(emptyMasks[i]), 0);
+    BOOST_CHECK_EQUAL(fullRLE.calculate_union_area(emptyMasks[i]), fullRLE.area());
+    BOOST_CHECK_EQUAL(cv::countNonZero(emptyMasks[i].decode()), 0);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,62 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <vector>
+
+#include <dataset/VOCSegmentationAnnotation.h>
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Makes a cached instance that covers the specified rectangle of the image.
+ */
+SegmentationAnnotationCache::CachedObject make_cached_object(size_t categoryId, const cv::Rect& rect)
+{
+  SegmentationAnnotationCache::CachedObject cachedObject;
+  cachedObject.categoryId = categoryId;
+  cachedObject.box = VOCBox(rect.x, rect.y, rect.x + rect.width - 1, rect.y + rect.height - 1);
+  cachedObject.mask = RLEMask::encode(cv::Mat1b(rect.size(), 255), rect.tl());
+  return cachedObject;
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_VOCSegmentationAnnotation)
+
+BOOST_AUTO_TEST_CASE(get_objects_from_cache_overlap_test)
+{
+  std::map<size_t,std::string> categoryIdToName;
+  categoryIdToName[1] = "person";
+  categoryIdToName[2] = "horse";
+  VOCAnnotation::set_category_id_to_name(categoryIdToName);
+
+  // Two instances that share a 10x9 block of pixels.
+  const cv::Size imageSize(40, 30);
+  std::vector<SegmentationAnnotationCache::CachedObject> cachedObjects;
+  cachedObjects.push_back(make_cached_object(1, cv::Rect(4, 4, 20, 15)));
+  cachedObjects.push_back(make_cached_object(2, cv::Rect(14, 10, 20, 15)));
+
+  // A transformation that only flips the image horizontally, so each instance should come back whole and mirrored.
+  const DataTransformation flip(0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, true, imageSize.width, imageSize.height);
+
+  const VOCSegmentationAnnotation annotation("2007_000001.png", "2007_000001.png");
+  const std::vector<VOCObject> objects = annotation.get_objects_from_cache(cachedObjects, imageSize, flip);
+  BOOST_REQUIRE_EQUAL(objects.size(), cachedObjects.size());
+
+  for(size_t i = 0, size = objects.size(); i < size; ++i)
+  {
+    const VOCBox& box = cachedObjects[i].box;
+    const VOCBox expectedBox(imageSize.width - 1 - box.xmax, box.ymin, imageSize.width - 1 - box.xmin, box.ymax);
+    const VOCBox actualBox = objects[i].rep.get_voc_box();
+
+    BOOST_CHECK_EQUAL(objects[i].categoryId, static_cast<int>(cachedObjects[i].categoryId));
+    BOOST_CHECK_EQUAL(actualBox.xmin, expectedBox.xmin);
+    BOOST_CHECK_EQUAL(actualBox.ymin, expectedBox.ymin);
+    BOOST_CHECK_EQUAL(actualBox.xmax, expectedBox.xmax);
+    BOOST_CHECK_EQUAL(actualBox.ymax, expectedBox.ymax);
+    BOOST_CHECK_EQUAL(cv::countNonZero(objects[i].rep.get_mask()), expectedBox.area());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()